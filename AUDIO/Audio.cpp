@@ -1,7 +1,7 @@
 #define MINIAUDIO_IMPLEMENTATION
 #include "Audio.h"
 #include "NETWORKING/CNetworking.h"
-#include <iostream>
+#include "UTILS/Logger.h"
 #include <thread>
 #include <vector>
 
@@ -38,7 +38,7 @@ namespace AUDIO {
 
         ma_result result = ma_engine_init(NULL, &engine);
         if (result != MA_SUCCESS) {
-            std::cerr << "Failed to initialize audio engine." << std::endl;
+            LOG_ERROR(Audio, "Failed to initialize audio engine.");
             return;
         }
         isInitialized = true;
@@ -68,16 +68,15 @@ namespace AUDIO {
             try {
                 auto downloadResult = Curl::Get(url);
                 if (downloadResult.empty()) {
-                    std::cerr << "Download failed or returned empty data for: " << url
-                              << std::endl;
+                    LOG_ERROR(Audio, "Download failed or returned empty data for: {}", url);
                     return;
                 }
 
                 // Safety limit
                 const size_t MAX_AUDIO_SIZE = 50 * 1024 * 1024; // 50MB
                 if (downloadResult.size() > MAX_AUDIO_SIZE) {
-                    std::cerr << "Audio file too large (" << downloadResult.size()
-                              << " bytes) for: " << url << std::endl;
+                    LOG_ERROR(Audio, "Audio file too large ({} bytes) for: {}",
+                              downloadResult.size(), url);
                     return;
                 }
 
@@ -87,7 +86,7 @@ namespace AUDIO {
                 ma_result result = ma_decoder_init_memory(
                         audioData.data(), audioData.size(), NULL, decoder);
                 if (result != MA_SUCCESS) {
-                    std::cerr << "Failed to decode audio from URL: " << url << std::endl;
+                    LOG_ERROR(Audio, "Failed to decode audio from URL: {}", url);
                     delete decoder;
                     return;
                 }
@@ -97,8 +96,7 @@ namespace AUDIO {
                 result = ma_sound_init_from_data_source(&engine, decoder, 0, NULL, sound);
 
                 if (result != MA_SUCCESS) {
-                    std::cerr << "Failed to init sound from decoded URL data: " << url
-                              << std::endl;
+                    LOG_ERROR(Audio, "Failed to init sound from decoded URL data: {}", url);
                     ma_decoder_uninit(decoder);
                     delete decoder;
                     delete sound;
@@ -112,8 +110,7 @@ namespace AUDIO {
                 ma_sound_start(sound);
 
             } catch (const std::exception &e) {
-                std::cerr << "Audio download/play failed for URL " << url << ": "
-                          << e.what() << std::endl;
+                LOG_ERROR(Audio, "Audio download/play failed for URL {}: {}", url, e.what());
             }
         }).detach(); // Detach the thread to let it run in the background
     }
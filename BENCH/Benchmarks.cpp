@@ -0,0 +1,212 @@
+#include "Harness.h"
+#include "../Dependencies/ImGui/imgui.h"
+#include "../Dependencies/quickjs/quickjs.h"
+#include "FS/MainFileSystem.h"
+#include "NETWORKING/CNetworking.h"
+#include "SCRIPTING/ImGuiBindings.h"
+#include "SCRIPTING/ScriptArena.h"
+#include "UI/GuiTaskQueue.h"
+#include "UI/Image/image.h"
+#include "UI/SettingsMenu.h"
+#include "UTILS/ThreadPool.h"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace BENCH {
+
+    namespace {
+        constexpr int kImageSide = 256;
+        constexpr int kProducers = 4;
+
+        // Synthetic RGBA image with a pristine backup, as if decoded from disk
+        std::unique_ptr<CImage> MakeImage() {
+            std::vector<unsigned char> px((std::size_t)kImageSide * kImageSide * 4);
+            for (std::size_t i = 0; i < px.size(); i++)
+                px[i] = (unsigned char)((i * 2654435761u) >> 24);
+            auto img = std::make_unique<CImage>("bench");
+            img->SetPixels(px.data(), kImageSide, kImageSide);
+            return img;
+        }
+
+        // One ImGui context and one QuickJS context with the ui object, shared
+        // by the binding benchmarks. Every batch runs inside its own frame.
+        struct ScriptFixture {
+            JSRuntime *rt = nullptr;
+            JSContext *ctx = nullptr;
+
+            ScriptFixture() {
+                ImGui::CreateContext();
+                ImGuiIO &io = ImGui::GetIO();
+                io.DisplaySize = ImVec2(1280, 720);
+                io.IniFilename = nullptr;
+                // Large batches would otherwise overflow 16-bit indices
+                io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+                unsigned char *px;
+                int w, h;
+                io.Fonts->GetTexDataAsRGBA32(&px, &w, &h);
+
+                rt = JS_NewRuntime();
+                ctx = JS_NewContext(rt);
+                SCR::install_ui_object(ctx);
+
+                static const char kSrc[] = R"(
+                    function bench_noop() {}
+                    function bench_js(n) { for (let i = 0; i < n; i++) bench_noop(); }
+                    function bench_frame(n) { for (let i = 0; i < n; i++) ui.frame(); }
+                    function bench_text(n) { for (let i = 0; i < n; i++) ui.text("bench"); }
+                    function bench_button(n) { for (let i = 0; i < n; i++) ui.button("bench"); }
+                )";
+                JS_FreeValue(ctx, JS_Eval(ctx, kSrc, sizeof(kSrc) - 1, "<bench>", JS_EVAL_TYPE_GLOBAL));
+            }
+
+            void Call(const char *fn, uint64_t n) {
+                ImGuiIO &io = ImGui::GetIO();
+                io.DeltaTime = 1.0f / 60.0f;
+                ImGui::NewFrame();
+                ImGui::Begin("bench");
+
+                JSValue global = JS_GetGlobalObject(ctx);
+                JSValue func = JS_GetPropertyStr(ctx, global, fn);
+                JSValue arg = JS_NewFloat64(ctx, (double)n);
+                JS_FreeValue(ctx, JS_Call(ctx, func, JS_UNDEFINED, 1, &arg));
+                JS_FreeValue(ctx, func);
+                JS_FreeValue(ctx, global);
+
+                ImGui::End();
+                ImGui::EndFrame();
+            }
+        };
+
+        // A whole short script run: runtime, context, an allocation heavy
+        // body, teardown. `arena` picks the allocator RunScriptJob uses.
+        void ScriptLifecycle(bool arena) {
+            static const char kSrc[] = R"(
+                let rows = [];
+                for (let i = 0; i < 2000; i++) rows.push({ id: i, name: 'row' + i, tags: [i, i + 1] });
+                JSON.stringify(rows).length;
+            )";
+            SCR::CScriptArena pool;
+            JSRuntime *rt = arena ? pool.NewRuntime() : JS_NewRuntime();
+            JSContext *ctx = JS_NewContext(rt);
+            JS_FreeValue(ctx, JS_Eval(ctx, kSrc, sizeof(kSrc) - 1, "<bench>", JS_EVAL_TYPE_GLOBAL));
+            JS_FreeContext(ctx);
+            JS_FreeRuntime(rt);
+        }
+
+        ScriptFixture &Script() {
+            static ScriptFixture fixture;
+            return fixture;
+        }
+    }
+
+    void RegisterBenchmarks(CHarness &h) {
+        // ThreadPool: one task at a time, submit to completion
+        h.Add("threadpool/submit_roundtrip", [](uint64_t n) {
+            static ThreadPool pool(4);
+            for (uint64_t i = 0; i < n; i++) {
+                std::atomic<bool> done{false};
+                pool.Add([&done] { done.store(true, std::memory_order_release); });
+                while (!done.load(std::memory_order_acquire))
+                    std::this_thread::yield();
+            }
+        });
+
+        // ThreadPool: n tasks in flight at once
+        h.Add("threadpool/submit_throughput", [](uint64_t n) {
+            static ThreadPool pool(4);
+            std::atomic<uint64_t> ran{0};
+            for (uint64_t i = 0; i < n; i++)
+                pool.Add([&ran] { ran.fetch_add(1, std::memory_order_relaxed); });
+            while (ran.load(std::memory_order_relaxed) < n)
+                std::this_thread::yield();
+        });
+
+        // GuiTaskQueue: kProducers threads push while this thread drains
+        h.Add("guitaskqueue/push_pop_contended", [](uint64_t n) {
+            GuiTaskQueue queue;
+            const uint64_t perProducer = std::max<uint64_t>(1, n / kProducers);
+            std::vector<std::thread> producers;
+            for (int p = 0; p < kProducers; p++)
+                producers.emplace_back([&queue, perProducer] {
+                    for (uint64_t i = 0; i < perProducer; i++)
+                        queue.push([] {});
+                });
+
+            uint64_t popped = 0;
+            GuiTaskQueue::Task task;
+            while (popped < perProducer * kProducers) {
+                if (queue.pop(task)) {
+                    task();
+                    ++popped;
+                }
+            }
+            for (auto &t : producers)
+                t.join();
+        });
+
+        h.Add("image/recolour_256", [](uint64_t n) {
+            static std::unique_ptr<CImage> img = MakeImage();
+            for (uint64_t i = 0; i < n; i++)
+                img->RecolourPixels(ImVec4(0.3f, 0.4f, 0.9f, 1.0f), ImVec4(1.0f, 0.65f, 0.0f, 1.0f), 0.05f);
+            DoNotOptimize(img->GetPixels()[0]);
+        });
+
+        h.Add("image/compute_hash_256", [](uint64_t n) {
+            static std::unique_ptr<CImage> img = MakeImage();
+            for (uint64_t i = 0; i < n; i++)
+                DoNotOptimize(img->ComputeHash());
+        });
+
+        h.Add("net/url_encode_256", [](uint64_t n) {
+            static const std::string input = [] {
+                std::string s;
+                for (int i = 0; i < 256; i++)
+                    s.push_back("abc XYZ-_.~/?&=%#\xc3\xa9"[i % 20]);
+                return s;
+            }();
+            for (uint64_t i = 0; i < n; i++)
+                DoNotOptimize(NETWORKING::url_encode(input).size());
+        });
+
+        // JS -> native: a pure JS call first, as the baseline to subtract
+        h.Add("js/call_js_function", [](uint64_t n) { Script().Call("bench_js", n); });
+        h.Add("js/ui_frame", [](uint64_t n) { Script().Call("bench_frame", n); });
+        h.Add("js/ui_text", [](uint64_t n) { Script().Call("bench_text", n); });
+        h.Add("js/ui_button", [](uint64_t n) { Script().Call("bench_button", n); });
+
+        h.Add("js/run_default_malloc", [](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+                ScriptLifecycle(false);
+        });
+        h.Add("js/run_script_arena", [](uint64_t n) {
+            for (uint64_t i = 0; i < n; i++)
+                ScriptLifecycle(true);
+        });
+
+        h.Add("settings/serialize", [](uint64_t n) {
+            GUI::CSettings settings;
+            for (uint64_t i = 0; i < n; i++)
+                DoNotOptimize(settings.Serialize().size());
+        });
+
+        h.Add("settings/deserialize", [](uint64_t n) {
+            static const std::string text = GUI::CSettings{}.Serialize();
+            for (uint64_t i = 0; i < n; i++) {
+                GUI::CSettings settings;
+                DoNotOptimize(settings.Deserialize(text));
+            }
+        });
+
+        // What the settings writer does per save: serialize plus atomic replace
+        h.Add("settings/save_atomic", [](uint64_t n) {
+            static const std::filesystem::path file =
+                    std::filesystem::temp_directory_path() / "nexus_bench_settings.json";
+            GUI::CSettings settings;
+            for (uint64_t i = 0; i < n; i++)
+                DoNotOptimize(FS::CFileSystem::WriteFileAtomic(file, settings.Serialize()));
+        });
+    }
+}
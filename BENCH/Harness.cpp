@@ -0,0 +1,96 @@
+#include "Harness.h"
+#include "../Dependencies/json/json.hpp"
+#include "../UTILS/BuildInfo.h"
+#include "fmt/core.h"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+
+namespace BENCH {
+
+    namespace {
+        double SampleNs(const BenchBody &body, uint64_t n) {
+            const auto t0 = std::chrono::steady_clock::now();
+            body(n);
+            const auto t1 = std::chrono::steady_clock::now();
+            return std::chrono::duration<double, std::nano>(t1 - t0).count();
+        }
+    }
+
+    void CHarness::Add(std::string name, BenchBody body) {
+        entries.push_back({std::move(name), std::move(body)});
+    }
+
+    std::vector<std::string> CHarness::Names() const {
+        std::vector<std::string> names;
+        for (const Entry &e : entries)
+            names.push_back(e.name);
+        return names;
+    }
+
+    std::vector<BenchResult> CHarness::Run(const std::string &filter) const {
+        const double target = std::chrono::duration<double, std::nano>(kTargetSample).count();
+
+        std::vector<BenchResult> results;
+        for (const Entry &e : entries) {
+            if (!filter.empty() && e.name.find(filter) == std::string::npos)
+                continue;
+
+            // Calibrate, which doubles as warm-up
+            uint64_t n = 1;
+            for (;;) {
+                const double ns = SampleNs(e.body, n);
+                if (ns >= target || n >= (1ull << 32))
+                    break;
+                const double grow = ns > 0.0 ? target / ns : 100.0;
+                n = (uint64_t)std::max<double>((double)n * 2.0, std::min((double)n * grow * 1.2, (double)n * 100.0));
+            }
+
+            std::vector<double> perOp;
+            perOp.reserve(kSamples);
+            for (int i = 0; i < kSamples; i++)
+                perOp.push_back(SampleNs(e.body, n) / (double)n);
+            std::sort(perOp.begin(), perOp.end());
+
+            BenchResult r;
+            r.name = e.name;
+            r.batch = n;
+            r.samples = kSamples;
+            r.min_ns = perOp.front();
+            r.max_ns = perOp.back();
+            r.median_ns = perOp[perOp.size() / 2];
+            double sum = 0.0;
+            for (double v : perOp)
+                sum += v;
+            r.mean_ns = sum / perOp.size();
+            double sq = 0.0;
+            for (double v : perOp)
+                sq += (v - r.mean_ns) * (v - r.mean_ns);
+            r.stddev_ns = std::sqrt(sq / (perOp.size() - 1));
+
+            fmt::print(stderr, "{:<40} {:>12.1f} ns/op  (min {:.1f}, stddev {:.1f}, batch {})\n", r.name,
+                       r.median_ns, r.min_ns, r.stddev_ns, r.batch);
+            results.push_back(std::move(r));
+        }
+        return results;
+    }
+
+    std::string CHarness::ToJson(const std::vector<BenchResult> &results) {
+        nlohmann::json doc;
+        doc["build"] = UTILS::BuildDescription();
+        doc["timestamp"] = (int64_t)std::time(nullptr);
+        doc["results"] = nlohmann::json::array();
+        for (const BenchResult &r : results) {
+            doc["results"].push_back({{"name", r.name},
+                                      {"batch", r.batch},
+                                      {"samples", r.samples},
+                                      {"ns_per_op",
+                                       {{"min", r.min_ns},
+                                        {"median", r.median_ns},
+                                        {"mean", r.mean_ns},
+                                        {"stddev", r.stddev_ns},
+                                        {"max", r.max_ns}}}});
+        }
+        return doc.dump(2);
+    }
+}
@@ -0,0 +1,56 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace BENCH {
+
+    // Per-operation timings of one benchmark
+    struct BenchResult {
+        std::string name;
+        uint64_t batch = 0; // operations per sample
+        int samples = 0;
+        double min_ns = 0.0;
+        double median_ns = 0.0;
+        double mean_ns = 0.0;
+        double stddev_ns = 0.0;
+        double max_ns = 0.0;
+    };
+
+    // A body performs `n` operations each time it is called
+    using BenchBody = std::function<void(uint64_t n)>;
+
+    // Minimal harness: the batch size is grown until one sample takes about
+    // kTargetSample, then kSamples samples are timed and reduced per operation.
+    class CHarness {
+        public:
+            void Add(std::string name, BenchBody body);
+
+            // Runs every benchmark whose name contains `filter`
+            std::vector<BenchResult> Run(const std::string &filter) const;
+            std::vector<std::string> Names() const;
+
+            static std::string ToJson(const std::vector<BenchResult> &results);
+
+            static constexpr int kSamples = 15;
+            static constexpr std::chrono::milliseconds kTargetSample{20};
+
+        private:
+            struct Entry {
+                std::string name;
+                BenchBody body;
+            };
+            std::vector<Entry> entries;
+    };
+
+    // Keeps the optimiser from dropping work whose result is never used
+    inline void DoNotOptimize(std::size_t value) {
+        static volatile std::size_t sink;
+        sink = value;
+    }
+
+    void RegisterBenchmarks(CHarness &harness);
+}
@@ -0,0 +1,49 @@
+#include "Harness.h"
+#include "fmt/core.h"
+#include <cstring>
+#include <fstream>
+
+// nexus_bench [--filter <substring>] [--out <file.json>] [--list]
+//
+// Human readable lines go to stderr, the JSON report to stdout (or --out)
+// so two builds can be compared by diffing or scripting over the reports.
+int main(int argc, char **argv) {
+    std::string filter;
+    std::string out;
+    bool list = false;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+            out = argv[++i];
+        else if (!std::strcmp(argv[i], "--list"))
+            list = true;
+        else {
+            fmt::print(stderr, "usage: {} [--filter <substring>] [--out <file.json>] [--list]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    BENCH::CHarness harness;
+    BENCH::RegisterBenchmarks(harness);
+
+    if (list) {
+        for (const std::string &name : harness.Names())
+            fmt::print("{}\n", name);
+        return 0;
+    }
+
+    const std::string json = BENCH::CHarness::ToJson(harness.Run(filter));
+    if (out.empty()) {
+        fmt::print("{}\n", json);
+        return 0;
+    }
+
+    std::ofstream ofs(out, std::ios::trunc);
+    if (!ofs) {
+        fmt::print(stderr, "cannot write {}\n", out);
+        return 1;
+    }
+    ofs << json << '\n';
+    return 0;
+}
@@ -49294,6 +49294,12 @@ static __exception int JS_ThisTimeValue(JSContext *ctx, double *valp, JSValueCon
     return -1;
 }
 
+/* the [[DateValue]] of a Date object, without calling any JS code */
+int JS_GetTimeValue(JSContext *ctx, JSValueConst obj, double *pres)
+{
+    return JS_ThisTimeValue(ctx, pres, obj);
+}
+
 static JSValue JS_SetThisTimeValue(JSContext *ctx, JSValueConst this_val, double v)
 {
     if (JS_VALUE_GET_TAG(this_val) == JS_TAG_OBJECT) {
@@ -0,0 +1,599 @@
+#include "LogStore.h"
+#include "../UTILS/Logger.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace FS {
+
+    namespace {
+        constexpr char kMagic[8] = {'N', 'X', 'L', 'O', 'G', '\x01', '\r', '\n'};
+
+        // Before every key and value. The checksum covers the rest of the
+        // header, the key and the value.
+        struct RecordHeader {
+            uint32_t crc;
+            uint32_t keySize;
+            uint32_t valueSize; // kTombstone for a remove
+        };
+        static_assert(sizeof(RecordHeader) == 12, "RecordHeader is written as is");
+        constexpr uint32_t kTombstone = UINT32_MAX;
+
+        uint64_t RecordSize(uint32_t keySize, uint32_t valueSize) {
+            return sizeof(RecordHeader) + keySize + (valueSize == kTombstone ? 0 : valueSize);
+        }
+
+        constexpr std::array<uint32_t, 256> MakeCrcTable() {
+            std::array<uint32_t, 256> table{};
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                table[i] = c;
+            }
+            return table;
+        }
+        constexpr std::array<uint32_t, 256> kCrcTable = MakeCrcTable();
+
+        // CRC-32 (IEEE), continued from `crc`
+        uint32_t Crc32(uint32_t crc, const void *data, std::size_t size) {
+            const auto *p = static_cast<const uint8_t *>(data);
+            crc = ~crc;
+            while (size--)
+                crc = kCrcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+            return ~crc;
+        }
+
+        uint32_t RecordCrc(const RecordHeader &h, std::string_view key, std::string_view value) {
+            uint32_t crc = Crc32(0, &h.keySize, sizeof(h) - sizeof(h.crc));
+            crc = Crc32(crc, key.data(), key.size());
+            return Crc32(crc, value.data(), value.size());
+        }
+    }
+
+    // The log file, read and written at explicit offsets so readers never
+    // share a file position
+    struct CLogStore::File {
+#ifdef _WIN32
+        HANDLE h = INVALID_HANDLE_VALUE;
+
+        ~File() {
+            if (h != INVALID_HANDLE_VALUE)
+                CloseHandle(h);
+        }
+
+        bool Open(const fs::path &p, bool truncate) {
+            // Shared for delete so compaction can rename over the open log
+            h = CreateFileW(p.wstring().c_str(), GENERIC_READ | GENERIC_WRITE,
+                            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                            truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+            return h != INVALID_HANDLE_VALUE;
+        }
+
+        bool ReadAt(uint64_t offset, void *buf, std::size_t size) const {
+            auto *p = static_cast<uint8_t *>(buf);
+            while (size) {
+                OVERLAPPED ov{};
+                ov.Offset = (DWORD)offset;
+                ov.OffsetHigh = (DWORD)(offset >> 32);
+                DWORD n = 0;
+                if (!ReadFile(h, p, (DWORD)std::min<std::size_t>(size, 1u << 30), &n, &ov) || n == 0)
+                    return false;
+                p += n;
+                offset += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool WriteAt(uint64_t offset, const void *buf, std::size_t size) {
+            const auto *p = static_cast<const uint8_t *>(buf);
+            while (size) {
+                OVERLAPPED ov{};
+                ov.Offset = (DWORD)offset;
+                ov.OffsetHigh = (DWORD)(offset >> 32);
+                DWORD n = 0;
+                if (!WriteFile(h, p, (DWORD)std::min<std::size_t>(size, 1u << 30), &n, &ov) || n == 0)
+                    return false;
+                p += n;
+                offset += n;
+                size -= n;
+            }
+            return true;
+        }
+
+        bool Truncate(uint64_t size) {
+            FILE_END_OF_FILE_INFO info{};
+            info.EndOfFile.QuadPart = (LONGLONG)size;
+            return SetFileInformationByHandle(h, FileEndOfFileInfo, &info, sizeof(info));
+        }
+
+        bool Sync() { return FlushFileBuffers(h); }
+
+        bool Size(uint64_t &size) const {
+            LARGE_INTEGER s;
+            if (!GetFileSizeEx(h, &s))
+                return false;
+            size = (uint64_t)s.QuadPart;
+            return true;
+        }
+#else
+        int fd = -1;
+
+        ~File() {
+            if (fd >= 0)
+                ::close(fd);
+        }
+
+        bool Open(const fs::path &p, bool truncate) {
+            fd = ::open(p.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0644);
+            return fd >= 0;
+        }
+
+        bool ReadAt(uint64_t offset, void *buf, std::size_t size) const {
+            auto *p = static_cast<uint8_t *>(buf);
+            while (size) {
+                const ssize_t n = ::pread(fd, p, size, (off_t)offset);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                offset += (uint64_t)n;
+                size -= (std::size_t)n;
+            }
+            return true;
+        }
+
+        bool WriteAt(uint64_t offset, const void *buf, std::size_t size) {
+            const auto *p = static_cast<const uint8_t *>(buf);
+            while (size) {
+                const ssize_t n = ::pwrite(fd, p, size, (off_t)offset);
+                if (n < 0 && errno == EINTR)
+                    continue;
+                if (n <= 0)
+                    return false;
+                p += n;
+                offset += (uint64_t)n;
+                size -= (std::size_t)n;
+            }
+            return true;
+        }
+
+        bool Truncate(uint64_t size) { return ::ftruncate(fd, (off_t)size) == 0; }
+
+#ifdef __linux__
+        bool Sync() { return ::fdatasync(fd) == 0; }
+#else
+        bool Sync() { return ::fsync(fd) == 0; }
+#endif
+
+        bool Size(uint64_t &size) const {
+            struct stat st;
+            if (::fstat(fd, &st) != 0)
+                return false;
+            size = (uint64_t)st.st_size;
+            return true;
+        }
+#endif
+    };
+
+    namespace {
+        struct Record {
+            uint64_t offset;
+            RecordHeader header;
+            std::string_view key;
+            std::string_view value;
+            std::string_view bytes; // the whole record
+        };
+
+        // Walks the records between two offsets through a read buffer,
+        // stopping at the end or at the first record that is cut short or
+        // fails its checksum
+        template <typename LogFile>
+        class Scanner {
+            public:
+                Scanner(const LogFile &file, uint64_t from, uint64_t to) : file(file), pos(from), to(to) {}
+
+                bool Next(Record &r) {
+                    if (!Fill(sizeof(RecordHeader)))
+                        return false;
+                    RecordHeader h;
+                    std::memcpy(&h, At(), sizeof(h));
+                    if (h.keySize > CLogStore::kMaxKeySize ||
+                        (h.valueSize != kTombstone && h.valueSize > CLogStore::kMaxValueSize))
+                        return false;
+                    const uint64_t size = RecordSize(h.keySize, h.valueSize);
+                    if (!Fill(size))
+                        return false;
+
+                    const char *p = At();
+                    r.offset = pos;
+                    r.header = h;
+                    r.key = std::string_view(p + sizeof(h), h.keySize);
+                    r.value = std::string_view(p + sizeof(h) + h.keySize, size - sizeof(h) - h.keySize);
+                    r.bytes = std::string_view(p, size);
+                    if (RecordCrc(h, r.key, r.value) != h.crc)
+                        return false;
+                    pos += size;
+                    return true;
+                }
+
+                uint64_t Position() const { return pos; }
+                bool ReadFailed() const { return failed; }
+
+            private:
+                static constexpr std::size_t kChunk = 1 << 20;
+
+                const char *At() const { return buf.data() + (pos - bufOffset); }
+
+                bool Fill(uint64_t size) {
+                    if (to - pos < size)
+                        return false;
+                    if (pos >= bufOffset && pos + size <= bufOffset + buf.size())
+                        return true;
+                    buf.resize(std::min<uint64_t>(std::max<uint64_t>(size, kChunk), to - pos));
+                    bufOffset = pos;
+                    if (!file.ReadAt(pos, buf.data(), buf.size())) {
+                        buf.clear();
+                        failed = true;
+                        return false;
+                    }
+                    return true;
+                }
+
+                const LogFile &file;
+                uint64_t pos;
+                const uint64_t to;
+                std::string buf;
+                uint64_t bufOffset = 0;
+                bool failed = false;
+        };
+    }
+
+    CLogStore::CLogStore(fs::path path) : path(std::move(path)) {}
+
+    CLogStore::~CLogStore() {
+        if (maintainer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lk(maintainMutex);
+                stop = true;
+            }
+            maintainCv.notify_all();
+            maintainer.join();
+        }
+        if (file && dirty)
+            Sync();
+    }
+
+    bool CLogStore::Open(std::string &error) {
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+
+        auto f = std::make_unique<File>();
+        uint64_t size = 0;
+        if (!f->Open(path, false) || !f->Size(size)) {
+            error = "cannot open " + path.string();
+            return false;
+        }
+        if (size == 0) {
+            if (!f->WriteAt(0, kMagic, sizeof(kMagic)) || !f->Sync()) {
+                error = "cannot write " + path.string();
+                return false;
+            }
+            size = sizeof(kMagic);
+        } else {
+            char magic[sizeof(kMagic)];
+            if (size < sizeof(kMagic) || !f->ReadAt(0, magic, sizeof(magic)) ||
+                std::memcmp(magic, kMagic, sizeof(kMagic)) != 0) {
+                error = path.string() + " is not a store log";
+                return false;
+            }
+        }
+
+        Scanner<File> scan(*f, sizeof(kMagic), size);
+        Record r;
+        while (scan.Next(r)) {
+            const Location at{r.offset, r.header.keySize, r.header.valueSize};
+            auto it = index.find(std::string(r.key));
+            if (it != index.end())
+                liveBytes -= RecordSize(it->second.keySize, it->second.valueSize);
+            if (r.header.valueSize == kTombstone) {
+                if (it != index.end())
+                    index.erase(it);
+                continue;
+            }
+            liveBytes += r.bytes.size();
+            if (it != index.end())
+                it->second = at;
+            else
+                index.emplace(r.key, at);
+        }
+
+        if (scan.ReadFailed()) {
+            error = "cannot read " + path.string();
+            index.clear();
+            liveBytes = 0;
+            return false;
+        }
+        end = scan.Position();
+        if (end < size) {
+            // A crash in the middle of an append; everything before it is intact
+            LOG_WARN(FS, "{}: dropping {} bytes of torn records at offset {}", path.string(), size - end, end);
+            if (!f->Truncate(end) || !f->Sync()) {
+                error = "cannot truncate " + path.string();
+                return false;
+            }
+        }
+
+        file = std::move(f);
+        LOG_INFO(FS, "Opened {} with {} keys", path.string(), index.size());
+        maintainer = std::thread([this] { Maintain(); });
+        return true;
+    }
+
+    bool CLogStore::Get(const std::string &key, std::string &value) const {
+        std::shared_lock<std::shared_mutex> lk(indexMutex);
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+        const Location at = it->second;
+        value.resize(at.valueSize);
+        return file->ReadAt(at.offset + sizeof(RecordHeader) + at.keySize, value.data(), at.valueSize);
+    }
+
+    bool CLogStore::Contains(const std::string &key) const {
+        std::shared_lock<std::shared_mutex> lk(indexMutex);
+        return index.count(key) != 0;
+    }
+
+    std::vector<std::string> CLogStore::Keys(std::string_view prefix) const {
+        std::vector<std::string> keys;
+        std::shared_lock<std::shared_mutex> lk(indexMutex);
+        for (const auto &[key, at] : index)
+            if (std::string_view(key).substr(0, prefix.size()) == prefix)
+                keys.push_back(key);
+        return keys;
+    }
+
+    bool CLogStore::Append(std::string_view key, std::string_view value, bool tombstone, Location &at) {
+        RecordHeader h{0, (uint32_t)key.size(), tombstone ? kTombstone : (uint32_t)value.size()};
+        h.crc = RecordCrc(h, key, value);
+
+        // One write per record, so a crash tears at most the last one
+        std::string record(RecordSize(h.keySize, h.valueSize), '\0');
+        std::memcpy(record.data(), &h, sizeof(h));
+        std::memcpy(record.data() + sizeof(h), key.data(), key.size());
+        std::memcpy(record.data() + sizeof(h) + key.size(), value.data(), value.size());
+
+        if (!file->WriteAt(end, record.data(), record.size())) {
+            LOG_ERROR(FS, "{}: append failed", path.string());
+            file->Truncate(end);
+            return false;
+        }
+        at = Location{end, h.keySize, h.valueSize};
+        end += record.size();
+        dirty = true;
+        return true;
+    }
+
+    bool CLogStore::Put(std::string_view key, std::string_view value) {
+        if (key.size() > kMaxKeySize || value.size() > kMaxValueSize || !file)
+            return false;
+
+        // Held across the index update so the index follows log order
+        std::lock_guard<std::mutex> w(writeMutex);
+        Location at;
+        if (!Append(key, value, false, at))
+            return false;
+
+        std::unique_lock<std::shared_mutex> lk(indexMutex);
+        auto [it, inserted] = index.try_emplace(std::string(key), at);
+        if (!inserted) {
+            liveBytes -= RecordSize(it->second.keySize, it->second.valueSize);
+            it->second = at;
+        }
+        liveBytes += RecordSize(at.keySize, at.valueSize);
+        return true;
+    }
+
+    bool CLogStore::Remove(std::string_view key) {
+        if (!file)
+            return false;
+
+        std::lock_guard<std::mutex> w(writeMutex);
+        // Only writers change the index, so it can be read here unlocked
+        auto it = index.find(std::string(key));
+        if (it == index.end())
+            return false;
+        Location at;
+        if (!Append(key, {}, true, at))
+            return false;
+
+        std::unique_lock<std::shared_mutex> lk(indexMutex);
+        liveBytes -= RecordSize(it->second.keySize, it->second.valueSize);
+        index.erase(it);
+        return true;
+    }
+
+    bool CLogStore::Sync() {
+        std::shared_lock<std::shared_mutex> lk(indexMutex);
+        if (!file)
+            return false;
+        dirty = false;
+        if (file->Sync())
+            return true;
+        dirty = true;
+        return false;
+    }
+
+    CLogStore::Stats CLogStore::GetStats() const {
+        std::lock_guard<std::mutex> w(writeMutex);
+        std::shared_lock<std::shared_mutex> lk(indexMutex);
+        return Stats{index.size(), liveBytes, end};
+    }
+
+    bool CLogStore::Compact() {
+        std::lock_guard<std::mutex> compacting(compactMutex);
+        if (!file)
+            return false;
+
+        // The live records as of now; anything appended meanwhile is
+        // carried over after them
+        uint64_t from;
+        std::vector<std::pair<std::string, Location>> live;
+        {
+            std::lock_guard<std::mutex> w(writeMutex);
+            from = end;
+            live.assign(index.begin(), index.end());
+        }
+        std::sort(live.begin(), live.end(),
+                  [](const auto &a, const auto &b) { return a.second.offset < b.second.offset; });
+
+        fs::path tmp = path;
+        tmp += ".compact";
+        auto out = std::make_unique<File>();
+        auto fail = [&](const char *what) {
+            LOG_ERROR(FS, "{}: compaction failed, {}", path.string(), what);
+            out.reset();
+            std::error_code ec;
+            fs::remove(tmp, ec);
+            return false;
+        };
+        if (!out->Open(tmp, true))
+            return fail("cannot create the new log");
+
+        // Records are copied as they are, checksums included, through a
+        // buffer so the new log is written in large sequential chunks
+        std::string chunk(kMagic, sizeof(kMagic));
+        uint64_t written = 0;
+        auto flush = [&] {
+            const bool ok = out->WriteAt(written, chunk.data(), chunk.size());
+            written += chunk.size();
+            chunk.clear();
+            return ok;
+        };
+        std::unordered_map<std::string, Location> rebuilt;
+        rebuilt.reserve(live.size());
+        uint64_t rebuiltBytes = 0;
+        for (auto &[key, at] : live) {
+            const uint64_t size = RecordSize(at.keySize, at.valueSize);
+            const std::size_t pos = chunk.size();
+            chunk.resize(pos + size);
+            if (!file->ReadAt(at.offset, chunk.data() + pos, size))
+                return fail("cannot read the old log");
+            rebuilt.emplace(std::move(key), Location{written + pos, at.keySize, at.valueSize});
+            rebuiltBytes += size;
+            if (chunk.size() >= (1u << 20) && !flush())
+                return fail("cannot write the new log");
+        }
+        live.clear();
+        if (!flush())
+            return fail("cannot write the new log");
+
+        // Replays the old log from `from` to `to` onto the new one; null
+        // on success, otherwise what went wrong
+        auto carryOver = [&](uint64_t to) -> const char * {
+            Scanner<File> scan(*file, from, to);
+            Record r;
+            while (scan.Next(r)) {
+                const Location at{written, r.header.keySize, r.header.valueSize};
+                if (!out->WriteAt(written, r.bytes.data(), r.bytes.size()))
+                    return "cannot write the new log";
+                written += r.bytes.size();
+                auto it = rebuilt.find(std::string(r.key));
+                if (it != rebuilt.end()) {
+                    rebuiltBytes -= RecordSize(it->second.keySize, it->second.valueSize);
+                    rebuilt.erase(it);
+                }
+                if (r.header.valueSize != kTombstone) {
+                    rebuilt.emplace(r.key, at);
+                    rebuiltBytes += r.bytes.size();
+                }
+            }
+            if (scan.Position() != to)
+                return "cannot read the old log";
+            from = to;
+            return nullptr;
+        };
+
+        // Catches up with the writers for a few rounds and syncs without
+        // holding them up, so the swap below only has to carry over what
+        // was appended since
+        for (int round = 0; round < 4; round++) {
+            uint64_t to;
+            {
+                std::lock_guard<std::mutex> w(writeMutex);
+                to = end;
+            }
+            if (to == from)
+                break;
+            if (const char *error = carryOver(to))
+                return fail(error);
+        }
+        if (!out->Sync())
+            return fail("cannot sync the new log");
+
+        uint64_t before;
+        {
+            std::lock_guard<std::mutex> w(writeMutex);
+            if (end != from) {
+                if (const char *error = carryOver(end))
+                    return fail(error);
+                if (!out->Sync())
+                    return fail("cannot sync the new log");
+            }
+#ifdef _WIN32
+            if (!MoveFileExW(tmp.wstring().c_str(), path.wstring().c_str(),
+                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+                return fail("cannot replace the old log");
+#else
+            if (::rename(tmp.c_str(), path.c_str()) != 0)
+                return fail("cannot replace the old log");
+#endif
+
+            before = end;
+            std::unique_lock<std::shared_mutex> lk(indexMutex);
+            file.swap(out);
+            index.swap(rebuilt);
+            liveBytes = rebuiltBytes;
+            end = written;
+            dirty = false;
+        }
+#ifndef _WIN32
+        // Makes the rename itself durable; until then a power loss leaves
+        // the old log, which still holds every record from before the swap
+        int dir = ::open(path.parent_path().c_str(), O_RDONLY);
+        if (dir >= 0) {
+            ::fsync(dir);
+            ::close(dir);
+        }
+#endif
+        LOG_INFO(FS, "Compacted {} from {} to {} bytes", path.string(), before, written);
+        return true;
+    }
+
+    void CLogStore::Maintain() {
+        std::unique_lock<std::mutex> lk(maintainMutex);
+        while (!maintainCv.wait_for(lk, kSyncInterval, [this] { return stop; })) {
+            lk.unlock();
+            if (dirty)
+                Sync();
+            const Stats stats = GetStats();
+            const uint64_t garbage = stats.fileBytes - sizeof(kMagic) - stats.liveBytes;
+            if (garbage >= kCompactMinGarbage && garbage > stats.liveBytes)
+                Compact();
+            lk.lock();
+        }
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace FS {
+
+    // A key-value store kept as one append-only log. Every put and remove
+    // is a checksummed record appended to the file, and an in-memory hash
+    // index maps each live key to its latest record, so a get is one lookup
+    // and one positioned read. Any number of threads can read at once;
+    // writers only exclude each other.
+    //
+    // A record is on disk once Put returns, so it survives the app crashing;
+    // it survives a power loss after the next sync, which happens in the
+    // background at most kSyncInterval later, or right away with Sync. A
+    // torn record at the end of the log, from a crash mid-write, is cut off
+    // when the store is opened. Once enough of the log is superseded records
+    // it is compacted in the background into a new file holding only the
+    // live ones, while reads and writes go on.
+    class CLogStore {
+        public:
+            explicit CLogStore(std::filesystem::path path);
+            ~CLogStore();
+
+            CLogStore(const CLogStore &) = delete;
+            CLogStore &operator=(const CLogStore &) = delete;
+
+            // Creates the file if needed and rebuilds the index from it
+            bool Open(std::string &error);
+
+            bool Get(const std::string &key, std::string &value) const;
+            bool Contains(const std::string &key) const;
+            std::vector<std::string> Keys(std::string_view prefix = {}) const;
+
+            // In the file once it returns, but only synced by the background
+            // thread: a power loss can lose the puts of the last
+            // kSyncInterval (1 s) unless Sync is called
+            bool Put(std::string_view key, std::string_view value);
+            // False when the key did not exist or the write failed
+            bool Remove(std::string_view key);
+
+            bool Sync();
+            bool Compact();
+
+            struct Stats {
+                std::size_t keys = 0;
+                uint64_t liveBytes = 0; // records the index points at
+                uint64_t fileBytes = 0;
+            };
+            Stats GetStats() const;
+
+            static constexpr std::size_t kMaxKeySize = 64 * 1024;
+            static constexpr std::size_t kMaxValueSize = 256 * 1024 * 1024;
+            static constexpr std::chrono::seconds kSyncInterval{1};
+            // Compacted once superseded records pass this and outweigh the live ones
+            static constexpr uint64_t kCompactMinGarbage = 4 * 1024 * 1024;
+
+        private:
+            struct File;
+            struct Location {
+                uint64_t offset; // of the record
+                uint32_t keySize;
+                uint32_t valueSize;
+            };
+
+            bool Append(std::string_view key, std::string_view value, bool tombstone, Location &at);
+            void Maintain();
+
+            const std::filesystem::path path;
+
+            // The file and the index are swapped together by compaction, so
+            // readers hold `indexMutex` shared across their read
+            mutable std::shared_mutex indexMutex;
+            std::unique_ptr<File> file;
+            std::unordered_map<std::string, Location> index;
+            uint64_t liveBytes = 0;
+
+            mutable std::mutex writeMutex; // one appender at a time; guards `end`
+            uint64_t end = 0;
+            std::atomic<bool> dirty{false};
+
+            std::mutex compactMutex;
+
+            std::mutex maintainMutex;
+            std::condition_variable maintainCv;
+            bool stop = false;
+            std::thread maintainer;
+    };
+}
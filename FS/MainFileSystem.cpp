@@ -1,6 +1,12 @@
 #include "MainFileSystem.h"
-#include "../Dependencies/fmt/fmt/base.h"
-#include "../Dependencies/fmt/fmt/color.h"
+#include "../UTILS/Logger.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace fs = std::filesystem;
 
@@ -10,6 +16,7 @@ namespace FS {
     std::filesystem::path CFileSystem::base_folder;
     std::filesystem::path CFileSystem::scripts_path;
     std::filesystem::path CFileSystem::logs_path;
+    std::filesystem::path CFileSystem::cache_path;
     std::filesystem::path CFileSystem::settings_path;
     std::vector<std::unique_ptr<ScriptJS>> CFileSystem::scripts_array;
     std::vector<std::string> CFileSystem::setting_files_array;
@@ -17,19 +24,27 @@ namespace FS {
     void CFileSystem::InitFileSystem() {
         LoadLocations();
         if (!fs::exists(base)) {
-            fmt::print("The base folder is non-existent! Leaving...");
+            LOG_ERROR(FS, "The base folder {} is non-existent! Leaving...", base.string());
             return;
         }
         if (!fs::exists(base_folder)) {
-            fmt::print("Base directory does not exist.. Generating...\n");
+            LOG_INFO(FS, "Base directory does not exist.. Generating...");
             fs::create_directory(base_folder);
-            fmt::print("Creating scripts folder..\n");
+        }
+        if (!fs::exists(scripts_path)) {
+            LOG_INFO(FS, "Creating scripts folder..");
             fs::create_directory(scripts_path);
-            fmt::print("Creating logs folder...");
+        }
+        if (!fs::exists(logs_path)) {
+            LOG_INFO(FS, "Creating logs folder...");
             fs::create_directory(logs_path);
         }
+        if (!fs::exists(cache_path)) {
+            LOG_INFO(FS, "Creating cache folder...");
+            fs::create_directory(cache_path);
+        }
         if (!LoadScripts()) {
-            fmt::print("Failed to load scripts.\n");
+            LOG_ERROR(FS, "Failed to load scripts.");
         }
     }
 
@@ -62,7 +77,7 @@ namespace FS {
                     std::make_unique<ScriptJS>(stem, entry.path().string()));
         }
 
-        fmt::print("Loaded {} JavaScript files\n", scripts_array.size());
+        LOG_INFO(FS, "Loaded {} JavaScript files", scripts_array.size());
         return true;
     }
 
@@ -76,6 +91,8 @@ namespace FS {
         base_folder = base / "Buddy";
         scripts_path = base_folder / "Scripts";
         logs_path = base_folder / "Logs";
+        cache_path = base_folder / "Cache";
+        settings_path = base_folder / "settings.json";
     }
 
     std::vector<std::string> &CFileSystem::GetSettings() {
@@ -90,4 +107,75 @@ namespace FS {
         return scripts_path;
     }
 
+    std::filesystem::path CFileSystem::GetLogsFolderLocation() {
+        return logs_path;
+    }
+
+    std::filesystem::path CFileSystem::GetBaseFolderLocation() {
+        return base_folder;
+    }
+
+    std::filesystem::path CFileSystem::GetCacheFolderLocation() {
+        return cache_path;
+    }
+
+    std::filesystem::path CFileSystem::GetSettingsFileLocation() {
+        return settings_path;
+    }
+
+    bool CFileSystem::WriteFileAtomic(const fs::path &path, std::string_view data) {
+        fs::path tmp = path;
+        tmp += ".tmp";
+
+#ifdef _WIN32
+        HANDLE h = CreateFileW(tmp.wstring().c_str(), GENERIC_WRITE, 0, nullptr,
+                               CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (h == INVALID_HANDLE_VALUE) {
+            LOG_ERROR(FS, "Cannot create {}", tmp.string());
+            return false;
+        }
+        DWORD written = 0;
+        bool ok = WriteFile(h, data.data(), (DWORD)data.size(), &written, nullptr) &&
+                  written == data.size() && FlushFileBuffers(h);
+        CloseHandle(h);
+        if (ok)
+            ok = MoveFileExW(tmp.wstring().c_str(), path.wstring().c_str(),
+                             MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH);
+#else
+        int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+            LOG_ERROR(FS, "Cannot create {}", tmp.string());
+            return false;
+        }
+        bool ok = true;
+        size_t off = 0;
+        while (ok && off < data.size()) {
+            ssize_t n = ::write(fd, data.data() + off, data.size() - off);
+            if (n < 0 && errno == EINTR)
+                continue;
+            ok = n > 0;
+            if (ok)
+                off += (size_t)n;
+        }
+        ok = ok && ::fsync(fd) == 0;
+        ::close(fd);
+        if (ok)
+            ok = ::rename(tmp.c_str(), path.c_str()) == 0;
+        if (ok) {
+            // Persist the rename itself
+            int dir = ::open(path.parent_path().c_str(), O_RDONLY);
+            if (dir >= 0) {
+                ::fsync(dir);
+                ::close(dir);
+            }
+        }
+#endif
+        if (!ok) {
+            LOG_ERROR(FS, "Atomic write of {} failed", path.string());
+            std::error_code ec;
+            fs::remove(tmp, ec);
+        }
+        return ok;
+    }
+
 }
\ No newline at end of file
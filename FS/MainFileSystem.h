@@ -2,6 +2,7 @@
 #include <filesystem>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace FS {
@@ -11,6 +12,7 @@ namespace FS {
         std::string fullpath;
         std::string output;
         std::mutex m; // for thread-safe output
+        bool mirrorLog = true; // console.log also goes to the app log
 
         // Constructor needed for make_unique
         ScriptJS(std::string n, std::string p): name(std::move(n)), fullpath(std::move(p)) {}
@@ -34,12 +36,21 @@ namespace FS {
             static std::vector<std::string> &GetSettings();
             static std::vector<std::unique_ptr<FS::ScriptJS>> & GetScripts();
             static std::filesystem::path GetScriptFolderLocation();
+            static std::filesystem::path GetLogsFolderLocation();
+            static std::filesystem::path GetBaseFolderLocation();
+            static std::filesystem::path GetCacheFolderLocation();
+            static std::filesystem::path GetSettingsFileLocation();
+
+            // Writes to a sibling temp file, fsyncs it and renames it over
+            // `path`, so readers only ever see the old or the new contents.
+            static bool WriteFileAtomic(const std::filesystem::path &path, std::string_view data);
 
         private:
             static std::filesystem::path base_folder;
             static std::filesystem::path base;
             static std::filesystem::path scripts_path;
             static std::filesystem::path logs_path;
+            static std::filesystem::path cache_path;
             static std::filesystem::path settings_path;
             static std::vector<std::unique_ptr<ScriptJS>> scripts_array;
             static std::vector<std::string> setting_files_array;
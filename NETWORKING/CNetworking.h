@@ -1,6 +1,8 @@
 #pragma once
 #include <curl/curl.h>
+#include <algorithm>
 #include <iomanip>
+#include <new>
 #include <sstream>
 #include <stdexcept>
 #include <string>
@@ -8,31 +10,88 @@
 class Curl {
     public:
         static std::string Get(const std::string &url) {
+        std::string buffer;
+        StringSink sink{buffer};
+        Get(url, sink);
+        return buffer;
+        }
+
+        // Streams the body into `sink` as it arrives: sink.Reserve(bytes)
+        // is called once with the Content-Length when the server sends one,
+        // capped at kMaxReserve, and sink.Append(data, bytes) for every
+        // piece. Neither may throw; either returns false when it cannot
+        // allocate, which aborts the download with std::bad_alloc.
+        template <typename Sink> static void Get(const std::string &url, Sink &sink) {
         CURL *curl = curl_easy_init();
         if (!curl)
             throw std::runtime_error("curl_easy_init failed");
 
-        std::string buffer;
+        Transfer<Sink> transfer{curl, &sink};
         curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
         curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
-                         WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &buffer);
+                         WriteCallback<Sink>);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
         curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L); // handle redirects
 
         CURLcode rc = curl_easy_perform(curl);
         curl_easy_cleanup(curl);
 
+        if (transfer.outOfMemory)
+            throw std::bad_alloc();
         if (rc != CURLE_OK)
             throw std::runtime_error(curl_easy_strerror(rc));
-
-        return buffer;
         }
 
+        // A larger Content-Length is only trusted this far; the rest
+        // grows as the body actually arrives
+        static constexpr curl_off_t kMaxReserve = 64 * 1024 * 1024;
+
     private:
+        struct StringSink {
+            std::string &out;
+            bool Reserve(size_t bytes) {
+                try {
+                    out.reserve(bytes);
+                    return true;
+                } catch (const std::exception &) {
+                    return false;
+                }
+            }
+            bool Append(const char *data, size_t bytes) {
+                try {
+                    out.append(data, bytes);
+                    return true;
+                } catch (const std::exception &) {
+                    return false;
+                }
+            }
+        };
+
+        template <typename Sink> struct Transfer {
+            CURL *curl;
+            Sink *sink;
+            bool sized = false;
+            bool outOfMemory = false;
+        };
+
+        template <typename Sink>
         static size_t WriteCallback(void *ptr, size_t size, size_t nmemb,
                                   void *userdata) {
-        auto *out = static_cast<std::string *>(userdata);
-        out->append(static_cast<char *>(ptr), size * nmemb);
+        auto *transfer = static_cast<Transfer<Sink> *>(userdata);
+        if (!transfer->sized) {
+            // Headers are in by the first piece of the body
+            transfer->sized = true;
+            curl_off_t length = -1;
+            if (curl_easy_getinfo(transfer->curl, CURLINFO_CONTENT_LENGTH_DOWNLOAD_T, &length) == CURLE_OK &&
+                length > 0 && !transfer->sink->Reserve(static_cast<size_t>(std::min(length, kMaxReserve)))) {
+                transfer->outOfMemory = true;
+                return 0;
+            }
+        }
+        if (!transfer->sink->Append(static_cast<const char *>(ptr), size * nmemb)) {
+            transfer->outOfMemory = true;
+            return 0;
+        }
         return size * nmemb;
         }
 
@@ -0,0 +1,150 @@
+#include "Scenario.h"
+#include "../Dependencies/json/json.hpp"
+#include "AUDIO/Audio.h"
+#include "FS/MainFileSystem.h"
+#include "UI/Renderer.h"
+#include "UI/SettingsWriter.h"
+#include "UTILS/Logger.h"
+#include <algorithm>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace SCENARIOS {
+
+    namespace {
+        double MsSince(std::chrono::steady_clock::time_point t0) {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        }
+
+        // Nearest-rank percentile of an already sorted sample
+        double Percentile(const std::vector<double> &sorted, double p) {
+            if (sorted.empty())
+                return 0.0;
+            std::size_t rank = (std::size_t)(p / 100.0 * (double)sorted.size() + 0.5);
+            rank = std::clamp<std::size_t>(rank, 1, sorted.size());
+            return sorted[rank - 1];
+        }
+
+        // CPU time (user + system) and peak resident set of this process
+        void SampleProcess(double &cpuMs, double &peakRssMb) {
+#ifdef _WIN32
+            FILETIME created, exited, kernel, user;
+            GetProcessTimes(GetCurrentProcess(), &created, &exited, &kernel, &user);
+            auto toMs = [](const FILETIME &ft) {
+                ULARGE_INTEGER v;
+                v.LowPart = ft.dwLowDateTime;
+                v.HighPart = ft.dwHighDateTime;
+                return (double)v.QuadPart / 10000.0; // 100 ns ticks
+            };
+            cpuMs = toMs(kernel) + toMs(user);
+
+            PROCESS_MEMORY_COUNTERS pmc{};
+            GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc));
+            peakRssMb = (double)pmc.PeakWorkingSetSize / (1024.0 * 1024.0);
+#else
+            rusage ru{};
+            getrusage(RUSAGE_SELF, &ru);
+            cpuMs = (double)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000.0 +
+                    (double)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1000.0;
+#ifdef __APPLE__
+            peakRssMb = (double)ru.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+            peakRssMb = (double)ru.ru_maxrss / 1024.0; // kilobytes
+#endif
+#endif
+        }
+    }
+
+    CScenarioRun::CScenarioRun(std::chrono::steady_clock::time_point processStart)
+        : processStart(processStart), bodyStart(std::chrono::steady_clock::now()) {}
+
+    void CScenarioRun::Frame(bool record) {
+        const auto t0 = std::chrono::steady_clock::now();
+        GUI::Renderer::Get()->RenderFrame();
+        const double ms = MsSince(t0);
+
+        if (frames++ == 0)
+            firstFrameMs = MsSince(processStart);
+        if (record)
+            frameMs.push_back(ms);
+    }
+
+    void CScenarioRun::Frames(int n, bool record) {
+        for (int i = 0; i < n; i++)
+            Frame(record);
+    }
+
+    bool CScenarioRun::FramesUntil(const std::function<bool()> &done, std::chrono::milliseconds timeout,
+                                   bool record) {
+        const auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (!done()) {
+            if (std::chrono::steady_clock::now() >= deadline)
+                return false;
+            Frame(record);
+        }
+        return true;
+    }
+
+    ScenarioMetrics CScenarioRun::Finish() const {
+        std::vector<double> sorted = frameMs;
+        std::sort(sorted.begin(), sorted.end());
+
+        ScenarioMetrics m;
+        m["frames"] = (double)frames;
+        m["first_frame_ms"] = firstFrameMs;
+        m["frame_p50_ms"] = Percentile(sorted, 50.0);
+        m["frame_p95_ms"] = Percentile(sorted, 95.0);
+        m["frame_p99_ms"] = Percentile(sorted, 99.0);
+        m["frame_max_ms"] = sorted.empty() ? 0.0 : sorted.back();
+        m["wall_ms"] = MsSince(bodyStart);
+        SampleProcess(m["cpu_ms"], m["peak_rss_mb"]);
+        return m;
+    }
+
+    int RunScenario(const Scenario &scenario, std::chrono::steady_clock::time_point processStart,
+                    const std::string &outPath, bool headless) {
+        FS::CFileSystem::InitFileSystem();
+        UTILS::CLogger::Init(FS::CFileSystem::GetLogsFolderLocation());
+        AUDIO::AudioPlayer::GetInstance()->Init();
+
+        if (scenario.prepare)
+            scenario.prepare();
+
+        GUI::Renderer *renderer = GUI::Renderer::Get();
+        GUI::RendererOptions options;
+        options.headless = headless;
+        if (!renderer->Setup(options)) {
+            LOG_ERROR(GUI, "Scenario {}: no window, cannot run", scenario.name);
+            UTILS::CLogger::Shutdown();
+            return 1;
+        }
+        // Frame times should measure the work, not the display refresh
+        renderer->SetSwapInterval(0);
+
+        CScenarioRun run(processStart);
+        const bool ok = scenario.body(run);
+        const ScenarioMetrics metrics = run.Finish();
+
+        renderer->Shutdown();
+        GUI::Renderer::Destroy();
+        GUI::CSettingsWriter::Get().Flush();
+        AUDIO::AudioPlayer::GetInstance()->Shutdown();
+
+        if (!ok) {
+            LOG_ERROR(GUI, "Scenario {} did not reach its steady state", scenario.name);
+            UTILS::CLogger::Shutdown();
+            return 1;
+        }
+        UTILS::CLogger::Shutdown();
+
+        std::ofstream out(outPath, std::ios::trunc);
+        out << nlohmann::json(metrics).dump(2) << '\n';
+        return out ? 0 : 1;
+    }
+}
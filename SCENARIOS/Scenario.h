@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace SCENARIOS {
+
+    // Everything a scenario reports, keyed by metric name. Every metric is
+    // "lower is better", which is what the baseline comparison assumes.
+    using ScenarioMetrics = std::map<std::string, double>;
+
+    // Drives the real Renderer loop one frame at a time and records frame
+    // times. Frames rendered with record = false (waiting for a window to
+    // appear, a texture to upload) are not part of the percentiles.
+    class CScenarioRun {
+        public:
+            explicit CScenarioRun(std::chrono::steady_clock::time_point processStart);
+
+            void Frame(bool record = true);
+            void Frames(int n, bool record = true);
+
+            // Renders until `done` returns true; false if `timeout` passed first.
+            // A wall clock limit, since a headless frame can take microseconds.
+            bool FramesUntil(const std::function<bool()> &done, std::chrono::milliseconds timeout,
+                             bool record = false);
+
+            ScenarioMetrics Finish() const;
+
+        private:
+            std::chrono::steady_clock::time_point processStart;
+            std::chrono::steady_clock::time_point bodyStart;
+            double firstFrameMs = -1.0;
+            int frames = 0;
+            std::vector<double> frameMs;
+    };
+
+    struct Scenario {
+        std::string name;
+        // false keeps the profile (settings, cache) the previous scenario left
+        bool freshHome = true;
+        // Runs after the file system is up and before Renderer::Setup
+        std::function<void()> prepare;
+        // Returns false when the scenario could not reach its steady state
+        std::function<bool(CScenarioRun &)> body;
+    };
+
+    const std::vector<Scenario> &GetScenarios();
+
+    // Runs one scenario in this process the way main() runs the app and
+    // writes its metrics as JSON to `outPath`. Returns the exit code.
+    int RunScenario(const Scenario &scenario, std::chrono::steady_clock::time_point processStart,
+                    const std::string &outPath, bool headless);
+}
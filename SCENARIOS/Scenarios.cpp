@@ -0,0 +1,344 @@
+#include "Scenario.h"
+#include "FS/LogStore.h"
+#include "FS/MainFileSystem.h"
+#include "SCRIPTING/ScriptWindows.h"
+#include "SCRIPTING/Scripting.h"
+#include "UI/CMainWindow.h"
+#include "UI/Renderer.h"
+#include "UI/SettingsMenu.h"
+#include "UTILS/Logger.h"
+#include "fmt/core.h"
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <thread>
+
+namespace SCENARIOS {
+
+    namespace {
+        constexpr int kSteadyFrames = 300;
+        // Upper bounds on waiting for a scenario's setup and for queued work
+        constexpr std::chrono::seconds kSetupTimeout{30};
+        constexpr std::chrono::seconds kDrainTimeout{300};
+        constexpr int kScriptLaunches = 1000;
+        constexpr int kLaunchesPerFrame = 10;
+        constexpr int kConsoleLines = 100000;
+        constexpr int kGifSide = 512;
+        constexpr int kGifFrames = 30;
+        constexpr int kStoreKeys = 500;
+        constexpr int kStoreWriters = 4;
+        constexpr int kStoreRounds = 20;
+
+        // Scripts handed to RunScriptAsync must outlive their threads
+        std::vector<std::unique_ptr<FS::ScriptJS>> s_scripts;
+
+        FS::ScriptJS *WriteScript(const std::string &name, const std::string &source) {
+            const std::filesystem::path path = FS::CFileSystem::GetScriptFolderLocation() / (name + ".js");
+            std::ofstream(path, std::ios::trunc) << source;
+            s_scripts.push_back(std::make_unique<FS::ScriptJS>(name, path.string()));
+            return s_scripts.back().get();
+        }
+
+        // An animated GIF written without an encoder: 7-bit palette indices
+        // as 8-bit LZW codes, with a clear code often enough that the code
+        // width never grows. Stripes move a little every frame.
+        std::string MakeAnimatedGif(int side, int frameCount) {
+            std::string gif = "GIF89a";
+            auto u16 = [&gif](int v) {
+                gif.push_back((char)(v & 0xff));
+                gif.push_back((char)((v >> 8) & 0xff));
+            };
+
+            u16(side);
+            u16(side);
+            gif += std::string("\xF6\x00\x00", 3); // 128 entry global colour table
+            for (int i = 0; i < 128; i++) {
+                gif.push_back((char)(i * 2));
+                gif.push_back((char)(255 - i * 2));
+                gif.push_back((char)((i * 5) & 0xff));
+            }
+            gif += std::string("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19); // loop forever
+
+            constexpr int kClear = 128, kEnd = 129, kRun = 100;
+            for (int f = 0; f < frameCount; f++) {
+                gif += std::string("\x21\xF9\x04\x04", 4);
+                u16(4); // 40 ms
+                gif += std::string("\x00\x00", 2);
+                gif.push_back('\x2C');
+                u16(0);
+                u16(0);
+                u16(side);
+                u16(side);
+                gif.push_back('\x00');
+                gif.push_back('\x07'); // LZW minimum code size
+
+                std::string codes;
+                for (int i = 0; i < side * side; i++) {
+                    if (i % kRun == 0)
+                        codes.push_back((char)kClear);
+                    const int x = i % side, y = i / side;
+                    codes.push_back((char)(((x + y + f * 8) / 8) % 128));
+                }
+                codes.push_back((char)kEnd);
+
+                for (std::size_t at = 0; at < codes.size(); at += 255) {
+                    const std::size_t n = std::min<std::size_t>(255, codes.size() - at);
+                    gif.push_back((char)n);
+                    gif.append(codes, at, n);
+                }
+                gif.push_back('\x00');
+            }
+            gif.push_back('\x3B');
+            return gif;
+        }
+
+        std::string StoreKey(int writer, int key) {
+            return fmt::format("writer{}/key{}", writer, key);
+        }
+
+        // Big enough that the rounds leave megabytes of superseded records
+        std::string StoreValue(int writer, int key, int round) {
+            return fmt::format("{}:{}:{}:", writer, key, round) + std::string(256, 'v');
+        }
+
+        // Exactly the keys of the first `writers`, each with its value from `round`
+        bool StoreHolds(const FS::CLogStore &store, int writers, int round) {
+            std::string value;
+            for (int w = 0; w < writers; w++)
+                for (int k = 0; k < kStoreKeys; k++)
+                    if (!store.Get(StoreKey(w, k), value) || value != StoreValue(w, k, round)) {
+                        LOG_ERROR(FS, "Scenario store: {} is missing or stale", StoreKey(w, k));
+                        return false;
+                    }
+            return store.GetStats().keys == (std::size_t)(writers * kStoreKeys);
+        }
+
+        uint64_t FileSize(const std::filesystem::path &path) {
+            std::error_code ec;
+            const auto size = std::filesystem::file_size(path, ec);
+            return ec ? 0 : (uint64_t)size;
+        }
+
+        // A store whose last record was torn by a crash, then one whose last
+        // record fails its checksum: reopening cuts the tail off and keeps
+        // everything before it
+        bool StoreTornTailBody(CScenarioRun &run) {
+            const std::filesystem::path path = FS::CFileSystem::GetBaseFolderLocation() / "scenario_torn.log";
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            std::string error;
+            run.Frame();
+
+            // Writes `key` as the last record and returns the file size before it
+            auto appendLast = [&](const std::string &key) -> uint64_t {
+                FS::CLogStore store(path);
+                if (!store.Open(error))
+                    return 0;
+                const uint64_t before = store.GetStats().fileBytes;
+                return store.Put(key, std::string(4096, 'x')) ? before : 0;
+            };
+            // Reopens after damaging the tail; only `intact` bytes may be left
+            auto reopen = [&](const std::string &key, uint64_t intact) {
+                FS::CLogStore store(path);
+                if (!store.Open(error)) {
+                    LOG_ERROR(FS, "Scenario store: {}", error);
+                    return false;
+                }
+                if (store.Contains(key) || store.GetStats().fileBytes != intact || FileSize(path) != intact) {
+                    LOG_ERROR(FS, "Scenario store: the damaged {} record was not cut off", key);
+                    return false;
+                }
+                return StoreHolds(store, 1, 0);
+            };
+
+            {
+                FS::CLogStore store(path);
+                if (!store.Open(error)) {
+                    LOG_ERROR(FS, "Scenario store: {}", error);
+                    return false;
+                }
+                for (int k = 0; k < kStoreKeys; k++)
+                    if (!store.Put(StoreKey(0, k), StoreValue(0, k, 0)))
+                        return false;
+            }
+            run.Frame();
+
+            // Half of the last record made it to the file
+            uint64_t intact = appendLast("torn");
+            if (!intact)
+                return false;
+            std::filesystem::resize_file(path, intact + (FileSize(path) - intact) / 2, ec);
+            if (ec || !reopen("torn", intact))
+                return false;
+            run.Frame();
+
+            // All of it did, but with a flipped byte
+            intact = appendLast("corrupt");
+            if (!intact)
+                return false;
+            {
+                std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+                f.seekp((std::streamoff)FileSize(path) - 1);
+                f.put('y');
+                if (!f)
+                    return false;
+            }
+            if (!reopen("corrupt", intact))
+                return false;
+            run.Frames(kSteadyFrames);
+            return true;
+        }
+
+        // Writers keep overwriting their keys while the store is compacted
+        // over and over; afterwards, and after reopening, every key must
+        // hold its last value. Frames are recorded throughout.
+        bool StoreCompactionBody(CScenarioRun &run) {
+            const std::filesystem::path path = FS::CFileSystem::GetBaseFolderLocation() / "scenario_compact.log";
+            std::error_code ec;
+            std::filesystem::remove(path, ec);
+            std::string error;
+            auto store = std::make_unique<FS::CLogStore>(path);
+            if (!store->Open(error)) {
+                LOG_ERROR(FS, "Scenario store: {}", error);
+                return false;
+            }
+
+            std::atomic<int> writing{kStoreWriters};
+            std::atomic<bool> failed{false};
+            std::vector<std::thread> writers;
+            for (int w = 0; w < kStoreWriters; w++)
+                writers.emplace_back([&, w] {
+                    for (int round = 0; round < kStoreRounds; round++)
+                        for (int k = 0; k < kStoreKeys; k++)
+                            if (!store->Put(StoreKey(w, k), StoreValue(w, k, round)))
+                                failed = true;
+                    writing--;
+                });
+
+            int compactions = 0;
+            const bool done = run.FramesUntil(
+                    [&] {
+                        if (writing == 0)
+                            return true;
+                        if (!store->Compact())
+                            failed = true;
+                        compactions++;
+                        return false;
+                    },
+                    kDrainTimeout, true);
+            for (auto &t : writers)
+                t.join();
+            if (!done || failed || compactions == 0)
+                return false;
+
+            if (!StoreHolds(*store, kStoreWriters, kStoreRounds - 1))
+                return false;
+            store = std::make_unique<FS::CLogStore>(path);
+            if (!store->Open(error) || !StoreHolds(*store, kStoreWriters, kStoreRounds - 1))
+                return false;
+            run.Frames(kSteadyFrames);
+            return true;
+        }
+
+        bool StartupBody(CScenarioRun &run) {
+            run.Frame();
+            run.Frames(kSteadyFrames);
+            return true;
+        }
+
+        // `count` script windows, each drawing a handful of widgets
+        Scenario WindowsScenario(int count) {
+            Scenario s;
+            s.name = fmt::format("windows_{}", count);
+            s.body = [count](CScenarioRun &run) {
+                const std::string source = fmt::format(R"(
+                    for (let i = 0; i < {}; i++)
+                        ui.create_window("Scenario " + i, (ui) => {{
+                            ui.text("frame " + ui.frame());
+                            ui.button("Button");
+                            ui.separator();
+                            ui.text_wrapped("Some wrapped text to lay out every frame.");
+                        }});
+                )", count);
+                SCR::CScriptWindows &windows = SCR::CScriptWindows::Get();
+                SCR::CScripting::RunScriptAsync(WriteScript("scenario_windows", source));
+
+                if (!run.FramesUntil([&] { return windows.OpenCount() >= (std::size_t)count; }, kSetupTimeout))
+                    return false;
+                run.Frames(kSteadyFrames);
+                return true;
+            };
+            return s;
+        }
+
+        std::vector<Scenario> BuildScenarios() {
+            std::vector<Scenario> list;
+
+            // Cold: empty profile. Warm: the profile and OS caches the cold run left.
+            list.push_back({"startup_cold", true, nullptr, StartupBody});
+            list.push_back({"startup_warm", false, nullptr, StartupBody});
+
+            list.push_back(WindowsScenario(1));
+            list.push_back(WindowsScenario(10));
+            list.push_back(WindowsScenario(100));
+
+            // Launched a few per frame, so the percentiles sample every frame
+            // that started runs; recorded until the last run finished
+            list.push_back({"script_launches", true, nullptr, [](CScenarioRun &run) {
+                FS::ScriptJS *script = WriteScript("scenario_launch",
+                                                   "let x = 0; for (let i = 0; i < 1000; i++) x += i;");
+                for (int i = 0; i < kScriptLaunches; i += kLaunchesPerFrame) {
+                    for (int j = 0; j < kLaunchesPerFrame; j++)
+                        SCR::CScripting::RunScriptAsync(script);
+                    run.Frame();
+                }
+                return run.FramesUntil([] { return SCR::CScripting::RunningCount() == 0; }, kDrainTimeout,
+                                       true);
+            }});
+
+            // Restored from settings the way a user's saved background is
+            list.push_back({"gif_background", true,
+                            [] {
+                                const std::filesystem::path gif = FS::CFileSystem::GetBaseFolderLocation() /
+                                                                  "scenario_background.gif";
+                                std::ofstream(gif, std::ios::binary | std::ios::trunc)
+                                        << MakeAnimatedGif(kGifSide, kGifFrames);
+
+                                GUI::CSettings settings;
+                                settings.selected_background = 1;
+                                settings.image_source_type = 0;
+                                settings.background_filepath = gif.string();
+                                FS::CFileSystem::WriteFileAtomic(FS::CFileSystem::GetSettingsFileLocation(),
+                                                                 settings.Serialize());
+                            },
+                            [](CScenarioRun &run) {
+                                auto animated = [] {
+                                    const CImage *bg = GUI::CMainWindow::GetBackgroundImage();
+                                    return bg && bg->IsAnimated();
+                                };
+                                if (!run.FramesUntil(animated, kSetupTimeout))
+                                    return false;
+                                run.Frames(kSteadyFrames);
+                                return true;
+                            }});
+
+            list.push_back({"console_flood", true, nullptr, [](CScenarioRun &run) {
+                const std::string source = fmt::format(
+                        "for (let i = 0; i < {}; i++) console.log('line ' + i + ' of the flood');", kConsoleLines);
+                SCR::CScripting::RunScriptAsync(WriteScript("scenario_console", source));
+                return run.FramesUntil([] { return SCR::CScripting::RunningCount() == 0; }, kDrainTimeout,
+                                       true);
+            }});
+
+            list.push_back({"store_torn_tail", true, nullptr, StoreTornTailBody});
+            list.push_back({"store_compaction", true, nullptr, StoreCompactionBody});
+
+            return list;
+        }
+    }
+
+    const std::vector<Scenario> &GetScenarios() {
+        static const std::vector<Scenario> scenarios = BuildScenarios();
+        return scenarios;
+    }
+}
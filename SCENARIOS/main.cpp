@@ -0,0 +1,258 @@
+#include "Scenario.h"
+#include "../Dependencies/json/json.hpp"
+#include "fmt/core.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// nexus_scenarios [--baseline <file.json>] [--update-baseline] [--filter <substring>] [--out <report.json>]
+//                 [--headless] [--repeat <n>]
+//
+// Every scenario runs in a child process (`--run <name> --out <file>`) with
+// its own profile directory as HOME, so startup, memory and CPU figures are
+// per scenario and the user's real settings are never touched. Each one runs
+// --repeat times (3 by default) and reports the median of every metric. The
+// exit code is non-zero when a scenario fails, has no entry in the baseline
+// or a metric regresses past it.
+//
+// Timings depend on the machine, so the baseline also stores how long a
+// fixed calibration workload took where it was recorded. Baseline timings
+// are scaled by how much slower or faster that workload runs here before
+// the tolerance and slack are applied.
+// --headless runs the frame loop without a window or GL, for CI; its
+// numbers are not comparable with a windowed baseline.
+
+namespace {
+    const auto g_processStart = std::chrono::steady_clock::now();
+
+    constexpr double kDefaultTolerance = 0.25;
+    constexpr double kDefaultSlack = 0.5;
+    constexpr int kDefaultRepeat = 3;
+
+    void SetProfileHome(const std::filesystem::path &home) {
+#ifdef _WIN32
+        _putenv_s("USERPROFILE", home.string().c_str());
+#else
+        setenv("HOME", home.string().c_str(), 1);
+#endif
+    }
+
+    std::string Quote(const std::string &s) {
+        return "\"" + s + "\"";
+    }
+
+    // Per-metric value from an object like {"default": 0.25, "peak_rss_mb": 0.1}
+    double Setting(const nlohmann::json &obj, const std::string &metric, double fallback) {
+        if (!obj.is_object())
+            return fallback;
+        if (obj.contains(metric))
+            return obj[metric].get<double>();
+        return obj.value("default", fallback);
+    }
+
+    nlohmann::json ReadJson(const std::filesystem::path &path) {
+        std::ifstream in(path);
+        if (!in)
+            return nullptr;
+        return nlohmann::json::parse(in, nullptr, false);
+    }
+
+    // Where the calibration leaves its result, so it is not optimized away
+    volatile uint64_t g_calibrationSink = 0;
+
+    // Best of several runs of a fixed single-threaded workload: sorting and
+    // hashing, roughly the mix of the frame loop
+    double CalibrationMs() {
+        constexpr int kRuns = 5;
+        constexpr std::size_t kCount = 1 << 18;
+        double best = 0.0;
+        for (int r = 0; r < kRuns; r++) {
+            const auto t0 = std::chrono::steady_clock::now();
+            std::vector<uint64_t> v(kCount);
+            uint64_t x = 88172645463325252ull;
+            for (auto &e : v) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                e = x;
+            }
+            std::sort(v.begin(), v.end());
+            uint64_t hash = 14695981039346656037ull;
+            for (uint64_t e : v)
+                hash = (hash ^ e) * 1099511628211ull;
+            g_calibrationSink = hash;
+            const double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+            best = r == 0 ? ms : std::min(best, ms);
+        }
+        return best;
+    }
+
+    // Per metric, the median of the samples
+    nlohmann::json Median(const std::vector<nlohmann::json> &samples) {
+        nlohmann::json median = nlohmann::json::object();
+        for (const auto &[metric, value] : samples.front().items()) {
+            std::vector<double> values;
+            for (const auto &sample : samples)
+                if (sample.contains(metric))
+                    values.push_back(sample[metric].get<double>());
+            std::sort(values.begin(), values.end());
+            median[metric] = values[values.size() / 2];
+        }
+        return median;
+    }
+
+    bool IsTiming(const std::string &metric) {
+        return metric.size() > 3 && metric.compare(metric.size() - 3, 3, "_ms") == 0;
+    }
+}
+
+int main(int argc, char **argv) {
+    std::string run, filter, out, baselinePath;
+    bool updateBaseline = false;
+    bool headless = false;
+    int repeat = kDefaultRepeat;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--run") && i + 1 < argc)
+            run = argv[++i];
+        else if (!std::strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--out") && i + 1 < argc)
+            out = argv[++i];
+        else if (!std::strcmp(argv[i], "--baseline") && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (!std::strcmp(argv[i], "--update-baseline"))
+            updateBaseline = true;
+        else if (!std::strcmp(argv[i], "--headless"))
+            headless = true;
+        else if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc)
+            repeat = std::max(1, std::atoi(argv[++i]));
+        else {
+            fmt::print(stderr,
+                       "usage: {} [--baseline <file.json>] [--update-baseline] [--filter <substring>] "
+                       "[--out <report.json>] [--headless] [--repeat <n>]\n",
+                       argv[0]);
+            return 2;
+        }
+    }
+
+    // Child: one scenario in this process
+    if (!run.empty()) {
+        for (const SCENARIOS::Scenario &s : SCENARIOS::GetScenarios())
+            if (s.name == run)
+                return SCENARIOS::RunScenario(s, g_processStart, out, headless);
+        fmt::print(stderr, "unknown scenario {}\n", run);
+        return 2;
+    }
+
+    namespace fs = std::filesystem;
+    const fs::path work = fs::temp_directory_path() / "nexus_scenarios";
+    const fs::path home = work / "home";
+    std::error_code ec;
+    fs::create_directories(work, ec);
+
+    nlohmann::json baseline = baselinePath.empty() ? nlohmann::json(nullptr) : ReadJson(baselinePath);
+    if (!baselinePath.empty() && !baseline.is_object()) {
+        if (!updateBaseline) {
+            fmt::print(stderr, "cannot read baseline {}\n", baselinePath);
+            return 2;
+        }
+        baseline = nlohmann::json::object();
+    }
+
+    const double calibration = CalibrationMs();
+    // A baseline without a calibration is compared as recorded
+    double scale = 1.0;
+    if (baseline.is_object() && baseline.contains("calibration_ms") && !updateBaseline)
+        scale = calibration / baseline["calibration_ms"].get<double>();
+    fmt::print(stderr, "calibration {:.2f} ms, baseline timings scaled by {:.2f}\n", calibration, scale);
+
+    nlohmann::json report = nlohmann::json::object();
+    bool failed = false;
+    for (const SCENARIOS::Scenario &s : SCENARIOS::GetScenarios()) {
+        if (!filter.empty() && s.name.find(filter) == std::string::npos)
+            continue;
+
+        fmt::print(stderr, "== {}\n", s.name);
+        std::vector<nlohmann::json> samples;
+        for (int i = 0; i < repeat; i++) {
+            if (s.freshHome)
+                fs::remove_all(home, ec);
+            fs::create_directories(home, ec);
+            SetProfileHome(home);
+
+            const fs::path result = work / (s.name + ".json");
+            fs::remove(result, ec);
+            std::string cmd = Quote(argv[0]) + " --run " + s.name + " --out " + Quote(result.string());
+            if (headless)
+                cmd += " --headless";
+#ifdef _WIN32
+            cmd = Quote(cmd); // cmd.exe strips the outermost pair
+#endif
+            const int rc = std::system(cmd.c_str());
+            nlohmann::json sample = ReadJson(result);
+            if (rc != 0 || !sample.is_object()) {
+                fmt::print(stderr, "   FAILED (exit status {})\n", rc);
+                samples.clear();
+                break;
+            }
+            samples.push_back(std::move(sample));
+        }
+        if (samples.empty()) {
+            failed = true;
+            continue;
+        }
+        const nlohmann::json metrics = Median(samples);
+        report[s.name] = metrics;
+
+        if (updateBaseline || !baseline.is_object())
+            continue;
+
+        const nlohmann::json expected =
+                baseline.value("scenarios", nlohmann::json::object()).value(s.name, nlohmann::json());
+        if (!expected.is_object()) {
+            // Otherwise a scenario added without a baseline is never gated
+            fmt::print(stderr, "   FAILED: no baseline, run with --update-baseline to record one\n");
+            failed = true;
+            continue;
+        }
+        for (const auto &[metric, value] : expected.items()) {
+            if (!metrics.contains(metric))
+                continue;
+            const double base = value.get<double>() * (IsTiming(metric) ? scale : 1.0);
+            const double now = metrics[metric].get<double>();
+            const double limit =
+                    base * (1.0 + Setting(baseline.value("tolerance", nlohmann::json()), metric, kDefaultTolerance)) +
+                    Setting(baseline.value("slack", nlohmann::json()), metric, kDefaultSlack);
+            const bool regressed = now > limit;
+            fmt::print(stderr, "   {:<16} {:>10.2f}  baseline {:>10.2f}  limit {:>10.2f}{}\n", metric, now, base,
+                       limit, regressed ? "  REGRESSED" : "");
+            failed |= regressed;
+        }
+    }
+
+    if (updateBaseline && !baselinePath.empty()) {
+        for (const auto &[name, metrics] : report.items()) {
+            nlohmann::json kept = metrics;
+            // Reported but not gated: the frame count depends on how fast the
+            // setup went, and a single worst frame is too noisy to compare
+            kept.erase("frames");
+            kept.erase("frame_max_ms");
+            baseline["scenarios"][name] = kept;
+        }
+        baseline["calibration_ms"] = calibration;
+        std::ofstream(baselinePath, std::ios::trunc) << baseline.dump(2) << '\n';
+        fmt::print(stderr, "baseline written to {}\n", baselinePath);
+    }
+
+    if (!out.empty())
+        std::ofstream(out, std::ios::trunc) << report.dump(2) << '\n';
+    else
+        fmt::print("{}\n", report.dump(2));
+
+    return failed ? 1 : 0;
+}
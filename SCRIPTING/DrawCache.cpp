@@ -0,0 +1,74 @@
+#include "DrawCache.h"
+#include <algorithm>
+#include <limits>
+
+namespace SCR {
+
+    void CDrawCache::Start() {
+        origin = ImGui::GetCursorScreenPos();
+        firstIdx = ImGui::GetWindowDrawList()->IdxBuffer.Size;
+    }
+
+    void CDrawCache::Capture() {
+        const ImDrawList *dl = ImGui::GetWindowDrawList();
+        cmds.clear();
+        ImVec2 max = origin;
+        for (const ImDrawCmd &cmd : dl->CmdBuffer) {
+            const int begin = std::max((int)cmd.IdxOffset, firstIdx);
+            const int end = (int)(cmd.IdxOffset + cmd.ElemCount);
+            if (begin >= end || cmd.UserCallback)
+                continue;
+
+            // The vertices this command's indices use, renumbered from 0
+            unsigned int lo = std::numeric_limits<unsigned int>::max(), hi = 0;
+            for (int i = begin; i < end; i++) {
+                lo = std::min(lo, (unsigned int)dl->IdxBuffer[i]);
+                hi = std::max(hi, (unsigned int)dl->IdxBuffer[i]);
+            }
+            if (hi - lo >= std::numeric_limits<ImDrawIdx>::max()) {
+                // Too big to append to a draw list in one go
+                cmds.clear();
+                return;
+            }
+            Cmd copy{cmd.ClipRect, cmd.TextureId, {}, {}};
+            const ImDrawVert *vtx = dl->VtxBuffer.Data + cmd.VtxOffset;
+            copy.vtx.assign(vtx + lo, vtx + hi + 1);
+            copy.idx.reserve(end - begin);
+            for (int i = begin; i < end; i++)
+                copy.idx.push_back((ImDrawIdx)(dl->IdxBuffer[i] - lo));
+            for (const ImDrawVert &v : copy.vtx) {
+                max.x = std::max(max.x, v.pos.x);
+                max.y = std::max(max.y, v.pos.y);
+            }
+            cmds.push_back(std::move(copy));
+        }
+        // The cursor sits one item spacing below the last item
+        const ImVec2 cursor = ImGui::GetCursorScreenPos();
+        max.y = std::max(max.y, cursor.y - ImGui::GetStyle().ItemSpacing.y);
+        extent = ImVec2(max.x - origin.x, max.y - origin.y);
+    }
+
+    bool CDrawCache::Replay() {
+        if (cmds.empty())
+            return false;
+        ImDrawList *dl = ImGui::GetWindowDrawList();
+        const ImVec2 now = ImGui::GetCursorScreenPos();
+        const ImVec2 shift(now.x - origin.x, now.y - origin.y);
+        for (const Cmd &cmd : cmds) {
+            dl->PushClipRect(ImVec2(cmd.clip.x + shift.x, cmd.clip.y + shift.y),
+                             ImVec2(cmd.clip.z + shift.x, cmd.clip.w + shift.y), true);
+            dl->PushTextureID(cmd.texture);
+            dl->PrimReserve((int)cmd.idx.size(), (int)cmd.vtx.size());
+            const unsigned int base = dl->_VtxCurrentIdx;
+            for (ImDrawIdx i : cmd.idx)
+                dl->PrimWriteIdx((ImDrawIdx)(base + i));
+            for (const ImDrawVert &v : cmd.vtx)
+                dl->PrimWriteVtx(ImVec2(v.pos.x + shift.x, v.pos.y + shift.y), v.uv, v.col);
+            dl->PopTextureID();
+            dl->PopClipRect();
+        }
+        // Keeps the window's content size, and so its scrolling, as it was
+        ImGui::Dummy(extent);
+        return true;
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+#include <imgui.h>
+#include <vector>
+
+namespace SCR {
+
+    // A copy of what a window's content put into its draw list, so a frame
+    // that skips the content can show it again. Only geometry is kept: the
+    // copy follows the window when it moves or scrolls and keeps its layout
+    // size, but its widgets do not react until the content runs again, and
+    // child windows, which have draw lists of their own, are not in it.
+    class CDrawCache {
+        public:
+            // Right after ImGui::Begin, before the content
+            void Start();
+            // After the content; replaces the copy
+            void Capture();
+            // In place of the content. False when there is nothing to show.
+            bool Replay();
+            bool Empty() const { return cmds.empty(); }
+            void Clear() { cmds.clear(); }
+
+        private:
+            struct Cmd {
+                ImVec4 clip;
+                ImTextureID texture;
+                std::vector<ImDrawVert> vtx;
+                std::vector<ImDrawIdx> idx; // into vtx
+            };
+
+            std::vector<Cmd> cmds;
+            ImVec2 origin;   // content start on screen when captured
+            ImVec2 extent;   // what the content took up from there
+            int firstIdx = 0; // index buffer size at Start
+    };
+}
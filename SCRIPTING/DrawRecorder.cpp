@@ -0,0 +1,654 @@
+#include "DrawRecorder.h"
+#include "../UTILS/Logger.h"
+#include "../UTILS/ThreadPool.h"
+#include "EventBus.h"
+#include "FunctionBindings.h"
+#include "ImGuiBindings.h"
+#include "JsHelpers.h"
+#include "ModuleLoader.h"
+#include "ScriptArena.h"
+#include "SharedBuffers.h"
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <vector>
+
+namespace SCR {
+
+    // Indexed by opcode, which is the magic of the recording function
+    const CDrawRecorder::Call CDrawRecorder::calls[] = {
+            {"text", ui_text, 1, Kind::None, Value::Undefined, false},
+            {"text_colored", ui_text_colored, 4, Kind::None, Value::Undefined, false},
+            {"text_wrapped", ui_text_wrapped, 1, Kind::None, Value::Undefined, false},
+            {"bullet_text", ui_bullet_text, 1, Kind::None, Value::Undefined, false},
+            {"button", ui_button, 1, Kind::Edge, Value::Undefined, false},
+            {"small_button", ui_small_button, 1, Kind::Edge, Value::Undefined, false},
+            {"invisible_button", ui_invisible_button, 3, Kind::Edge, Value::Undefined, false},
+            {"radio_button", ui_radio_button, 2, Kind::Edge, Value::Undefined, false},
+            {"input_text", ui_input_text, 2, Kind::Edit, Value::Undefined, false},
+            {"input_int", ui_input_int, 2, Kind::Edit, Value::Undefined, false},
+            {"input_float", ui_input_float, 2, Kind::Edit, Value::Undefined, false},
+            {"slider_int", ui_slider_int, 4, Kind::Edit, Value::Undefined, false},
+            {"slider_float", ui_slider_float, 4, Kind::Edit, Value::Undefined, false},
+            {"checkbox", ui_checkbox, 2, Kind::Edit, Value::Undefined, false},
+            {"separator", ui_separator, 0, Kind::None, Value::Undefined, false},
+            {"same_line", ui_same_line, 1, Kind::None, Value::Undefined, false},
+            {"new_line", ui_new_line, 0, Kind::None, Value::Undefined, false},
+            {"spacing", ui_spacing, 0, Kind::None, Value::Undefined, false},
+            {"dummy", ui_dummy, 2, Kind::None, Value::Undefined, false},
+            {"tree_node", ui_tree_node, 1, Kind::Level, Value::False, false},
+            {"tree_pop", ui_tree_pop, 0, Kind::None, Value::Undefined, false},
+            {"collapsing_header", ui_collapsing_header, 1, Kind::Level, Value::False, false},
+            {"progress_bar", ui_progress_bar, 3, Kind::None, Value::Undefined, false},
+            {"image", ui_image, 3, Kind::None, Value::Undefined, false},
+            {"is_key_pressed", ui_is_key_pressed, 2, Kind::Edge, Value::Undefined, false},
+            {"is_window_focused", ui_is_window_focused, 0, Kind::Level, Value::False, false},
+            {"frame", ui_frame, 0, Kind::Level, Value::Number, false},
+            {"get_cursor_screen_pos", ui_get_cursor_screen_pos, 0, Kind::Level, Value::Point, false},
+            {"add_line", ui_add_line, 6, Kind::None, Value::Undefined, true},
+            {"add_rect", ui_add_rect, 8, Kind::None, Value::Undefined, true},
+            {"add_rect_filled", ui_add_rect_filled, 7, Kind::None, Value::Undefined, true},
+            {"add_rect_filled_multi_color", ui_add_rect_filled_multi_color, 8, Kind::None, Value::Undefined, true},
+            {"add_circle", ui_add_circle, 6, Kind::None, Value::Undefined, true},
+            {"add_circle_filled", ui_add_circle_filled, 5, Kind::None, Value::Undefined, true},
+            {"add_ellipse", ui_add_ellipse, 8, Kind::None, Value::Undefined, true},
+            {"add_ellipse_filled", ui_add_ellipse_filled, 7, Kind::None, Value::Undefined, true},
+            {"add_ngon", ui_add_ngon, 6, Kind::None, Value::Undefined, true},
+            {"add_ngon_filled", ui_add_ngon_filled, 5, Kind::None, Value::Undefined, true},
+            {"add_quad", ui_add_quad, 10, Kind::None, Value::Undefined, true},
+            {"add_quad_filled", ui_add_quad_filled, 9, Kind::None, Value::Undefined, true},
+            {"add_triangle", ui_add_triangle, 8, Kind::None, Value::Undefined, true},
+            {"add_triangle_filled", ui_add_triangle_filled, 7, Kind::None, Value::Undefined, true},
+            {"add_bezier_cubic", ui_add_bezier_cubic, 11, Kind::None, Value::Undefined, true},
+            {"add_bezier_quadratic", ui_add_bezier_quadratic, 9, Kind::None, Value::Undefined, true},
+            {"add_image", ui_add_image, 10, Kind::None, Value::Undefined, true},
+            {"add_image_quad", ui_add_image_quad, 18, Kind::None, Value::Undefined, true},
+            {"add_image_rounded", ui_add_image_rounded, 11, Kind::None, Value::Undefined, true},
+            {"add_text_dl", ui_add_text, 4, Kind::None, Value::Undefined, true},
+            {"draw_batch", ui_draw_batch, 3, Kind::None, Value::Undefined, true},
+    };
+
+    namespace {
+        template <typename T> void Append(std::string &out, T v) {
+            out.append(reinterpret_cast<const char *>(&v), sizeof(v));
+        }
+
+        template <typename T> bool Read(std::string_view bytes, std::size_t &pos, T &v) {
+            if (bytes.size() - pos < sizeof(v))
+                return false;
+            std::memcpy(&v, bytes.data() + pos, sizeof(v));
+            pos += sizeof(v);
+            return true;
+        }
+    }
+
+    CDrawRecorder::CDrawRecorder(std::string title, std::string fnSource, std::string modulePath,
+                                 std::shared_ptr<ClonedValue> state)
+        : title(std::move(title)), fnSource(std::move(fnSource)), modulePath(std::move(modulePath)),
+          initialState(std::move(state)) {}
+
+    CDrawRecorder::~CDrawRecorder() { Teardown(); }
+
+    void CDrawRecorder::Hold() {
+        std::lock_guard<std::mutex> lk(m);
+        holds++;
+    }
+
+    void CDrawRecorder::Post(std::function<void(JSContext *)> task) {
+        std::lock_guard<std::mutex> lk(m);
+        holds--;
+        // Runs before the next recording
+        if (!stopped)
+            tasks.push_back(std::move(task));
+    }
+
+    void CDrawRecorder::Update(std::string_view delta) {
+        std::lock_guard<std::mutex> lk(m);
+        if (stopped)
+            return;
+        tasks.push_back([this, delta = std::string(delta)](JSContext *c) {
+            if (merge_state(c, state, delta))
+                changed = true;
+        });
+    }
+
+    void CDrawRecorder::Stop() {
+        bool idle;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stopped = true;
+            idle = !busy;
+        }
+        // Cuts a recording that is running short; it tears down when it ends
+        interrupt = true;
+        if (idle)
+            Teardown();
+    }
+
+    bool CDrawRecorder::Drained() {
+        std::lock_guard<std::mutex> lk(m);
+        return closed && holds == 0;
+    }
+
+    // Recording side, on the recording pool
+
+    void CDrawRecorder::Record(uint64_t generation, Feedback fresh) {
+        auto out = std::make_shared<Commands>();
+        out->generation = generation;
+
+        bool ok = true;
+        if (rt) {
+            // Recordings land on whichever pool thread is free
+            JS_UpdateStackTop(rt);
+        } else if (!(ok = Boot(out->error))) {
+            LOG_WARN(Script, "{}: [JS exception] {}", title, out->error);
+        }
+
+        if (ok) {
+            RunTasks();
+            for (auto &[key, value] : fresh)
+                feedback[key] = std::move(value);
+            commands.clear();
+            recordSeen.clear();
+
+            JSValue global = JS_GetGlobalObject(ctx);
+            JSValue ui = JS_GetPropertyStr(ctx, global, "ui");
+            JSValue args[] = {ui, state, JS_NewBool(ctx, changed)};
+            recording = true;
+            JSValue r = JS_Call(ctx, draw, JS_UNDEFINED, 3, args);
+            recording = false;
+            changed = false;
+            if (JS_IsException(r))
+                out->error = TakeException(ctx);
+            JS_FreeValue(ctx, r);
+            JS_FreeValue(ctx, ui);
+            JS_FreeValue(ctx, global);
+
+            JSContext *failedCtx = ctx;
+            if (!RunJobs(rt, failedCtx))
+                Report(failedCtx);
+            out->bytes.swap(commands);
+
+            // Presses and edits for calls this draw did not make are stale;
+            // levels stay until a replay sees something else
+            for (auto it = feedback.begin(); it != feedback.end();)
+                it = calls[(uint8_t)it->first[0]].kind == Kind::Level ? std::next(it) : feedback.erase(it);
+        }
+
+        bool teardown;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            failed = !ok;
+            latest = std::move(out);
+            busy = false;
+            teardown = stopped;
+        }
+        if (teardown)
+            Teardown();
+    }
+
+    bool CDrawRecorder::Boot(std::string &error) {
+        arena = std::make_unique<CScriptArena>();
+        rt = arena->NewRuntime();
+        if (!rt) {
+            error = "cannot create runtime";
+            return false;
+        }
+        register_class(rt);
+        CModuleLoader::Install(rt);
+        CSharedBuffers::InstallAllocator(rt);
+        JS_SetInterruptHandler(rt, Interrupt, this);
+        ctx = JS_NewContext(rt);
+        if (!ctx) {
+            error = "cannot create context";
+            return false;
+        }
+        Attach(ctx);
+        InstallUi(ctx);
+        CEventBus::Install(ctx);
+        CSharedBuffers::Install(ctx);
+
+        state = initialState->data.empty() ? JS_NewObject(ctx) : CStructuredClone::Deserialize(ctx, *initialState);
+        initialState.reset();
+        JSValue init = JS_UNDEFINED;
+        if (!JS_IsException(state))
+            draw = load_draw_callback(ctx, fnSource, modulePath, init);
+        if (JS_IsException(state) || JS_IsException(draw)) {
+            state = draw = JS_UNDEFINED;
+            error = TakeException(ctx);
+            return false;
+        }
+
+        if (JS_IsFunction(ctx, init)) {
+            JSValue r = JS_Call(ctx, init, JS_UNDEFINED, 1, &state);
+            if (JS_IsException(r))
+                Report(ctx);
+            JS_FreeValue(ctx, r);
+        }
+        JS_FreeValue(ctx, init);
+        return true;
+    }
+
+    void CDrawRecorder::RunTasks() {
+        std::deque<std::function<void(JSContext *)>> queued;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            queued.swap(tasks);
+        }
+        for (auto &task : queued) {
+            task(ctx);
+            JSContext *failedCtx = ctx;
+            if (Threw(ctx))
+                Report(ctx);
+            else if (!RunJobs(rt, failedCtx))
+                Report(failedCtx);
+        }
+    }
+
+    void CDrawRecorder::Report(JSContext *failedCtx) {
+        LOG_WARN(Script, "{}: [JS exception] {}", title, TakeException(failedCtx));
+    }
+
+    void CDrawRecorder::Teardown() {
+        std::deque<std::function<void(JSContext *)>> dropped;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            dropped.swap(tasks);
+        }
+        std::size_t released = 0;
+        if (ctx) {
+            JS_UpdateStackTop(rt);
+            // Its subscriptions are gone without the Post that would release
+            // them
+            released = Close(ctx);
+            JS_FreeValue(ctx, draw);
+            JS_FreeValue(ctx, state);
+            draw = state = JS_UNDEFINED;
+            JS_FreeContext(ctx);
+            ctx = nullptr;
+        }
+        if (rt) {
+            JS_FreeRuntime(rt);
+            rt = nullptr;
+        }
+        arena.reset();
+
+        std::lock_guard<std::mutex> lk(m);
+        holds -= (std::ptrdiff_t)released;
+        closed = true;
+    }
+
+    void CDrawRecorder::InstallUi(JSContext *ctx) {
+        static_assert(std::size(calls) <= 256, "opcodes are one byte");
+        JSValue ui = JS_NewObject(ctx);
+        for (std::size_t op = 0; op < std::size(calls); op++)
+            JS_SetPropertyStr(ctx, ui, calls[op].name,
+                              JS_NewCFunctionMagic(ctx, JsRecord, calls[op].name, calls[op].length,
+                                                   JS_CFUNC_generic_magic, (int)op));
+        JS_SetPropertyStr(ctx, ui, "create_window", JS_NewCFunction(ctx, js_create_window, "create_window", 2));
+        JS_SetPropertyStr(ctx, ui, "load_image", JS_NewCFunction(ctx, JsLoadImage, "load_image", 1));
+        install_draw_ops(ctx, ui);
+
+        JS_SetPropertyStr(ctx, ui, "KEY_LEFT", JS_NewInt32(ctx, KEY_LEFT));
+        JS_SetPropertyStr(ctx, ui, "KEY_RIGHT", JS_NewInt32(ctx, KEY_RIGHT));
+        JS_SetPropertyStr(ctx, ui, "KEY_UP", JS_NewInt32(ctx, KEY_UP));
+        JS_SetPropertyStr(ctx, ui, "KEY_DOWN", JS_NewInt32(ctx, KEY_DOWN));
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "ui", ui);
+        JS_FreeValue(ctx, global);
+    }
+
+    JSValue CDrawRecorder::JsRecord(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int magic) {
+        auto *self = static_cast<CDrawRecorder *>(Of(ctx));
+        const Call &call = calls[magic];
+        if (!self->recording)
+            return JS_ThrowTypeError(ctx, "ui.%s: only available while drawing", call.name);
+
+        // [op][argc] then each argument, and for a Level what it returned
+        const int n = std::min(argc, 255);
+        std::string &out = self->commands;
+        out.push_back((char)magic);
+        out.push_back((char)n);
+        Value label, value;
+        for (int i = 0; i < n; i++) {
+            Value arg = FromJS(ctx, argv[i]);
+            Encode(out, arg);
+            if (i == 0)
+                label = std::move(arg);
+            else if (i == 1)
+                value = std::move(arg);
+        }
+        if (call.kind == Kind::None)
+            return JS_UNDEFINED;
+
+        const bool labelled = label.type == Value::String || label.type == Value::Number;
+        const std::string key = Key(magic, labelled ? &label : nullptr, self->recordSeen);
+        auto it = self->feedback.find(key);
+        const bool fed = it != self->feedback.end();
+        Value result;
+        switch (call.kind) {
+            case Kind::Edge:
+                result.type = fed && it->second.type == Value::True ? Value::True : Value::False;
+                break;
+            case Kind::Edit:
+                result = fed ? it->second : value;
+                break;
+            default:
+                if (fed)
+                    result = it->second;
+                else
+                    result.type = call.initial;
+                Encode(out, result);
+                break;
+        }
+        // Presses and edits are returned once
+        if (fed && call.kind != Kind::Level)
+            self->feedback.erase(it);
+        return ToJS(ctx, result);
+    }
+
+    JSValue CDrawRecorder::JsLoadImage(JSContext *ctx, JSValueConst, int, JSValueConst *) {
+        return JS_ThrowTypeError(ctx, "ui.load_image: not available in a deferred window");
+    }
+
+    int CDrawRecorder::Interrupt(JSRuntime *, void *opaque) {
+        return ((CDrawRecorder *)opaque)->interrupt.load(std::memory_order_relaxed) ? 1 : 0;
+    }
+
+    // Replay side, on the GUI thread
+
+    bool CDrawRecorder::Ready() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (latest)
+                return true;
+        }
+        StartRecording();
+        return false;
+    }
+
+    void CDrawRecorder::Replay(JSContext *gui) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            shown = latest;
+        }
+        if (shown) {
+            // Edits a shown recording took in are part of its arguments now
+            for (auto it = results.begin(); it != results.end();) {
+                const Result &r = it->second;
+                const bool done = r.kind == Kind::Edit && r.sentIn != 0 && r.sentIn <= shown->generation;
+                it = done ? results.erase(it) : std::next(it);
+            }
+            Execute(gui, *shown);
+        }
+        StartRecording();
+    }
+
+    void CDrawRecorder::Execute(JSContext *gui, const Commands &recorded) {
+        replaySeen.clear();
+        const std::string_view bytes = recorded.bytes;
+        std::size_t pos = 0;
+        int skipped = 0;   // depth of tree nodes recorded open that the replay found closed
+        ImVec2 shift{0, 0}; // how far the window moved since the recording asked where it was
+        std::vector<Value> args;
+        std::vector<JSValue> jsArgs;
+        std::string error;
+
+        while (bytes.size() - pos >= 2) {
+            const uint8_t op = (uint8_t)bytes[pos];
+            const uint8_t argc = (uint8_t)bytes[pos + 1];
+            pos += 2;
+            if (op >= std::size(calls))
+                break;
+            const Call &call = calls[op];
+            args.resize(argc);
+            bool ok = true;
+            for (Value &arg : args)
+                ok = ok && Decode(bytes, pos, arg);
+            Value seen; // what the script got from a Level
+            if (!ok || (call.kind == Kind::Level && !Decode(bytes, pos, seen)))
+                break;
+
+            std::string key;
+            if (call.kind != Kind::None) {
+                const bool labelled =
+                        !args.empty() && (args[0].type == Value::String || args[0].type == Value::Number);
+                key = Key(op, labelled ? &args[0] : nullptr, replaySeen);
+            }
+            if (skipped > 0) {
+                if (call.fn == ui_tree_pop)
+                    skipped--;
+                else if (call.fn == ui_tree_node && seen.type == Value::True)
+                    skipped++;
+                continue;
+            }
+
+            auto found = call.kind == Kind::None ? results.end() : results.find(key);
+            if (call.kind == Kind::Edit && found != results.end() && args.size() > 1)
+                args[1] = found->second.value;
+
+            jsArgs.clear();
+            for (const Value &arg : args)
+                jsArgs.push_back(ToJS(gui, arg));
+            ImDrawList *dl = ImGui::GetWindowDrawList();
+            const int firstVtx = dl->VtxBuffer.Size;
+            JSValue r = call.fn(gui, JS_UNDEFINED, (int)jsArgs.size(), jsArgs.data());
+            for (JSValue v : jsArgs)
+                JS_FreeValue(gui, v);
+            if (JS_IsException(r)) {
+                error = TakeException(gui);
+                break;
+            }
+            if (call.screen && (shift.x != 0 || shift.y != 0)) {
+                for (int i = firstVtx; i < dl->VtxBuffer.Size; i++) {
+                    dl->VtxBuffer[i].pos.x += shift.x;
+                    dl->VtxBuffer[i].pos.y += shift.y;
+                }
+            }
+
+            switch (call.kind) {
+                case Kind::Edge:
+                    if (JS_ToBool(gui, r)) {
+                        Value pressed{};
+                        pressed.type = Value::True;
+                        results[key] = Result{std::move(pressed), Kind::Edge, 0};
+                    }
+                    break;
+                case Kind::Edit: {
+                    Value now = FromJS(gui, r);
+                    // Float widgets hand back their value at float precision
+                    const bool same = args.size() > 1 && now.type == Value::Number &&
+                                                      args[1].type == Value::Number
+                                              ? (float)now.x == (float)args[1].x
+                                              : args.size() > 1 && now == args[1];
+                    if (!same)
+                        results[key] = Result{std::move(now), Kind::Edit, 0};
+                    break;
+                }
+                case Kind::Level: {
+                    Value now = FromJS(gui, r);
+                    if (call.fn == ui_get_cursor_screen_pos)
+                        shift = ImVec2((float)(now.x - seen.x), (float)(now.y - seen.y));
+                    if (call.fn == ui_tree_node) {
+                        // The script drew, or left out, the node's contents
+                        // by what it was told
+                        if (seen.type == Value::True && now.type != Value::True)
+                            skipped = 1;
+                        else if (seen.type != Value::True && now.type == Value::True)
+                            ImGui::TreePop();
+                    }
+                    Result &level = results[key];
+                    if (level.kind != Kind::Level || level.value != now)
+                        level = Result{std::move(now), Kind::Level, 0};
+                    break;
+                }
+                case Kind::None:
+                    break;
+            }
+            JS_FreeValue(gui, r);
+        }
+
+        if (!error.empty())
+            ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "[JS exception] %s", error.c_str());
+        if (!recorded.error.empty())
+            ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "[JS exception] %s", recorded.error.c_str());
+    }
+
+    void CDrawRecorder::StartRecording() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            if (busy || stopped || failed)
+                return;
+            busy = true;
+        }
+        const uint64_t generation = nextGeneration++;
+        Feedback fresh;
+        for (auto it = results.begin(); it != results.end();) {
+            Result &r = it->second;
+            if (r.sentIn == 0) {
+                fresh.emplace(it->first, r.value);
+                r.sentIn = generation;
+            }
+            // A press goes back once; edits stay until a recording shows them
+            it = r.kind == Kind::Edge ? results.erase(it) : std::next(it);
+        }
+        RecordPool().Add([self = shared_from_this(), generation, fresh = std::move(fresh)]() mutable {
+            self->Record(generation, std::move(fresh));
+        });
+    }
+
+    ThreadPool &CDrawRecorder::RecordPool() {
+        static ThreadPool pool(kRecordThreads);
+        return pool;
+    }
+
+    // Encoding
+
+    void CDrawRecorder::Encode(std::string &out, const Value &v) {
+        out.push_back((char)v.type);
+        switch (v.type) {
+            case Value::Number:
+                Append(out, v.x);
+                break;
+            case Value::String:
+            case Value::Words:
+                Append(out, (uint32_t)v.s.size());
+                out += v.s;
+                break;
+            case Value::Point:
+                Append(out, v.x);
+                Append(out, v.y);
+                break;
+            default:
+                break;
+        }
+    }
+
+    bool CDrawRecorder::Decode(std::string_view bytes, std::size_t &pos, Value &out) {
+        if (pos >= bytes.size())
+            return false;
+        out.type = (Value::Type)bytes[pos++];
+        out.s.clear();
+        switch (out.type) {
+            case Value::Number:
+                return Read(bytes, pos, out.x);
+            case Value::String:
+            case Value::Words: {
+                uint32_t n;
+                if (!Read(bytes, pos, n) || bytes.size() - pos < n)
+                    return false;
+                out.s.assign(bytes.data() + pos, n);
+                pos += n;
+                return true;
+            }
+            case Value::Point:
+                return Read(bytes, pos, out.x) && Read(bytes, pos, out.y);
+            case Value::Undefined:
+            case Value::False:
+            case Value::True:
+                return true;
+        }
+        return false;
+    }
+
+    JSValue CDrawRecorder::ToJS(JSContext *ctx, const Value &v) {
+        switch (v.type) {
+            case Value::Number:
+                // The cast is only defined for values in range
+                if (std::isfinite(v.x) && v.x >= INT32_MIN && v.x <= INT32_MAX && v.x == (int32_t)v.x)
+                    return JS_NewInt32(ctx, (int32_t)v.x);
+                return JS_NewFloat64(ctx, v.x);
+            case Value::String:
+                return JS_NewStringLen(ctx, v.s.data(), v.s.size());
+            case Value::Words:
+                return JS_NewArrayBufferCopy(ctx, (const uint8_t *)v.s.data(), v.s.size());
+            case Value::False:
+                return JS_FALSE;
+            case Value::True:
+                return JS_TRUE;
+            case Value::Point: {
+                JSValue obj = JS_NewObject(ctx);
+                JS_SetPropertyStr(ctx, obj, "x", JS_NewFloat64(ctx, v.x));
+                JS_SetPropertyStr(ctx, obj, "y", JS_NewFloat64(ctx, v.y));
+                return obj;
+            }
+            case Value::Undefined:
+                break;
+        }
+        return JS_UNDEFINED;
+    }
+
+    CDrawRecorder::Value CDrawRecorder::FromJS(JSContext *ctx, JSValueConst v) {
+        Value out;
+        if (JS_IsNumber(v)) {
+            out.type = Value::Number;
+            JS_ToFloat64(ctx, &out.x, v);
+        } else if (JS_IsBool(v)) {
+            out.type = JS_ToBool(ctx, v) ? Value::True : Value::False;
+        } else if (JS_IsString(v)) {
+            std::size_t n;
+            const char *s = JS_ToCStringLen(ctx, &n, v);
+            if (s) {
+                out.type = Value::String;
+                out.s.assign(s, n);
+                JS_FreeCString(ctx, s);
+            }
+        } else if (JS_IsObject(v)) {
+            // A draw_batch buffer, or {x, y} as get_cursor_screen_pos
+            // returns it; other objects are not ui arguments
+            const uint8_t *words;
+            std::size_t count;
+            if (draw_batch_words(ctx, v, words, count)) {
+                out.type = Value::Words;
+                out.s.assign((const char *)words, count * 4);
+                return out;
+            }
+            JS_FreeValue(ctx, JS_GetException(ctx));
+            JSValue x = JS_GetPropertyStr(ctx, v, "x");
+            JSValue y = JS_GetPropertyStr(ctx, v, "y");
+            if (JS_IsNumber(x) && JS_IsNumber(y)) {
+                out.type = Value::Point;
+                JS_ToFloat64(ctx, &out.x, x);
+                JS_ToFloat64(ctx, &out.y, y);
+            }
+            JS_FreeValue(ctx, x);
+            JS_FreeValue(ctx, y);
+        }
+        return out;
+    }
+
+    std::string CDrawRecorder::Key(int op, const Value *label, std::unordered_map<std::string, int> &seen) {
+        // The opcode leads, so the kind of call is known from the key alone
+        std::string key(1, (char)op);
+        if (label && label->type == Value::String)
+            key += label->s;
+        else if (label)
+            Append(key, label->x);
+        key += '\x1f';
+        key += std::to_string(seen[key]++);
+        return key;
+    }
+}
@@ -0,0 +1,178 @@
+#pragma once
+#include "RunLoop.h"
+#include "StructuredClone.h"
+#include <quickjs.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+class ThreadPool;
+
+namespace SCR {
+
+    class CScriptArena;
+
+    // The script half of a deferred window, ui.create_window(title, draw,
+    // {deferred: true}). Its draw callback runs in a runtime of its own on
+    // a pool of recording threads, against a `ui` object that records every call
+    // into a command buffer instead of drawing. The GUI thread replays the
+    // newest buffer each frame through the regular ui functions, so a slow
+    // script only updates its window less often and never holds up the
+    // frame.
+    //
+    // What the user does to the replayed widgets goes back with the next
+    // recording, keyed by function, label and occurrence: a button or key
+    // press is returned by that call exactly once, an edited slider, input
+    // or checkbox returns its new value, and tree_node, collapsing_header,
+    // is_window_focused, get_cursor_screen_pos and frame return what the
+    // latest replay saw. Until a recording has taken an edit in, replays
+    // keep showing the edited value rather than the recorded one, and
+    // draw-list shapes follow the window when it moved since the recording
+    // asked for the cursor position. A ui.draw_batch buffer is copied as it
+    // was at the call. ui.load_image is not available; images
+    // can be loaded by a regular window and drawn here by handle.
+    class CDrawRecorder : public CRunLoop, public std::enable_shared_from_this<CDrawRecorder> {
+        public:
+            CDrawRecorder(std::string title, std::string fnSource, std::string modulePath,
+                          std::shared_ptr<ClonedValue> state);
+            ~CDrawRecorder() override;
+
+            CDrawRecorder(const CDrawRecorder &) = delete;
+            CDrawRecorder &operator=(const CDrawRecorder &) = delete;
+
+            void Hold() override;
+            void Post(std::function<void(JSContext *)> task) override;
+
+            // GUI thread. Whether there is a recording to replay; starts
+            // the first one otherwise.
+            bool Ready();
+            // GUI thread. Replays the newest recording into the current
+            // ImGui window and starts the next one unless one is running.
+            void Replay(JSContext *gui);
+            // GUI thread; merged into the state before the next recording
+            void Update(std::string_view delta);
+            // GUI thread. The runtime is freed once no recording runs.
+            void Stop();
+            // No Hold is waiting for its Post any more
+            bool Drained();
+
+            // Where recordings run; apart from the worker executor, so
+            // busy workers never hold up a window
+            static ThreadPool &RecordPool();
+            static constexpr std::size_t kRecordThreads = 2;
+
+        private:
+            // A call argument, or what a replayed call returned
+            struct Value {
+                enum Type : uint8_t { Undefined, Number, String, False, True, Point, Words };
+                Type type = Undefined;
+                double x = 0, y = 0;
+                std::string s; // a String, or the bytes of Words
+
+                bool operator==(const Value &o) const {
+                    return type == o.type && x == o.x && y == o.y && s == o.s;
+                }
+                bool operator!=(const Value &o) const { return !(*this == o); }
+            };
+
+            // What the script gets back from a recorded call. A recorded
+            // Level is followed by the value the script got, which the
+            // replay reconciles with what it sees.
+            enum class Kind : uint8_t {
+                None,  // undefined
+                Edge,  // true once for each time a replay returned true
+                Edit,  // the edited value, or the value passed in
+                Level, // what the latest replay returned
+            };
+
+            struct Call {
+                const char *name;
+                JSCFunction *fn; // the ui function it replays through
+                int length;
+                Kind kind;
+                Value::Type initial; // a Level before any replay saw it
+                bool screen;         // draws at screen positions
+            };
+            static const Call calls[];
+
+            struct Commands {
+                std::string bytes;
+                uint64_t generation = 0;
+                std::string error; // the draw callback threw
+            };
+
+            // What a replay saw, on its way back to the script
+            struct Result {
+                Value value;
+                Kind kind = Kind::None;
+                uint64_t sentIn = 0; // the recording it went to, 0 while unsent
+            };
+
+            using Feedback = std::unordered_map<std::string, Value>;
+
+            // Recording pool
+            void Record(uint64_t generation, Feedback fresh);
+            bool Boot(std::string &error);
+            void RunTasks();
+            void Report(JSContext *failed);
+            // Whichever side is last to let go of the runtime
+            void Teardown();
+
+            // GUI thread
+            void Execute(JSContext *gui, const Commands &commands);
+            void StartRecording();
+
+            static void InstallUi(JSContext *ctx);
+            static JSValue JsRecord(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int magic);
+            static JSValue JsLoadImage(JSContext *ctx, JSValueConst, int, JSValueConst *);
+            static int Interrupt(JSRuntime *, void *opaque);
+
+            static void Encode(std::string &out, const Value &v);
+            static bool Decode(std::string_view bytes, std::size_t &pos, Value &out);
+            static JSValue ToJS(JSContext *ctx, const Value &v);
+            static Value FromJS(JSContext *ctx, JSValueConst v);
+            // Identifies a call across recording and replay: its function,
+            // its label and how many calls with both came before it
+            static std::string Key(int op, const Value *label, std::unordered_map<std::string, int> &seen);
+
+            const std::string title;
+            const std::string fnSource;
+            const std::string modulePath;
+            std::shared_ptr<ClonedValue> initialState;
+
+            std::mutex m;
+            bool busy = false;    // a recording is queued or running
+            bool stopped = false;
+            bool closed = false;  // the runtime is gone
+            bool failed = false;  // the script could not be loaded
+            std::ptrdiff_t holds = 0;
+            std::deque<std::function<void(JSContext *)>> tasks;
+            std::shared_ptr<const Commands> latest;
+            std::atomic<bool> interrupt{false};
+
+            // Recording side, only touched by the one recording running
+            std::unique_ptr<CScriptArena> arena;
+            JSRuntime *rt = nullptr;
+            JSContext *ctx = nullptr;
+            JSValue draw = JS_UNDEFINED;
+            JSValue state = JS_UNDEFINED;
+            bool changed = true;
+            bool recording = false;
+            std::string commands;
+            Feedback feedback;
+            std::unordered_map<std::string, int> recordSeen;
+
+            // Replay side
+            std::shared_ptr<const Commands> shown;
+            std::unordered_map<std::string, Result> results;
+            std::unordered_map<std::string, int> replaySeen;
+            uint64_t nextGeneration = 1;
+    };
+}
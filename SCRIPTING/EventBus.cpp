@@ -0,0 +1,266 @@
+#include "EventBus.h"
+#include "FunctionBindings.h"
+#include "RunLoop.h"
+#include "StructuredClone.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+namespace SCR {
+
+    JSClassID CEventBus::subscriptionClassId = 0;
+
+    namespace {
+        bool ToTopic(JSContext *ctx, JSValueConst arg, std::string &out) {
+            if (!JS_IsString(arg)) {
+                JS_ThrowTypeError(ctx, "bus: topic string expected");
+                return false;
+            }
+            std::size_t n;
+            const char *s = JS_ToCStringLen(ctx, &n, arg);
+            if (!s)
+                return false;
+            out.assign(s, n);
+            JS_FreeCString(ctx, s);
+            return true;
+        }
+    }
+
+    CEventBus &CEventBus::Get() {
+        static CEventBus bus;
+        return bus;
+    }
+
+    void CEventBus::Install(JSContext *ctx) {
+        RegisterSubscription(ctx);
+
+        JSValue bus = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, bus, "publish", JS_NewCFunction(ctx, JsPublish, "publish", 2));
+        JS_SetPropertyStr(ctx, bus, "subscribe", JS_NewCFunction(ctx, JsSubscribe, "subscribe", 3));
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "bus", bus);
+        JS_FreeValue(ctx, global);
+    }
+
+    void CEventBus::RegisterSubscription(JSContext *ctx) {
+        static std::once_flag once;
+        std::call_once(once, [] { JS_NewClassID(&subscriptionClassId); });
+
+        JSRuntime *rt = JS_GetRuntime(ctx);
+        if (!JS_IsRegisteredClass(rt, subscriptionClassId)) {
+            JSClassDef def{};
+            def.class_name = "Subscription";
+            def.finalizer = SubscriptionFinalizer;
+            JS_NewClass(rt, subscriptionClassId, &def);
+        }
+        if (has_class_proto(ctx, subscriptionClassId))
+            return;
+
+        JSValue proto = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, proto, "unsubscribe", JS_NewCFunction(ctx, JsUnsubscribe, "unsubscribe", 0));
+        JSAtom dropped = JS_NewAtom(ctx, "dropped");
+        JS_DefinePropertyGetSet(ctx, proto, dropped, JS_NewCFunction(ctx, JsDropped, "dropped", 0), JS_UNDEFINED,
+                                JS_PROP_CONFIGURABLE);
+        JS_FreeAtom(ctx, dropped);
+        JS_SetClassProto(ctx, subscriptionClassId, proto);
+    }
+
+    std::size_t CEventBus::Publish(const std::string &topic, const Message &message) {
+        std::shared_lock<std::shared_mutex> lk(m);
+        auto it = topics.find(topic);
+        if (it == topics.end())
+            return 0;
+
+        std::size_t reached = 0;
+        for (const auto &sub : it->second) {
+            if (!Offer(*sub, message))
+                continue;
+            reached++;
+            if (!sub->scheduled.exchange(true))
+                Wake(sub);
+        }
+        return reached;
+    }
+
+    bool CEventBus::Offer(Subscriber &sub, const Message &message) {
+        for (;;) {
+            if (sub.held.fetch_add(1) < sub.capacity && sub.queue.push(message))
+                return true;
+            sub.held--;
+            if (sub.policy == DropPolicy::Newest) {
+                sub.dropped++;
+                return false;
+            }
+            // Make room by dropping the oldest; another publisher may take
+            // the slot first, in which case the next oldest goes too
+            Message oldest;
+            if (sub.queue.pop(oldest)) {
+                sub.held--;
+                sub.dropped++;
+            }
+        }
+    }
+
+    void CEventBus::Wake(const std::shared_ptr<Subscriber> &sub) {
+        sub->loop->Hold();
+        sub->loop->Post([sub](JSContext *ctx) { Deliver(sub, ctx); });
+    }
+
+    void CEventBus::Deliver(const std::shared_ptr<Subscriber> &sub, JSContext *ctx) {
+        // Cleared before popping, so a message queued after the last pop
+        // posts a new delivery
+        sub->scheduled = false;
+
+        Message message;
+        for (int n = 0; n < kBatch && sub->active && sub->queue.pop(message); n++) {
+            sub->held--;
+            JSValue args[2] = {CStructuredClone::Deserialize(ctx, *message),
+                               JS_NewStringLen(ctx, sub->topic.data(), sub->topic.size())};
+            if (JS_IsException(args[0])) {
+                JS_FreeValue(ctx, args[1]);
+                break;
+            }
+            // The callback may unsubscribe, which frees it
+            JSValue callback = JS_DupValue(ctx, sub->callback);
+            JSValue r = JS_Call(ctx, callback, JS_UNDEFINED, 2, args);
+            JS_FreeValue(ctx, callback);
+            JS_FreeValue(ctx, args[0]);
+            JS_FreeValue(ctx, args[1]);
+            if (JS_IsException(r))
+                break; // left pending for the loop to report
+            JS_FreeValue(ctx, r);
+        }
+
+        // A full batch, or a callback that threw, leaves messages for later
+        if (sub->active && sub->queue.size_approx() > 0 && !sub->scheduled.exchange(true))
+            Wake(sub);
+    }
+
+    void CEventBus::Unsubscribe(const std::shared_ptr<Subscriber> &sub, JSContext *ctx) {
+        if (!sub->active)
+            return;
+        {
+            std::unique_lock<std::shared_mutex> lk(m);
+            auto it = topics.find(sub->topic);
+            if (it != topics.end()) {
+                auto &subs = it->second;
+                subs.erase(std::remove(subs.begin(), subs.end(), sub), subs.end());
+                if (subs.empty())
+                    topics.erase(it);
+            }
+        }
+        sub->active = false;
+        JS_FreeValue(ctx, sub->callback);
+        sub->callback = JS_UNDEFINED;
+        // Releases the hold the subscription kept on the loop
+        sub->loop->Post([](JSContext *) {});
+    }
+
+    std::size_t CEventBus::Detach(CRunLoop *loop, JSContext *ctx) {
+        std::vector<std::shared_ptr<Subscriber>> detached;
+        {
+            std::unique_lock<std::shared_mutex> lk(m);
+            for (auto it = topics.begin(); it != topics.end();) {
+                auto &subs = it->second;
+                auto mine = std::stable_partition(subs.begin(), subs.end(),
+                                                  [loop](const auto &sub) { return sub->loop != loop; });
+                detached.insert(detached.end(), mine, subs.end());
+                subs.erase(mine, subs.end());
+                it = subs.empty() ? topics.erase(it) : std::next(it);
+            }
+        }
+        for (const auto &sub : detached) {
+            sub->active = false;
+            JS_FreeValue(ctx, sub->callback);
+            sub->callback = JS_UNDEFINED;
+        }
+        return detached.size();
+    }
+
+    JSValue CEventBus::JsPublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        std::string topic;
+        if (!ToTopic(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, topic))
+            return JS_EXCEPTION;
+        ClonedValue value;
+        if (!CStructuredClone::Serialize(ctx, argc > 1 ? argv[1] : JS_UNDEFINED, JS_UNDEFINED, value))
+            return JS_EXCEPTION;
+        const Message message = std::make_shared<const std::string>(std::move(value.data));
+        return JS_NewInt64(ctx, (int64_t)Get().Publish(topic, message));
+    }
+
+    JSValue CEventBus::JsSubscribe(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        CRunLoop *loop = CRunLoop::Of(ctx);
+        if (!loop)
+            return JS_ThrowTypeError(ctx, "bus: subscribe is not available here");
+        // It would keep the run going until unsubscribed, and with it every
+        // later fire of the schedule, which is coalesced while it runs
+        if (loop->IsScheduledRun())
+            return JS_ThrowTypeError(ctx, "bus: subscribe is not available in scheduled runs");
+        std::string topic;
+        if (!ToTopic(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, topic))
+            return JS_EXCEPTION;
+        if (argc < 2 || !JS_IsFunction(ctx, argv[1]))
+            return JS_ThrowTypeError(ctx, "bus: callback function expected");
+
+        int64_t capacity = kDefaultCapacity;
+        DropPolicy policy = DropPolicy::Oldest;
+        if (argc > 2 && JS_IsObject(argv[2])) {
+            JSValue v = JS_GetPropertyStr(ctx, argv[2], "capacity");
+            const bool bad = !JS_IsUndefined(v) && JS_ToInt64(ctx, &capacity, v);
+            JS_FreeValue(ctx, v);
+            if (bad)
+                return JS_EXCEPTION;
+            if (capacity < 1 || capacity > (int64_t)kMaxCapacity)
+                return JS_ThrowRangeError(ctx, "bus: capacity must be between 1 and %zu", kMaxCapacity);
+
+            v = JS_GetPropertyStr(ctx, argv[2], "drop");
+            if (!JS_IsUndefined(v)) {
+                const char *s = JS_ToCString(ctx, v);
+                const bool oldest = s && std::strcmp(s, "oldest") == 0;
+                const bool newest = s && std::strcmp(s, "newest") == 0;
+                JS_FreeCString(ctx, s);
+                if (!oldest && !newest) {
+                    JS_FreeValue(ctx, v);
+                    return JS_ThrowTypeError(ctx, "bus: drop must be \"oldest\" or \"newest\"");
+                }
+                policy = newest ? DropPolicy::Newest : DropPolicy::Oldest;
+            }
+            JS_FreeValue(ctx, v);
+        }
+
+        JSValue obj = JS_NewObjectClass(ctx, subscriptionClassId);
+        if (JS_IsException(obj))
+            return obj;
+        auto sub = std::make_shared<Subscriber>(topic, loop, policy, (std::size_t)capacity);
+        sub->callback = JS_DupValue(ctx, argv[1]);
+        JS_SetOpaque(obj, new std::shared_ptr<Subscriber>(sub));
+
+        loop->Hold();
+        CEventBus &bus = Get();
+        std::unique_lock<std::shared_mutex> lk(bus.m);
+        bus.topics[topic].push_back(std::move(sub));
+        return obj;
+    }
+
+    JSValue CEventBus::JsUnsubscribe(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        auto *sub = static_cast<std::shared_ptr<Subscriber> *>(JS_GetOpaque2(ctx, thisVal, subscriptionClassId));
+        if (!sub)
+            return JS_EXCEPTION;
+        Get().Unsubscribe(*sub, ctx);
+        return JS_UNDEFINED;
+    }
+
+    JSValue CEventBus::JsDropped(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        auto *sub = static_cast<std::shared_ptr<Subscriber> *>(JS_GetOpaque2(ctx, thisVal, subscriptionClassId));
+        if (!sub)
+            return JS_EXCEPTION;
+        return JS_NewInt64(ctx, (int64_t)(*sub)->dropped.load());
+    }
+
+    void CEventBus::SubscriptionFinalizer(JSRuntime *, JSValue val) {
+        // The subscription itself lives on until it is unsubscribed or its
+        // loop detaches
+        delete static_cast<std::shared_ptr<Subscriber> *>(JS_GetOpaque(val, subscriptionClassId));
+    }
+}
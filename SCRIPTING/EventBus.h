@@ -0,0 +1,95 @@
+#pragma once
+#include "UTILS/BoundedQueue.h"
+#include <quickjs.h>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SCR {
+
+    class CRunLoop;
+
+    // Named topics shared by every script runtime in the process: script
+    // runs, their workers and script windows. Scripts get a `bus` global:
+    //
+    //   bus.publish(topic, value)                 number of subscribers it reached
+    //   bus.subscribe(topic, (value, topic) => {}, {capacity, drop})
+    //       capacity  messages held for the subscriber, 256 by default
+    //       drop      "oldest" (default) or "newest" once that is full
+    //   sub.unsubscribe(), sub.dropped
+    //
+    // A published value is cloned once, and each subscriber gets its own
+    // copy on its own thread through its runtime's loop: a window during
+    // its draw, a script or worker between its other events. Publishers
+    // never wait; each subscriber has a lock-free queue, and a subscriber
+    // that falls behind loses messages by its drop policy instead of
+    // slowing the publisher down. A subscription keeps its script running
+    // until it is unsubscribed, so scheduled runs, which have to end before
+    // their next fire, can publish but not subscribe.
+    class CEventBus {
+        public:
+            enum class DropPolicy { Oldest, Newest };
+
+            static CEventBus &Get();
+
+            static void Install(JSContext *ctx);
+
+            // Ends every subscription made through `loop`, before its
+            // context is freed; returns how many, each of which held the
+            // loop
+            std::size_t Detach(CRunLoop *loop, JSContext *ctx);
+
+            static constexpr std::size_t kDefaultCapacity = 256;
+            static constexpr std::size_t kMaxCapacity = 65536;
+            static constexpr int kBatch = 64; // messages per delivery before yielding the loop
+
+        private:
+            CEventBus() = default;
+
+            using Message = std::shared_ptr<const std::string>; // a cloned value
+
+            struct Subscriber {
+                Subscriber(std::string topic, CRunLoop *loop, DropPolicy policy, std::size_t capacity)
+                    : topic(std::move(topic)), loop(loop), policy(policy), capacity(capacity), queue(capacity) {}
+
+                const std::string topic;
+                CRunLoop *const loop;
+                const DropPolicy policy;
+                const std::size_t capacity;
+                // Rounds its size up to a power of two, so `held` is what
+                // keeps it to `capacity`
+                BoundedQueue<Message> queue;
+                std::atomic<std::size_t> held{0}; // slots claimed by publishers, freed after each pop
+                std::atomic<bool> scheduled{false}; // a delivery is posted to the loop
+                std::atomic<uint64_t> dropped{0};
+
+                // Loop thread only
+                JSValue callback = JS_UNDEFINED;
+                bool active = true;
+            };
+
+            std::size_t Publish(const std::string &topic, const Message &message);
+            bool Offer(Subscriber &sub, const Message &message);
+            static void Wake(const std::shared_ptr<Subscriber> &sub);
+            static void Deliver(const std::shared_ptr<Subscriber> &sub, JSContext *ctx);
+            void Unsubscribe(const std::shared_ptr<Subscriber> &sub, JSContext *ctx);
+
+            static void RegisterSubscription(JSContext *ctx);
+            static JSValue JsPublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsSubscribe(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsUnsubscribe(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+            static JSValue JsDropped(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+            static void SubscriptionFinalizer(JSRuntime *rt, JSValue val);
+
+            static JSClassID subscriptionClassId;
+
+            // Publishers hold it shared while they queue and wake, so a loop
+            // that detaches is never woken afterwards
+            std::shared_mutex m;
+            std::unordered_map<std::string, std::vector<std::shared_ptr<Subscriber>>> topics;
+    };
+}
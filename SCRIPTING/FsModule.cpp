@@ -0,0 +1,397 @@
+#include "FsModule.h"
+#include "../UTILS/ThreadPool.h"
+#include "FS/MainFileSystem.h"
+#include "FunctionBindings.h"
+#include "RunLoop.h"
+#include "ScriptArena.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace SCR {
+
+    namespace fs = std::filesystem;
+
+    JSClassID CFsModule::lineReaderClassId = 0;
+
+    namespace {
+        // A whole file as a transfer block, so an ArrayBuffer can adopt it
+        // as is. Unmapped or freed when nobody took it.
+        struct MappedFile {
+            uint8_t *data = nullptr;
+            std::size_t size = 0;
+            bool mapped = false; // a view of the file rather than a copy
+
+            MappedFile() = default;
+            MappedFile(const MappedFile &) = delete;
+            MappedFile &operator=(const MappedFile &) = delete;
+            ~MappedFile() { Reset(); }
+
+            void Reset() {
+                CScriptArena::FreeTransferred(nullptr, nullptr, data);
+                data = nullptr;
+                size = 0;
+                mapped = false;
+            }
+        };
+
+        struct LineCursor {
+            MappedFile file;
+            std::size_t pos = 0;
+        };
+
+#ifdef _WIN32
+        // Windows cannot put the block header in front of a view, so the
+        // file is read into a heap block in one call instead
+        bool MapFile(const fs::path &path, MappedFile &out, std::string &error) {
+            HANDLE h = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                   FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (h == INVALID_HANDLE_VALUE) {
+                error = "cannot open file";
+                return false;
+            }
+            LARGE_INTEGER size;
+            bool ok = GetFileSizeEx(h, &size) && (out.data = (uint8_t *)CScriptArena::NewTransferBlock(size.QuadPart));
+            std::size_t done = 0;
+            while (ok && done < (std::size_t)size.QuadPart) {
+                DWORD n = 0;
+                const DWORD want = (DWORD)std::min<std::size_t>(size.QuadPart - done, 1u << 30);
+                ok = ReadFile(h, out.data + done, want, &n, nullptr) && n > 0;
+                done += n;
+            }
+            CloseHandle(h);
+            if (!ok) {
+                error = "read failed";
+                return false;
+            }
+            out.size = done;
+            return true;
+        }
+
+        void PageIn(const MappedFile &) {}
+#else
+        std::size_t PageSize() {
+            static const std::size_t page = (std::size_t)sysconf(_SC_PAGESIZE);
+            return page;
+        }
+
+        void Unmap(void *data, std::size_t size, void *) {
+            munmap((char *)data - PageSize(), PageSize() + size);
+        }
+
+        // Small files are read into a transfer block. Larger ones are mapped
+        // right after one anonymous page, whose tail holds the transfer block
+        // header; see CFsModule for what truncating them does.
+        bool MapFile(const fs::path &path, MappedFile &out, std::string &error) {
+            const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                error = std::strerror(errno);
+                return false;
+            }
+            struct stat st;
+            if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+                error = "not a regular file";
+                ::close(fd);
+                return false;
+            }
+
+            const auto size = (std::size_t)st.st_size;
+            if (size < CFsModule::kMapThreshold) {
+                out.data = (uint8_t *)CScriptArena::NewTransferBlock(size);
+                std::size_t done = 0;
+                ssize_t n = 0;
+                while (out.data && done < size) {
+                    n = ::read(fd, out.data + done, size - done);
+                    if (n < 0 && errno == EINTR)
+                        continue;
+                    if (n <= 0) // 0: truncated since the fstat, keep what is there
+                        break;
+                    done += (std::size_t)n;
+                }
+                const int err = errno;
+                ::close(fd);
+                if (!out.data || n < 0) {
+                    error = out.data ? std::strerror(err) : "out of memory";
+                    out.Reset();
+                    return false;
+                }
+                out.size = done;
+                return true;
+            }
+
+            const std::size_t page = PageSize();
+            void *region = mmap(nullptr, page + size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            void *data = region == MAP_FAILED ? MAP_FAILED
+                                              : mmap((char *)region + page, size, PROT_READ | PROT_WRITE,
+                                                     MAP_PRIVATE | MAP_FIXED, fd, 0);
+            const int err = errno;
+            ::close(fd);
+            if (data == MAP_FAILED) {
+                if (region != MAP_FAILED)
+                    munmap(region, page + size);
+                error = std::strerror(err);
+                return false;
+            }
+
+            CScriptArena::InitExternalBlock(data, size, Unmap, nullptr);
+            out.data = (uint8_t *)data;
+            out.size = size;
+            out.mapped = true;
+            return true;
+        }
+
+        // Reads the whole file in on this thread, so the script that gets
+        // the buffer does not stall on page faults
+        void PageIn(const MappedFile &file) {
+            if (!file.mapped || !file.size)
+                return;
+            madvise(file.data, file.size, MADV_WILLNEED);
+            const std::size_t page = PageSize();
+            volatile uint8_t sink = 0;
+            for (std::size_t i = 0; i < file.size; i += page)
+                sink ^= file.data[i];
+            (void)sink;
+        }
+#endif
+
+        // Resolves `arg` against the Buddy folder; throws for anything
+        // that ends up outside it
+        bool ResolvePath(JSContext *ctx, JSValueConst arg, fs::path &out) {
+            if (!JS_IsString(arg)) {
+                JS_ThrowTypeError(ctx, "fs: path string expected");
+                return false;
+            }
+            const char *s = JS_ToCString(ctx, arg);
+            if (!s)
+                return false;
+            const std::string spec = s;
+            JS_FreeCString(ctx, s);
+
+            const fs::path base = FS::CFileSystem::GetBaseFolderLocation();
+            fs::path p = fs::u8path(spec);
+            if (p.is_relative())
+                p = base / p;
+
+            std::error_code ec, ecBase;
+            out = fs::weakly_canonical(p, ec);
+            const fs::path root = fs::weakly_canonical(base, ecBase);
+            const fs::path rel = out.lexically_relative(root);
+            if (ec || ecBase || rel.empty() || *rel.begin() == "..") {
+                JS_ThrowTypeError(ctx, "fs: '%s' is outside the Buddy folder", spec.c_str());
+                return false;
+            }
+            return true;
+        }
+
+        JSValue ThrowReadError(JSContext *ctx, const fs::path &path, const std::string &error) {
+            return JS_ThrowInternalError(ctx, "fs: cannot read '%s': %s", path.string().c_str(), error.c_str());
+        }
+
+        // Wraps the file without copying; the file keeps it on failure
+        JSValue AdoptBuffer(JSContext *ctx, MappedFile &file) {
+            JSValue buffer = JS_NewArrayBuffer(ctx, file.data, file.size, CScriptArena::FreeTransferred, nullptr, false);
+            if (!JS_IsException(buffer))
+                file.data = nullptr;
+            return buffer;
+        }
+
+        JSValue NewIteratorResult(JSContext *ctx, JSValue value, bool done) {
+            JSValue result = JS_NewObject(ctx);
+            JS_SetPropertyStr(ctx, result, "value", value);
+            JS_SetPropertyStr(ctx, result, "done", JS_NewBool(ctx, done));
+            return result;
+        }
+
+        struct Function {
+            const char *name;
+            JSCFunction *func;
+            int length;
+        };
+    }
+
+    ThreadPool &CFsModule::IoPool() {
+        static ThreadPool pool(kIoThreads);
+        return pool;
+    }
+
+    void CFsModule::Install(JSContext *ctx) {
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "fs", NewExports(ctx));
+        JS_FreeValue(ctx, global);
+    }
+
+    JSModuleDef *CFsModule::NewModule(JSContext *ctx, const char *name) {
+        JSModuleDef *m = JS_NewCModule(ctx, name, InitModule);
+        if (!m)
+            return nullptr;
+        JS_AddModuleExport(ctx, m, "readFile");
+        JS_AddModuleExport(ctx, m, "readFileAsync");
+        JS_AddModuleExport(ctx, m, "lines");
+        JS_AddModuleExport(ctx, m, "default");
+        return m;
+    }
+
+    int CFsModule::InitModule(JSContext *ctx, JSModuleDef *m) {
+        JSValue exports = NewExports(ctx);
+        for (const char *name : {"readFile", "readFileAsync", "lines"})
+            JS_SetModuleExport(ctx, m, name, JS_GetPropertyStr(ctx, exports, name));
+        JS_SetModuleExport(ctx, m, "default", exports);
+        return 0;
+    }
+
+    JSValue CFsModule::NewExports(JSContext *ctx) {
+        RegisterLineReader(ctx);
+        static const Function functions[] = {
+                {"readFile", JsReadFile, 1},
+                {"readFileAsync", JsReadFileAsync, 1},
+                {"lines", JsLines, 1},
+        };
+        JSValue exports = JS_NewObject(ctx);
+        for (const Function &f : functions)
+            JS_SetPropertyStr(ctx, exports, f.name, JS_NewCFunction(ctx, f.func, f.name, f.length));
+        return exports;
+    }
+
+    void CFsModule::RegisterLineReader(JSContext *ctx) {
+        static std::once_flag once;
+        std::call_once(once, [] { JS_NewClassID(&lineReaderClassId); });
+
+        JSRuntime *rt = JS_GetRuntime(ctx);
+        if (!JS_IsRegisteredClass(rt, lineReaderClassId)) {
+            JSClassDef def{};
+            def.class_name = "LineReader";
+            def.finalizer = LineReaderFinalizer;
+            JS_NewClass(rt, lineReaderClassId, &def);
+        }
+        if (has_class_proto(ctx, lineReaderClassId))
+            return;
+
+        JSValue proto = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, proto, "next", JS_NewCFunction(ctx, JsLinesNext, "next", 0));
+        JS_SetPropertyStr(ctx, proto, "return", JS_NewCFunction(ctx, JsLinesReturn, "return", 0));
+
+        // for (const line of fs.lines(path))
+        JSValue global = JS_GetGlobalObject(ctx);
+        JSValue symbol = JS_GetPropertyStr(ctx, global, "Symbol");
+        JSValue iterator = JS_GetPropertyStr(ctx, symbol, "iterator");
+        const JSAtom atom = JS_ValueToAtom(ctx, iterator);
+        JS_DefinePropertyValue(ctx, proto, atom, JS_NewCFunction(ctx, JsLinesIterator, "[Symbol.iterator]", 0),
+                               JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+        JS_FreeAtom(ctx, atom);
+        JS_FreeValue(ctx, iterator);
+        JS_FreeValue(ctx, symbol);
+        JS_FreeValue(ctx, global);
+
+        JS_SetClassProto(ctx, lineReaderClassId, proto);
+    }
+
+    JSValue CFsModule::JsReadFile(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        fs::path path;
+        if (!ResolvePath(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, path))
+            return JS_EXCEPTION;
+
+        MappedFile file;
+        std::string error;
+        if (!MapFile(path, file, error))
+            return ThrowReadError(ctx, path, error);
+        return AdoptBuffer(ctx, file);
+    }
+
+    JSValue CFsModule::JsReadFileAsync(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        CRunLoop *loop = CRunLoop::Of(ctx);
+        if (!loop)
+            return JS_ThrowTypeError(ctx, "fs: readFileAsync is not available here");
+        fs::path path;
+        if (!ResolvePath(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, path))
+            return JS_EXCEPTION;
+
+        uint64_t id;
+        JSValue promise = loop->NewPromise(ctx, id);
+        if (JS_IsException(promise))
+            return promise;
+
+        loop->Hold();
+        IoPool().Add([loop, id, path] {
+            auto file = std::make_shared<MappedFile>();
+            std::string error;
+            const bool ok = MapFile(path, *file, error);
+            if (ok)
+                PageIn(*file);
+            loop->Post([loop, id, path, file, error, ok](JSContext *ctx) {
+                if (ok)
+                    loop->Settle(ctx, id, AdoptBuffer(ctx, *file), false);
+                else
+                    loop->Settle(ctx, id, ThrowReadError(ctx, path, error), true);
+            });
+        });
+        return promise;
+    }
+
+    JSValue CFsModule::JsLines(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        fs::path path;
+        if (!ResolvePath(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, path))
+            return JS_EXCEPTION;
+
+        auto cursor = std::make_unique<LineCursor>();
+        std::string error;
+        if (!MapFile(path, cursor->file, error))
+            return ThrowReadError(ctx, path, error);
+
+        JSValue reader = JS_NewObjectClass(ctx, (int)lineReaderClassId);
+        if (JS_IsException(reader))
+            return reader;
+        JS_SetOpaque(reader, cursor.release());
+        return reader;
+    }
+
+    JSValue CFsModule::JsLinesNext(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        auto *cursor = (LineCursor *)JS_GetOpaque2(ctx, thisVal, lineReaderClassId);
+        if (!cursor)
+            return JS_EXCEPTION;
+
+        const MappedFile &file = cursor->file;
+        if (!file.data || cursor->pos >= file.size) {
+            // Done with the file, let the mapping go now rather than at GC
+            cursor->file.Reset();
+            return NewIteratorResult(ctx, JS_UNDEFINED, true);
+        }
+
+        const char *start = (const char *)file.data + cursor->pos;
+        const std::size_t left = file.size - cursor->pos;
+        const auto *nl = (const char *)std::memchr(start, '\n', left);
+        std::size_t length = nl ? (std::size_t)(nl - start) : left;
+        cursor->pos += nl ? length + 1 : length;
+        if (length && start[length - 1] == '\r')
+            length--;
+        return NewIteratorResult(ctx, JS_NewStringLen(ctx, start, length), false);
+    }
+
+    JSValue CFsModule::JsLinesReturn(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        auto *cursor = (LineCursor *)JS_GetOpaque2(ctx, thisVal, lineReaderClassId);
+        if (!cursor)
+            return JS_EXCEPTION;
+        // `break` out of a for-of ends up here
+        cursor->pos = cursor->file.size;
+        return JsLinesNext(ctx, thisVal, 0, nullptr);
+    }
+
+    JSValue CFsModule::JsLinesIterator(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        return JS_DupValue(ctx, thisVal);
+    }
+
+    void CFsModule::LineReaderFinalizer(JSRuntime *, JSValue val) {
+        delete (LineCursor *)JS_GetOpaque(val, lineReaderClassId);
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <quickjs.h>
+#include <cstddef>
+
+class ThreadPool;
+
+namespace SCR {
+
+    // The `fs` module, read only access to the files under the Buddy folder.
+    // Scripts import it with `import * as fs from "fs"`; classic scripts get
+    // the same functions on the global `fs`.
+    //
+    //   readFile(path)       ArrayBuffer with the file's contents
+    //   readFileAsync(path)  Promise of the same, read or mapped and paged in
+    //                        on an I/O thread so the script never waits on
+    //                        the disk
+    //   lines(path)          iterator over the file's lines
+    //
+    // Relative paths resolve against the Buddy folder, and nothing outside
+    // it can be read, symlinks included. Files under kMapThreshold are read
+    // into the buffer; larger ones get a private mapping instead. Either way
+    // the buffer is private to the script: writing to it never touches the
+    // file, and it can be transferred to a Worker without a copy. A mapping
+    // still reads through to the file, so truncating a large file while a
+    // script holds its buffer makes touching the lost pages fault (SIGBUS);
+    // files the app rewrites in place belong under the threshold or should
+    // be replaced by rename.
+    class CFsModule {
+        public:
+            static void Install(JSContext *ctx);
+            static JSModuleDef *NewModule(JSContext *ctx, const char *name);
+
+            static ThreadPool &IoPool();
+            static constexpr std::size_t kIoThreads = 2;
+            static constexpr std::size_t kMapThreshold = 1 << 20; // smaller files are read, not mapped
+
+        private:
+            static int InitModule(JSContext *ctx, JSModuleDef *m);
+            static void RegisterLineReader(JSContext *ctx);
+            static JSValue NewExports(JSContext *ctx);
+
+            static JSValue JsReadFile(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsReadFileAsync(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsLines(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsLinesNext(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+            static JSValue JsLinesReturn(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+            static JSValue JsLinesIterator(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+            static void LineReaderFinalizer(JSRuntime *rt, JSValue val);
+
+            static JSClassID lineReaderClassId;
+    };
+}
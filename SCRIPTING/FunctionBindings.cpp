@@ -1,9 +1,13 @@
 #include "./FunctionBindings.h"
 #include "../FS/MainFileSystem.h"      // FS::ScriptJS
 #include "../NETWORKING/CNetworking.h" // Curl::Get
+#include "../UTILS/Logger.h"
 
 #include "ImGuiBindings.h"
+#include "ScriptArena.h"
 #include <imgui.h>
+#include <algorithm>
+#include <cstring>
 #include <mutex>
 #include <string>
 
@@ -20,6 +24,13 @@ namespace SCR {
         JS_NewClass(rt, g_script_class_id, &def);
     }
 
+    bool has_class_proto(JSContext *ctx, JSClassID id) {
+        JSValue proto = JS_GetClassProto(ctx, id);
+        const bool has = JS_IsObject(proto);
+        JS_FreeValue(ctx, proto);
+        return has;
+    }
+
     JSValue js_console_log(JSContext *ctx, JSValueConst this_val, int argc,
                            JSValueConst *argv) {
         auto *script = static_cast<FS::ScriptJS *>(
@@ -28,39 +39,116 @@ namespace SCR {
         if (!script)
             return JS_ThrowTypeError(ctx, "invalid this");
 
+        std::string line;
         for (int i = 0; i < argc; ++i) {
             const char *s = JS_ToCString(ctx, argv[i]);
 
             if (s) {
-                std::lock_guard<std::mutex> lg(script->m);
-                script->output += s;
+                line += s;
 
                 if (i + 1 < argc)
-                    script->output += ' ';
+                    line += ' ';
 
                 JS_FreeCString(ctx, s);
             }
         }
 
+        // Mirrored to the log only with the Script channel at debug level,
+        // so chatty scripts do not flood it
+        if (script->mirrorLog)
+            LOG_DEBUG(Script, "{}: {}", script->name, line);
+
         std::lock_guard<std::mutex> lg(script->m);
+        script->output += line;
         script->output += '\n';
 
         return JS_UNDEFINED;
     }
 
+    namespace {
+        // Downloads straight into memory an ArrayBuffer can adopt, so the
+        // body reaches the script without being copied again. It is a
+        // transfer block, which also lets the script hand it to a Worker
+        // for free.
+        class BinaryBody {
+            public:
+                BinaryBody() = default;
+                ~BinaryBody() { CScriptArena::FreeTransferred(nullptr, nullptr, data); }
+                BinaryBody(const BinaryBody &) = delete;
+                BinaryBody &operator=(const BinaryBody &) = delete;
+
+                bool Reserve(size_t bytes) { return Grow(bytes); }
+
+                bool Append(const char *bytes, size_t n) {
+                    if (size + n > capacity && !Grow(std::max(size + n, capacity * 2)))
+                        return false;
+                    std::memcpy(data + size, bytes, n);
+                    size += n;
+                    return true;
+                }
+
+                // Hands the buffer over, trimmed to what arrived
+                uint8_t *Release(size_t &length) {
+                    if (size != capacity)
+                        Grow(size);
+                    uint8_t *out = data ? data : (uint8_t *)CScriptArena::NewTransferBlock(0);
+                    data = nullptr;
+                    length = size;
+                    size = capacity = 0;
+                    return out;
+                }
+
+            private:
+                bool Grow(size_t bytes) {
+                    auto *grown = (uint8_t *)CScriptArena::ResizeTransferBlock(data, bytes);
+                    if (!grown)
+                        return false;
+                    data = grown;
+                    capacity = bytes;
+                    return true;
+                }
+
+                uint8_t *data = nullptr;
+                size_t size = 0, capacity = 0;
+        };
+    }
+
     JSValue js_http_get(JSContext *ctx, JSValueConst, int argc,
                         JSValueConst *argv) {
         if (argc < 1 || !JS_IsString(argv[0]))
             return JS_ThrowTypeError(ctx, "url string expected");
 
+        // http_get(url, {binary: true}) gives an ArrayBuffer instead of a string
+        bool binary = false;
+        if (argc > 1 && JS_IsObject(argv[1])) {
+            JSValue b = JS_GetPropertyStr(ctx, argv[1], "binary");
+            binary = JS_ToBool(ctx, b) > 0;
+            JS_FreeValue(ctx, b);
+        }
+
         size_t n;
         const char *url_c = JS_ToCStringLen(ctx, &n, argv[0]);
         std::string url(url_c, n);
         JS_FreeCString(ctx, url_c);
 
         try {
+            if (binary) {
+                BinaryBody body;
+                Curl::Get(url, body);
+                size_t length;
+                uint8_t *data = body.Release(length);
+                if (!data)
+                    return JS_ThrowOutOfMemory(ctx);
+                JSValue buffer = JS_NewArrayBuffer(ctx, data, length, CScriptArena::FreeTransferred, nullptr, false);
+                if (JS_IsException(buffer))
+                    CScriptArena::FreeTransferred(nullptr, nullptr, data);
+                return buffer;
+            }
+
             std::string body = Curl::Get(url);
             return JS_NewStringLen(ctx, body.c_str(), body.size());
+        } catch (const std::bad_alloc &) {
+            return JS_ThrowOutOfMemory(ctx);
         } catch (const std::exception &e) {
             return JS_ThrowInternalError(ctx, "%s", e.what());
         }
@@ -13,6 +13,11 @@ namespace SCR {
     // one-off class registration
     void register_class(JSRuntime *);
 
+    // whether `ctx` has a prototype for `id` yet: classes are registered
+    // once per runtime, but every context in it, such as each script
+    // window, needs its own prototype
+    bool has_class_proto(JSContext *, JSClassID id);
+
     // individual native callbacks
     JSValue js_console_log(JSContext *, JSValueConst, int, JSValueConst *);
     JSValue js_imgui_window(JSContext *, JSValueConst, int, JSValueConst *);
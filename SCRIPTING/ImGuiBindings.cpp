@@ -1,8 +1,22 @@
 #include "ImGuiBindings.h"
 #include "../UI/GuiTaskQueue.h"
 #include "../UI/Image/image.h"
+#include "EventBus.h"
 #include "FunctionBindings.h"
-#include "UI/Renderer.h"
+#include "ModuleLoader.h"
+#include "ScriptArena.h"
+#include "ScriptWindows.h"
+#include "SharedBuffers.h"
+#include "StructuredClone.h"
+#include "UTILS/Logger.h"
+#include <imgui_internal.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <memory>
+#include <mutex>
 
 static inline ImDrawList *GetDL() { return ImGui::GetWindowDrawList(); }
 
@@ -435,6 +449,149 @@ JSValue ui_add_image(JSContext *ctx, JSValueConst, int argc,
   return JS_UNDEFINED;
 }
 
+/*---------------- draw_batch ---------------------------------------------*/
+enum DrawOp : uint32_t {
+  DRAW_END,
+  DRAW_LINE,
+  DRAW_RECT,
+  DRAW_RECT_FILLED,
+  DRAW_CIRCLE,
+  DRAW_CIRCLE_FILLED,
+  DRAW_TRIANGLE,
+  DRAW_TRIANGLE_FILLED,
+  DRAW_POLYLINE,
+  DRAW_POLY_FILLED,
+};
+
+// Operand words after each opcode, indexed by opcode
+static const struct {
+  const char *name;
+  uint32_t operands;
+} kDrawOps[] = {
+    {"DRAW_END", 0},
+    {"DRAW_LINE", 6},            // x1 y1 x2 y2 col thickness
+    {"DRAW_RECT", 7},            // x1 y1 x2 y2 col rounding thickness
+    {"DRAW_RECT_FILLED", 6},     // x1 y1 x2 y2 col rounding
+    {"DRAW_CIRCLE", 5},          // cx cy r col thickness
+    {"DRAW_CIRCLE_FILLED", 4},   // cx cy r col
+    {"DRAW_TRIANGLE", 8},        // x1 y1 x2 y2 x3 y3 col thickness
+    {"DRAW_TRIANGLE_FILLED", 7}, // x1 y1 x2 y2 x3 y3 col
+    {"DRAW_POLYLINE", 4},        // n col thickness closed, then n points
+    {"DRAW_POLY_FILLED", 2},     // n col, then n points of a convex shape
+};
+
+void install_draw_ops(JSContext *ctx, JSValueConst ui) {
+  for (uint32_t op = 0; op < std::size(kDrawOps); op++)
+    JS_SetPropertyStr(ctx, ui, kDrawOps[op].name, JS_NewUint32(ctx, op));
+}
+
+bool draw_batch_words(JSContext *ctx, JSValueConst v, const uint8_t *&words,
+                      std::size_t &count) {
+  std::size_t offset = 0, length = SIZE_MAX, element = 4;
+  JSValue buffer = JS_GetTypedArrayBuffer(ctx, v, &offset, &length, &element);
+  if (JS_IsException(buffer)) {
+    JS_FreeValue(ctx, JS_GetException(ctx)); // not a typed array
+    buffer = JS_DupValue(ctx, v);
+    offset = 0;
+    length = SIZE_MAX;
+  }
+  std::size_t size = 0;
+  uint8_t *data = element == 4 ? JS_GetArrayBuffer(ctx, &size, buffer) : nullptr;
+  JS_FreeValue(ctx, buffer);
+  if (!data) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    JS_ThrowTypeError(ctx, "draw_batch: Float32Array, Uint32Array or ArrayBuffer expected");
+    return false;
+  }
+  words = data + offset;
+  count = std::min(length, size) / 4;
+  return true;
+}
+
+JSValue ui_draw_batch(JSContext *ctx, JSValueConst, int argc,
+                      JSValueConst *argv) {
+  ARG_CHECK(argc >= 1, "draw_batch: need commands[,x,y]");
+  const uint8_t *words;
+  std::size_t count;
+  if (!draw_batch_words(ctx, argv[0], words, count))
+    return JS_EXCEPTION;
+  double ox = 0, oy = 0;
+  if ((argc > 1 && js_to_double(ctx, argv[1], ox)) ||
+      (argc > 2 && js_to_double(ctx, argv[2], oy)))
+    return JS_EXCEPTION;
+  const ImVec2 origin((float)ox, (float)oy);
+
+  // Opcodes, colors and counts are uint32 words, the rest float32 words
+  auto U = [words](std::size_t i) {
+    uint32_t u;
+    std::memcpy(&u, words + 4 * i, 4);
+    return u;
+  };
+  auto F = [words](std::size_t i) {
+    float f;
+    std::memcpy(&f, words + 4 * i, 4);
+    return f;
+  };
+  auto P = [&F, origin](std::size_t i) {
+    return ImVec2(F(i) + origin.x, F(i + 1) + origin.y);
+  };
+
+  static std::vector<ImVec2> points;
+  ImDrawList *dl = GetDL();
+  std::size_t i = 0;
+  while (i < count) {
+    const uint32_t op = U(i);
+    if (op == DRAW_END)
+      break;
+    if (op >= std::size(kDrawOps))
+      return JS_ThrowRangeError(ctx, "draw_batch: unknown opcode %u at word %zu", op, i);
+    const std::size_t a = i + 1;
+    if (count - a < kDrawOps[op].operands)
+      return JS_ThrowRangeError(ctx, "draw_batch: %s at word %zu is cut short", kDrawOps[op].name, i);
+    i = a + kDrawOps[op].operands;
+
+    switch (op) {
+    case DRAW_LINE:
+      dl->AddLine(P(a), P(a + 2), U(a + 4), F(a + 5));
+      break;
+    case DRAW_RECT:
+      dl->AddRect(P(a), P(a + 2), U(a + 4), F(a + 5), 0, F(a + 6));
+      break;
+    case DRAW_RECT_FILLED:
+      dl->AddRectFilled(P(a), P(a + 2), U(a + 4), F(a + 5));
+      break;
+    case DRAW_CIRCLE:
+      dl->AddCircle(P(a), F(a + 2), U(a + 3), 0, F(a + 4));
+      break;
+    case DRAW_CIRCLE_FILLED:
+      dl->AddCircleFilled(P(a), F(a + 2), U(a + 3));
+      break;
+    case DRAW_TRIANGLE:
+      dl->AddTriangle(P(a), P(a + 2), P(a + 4), U(a + 6), F(a + 7));
+      break;
+    case DRAW_TRIANGLE_FILLED:
+      dl->AddTriangleFilled(P(a), P(a + 2), P(a + 4), U(a + 6));
+      break;
+    case DRAW_POLYLINE:
+    case DRAW_POLY_FILLED: {
+      const uint32_t n = U(a);
+      if ((count - i) / 2 < n)
+        return JS_ThrowRangeError(ctx, "draw_batch: %s at word %zu is cut short", kDrawOps[op].name, a - 1);
+      points.resize(n);
+      for (uint32_t k = 0; k < n; k++)
+        points[k] = P(i + 2 * k);
+      i += 2 * (std::size_t)n;
+      if (op == DRAW_POLYLINE)
+        dl->AddPolyline(points.data(), (int)n, U(a + 1), U(a + 3) ? ImDrawFlags_Closed : 0, F(a + 2));
+      else
+        dl->AddConvexPolyFilled(points.data(), (int)n, U(a + 1));
+      break;
+    }
+    }
+  }
+  return JS_UNDEFINED;
+}
+
 JSValue js_imgui_window(JSContext *ctx, JSValueConst, int argc,
                         JSValueConst *argv) {
   if (argc < 1 || !JS_IsString(argv[0]))
@@ -467,13 +624,313 @@ JSValue ui_text(JSContext *c, JSValueConst, int argc, JSValueConst *v) {
   return JS_UNDEFINED;
 }
 
+/* Windows ----------------------------------------------------------- */
+// What a window handle refers to; the window is filled in, and only ever
+// looked at, on the GUI thread
+struct WindowLink {
+  std::weak_ptr<JSImGuiWindow> window;
+};
+using WindowLinkPtr = std::shared_ptr<WindowLink>;
+
+static JSClassID g_window_class_id = 0;
+
+bool merge_state(JSContext *ctx, JSValueConst state, std::string_view delta) {
+  JSValue d = CStructuredClone::Deserialize(ctx, delta);
+  if (JS_IsException(d))
+    return false;
+
+  JSPropertyEnum *props;
+  uint32_t n;
+  if (JS_GetOwnPropertyNames(ctx, &props, &n, d,
+                             JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) == 0) {
+    for (uint32_t i = 0; i < n; i++) {
+      JSValue v = JS_GetProperty(ctx, d, props[i].atom);
+      if (JS_IsUndefined(v))
+        JS_DeleteProperty(ctx, state, props[i].atom, 0);
+      else
+        JS_SetProperty(ctx, state, props[i].atom, v);
+      JS_FreeAtom(ctx, props[i].atom);
+    }
+    js_free(ctx, props);
+  }
+  JS_FreeValue(ctx, d);
+  return true;
+}
+
+// Whether the current window gets input this frame, which only its content
+// can see: it is hovered or focused, holds the active item, or opened a
+// popup that is still up
+static bool takes_input() {
+  ImGuiContext &g = *GImGui;
+  ImGuiWindow *window = ImGui::GetCurrentWindow();
+  if (ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows |
+                             ImGuiHoveredFlags_AllowWhenBlockedByActiveItem) ||
+      ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows))
+    return true;
+  if (g.ActiveIdWindow && g.ActiveIdWindow->RootWindow == window)
+    return true;
+  for (const ImGuiPopupData &popup : g.OpenPopupStack)
+    if (popup.RestoreNavWindow && popup.RestoreNavWindow->RootWindow == window)
+      return true;
+  return false;
+}
+
+void JSImGuiWindow::Draw(bool run) {
+  if (!is_open_)
+    return;
+
+  RunTasks();
+  // Shows up once there is something to show, so ImGui sizes it
+  // to its contents
+  if (recorder_ && !recorder_->Ready())
+    return;
+
+  // Pass the is_open_ flag to ImGui::Begin() to get the native close button
+  const bool visible = ImGui::Begin(title_.c_str(), &is_open_);
+  focused_ = ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows);
+  if (!visible) {
+    ImGui::End();
+    return;
+  }
+
+  const double now = ImGui::GetTime();
+  if (stats_.frames == 0)
+    stats_.since = now;
+  stats_.frames++;
+  stats_.last_ms = 0;
+
+  if (recorder_) {
+    // Records off the GUI thread at its own pace
+    recorder_->Replay(ctx_);
+  } else if (!run && !takes_input() && cache_.Replay()) {
+    stats_.waited++;
+  } else {
+    // Get the global 'ui' object that was created by install_ui_object()
+    JSValue global = JS_GetGlobalObject(ctx_);
+    JSValue ui_obj = JS_GetPropertyStr(ctx_, global, "ui");
+
+    cache_.Start();
+    const auto start = std::chrono::steady_clock::now();
+    JSValue args[] = {ui_obj, state_, JS_NewBool(ctx_, changed_)};
+    JSValue res = JS_Call(ctx_, cb_, JS_UNDEFINED, 3, args);
+    changed_ = false;
+
+    if (JS_IsException(res)) {
+      JSValue exc = JS_GetException(ctx_);
+      const char *msg = JS_ToCString(ctx_, exc);
+      ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "[JS exception] %s", msg);
+      JS_FreeCString(ctx_, msg);
+      JS_FreeValue(ctx_, exc);
+    }
+    stats_.last_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    // Child windows have draw lists of their own that the copy would
+    // miss, so a window with any is never replayed
+    if (ImGui::GetCurrentWindow()->DC.ChildWindows.empty())
+      cache_.Capture();
+    else
+      cache_.Clear();
+
+    // Clean up
+    JS_FreeValue(ctx_, res);
+    JS_FreeValue(ctx_, ui_obj);
+    JS_FreeValue(ctx_, global);
+
+    stats_.cost_ms = stats_.cost_ms == 0 ? stats_.last_ms : stats_.cost_ms * 0.8 + stats_.last_ms * 0.2;
+    stats_.calls++;
+    stats_.waited = 0;
+  }
+
+  if (now - stats_.since >= 1.0) {
+    stats_.calls_per_sec = (float)(stats_.calls / (now - stats_.since));
+    stats_.frames_per_sec = (float)(stats_.frames / (now - stats_.since));
+    stats_.calls = stats_.frames = 0;
+  }
+
+  ImGui::End();
+}
+
+void JSImGuiWindow::Update(std::string_view delta) {
+  if (recorder_) {
+    recorder_->Update(delta);
+    return;
+  }
+  if (!ctx_)
+    return;
+  if (!merge_state(ctx_, state_, delta)) {
+    ReportException(ctx_);
+    return;
+  }
+  changed_ = true;
+}
+
+void JSImGuiWindow::Shutdown() {
+  JSContext *ctx = ctx_;
+  if (!ctx)
+    return;
+  std::deque<std::function<void(JSContext *)>> dropped;
+  {
+    std::lock_guard<std::mutex> lk(tasks_mutex_);
+    ctx_ = nullptr; // later posts are dropped
+    dropped.swap(tasks_);
+  }
+  is_open_ = false;
+  if (recorder_)
+    recorder_->Stop();
+
+  // Its subscriptions are gone without the Post that would release them
+  const std::size_t released = Close(ctx);
+  {
+    std::lock_guard<std::mutex> lk(tasks_mutex_);
+    holds_ -= (std::ptrdiff_t)released;
+  }
+  JS_FreeValue(ctx, cb_);
+  JS_FreeValue(ctx, state_);
+  JS_FreeValue(ctx, init_);
+  cb_ = state_ = init_ = JS_UNDEFINED;
+
+  for (int handle : images_)
+    g_image_cache.erase(handle);
+  images_.clear();
+
+  // Jobs still queued for the context may run after this, without a loop
+  JS_SetContextOpaque(ctx, nullptr);
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  JS_FreeContext(ctx);
+  JS_RunGC(rt); // closures keep the context until they are collected
+}
+
+static WindowLinkPtr *window_link(JSContext *ctx, JSValueConst this_val) {
+  return static_cast<WindowLinkPtr *>(
+      JS_GetOpaque2(ctx, this_val, g_window_class_id));
+}
+
+static JSValue window_update(JSContext *ctx, JSValueConst this_val, int argc,
+                             JSValueConst *argv) {
+  WindowLinkPtr *link = window_link(ctx, this_val);
+  if (!link)
+    return JS_EXCEPTION;
+  ARG_CHECK(argc >= 1 && JS_IsObject(argv[0]), "update(deltaObject)");
+  ClonedValue delta;
+  if (!CStructuredClone::Serialize(ctx, argv[0], JS_UNDEFINED, delta))
+    return JS_EXCEPTION;
+
+  // Queued behind the task creating the window, so it is always there
+  g_guiTasks.push([link = *link, delta = std::move(delta.data)] {
+    if (auto win = link->window.lock())
+      win->Update(delta);
+  });
+  return JS_UNDEFINED;
+}
+
+static JSValue window_close(JSContext *ctx, JSValueConst this_val, int,
+                            JSValueConst *) {
+  WindowLinkPtr *link = window_link(ctx, this_val);
+  if (!link)
+    return JS_EXCEPTION;
+  g_guiTasks.push([link = *link] {
+    if (auto win = link->window.lock())
+      win->RequestClose();
+  });
+  return JS_UNDEFINED;
+}
+
+static JSValue window_open(JSContext *ctx, JSValueConst this_val, int,
+                           JSValueConst *) {
+  WindowLinkPtr *link = window_link(ctx, this_val);
+  if (!link)
+    return JS_EXCEPTION;
+  g_guiTasks.push([link = *link] {
+    if (auto win = link->window.lock())
+      CScriptWindows::Get().Reopen(win);
+  });
+  return JS_UNDEFINED;
+}
+
+// The window stays with the window manager; a parked one can still be
+// reopened through create_window
+static void window_finalizer(JSRuntime *, JSValue val) {
+  delete static_cast<WindowLinkPtr *>(JS_GetOpaque(val, g_window_class_id));
+}
+
+static void register_window_class(JSContext *ctx) {
+  static std::once_flag once;
+  std::call_once(once, [] { JS_NewClassID(&g_window_class_id); });
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, g_window_class_id)) {
+    JSClassDef def{};
+    def.class_name = "ScriptWindow";
+    def.finalizer = window_finalizer;
+    JS_NewClass(rt, g_window_class_id, &def);
+  }
+  if (has_class_proto(ctx, g_window_class_id))
+    return;
+
+  JSValue proto = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, proto, "update",
+                    JS_NewCFunction(ctx, window_update, "update", 1));
+  JS_SetPropertyStr(ctx, proto, "close",
+                    JS_NewCFunction(ctx, window_close, "close", 0));
+  JS_SetPropertyStr(ctx, proto, "open",
+                    JS_NewCFunction(ctx, window_open, "open", 0));
+  JS_SetClassProto(ctx, g_window_class_id, proto);
+}
+
+// Every script window is a context in this one runtime, which only the GUI
+// thread touches. They share its heap, atom table and classes, and module
+// windows the loader's compiled modules, so a window costs a context
+// rather than a whole runtime.
+// An arena runtime like every other script runtime, so windows can take
+// and hand on transferred buffers. It lives as long as the process.
+static JSRuntime *gui_runtime() {
+  static JSRuntime *rt = [] {
+    static CScriptArena *arena = new CScriptArena();
+    JSRuntime *r = arena->NewRuntime();
+    SCR::register_class(r);
+    SCR::CSharedBuffers::InstallAllocator(r);
+    SCR::CModuleLoader::Install(r);
+    return r;
+  }();
+  return rt;
+}
+
+JSValue load_draw_callback(JSContext *ctx, const std::string &fn_source,
+                           const std::string &module_path, JSValue &init) {
+  if (module_path.empty())
+    return JS_Eval(ctx, fn_source.c_str(), fn_source.size(), "<draw_cb>",
+                   JS_EVAL_TYPE_GLOBAL);
+
+  JSValue ns = CModuleLoader::ImportModule(ctx, module_path);
+  if (JS_IsException(ns))
+    return ns;
+  JSValue draw_cb = JS_GetPropertyStr(ctx, ns, "draw");
+  init = JS_GetPropertyStr(ctx, ns, "init");
+  JS_FreeValue(ctx, ns);
+
+  if (!JS_IsFunction(ctx, draw_cb)) {
+    JS_FreeValue(ctx, draw_cb);
+    JS_FreeValue(ctx, init);
+    init = JS_UNDEFINED;
+    return JS_ThrowTypeError(ctx, "%s does not export a draw function",
+                             module_path.c_str());
+  }
+  return draw_cb;
+}
+
 JSValue js_create_window(JSContext *ctx, JSValueConst /*this_val*/, int argc,
                          JSValueConst *argv) {
   /* -------------------------------------------------------------- */
   /* 1. Argument check                                              */
   /* -------------------------------------------------------------- */
-  if (argc < 2 || !JS_IsString(argv[0]) || !JS_IsFunction(ctx, argv[1]))
-    return JS_ThrowTypeError(ctx, "create_window(titleString, drawCallback)");
+  const bool from_module = argc >= 2 && JS_IsObject(argv[1]) &&
+                           !JS_IsFunction(ctx, argv[1]);
+  if (argc < 2 || !JS_IsString(argv[0]) ||
+      !(from_module || JS_IsFunction(ctx, argv[1])))
+    return JS_ThrowTypeError(
+        ctx, "create_window(titleString, drawCallback[, {state, deferred}]) "
+             "or create_window(titleString, {module, state, deferred})");
+  JSValueConst options =
+      from_module ? argv[1] : (argc > 2 ? argv[2] : JS_UNDEFINED);
 
   /* -------------------------------------------------------------- */
   /* 2. Copy the title string                                       */
@@ -484,48 +941,144 @@ JSValue js_create_window(JSContext *ctx, JSValueConst /*this_val*/, int argc,
   JS_FreeCString(ctx, c_title);
 
   /* -------------------------------------------------------------- */
-  /* 3. Serialize the JS callback into source code                  */
-  /*    (we cannot move JSValue across threads or runtimes)         */
+  /* 3. What draws: a module the GUI context imports itself, or the */
+  /*    callback serialized into source code (we cannot move       */
+  /*    JSValue across threads or runtimes, closures are lost)     */
   /* -------------------------------------------------------------- */
-  JSValue src_val = JS_ToString(ctx, argv[1]); // fn -> string
-  const char *c_src = JS_ToCString(ctx, src_val);
-  std::string fn_source(c_src);
-  JS_FreeCString(ctx, c_src);
-  JS_FreeValue(ctx, src_val); // done with it
+  std::string fn_source, module_path;
+  if (from_module) {
+    JSValue spec_val = JS_GetPropertyStr(ctx, options, "module");
+    const char *spec =
+        JS_IsString(spec_val) ? JS_ToCString(ctx, spec_val) : nullptr;
+    JS_FreeValue(ctx, spec_val);
+    if (!spec)
+      return JS_ThrowTypeError(ctx, "create_window: module path expected");
+
+    // Resolved against the calling module, like an import
+    JSAtom base_atom = JS_GetScriptOrModuleName(ctx, 1);
+    const char *base =
+        base_atom != JS_ATOM_NULL ? JS_AtomToCString(ctx, base_atom) : nullptr;
+    JS_FreeAtom(ctx, base_atom);
+    module_path = CModuleLoader::Resolve(ctx, base ? base : "", spec);
+    JS_FreeCString(ctx, base);
+    JS_FreeCString(ctx, spec);
+    if (module_path.empty())
+      return JS_EXCEPTION;
+    if (!std::filesystem::is_regular_file(module_path))
+      return JS_ThrowReferenceError(ctx, "create_window: no module at '%s'",
+                                    module_path.c_str());
+  } else {
+    JSValue src_val = JS_ToString(ctx, argv[1]); // fn -> string
+    const char *c_src = JS_ToCString(ctx, src_val);
+    fn_source = c_src;
+    JS_FreeCString(ctx, c_src);
+    JS_FreeValue(ctx, src_val); // done with it
+  }
 
   /* -------------------------------------------------------------- */
-  /* 4. Post a task to the GUI thread                               */
+  /* 4. Clone the initial state once; later changes go through the */
+  /*    handle's update() as deltas                                 */
   /* -------------------------------------------------------------- */
-  g_guiTasks.push([title = std::move(title),
-                   fn_source = std::move(fn_source)]() mutable {
-    /* 4.1 Create QuickJS runtime _on the GUI thread_             */
-    JSRuntime *gui_rt = JS_NewRuntime();
-    SCR::register_class(gui_rt);
-    JSContext *gui_ctx = JS_NewContext(gui_rt);
-    SCR::install_ui_object(gui_ctx); // ui.text, etc.
+  auto state = std::make_shared<ClonedValue>();
+  bool deferred = false;
+  if (JS_IsObject(options)) {
+    JSValue deferred_val = JS_GetPropertyStr(ctx, options, "deferred");
+    deferred = JS_ToBool(ctx, deferred_val) > 0;
+    JS_FreeValue(ctx, deferred_val);
+
+    JSValue state_val = JS_GetPropertyStr(ctx, options, "state");
+    JSValue transfer = JS_GetPropertyStr(ctx, options, "transfer");
+    bool ok = !JS_IsException(state_val) && !JS_IsException(transfer);
+    if (ok && !JS_IsUndefined(state_val) && !JS_IsObject(state_val)) {
+      JS_ThrowTypeError(ctx, "create_window: state must be an object");
+      ok = false;
+    } else if (ok && !JS_IsUndefined(state_val)) {
+      ok = CStructuredClone::Serialize(ctx, state_val, transfer, *state);
+    }
+    JS_FreeValue(ctx, state_val);
+    JS_FreeValue(ctx, transfer);
+    if (!ok)
+      return JS_EXCEPTION;
+  }
+
+  register_window_class(ctx);
+  JSValue handle = JS_NewObjectClass(ctx, g_window_class_id);
+  if (JS_IsException(handle))
+    return handle;
+  auto link = std::make_shared<WindowLink>();
+  JS_SetOpaque(handle, new WindowLinkPtr(link));
 
-    /* 4.2 Evaluate the callback source in this GUI context       */
-    JSValue draw_cb = JS_Eval(gui_ctx, fn_source.c_str(), fn_source.size(),
-                              "<draw_cb>", JS_EVAL_TYPE_GLOBAL);
+  /* -------------------------------------------------------------- */
+  /* 5. Post a task to the GUI thread                               */
+  /* -------------------------------------------------------------- */
+  g_guiTasks.push([title = std::move(title), fn_source = std::move(fn_source),
+                   module_path = std::move(module_path), state, deferred,
+                   link]() mutable {
+    /* A parked window drawn the same way comes back with the new state  */
+    /* merged in; transferred buffers only travel with a new window      */
+    std::string key = std::string(deferred ? "deferred" : "live") + '\0' +
+                      title + '\0' +
+                      (module_path.empty() ? fn_source : module_path);
+    if (state->buffers.empty()) {
+      if (auto win = CScriptWindows::Get().Reuse(key)) {
+        if (!state->data.empty())
+          win->Update(state->data);
+        link->window = win;
+        return;
+      }
+    }
+
+    /* A deferred window only replays: its script runs in the recorder */
+    if (deferred) {
+      auto win = std::make_shared<SCR::JSImGuiWindow>(
+          title, JS_NewContext(gui_runtime()), JS_UNDEFINED, JS_UNDEFINED);
+      win->Defer(std::make_shared<CDrawRecorder>(
+          title, std::move(fn_source), std::move(module_path), state));
+      win->SetReuseKey(std::move(key));
+      link->window = win;
+      CScriptWindows::Get().Add(std::move(win));
+      return;
+    }
+
+    /* 5.1 Create the window's context _on the GUI thread_        */
+    JSContext *gui_ctx = JS_NewContext(gui_runtime());
+    SCR::install_ui_object(gui_ctx); // ui.text, etc.
+    SCR::CEventBus::Install(gui_ctx);
+    SCR::CSharedBuffers::Install(gui_ctx);
+
+    /* 5.2 Bring in the state and the draw callback               */
+    JSValue state_val = state->data.empty()
+                            ? JS_NewObject(gui_ctx)
+                            : CStructuredClone::Deserialize(gui_ctx, *state);
+    JSValue init = JS_UNDEFINED;
+    JSValue draw_cb =
+        JS_IsException(state_val)
+            ? JS_EXCEPTION
+            : load_draw_callback(gui_ctx, fn_source, module_path, init);
 
     if (JS_IsException(draw_cb)) { // broken script?
       JSValue exc = JS_GetException(gui_ctx);
       const char *msg = JS_ToCString(gui_ctx, exc);
+      LOG_WARN(Script, "{}: [JS exception] {}", title,
+               msg ? msg : "(unable to stringify exception)");
       JS_FreeCString(gui_ctx, msg);
       JS_FreeValue(gui_ctx, exc);
+      JS_FreeValue(gui_ctx, state_val);
       JS_FreeContext(gui_ctx);
-      JS_FreeRuntime(gui_rt);
       return; // abort window
     }
 
-    /* 4.3 Create the C++ ImGui window wrapper                    */
-    auto win = std::make_shared<SCR::JSImGuiWindow>(title, gui_ctx, draw_cb);
+    /* 5.3 Create the C++ ImGui window wrapper                    */
+    auto win = std::make_shared<SCR::JSImGuiWindow>(title, gui_ctx, draw_cb,
+                                                    state_val, init);
+    win->SetReuseKey(std::move(key));
+    link->window = win;
 
-    /* 4.4 Hand it to the renderer (GUI thread)                   */
-    GUI::Renderer::renderer->PushWindow(std::move(win));
+    /* 5.4 Hand it to the window manager (GUI thread)             */
+    CScriptWindows::Get().Add(std::move(win));
   });
 
-  return JS_UNDEFINED; // worker thread returns immediately
+  return handle; // worker thread returns immediately
 }
 /* Button ------------------------------------------------------------ */
 JSValue ui_button(JSContext *c, JSValueConst, int argc, JSValueConst *v) {
@@ -697,6 +1250,10 @@ void install_ui_object(JSContext *ctx) {
                     JS_NewCFunction(ctx, ui_get_cursor_screen_pos,
                                     "get_cursor_screen_pos", 0));
 
+  JS_SetPropertyStr(ctx, ui, "draw_batch",
+                    JS_NewCFunction(ctx, ui_draw_batch, "draw_batch", 3));
+  install_draw_ops(ctx, ui);
+
   /* Convenience name to avoid clashing with ui.text */
   JS_SetPropertyStr(ctx, ui, "add_text_dl",
                     JS_NewCFunction(ctx, ui_add_text, "add_text_dl", 4));
@@ -744,31 +1301,29 @@ JSValue ui_load_image(JSContext *c, JSValueConst, int argc, JSValueConst *v) {
   JS_FreeCString(c, path_c);
 
   bool is_url = (path.find("http://") == 0 || path.find("https://") == 0);
-  fmt::print("[JS] Loading image: {} (is_url: {})\n", path, is_url);
+  LOG_DEBUG(Script, "Loading image: {} (is_url: {})", path, is_url);
 
   auto image = std::make_shared<CImage>(path, is_url);
 
-  if (is_url) {
-    fmt::print("[JS] Calling LoadImageFromURL...\n");
+  if (is_url)
     image->LoadImageFromURL();
-  } else {
-    fmt::print("[JS] Calling LoadImage...\n");
+  else
     image->LoadImage();
-  }
-
-  fmt::print("[JS] After loading - ImageLoaded: {}\n", image->ImageLoaded);
 
   // Check if loading succeeded
   if (!image->ImageLoaded) {
-    fmt::print("[JS] Loading failed for: {}\n", path);
+    LOG_ERROR(Script, "Loading failed for: {}", path);
     return JS_ThrowInternalError(c, "Failed to load image: %s", path.c_str());
   }
 
   // Store in cache and return handle
   int handle = g_next_image_id++;
   g_image_cache[handle] = image;
+  // A window's images go with it
+  if (auto *win = dynamic_cast<JSImGuiWindow *>(CRunLoop::Of(c)))
+    win->OwnImage(handle);
 
-  fmt::print("[JS] Successfully loaded image, handle: {}\n", handle);
+  LOG_DEBUG(Script, "Loaded image {}, handle: {}", path, handle);
   return JS_NewInt32(c, handle);
 }
 
@@ -1,7 +1,18 @@
 #pragma once
+#include "DrawCache.h"
+#include "DrawRecorder.h"
+#include "RunLoop.h"
 #include "UI/IWindow.h"
+#include "UTILS/Logger.h"
 #include <quickjs.h>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #define KEY_LEFT (int)ImGuiKey_LeftArrow
 #define KEY_RIGHT (int)ImGuiKey_RightArrow
@@ -9,47 +20,100 @@
 #define KEY_DOWN (int)ImGuiKey_DownArrow
 
 namespace SCR {
-    class JSImGuiWindow : public GUI::IWindow {
+    // A window's context lives in the GUI runtime, on the GUI thread, so
+    // tasks posted to its loop run at the start of its next draw. The draw
+    // callback is called as draw(ui, state, changed): `state` is the same
+    // object every frame, and `changed` is true on the first frame after
+    // Update touched it, so anything derived from the state only needs
+    // computing then. A deferred window has no draw callback of its own;
+    // its recorder runs the script off the GUI thread and the window
+    // replays what it recorded. CScriptWindows owns every window and
+    // decides when a closed one is shut down.
+    class JSImGuiWindow : public GUI::IWindow, public CRunLoop {
     public:
-        JSImGuiWindow(std::string title, JSContext *ctx, JSValue draw_cb)
-                : title_(std::move(title)), ctx_(ctx), cb_(draw_cb), is_open_(true) {}
-
-        ~JSImGuiWindow() override { JS_FreeValue(ctx_, cb_); }
-
-        void Draw() override {
-            if (!is_open_) return;
-
-            // Pass the is_open_ flag to ImGui::Begin() to get the native close button
-            if (!ImGui::Begin(title_.c_str(), &is_open_)) {
-                ImGui::End();
-                return;
-            }
-
-            // Get the global 'ui' object that was created by install_ui_object()
-            JSValue global = JS_GetGlobalObject(ctx_);
-            JSValue ui_obj = JS_GetPropertyStr(ctx_, global, "ui");
-
-            // Pass it as the first argument to the callback
-            JSValue args[] = {ui_obj};
-            JSValue res = JS_Call(ctx_, cb_, JS_UNDEFINED, 1, args); // 1 arg
+        // `init`, when a function, is called with the state before the
+        // first draw
+        JSImGuiWindow(std::string title, JSContext *ctx, JSValue draw_cb, JSValue state,
+                      JSValue init = JS_UNDEFINED)
+                : title_(std::move(title)), ctx_(ctx), cb_(draw_cb), state_(state), init_(init), is_open_(true) {
+            Attach(ctx_);
+            // As a task, so it runs with the loop attached and has its
+            // errors reported
+            tasks_.push_back([this](JSContext *c) {
+                JSValue init_fn = init_;
+                init_ = JS_UNDEFINED;
+                JSValue r = JS_IsFunction(c, init_fn) ? JS_Call(c, init_fn, JS_UNDEFINED, 1, &state_) : JS_UNDEFINED;
+                JS_FreeValue(c, r);
+                JS_FreeValue(c, init_fn);
+            });
+        }
 
-            if (JS_IsException(res)) {
-                JSValue exc = JS_GetException(ctx_);
-                const char *msg = JS_ToCString(ctx_, exc);
-                ImGui::TextColored(ImVec4(1, 0.2f, 0.2f, 1), "[JS exception] %s", msg);
-                JS_FreeCString(ctx_, msg);
-                JS_FreeValue(ctx_, exc);
-            }
+        ~JSImGuiWindow() override { Shutdown(); }
 
-            // Clean up
-            JS_FreeValue(ctx_, res);
-            JS_FreeValue(ctx_, ui_obj);
-            JS_FreeValue(ctx_, global);
+        // Each Hold is released by the Post that follows it; the window
+        // object outlives its context until all of them came in
+        void Hold() override {
+            std::lock_guard<std::mutex> lk(tasks_mutex_);
+            holds_++;
+        }
+        void Post(std::function<void(JSContext *)> task) override {
+            std::lock_guard<std::mutex> lk(tasks_mutex_);
+            holds_--;
+            if (ctx_)
+                tasks_.push_back(std::move(task));
+        }
 
-            ImGui::End();
+        // Makes this a deferred window, before it first draws
+        void Defer(std::shared_ptr<CDrawRecorder> recorder) { recorder_ = std::move(recorder); }
+
+        // Shallow merges a cloned object into the state; keys set to
+        // undefined are deleted
+        void Update(std::string_view delta);
+        void RequestClose() { is_open_ = false; }
+        void Reopen() { is_open_ = ctx_ != nullptr; }
+
+        // Images loaded from this window, released with its context
+        void OwnImage(int handle) { images_.push_back(handle); }
+
+        // What create_window matches a parked window by: its title and
+        // what draws it
+        void SetReuseKey(std::string key) { reuse_key_ = std::move(key); }
+        const std::string &ReuseKey() const { return reuse_key_; }
+
+        // Frees the context and everything loaded through it; the window
+        // never draws again
+        void Shutdown();
+        // No Hold is waiting for its Post any more
+        bool Drained() {
+            std::lock_guard<std::mutex> lk(tasks_mutex_);
+            return holds_ == 0 && (!recorder_ || recorder_->Drained());
         }
 
+        // How the draw callback has been running, for scheduling and the
+        // profiler
+        struct DrawStats {
+            double cost_ms = 0; // per call, smoothed
+            double last_ms = 0; // the latest call, 0 on a frame it was skipped
+            int waited = 0;     // frames shown since the last call
+            float calls_per_sec = 0;
+            float frames_per_sec = 0; // frames the window was shown in
+
+            int calls = 0, frames = 0; // since `since`
+            double since = 0;
+        };
+        const DrawStats &Stats() const { return stats_; }
+        bool Focused() const { return focused_; }
+        bool Deferred() const { return recorder_ != nullptr; }
+        // Whether Draw(false) has something to show
+        bool CanReuse() const { return !cache_.Empty(); }
+
+        void Draw() override { Draw(true); }
+        // With `run` false, a window that has drawn before shows its last
+        // output again instead of calling into the script
+        void Draw(bool run);
+
         bool IsOpen() const { return is_open_; }
+        const std::string &Title() const { return title_; }
 
         void SetWindowSize(const MATH::Vector2D<int> &s) override { size_ = s; }
         MATH::Vector2D<int> GetWindowSize() override { return size_; }
@@ -60,12 +124,53 @@ namespace SCR {
         void ResizeWindowScaled(MATH::Vector2D<int> &) override {} // no-op
 
     private:
+        void RunTasks() {
+            std::deque<std::function<void(JSContext *)>> tasks;
+            {
+                std::lock_guard<std::mutex> lk(tasks_mutex_);
+                tasks.swap(tasks_);
+            }
+            for (auto &task : tasks) {
+                task(ctx_);
+                // Every window shares the GUI runtime and so its job queue;
+                // a job that throws is reported against its own window
+                JSContext *job_ctx = ctx_;
+                int r = Threw(ctx_) ? -1 : 1;
+                while (r > 0)
+                    r = JS_ExecutePendingJob(JS_GetRuntime(ctx_), &job_ctx);
+                if (r < 0)
+                    ReportException(job_ctx);
+            }
+        }
+
+        void ReportException(JSContext *ctx) {
+            auto *owner = dynamic_cast<JSImGuiWindow *>(Of(ctx));
+            JSValue exc = JS_GetException(ctx);
+            const char *msg = JS_ToCString(ctx, exc);
+            LOG_WARN(Script, "{}: [JS exception] {}", owner ? owner->title_ : title_,
+                     msg ? msg : "(unable to stringify exception)");
+            JS_FreeCString(ctx, msg);
+            JS_FreeValue(ctx, exc);
+        }
+
         std::string title_;
-        JSContext *ctx_;
+        JSContext *ctx_; // null once shut down
         JSValue cb_;
+        JSValue state_;
+        JSValue init_;
+        bool changed_ = true;
+        std::string reuse_key_;
+        std::vector<int> images_;
         MATH::Vector2D<int> size_{400, 300};
         MATH::Vector2D<int> pos_{100, 100};
         bool is_open_;
+        std::mutex tasks_mutex_;
+        std::deque<std::function<void(JSContext *)>> tasks_;
+        std::ptrdiff_t holds_ = 0;
+        std::shared_ptr<CDrawRecorder> recorder_;
+        CDrawCache cache_;
+        DrawStats stats_;
+        bool focused_ = false;
     };
 
     JSValue ui_text(JSContext *, JSValueConst, int, JSValueConst *);
@@ -116,6 +221,10 @@ namespace SCR {
     JSValue ui_progress_bar(JSContext *, JSValueConst, int, JSValueConst *);
     JSValue ui_frame(JSContext *, JSValueConst, int, JSValueConst *);
 
+    // ui.create_window(title, draw[, {state, deferred}]) or
+    // ui.create_window(title, {module, state, deferred}); returns a handle
+    // with update(delta), close() and open(). Reopens a parked window with
+    // the same title and callback or module instead of building a new one.
     JSValue js_create_window(JSContext *ctx, JSValueConst /*this_val*/, int argc,
                              JSValueConst *argv);
 
@@ -160,5 +269,30 @@ namespace SCR {
     JSValue ui_add_image_quad(JSContext *, JSValueConst, int, JSValueConst *);
     JSValue ui_add_image_rounded(JSContext *, JSValueConst, int, JSValueConst *);
 
+    // ui.draw_batch(commands[, x, y]) draws a whole command stream into the
+    // window's draw list in one call, every point offset by (x, y), so a
+    // buffer built once can be drawn wherever the window is. `commands` is
+    // a Float32Array, Uint32Array or ArrayBuffer of 32-bit words: an opcode
+    // (ui.DRAW_LINE, ...) followed by its operands, where colors, counts and
+    // flags are uint32 and coordinates and sizes float32, so scripts write
+    // through both views of one buffer. ui.DRAW_END, or a zero word, ends
+    // the stream early. Throws a RangeError at an unknown opcode or a
+    // command cut short; what came before it is drawn.
+    JSValue ui_draw_batch(JSContext *, JSValueConst, int, JSValueConst *);
+    // The words of a draw_batch argument; false with a TypeError pending
+    bool draw_batch_words(JSContext *ctx, JSValueConst v, const uint8_t *&words,
+                          std::size_t &count);
+    // Sets the ui.DRAW_* opcodes on `ui`, for every object that has
+    // draw_batch
+    void install_draw_ops(JSContext *ctx, JSValueConst ui);
+
+    // The draw callback of a new window: the module's `draw` export, along
+    // with its optional `init`, or the re-evaluated callback source
+    JSValue load_draw_callback(JSContext *ctx, const std::string &fn_source,
+                               const std::string &module_path, JSValue &init);
+    // Shallow merges a cloned object into `state`; keys set to undefined
+    // are deleted. False with the exception pending if it cannot be read.
+    bool merge_state(JSContext *ctx, JSValueConst state, std::string_view delta);
+
     void install_ui_object(JSContext *ctx);
 }
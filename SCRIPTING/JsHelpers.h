@@ -0,0 +1,25 @@
+#pragma once
+#include <quickjs.h>
+#include <string>
+
+namespace SCR {
+
+    // Takes the pending exception of `ctx` as text
+    inline std::string TakeException(JSContext *ctx) {
+        JSValue exc = JS_GetException(ctx);
+        const char *msg = JS_ToCString(ctx, exc);
+        std::string text = msg ? msg : "(unable to stringify exception)";
+        JS_FreeCString(ctx, msg);
+        JS_FreeValue(ctx, exc);
+        return text;
+    }
+
+    // Runs the queued promise jobs of `rt`. False if one threw, with the
+    // exception left pending on `failed`.
+    inline bool RunJobs(JSRuntime *rt, JSContext *&failed) {
+        int r;
+        while ((r = JS_ExecutePendingJob(rt, &failed)) > 0) {
+        }
+        return r == 0;
+    }
+}
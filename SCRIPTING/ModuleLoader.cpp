@@ -0,0 +1,228 @@
+#include "ModuleLoader.h"
+#include "../UTILS/Logger.h"
+#include "FS/MainFileSystem.h"
+#include "FsModule.h"
+#include <fstream>
+#include <cstring>
+#include <iterator>
+
+namespace SCR {
+
+    namespace fs = std::filesystem;
+
+    namespace {
+        // Native modules, imported by their bare name
+        struct Builtin {
+            const char *name;
+            JSModuleDef *(*create)(JSContext *ctx, const char *name);
+        };
+        const Builtin kBuiltins[] = {
+                {"fs", CFsModule::NewModule},
+        };
+
+        const Builtin *FindBuiltin(const char *name) {
+            for (const Builtin &b : kBuiltins)
+                if (std::strcmp(b.name, name) == 0)
+                    return &b;
+            return nullptr;
+        }
+    }
+
+    std::mutex CModuleLoader::cacheMutex;
+    std::unordered_map<std::string, std::shared_ptr<const CModuleLoader::Entry>> CModuleLoader::cache;
+
+    void CModuleLoader::Install(JSRuntime *rt) {
+        JS_SetModuleLoaderFunc(rt, Normalize, Load, nullptr);
+    }
+
+    JSValue CModuleLoader::EvalModule(JSContext *ctx, const std::string &path) {
+        JSValue mod = LoadModule(ctx, ModuleName(path));
+        if (JS_IsException(mod))
+            return mod;
+        // A module read from bytecode has not loaded its imports yet
+        if (JS_ResolveModule(ctx, mod) < 0) {
+            JS_FreeValue(ctx, mod);
+            return JS_EXCEPTION;
+        }
+
+        JSValue promise = JS_EvalFunction(ctx, mod);
+        if (JS_IsException(promise))
+            return promise;
+
+        // Module evaluation settles through the job queue, top level await
+        // and promise callbacks included
+        JSContext *jobCtx;
+        int pending;
+        while ((pending = JS_ExecutePendingJob(JS_GetRuntime(ctx), &jobCtx)) > 0) {
+        }
+        if (pending < 0) {
+            JS_FreeValue(ctx, promise);
+            return JS_Throw(ctx, JS_GetException(jobCtx));
+        }
+
+        JSValue ret = JS_UNDEFINED;
+        if (JS_PromiseState(ctx, promise) == JS_PROMISE_REJECTED)
+            ret = JS_Throw(ctx, JS_PromiseResult(ctx, promise));
+        JS_FreeValue(ctx, promise);
+        return ret;
+    }
+
+    JSValue CModuleLoader::ImportModule(JSContext *ctx, const std::string &path) {
+        // There is no public way to reach a module's namespace, so this
+        // goes through a dynamic import, which loads through Normalize
+        // and Load like any other
+        static const char kImport[] = "(path) => import(path)";
+        JSValue import = JS_Eval(ctx, kImport, sizeof(kImport) - 1, "<import>", JS_EVAL_TYPE_GLOBAL);
+        if (JS_IsException(import))
+            return import;
+        const std::string name = ModuleName(path);
+        JSValue arg = JS_NewStringLen(ctx, name.data(), name.size());
+        JSValue promise = JS_Call(ctx, import, JS_UNDEFINED, 1, &arg);
+        JS_FreeValue(ctx, arg);
+        JS_FreeValue(ctx, import);
+        if (JS_IsException(promise))
+            return promise;
+
+        JSContext *jobCtx;
+        int pending;
+        while ((pending = JS_ExecutePendingJob(JS_GetRuntime(ctx), &jobCtx)) > 0) {
+        }
+        if (pending < 0) {
+            JS_FreeValue(ctx, promise);
+            return JS_Throw(ctx, JS_GetException(jobCtx));
+        }
+
+        JSValue ret;
+        switch (JS_PromiseState(ctx, promise)) {
+            case JS_PROMISE_FULFILLED:
+                ret = JS_PromiseResult(ctx, promise);
+                break;
+            case JS_PROMISE_REJECTED:
+                ret = JS_Throw(ctx, JS_PromiseResult(ctx, promise));
+                break;
+            default:
+                ret = JS_ThrowInternalError(ctx, "module '%s' did not finish loading", name.c_str());
+                break;
+        }
+        JS_FreeValue(ctx, promise);
+        return ret;
+    }
+
+    JSValue CModuleLoader::CompileModule(JSContext *ctx, const std::string &src, const std::string &path) {
+        const std::string name = ModuleName(path);
+        return JS_Eval(ctx, src.c_str(), src.size(), name.c_str(), JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+    }
+
+    void CModuleLoader::ClearCache() {
+        std::lock_guard<std::mutex> lk(cacheMutex);
+        cache.clear();
+    }
+
+    std::string CModuleLoader::Resolve(JSContext *ctx, const std::string &base, const std::string &name) {
+        const fs::path root = FS::CFileSystem::GetScriptFolderLocation().lexically_normal();
+
+        fs::path resolved;
+        if (name[0] == '.') {
+            const fs::path from(base);
+            resolved = (from.is_absolute() ? from.parent_path() : root) / name;
+        } else {
+            resolved = root / name;
+        }
+        resolved = resolved.lexically_normal();
+        if (!resolved.has_extension())
+            resolved += ".js";
+
+        const fs::path rel = resolved.lexically_relative(root);
+        if (rel.empty() || *rel.begin() == "..") {
+            JS_ThrowReferenceError(ctx, "cannot import '%s': only files in the Scripts folder can be imported",
+                                   name.c_str());
+            return {};
+        }
+        return ModuleName(resolved);
+    }
+
+    char *CModuleLoader::Normalize(JSContext *ctx, const char *base, const char *name, void *) {
+        if (FindBuiltin(name))
+            return js_strdup(ctx, name);
+        const std::string resolved = Resolve(ctx, base, name);
+        return resolved.empty() ? nullptr : js_strdup(ctx, resolved.c_str());
+    }
+
+    JSModuleDef *CModuleLoader::Load(JSContext *ctx, const char *name, void *) {
+        if (const Builtin *builtin = FindBuiltin(name))
+            return builtin->create(ctx, name);
+        JSValue mod = LoadModule(ctx, name);
+        if (JS_IsException(mod))
+            return nullptr;
+        // The context's module list keeps its own reference
+        auto *m = (JSModuleDef *)JS_VALUE_GET_PTR(mod);
+        JS_FreeValue(ctx, mod);
+        return m;
+    }
+
+    JSValue CModuleLoader::LoadModule(JSContext *ctx, const std::string &path) {
+        std::error_code ec;
+        const auto mtime = fs::last_write_time(path, ec);
+        const std::uintmax_t size = ec ? 0 : fs::file_size(path, ec);
+        if (ec)
+            return JS_ThrowReferenceError(ctx, "could not load module '%s'", path.c_str());
+
+        std::shared_ptr<const Entry> hit;
+        {
+            std::lock_guard<std::mutex> lk(cacheMutex);
+            auto it = cache.find(path);
+            if (it != cache.end() && it->second->mtime == mtime && it->second->size == size)
+                hit = it->second;
+        }
+
+        JSValue mod;
+        if (hit) {
+            mod = JS_ReadObject(ctx, hit->bytecode.data(), hit->bytecode.size(), JS_READ_OBJ_BYTECODE);
+        } else {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                return JS_ThrowReferenceError(ctx, "could not load module '%s'", path.c_str());
+            const std::string src{std::istreambuf_iterator<char>(in), {}};
+
+            // Compiling also loads the module's imports, through this cache.
+            // No lock is held here, so two runs may compile the same file at
+            // once; the second one's bytecode simply replaces the first.
+            mod = JS_Eval(ctx, src.c_str(), src.size(), path.c_str(), JS_EVAL_TYPE_MODULE | JS_EVAL_FLAG_COMPILE_ONLY);
+            if (JS_IsException(mod))
+                return mod;
+
+            std::size_t len = 0;
+            uint8_t *buf = JS_WriteObject(ctx, &len, mod, JS_WRITE_OBJ_BYTECODE);
+            if (buf) {
+                auto entry = std::make_shared<Entry>();
+                entry->mtime = mtime;
+                entry->size = size;
+                entry->bytecode.assign(buf, buf + len);
+                js_free(ctx, buf);
+                LOG_TRACE(Script, "Compiled module {} ({} bytes of bytecode)", path, len);
+
+                std::lock_guard<std::mutex> lk(cacheMutex);
+                cache[path] = std::move(entry);
+            } else {
+                // Still usable, just not cached
+                JS_FreeValue(ctx, JS_GetException(ctx));
+            }
+        }
+        if (JS_IsException(mod))
+            return mod;
+
+        JSValue meta = JS_GetImportMeta(ctx, (JSModuleDef *)JS_VALUE_GET_PTR(mod));
+        if (!JS_IsException(meta)) {
+            JS_DefinePropertyValueStr(ctx, meta, "url", JS_NewString(ctx, ("file://" + path).c_str()),
+                                      JS_PROP_C_W_E);
+            JS_FreeValue(ctx, meta);
+        } else {
+            JS_FreeValue(ctx, JS_GetException(ctx));
+        }
+        return mod;
+    }
+
+    std::string CModuleLoader::ModuleName(const fs::path &path) {
+        return path.lexically_normal().generic_string();
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+#include <quickjs.h>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace SCR {
+
+    // ES module support for script runtimes. `import "./x.js"` resolves
+    // against the importing module's folder, a bare `import "lib/x"` against
+    // the Scripts folder, and ".js" is added when there is no extension.
+    // Nothing outside the Scripts folder can be imported. Native modules,
+    // such as "fs", are imported by their bare name.
+    //
+    // Compiled modules are kept as bytecode in one process wide cache keyed
+    // by path and checked against the file's size and modification time, so
+    // a shared library compiles once and every later run, in any runtime,
+    // only deserializes it.
+    class CModuleLoader {
+        public:
+            static void Install(JSRuntime *rt);
+
+            // Runs the module at `path` and its pending jobs; returns the
+            // exception when evaluation failed, undefined otherwise
+            static JSValue EvalModule(JSContext *ctx, const std::string &path);
+
+            // Runs the module at `path` like EvalModule and returns its
+            // namespace object
+            static JSValue ImportModule(JSContext *ctx, const std::string &path);
+
+            // Compile-only check of module source that may not be saved yet;
+            // imports are loaded so their errors show up too
+            static JSValue CompileModule(JSContext *ctx, const std::string &src, const std::string &path);
+
+            static void ClearCache();
+
+            // Full path of `name` imported from `base` under the rules
+            // above; throws and returns an empty string for paths outside
+            // the Scripts folder
+            static std::string Resolve(JSContext *ctx, const std::string &base, const std::string &name);
+
+        private:
+            static char *Normalize(JSContext *ctx, const char *base, const char *name, void *opaque);
+            static JSModuleDef *Load(JSContext *ctx, const char *name, void *opaque);
+
+            // Module value (JS_TAG_MODULE) for `path`, from the cache or freshly compiled
+            static JSValue LoadModule(JSContext *ctx, const std::string &path);
+            static std::string ModuleName(const std::filesystem::path &path);
+
+            struct Entry {
+                std::filesystem::file_time_type mtime;
+                std::uintmax_t size = 0;
+                std::vector<uint8_t> bytecode;
+            };
+
+            static std::mutex cacheMutex;
+            static std::unordered_map<std::string, std::shared_ptr<const Entry>> cache;
+    };
+}
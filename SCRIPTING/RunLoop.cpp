@@ -0,0 +1,53 @@
+#include "RunLoop.h"
+#include "EventBus.h"
+
+namespace SCR {
+
+    JSValue CRunLoop::NewPromise(JSContext *ctx, uint64_t &id) {
+        std::array<JSValue, 2> funcs;
+        JSValue promise = JS_NewPromiseCapability(ctx, funcs.data());
+        if (JS_IsException(promise))
+            return promise;
+        id = nextPromise++;
+        promises.emplace(id, funcs);
+        return promise;
+    }
+
+    void CRunLoop::Settle(JSContext *ctx, uint64_t id, JSValue value, bool reject) {
+        if (JS_IsException(value)) {
+            value = JS_GetException(ctx);
+            reject = true;
+        }
+        auto it = promises.find(id);
+        if (it == promises.end()) {
+            JS_FreeValue(ctx, value);
+            return;
+        }
+        const std::array<JSValue, 2> funcs = it->second;
+        promises.erase(it);
+
+        JSValue r = JS_Call(ctx, funcs[reject ? 1 : 0], JS_UNDEFINED, 1, &value);
+        JS_FreeValue(ctx, r);
+        JS_FreeValue(ctx, value);
+        JS_FreeValue(ctx, funcs[0]);
+        JS_FreeValue(ctx, funcs[1]);
+    }
+
+    bool CRunLoop::Threw(JSContext *ctx) {
+        JSValue exc = JS_GetException(ctx);
+        if (JS_IsNull(exc))
+            return false;
+        JS_Throw(ctx, exc);
+        return true;
+    }
+
+    std::size_t CRunLoop::Close(JSContext *ctx) {
+        const std::size_t released = CEventBus::Get().Detach(this, ctx);
+        for (auto &[id, funcs] : promises) {
+            JS_FreeValue(ctx, funcs[0]);
+            JS_FreeValue(ctx, funcs[1]);
+        }
+        promises.clear();
+        return released;
+    }
+}
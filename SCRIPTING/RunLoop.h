@@ -0,0 +1,55 @@
+#pragma once
+#include <quickjs.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+
+namespace SCR {
+
+    // The event loop of one script runtime: a script run, one of its workers
+    // or a script window. Native code that finishes work on another thread
+    // hands the result back through it, and it is what keeps the run going
+    // until that happens. Each such runtime has its loop as the context
+    // opaque.
+    class CRunLoop {
+        public:
+            virtual ~CRunLoop() = default;
+
+            // Null for runtimes without a loop, such as benchmark runs
+            static CRunLoop *Of(JSContext *ctx) { return (CRunLoop *)JS_GetContextOpaque(ctx); }
+            void Attach(JSContext *ctx) { JS_SetContextOpaque(ctx, this); }
+
+            // Any thread. Hold keeps the run alive until the matching Post,
+            // which runs `task` on the runtime's thread. A task posted after
+            // the runtime shut down is dropped without running; one that
+            // leaves an exception pending has it reported as uncaught.
+            virtual void Hold() = 0;
+            virtual void Post(std::function<void(JSContext *)> task) = 0;
+
+            // Whether a task left an exception pending; it stays pending
+            static bool Threw(JSContext *ctx);
+
+            // A run started by the scheduler, or one of its workers. Such a
+            // run has to end on its own, so nothing may hold it open
+            // indefinitely, such as a bus subscription.
+            virtual bool IsScheduledRun() const { return false; }
+
+            // A promise to settle later from a posted task
+            JSValue NewPromise(JSContext *ctx, uint64_t &id);
+            // Takes ownership of `value`; JS_EXCEPTION rejects with the
+            // pending exception
+            void Settle(JSContext *ctx, uint64_t id, JSValue value, bool reject);
+
+        protected:
+            // Before the context is freed: drops promises that never settled
+            // and ends the runtime's bus subscriptions. Returns the number of
+            // holds released without a Post, one per subscription.
+            std::size_t Close(JSContext *ctx);
+
+        private:
+            std::unordered_map<uint64_t, std::array<JSValue, 2>> promises; // resolve, reject
+            uint64_t nextPromise = 0;
+    };
+}
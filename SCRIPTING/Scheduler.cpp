@@ -0,0 +1,355 @@
+#include "Scheduler.h"
+#include "../UTILS/Logger.h"
+#include "FS/MainFileSystem.h"
+#include "Scripting.h"
+#include "UI/GuiTaskQueue.h"
+#include "fmt/chrono.h"
+#include <algorithm>
+#include <cctype>
+#include <sstream>
+#include <vector>
+
+namespace SCR {
+
+    namespace {
+        std::string Trim(const std::string &s) {
+            const auto b = s.find_first_not_of(" \t");
+            const auto e = s.find_last_not_of(" \t");
+            return b == std::string::npos ? std::string() : s.substr(b, e - b + 1);
+        }
+
+        bool ParseInt(const std::string &s, int &out) {
+            if (s.empty() || s.size() > 4 || !std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c); }))
+                return false;
+            out = std::stoi(s);
+            return true;
+        }
+
+        // One cron field: `*`, `n`, `a-b`, each optionally `/step`, comma
+        // separated. `any` is true when the field is a bare `*`.
+        template <std::size_t N>
+        bool ParseField(const std::string &field, int lo, int hi, std::bitset<N> &bits, bool &any,
+                        std::string &error) {
+            any = field == "*";
+            std::stringstream parts(field);
+            std::string part;
+            while (std::getline(parts, part, ',')) {
+                int step = 1;
+                const auto slash = part.find('/');
+                if (slash != std::string::npos) {
+                    if (!ParseInt(part.substr(slash + 1), step) || step == 0) {
+                        error = "bad step in '" + field + "'";
+                        return false;
+                    }
+                    part = part.substr(0, slash);
+                }
+
+                int a = lo, b = hi;
+                if (part != "*") {
+                    const auto dash = part.find('-');
+                    if (dash == std::string::npos) {
+                        if (!ParseInt(part, a)) {
+                            error = "bad value in '" + field + "'";
+                            return false;
+                        }
+                        b = slash == std::string::npos ? a : hi;
+                    } else if (!ParseInt(part.substr(0, dash), a) || !ParseInt(part.substr(dash + 1), b)) {
+                        error = "bad range in '" + field + "'";
+                        return false;
+                    }
+                }
+                if (a < lo || b > hi || a > b) {
+                    error = "'" + field + "' is outside " + std::to_string(lo) + "-" + std::to_string(hi);
+                    return false;
+                }
+                for (int v = a; v <= b; v += step)
+                    bits.set((std::size_t)v);
+            }
+            if (bits.none()) {
+                error = "empty field";
+                return false;
+            }
+            return true;
+        }
+    }
+
+    std::optional<ScheduleSpec> ScheduleSpec::Parse(const std::string &input, std::string &error) {
+        std::string text = Trim(input);
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        if (text.rfind("every ", 0) == 0)
+            text = Trim(text.substr(6));
+
+        if (text == "@hourly")
+            text = "0 * * * *";
+        else if (text == "@daily")
+            text = "0 0 * * *";
+        else if (text == "@weekly")
+            text = "0 0 * * 0";
+        else if (text == "@monthly")
+            text = "0 0 1 * *";
+
+        std::vector<std::string> fields;
+        std::stringstream ss(text);
+        for (std::string f; ss >> f;)
+            fields.push_back(f);
+
+        ScheduleSpec spec;
+        if (fields.size() == 5) {
+            bool anyMinute, anyHour, anyMonth;
+            std::bitset<8> weekdays; // 7 is Sunday too
+            if (!ParseField(fields[0], 0, 59, spec.minutes, anyMinute, error) ||
+                !ParseField(fields[1], 0, 23, spec.hours, anyHour, error) ||
+                !ParseField(fields[2], 1, 31, spec.days, spec.anyDay, error) ||
+                !ParseField(fields[3], 1, 12, spec.months, anyMonth, error) ||
+                !ParseField(fields[4], 0, 7, weekdays, spec.anyWeekday, error))
+                return std::nullopt;
+            for (int d = 0; d < 7; d++)
+                spec.weekdays[d] = weekdays[d] || (d == 0 && weekdays[7]);
+            return spec;
+        }
+
+        // Interval: number and unit pairs, "90s", "1h30m", "250ms"
+        if (fields.size() != 1) {
+            error = "expected an interval like 30s or five cron fields";
+            return std::nullopt;
+        }
+        std::chrono::milliseconds total{0};
+        std::size_t i = 0;
+        while (i < text.size()) {
+            std::size_t j = i;
+            while (j < text.size() && std::isdigit((unsigned char)text[j]))
+                j++;
+            std::size_t k = j;
+            while (k < text.size() && std::isalpha((unsigned char)text[k]))
+                k++;
+            const std::string number = text.substr(i, j - i), unit = text.substr(j, k - j);
+            int n;
+            if (!ParseInt(number, n)) {
+                error = "bad interval '" + text + "'";
+                return std::nullopt;
+            }
+            if (unit == "ms")
+                total += std::chrono::milliseconds(n);
+            else if (unit == "s")
+                total += std::chrono::seconds(n);
+            else if (unit == "m")
+                total += std::chrono::minutes(n);
+            else if (unit == "h")
+                total += std::chrono::hours(n);
+            else if (unit == "d")
+                total += std::chrono::hours(24 * n);
+            else {
+                error = "unknown unit '" + unit + "' (ms, s, m, h, d)";
+                return std::nullopt;
+            }
+            i = k;
+        }
+        if (total.count() <= 0) {
+            error = "the interval has to be longer than zero";
+            return std::nullopt;
+        }
+        spec.interval = total;
+        return spec;
+    }
+
+    std::optional<std::chrono::system_clock::time_point>
+    ScheduleSpec::NextCron(std::chrono::system_clock::time_point after) const {
+        std::tm tm = fmt::localtime(std::chrono::system_clock::to_time_t(after));
+        tm.tm_sec = 0;
+        tm.tm_min += 1;
+
+        // Each miss skips to the start of the next month, day, hour or
+        // minute, so even a yearly expression settles in a few hundred steps
+        for (int guard = 0; guard < 100000; guard++) {
+            tm.tm_isdst = -1;
+            const std::time_t t = std::mktime(&tm);
+            if (t == (std::time_t)-1)
+                return std::nullopt;
+
+            const bool dom = days[(std::size_t)tm.tm_mday], dow = weekdays[(std::size_t)tm.tm_wday];
+            const bool dayOk = anyDay && anyWeekday ? true : anyDay ? dow : anyWeekday ? dom : (dom || dow);
+
+            if (!months[(std::size_t)tm.tm_mon + 1]) {
+                tm.tm_mon++;
+                tm.tm_mday = 1;
+                tm.tm_hour = tm.tm_min = 0;
+            } else if (!dayOk) {
+                tm.tm_mday++;
+                tm.tm_hour = tm.tm_min = 0;
+            } else if (!hours[(std::size_t)tm.tm_hour]) {
+                tm.tm_hour++;
+                tm.tm_min = 0;
+            } else if (!minutes[(std::size_t)tm.tm_min]) {
+                tm.tm_min++;
+            } else {
+                return std::chrono::system_clock::from_time_t(t);
+            }
+        }
+        return std::nullopt; // e.g. "0 0 30 2 *"
+    }
+
+    CScheduler &CScheduler::Get() {
+        static CScheduler scheduler;
+        return scheduler;
+    }
+
+    CScheduler::CScheduler() : epoch(std::chrono::steady_clock::now()), rng(std::random_device{}()) {
+        worker = std::thread([this] { Run(); });
+    }
+
+    CScheduler::~CScheduler() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    bool CScheduler::Set(const std::string &path, const std::string &text, std::string &error) {
+        std::optional<ScheduleSpec> spec = ScheduleSpec::Parse(text, error);
+        if (!spec)
+            return false;
+        if (spec->interval.count() > 0 && spec->interval < kMinInterval) {
+            error = "the shortest interval is " + std::to_string(kMinInterval.count()) + "ms";
+            return false;
+        }
+        if (spec->interval.count() == 0 && !spec->NextCron(std::chrono::system_clock::now())) {
+            error = "the expression never matches";
+            return false;
+        }
+
+        {
+            std::lock_guard<std::mutex> lk(m);
+            std::shared_ptr<Entry> &entry = entries[path];
+            if (!entry) {
+                entry = std::make_shared<Entry>();
+                entry->path = path;
+                std::shared_ptr<std::atomic<bool>> &flag = inFlight[path];
+                if (!flag)
+                    flag = std::make_shared<std::atomic<bool>>(false);
+                entry->inFlight = flag;
+            }
+            entry->text = Trim(text);
+            entry->spec = *spec;
+            Arm(entry, true);
+        }
+        cv.notify_one();
+        LOG_DEBUG(Script, "Scheduled {} ({})", path, text);
+        return true;
+    }
+
+    void CScheduler::Remove(const std::string &path) {
+        std::lock_guard<std::mutex> lk(m);
+        auto it = entries.find(path);
+        if (it == entries.end())
+            return;
+        // Whatever is still on the wheel for it no longer matches
+        it->second->generation = ++nextGeneration;
+        entries.erase(it);
+    }
+
+    void CScheduler::Clear() {
+        std::lock_guard<std::mutex> lk(m);
+        for (auto &[path, entry] : entries)
+            entry->generation = ++nextGeneration;
+        entries.clear();
+    }
+
+    std::optional<ScheduleStatus> CScheduler::Status(const std::string &path) {
+        std::lock_guard<std::mutex> lk(m);
+        auto it = entries.find(path);
+        if (it == entries.end())
+            return std::nullopt;
+        const Entry &e = *it->second;
+        return ScheduleStatus{e.text, e.next, e.runs.load(), e.coalesced.load()};
+    }
+
+    uint64_t CScheduler::TickOf(std::chrono::steady_clock::time_point t) const {
+        if (t <= epoch)
+            return 0;
+        // Rounded up, so a timer never fires before its time
+        return (uint64_t)((t - epoch + kTick - std::chrono::nanoseconds(1)) / kTick);
+    }
+
+    void CScheduler::Arm(const std::shared_ptr<Entry> &entry, bool first) {
+        using namespace std::chrono;
+        const auto now = steady_clock::now();
+        milliseconds window;
+
+        if (entry->spec.interval.count() > 0) {
+            const auto interval = entry->spec.interval;
+            auto ideal = first ? now + interval : entry->ideal + interval;
+            // Missed fires (the machine slept) collapse into the next one
+            if (ideal <= now)
+                ideal += interval * ((now - ideal) / interval + 1);
+            entry->ideal = ideal;
+            window = std::min<milliseconds>(interval / 10, kMaxJitter);
+        } else {
+            const auto wall = system_clock::now();
+            const auto target = entry->spec.NextCron(first ? wall : std::max(wall, entry->cronTarget));
+            if (!target) {
+                LOG_WARN(Script, "Schedule '{}' for {} has no further matches", entry->text, entry->path);
+                return;
+            }
+            entry->cronTarget = *target;
+            entry->ideal = now + duration_cast<steady_clock::duration>(*target - wall);
+            window = kMaxJitter;
+        }
+
+        std::uniform_int_distribution<int64_t> jitter(0, std::max<int64_t>(window.count(), 0));
+        entry->next = entry->ideal + milliseconds(jitter(rng));
+        entry->generation = ++nextGeneration;
+        wheel.Schedule(TickOf(entry->next), Timer{entry, entry->generation});
+    }
+
+    void CScheduler::Fire(const std::shared_ptr<Entry> &entry) {
+        if (entry->inFlight->exchange(true)) {
+            entry->coalesced++;
+            return;
+        }
+        entry->runs++;
+
+        // CScripting and the script list belong to the GUI thread
+        g_guiTasks.push([entry, flag = entry->inFlight] {
+            FS::ScriptJS *script = nullptr;
+            for (auto &s : FS::CFileSystem::GetScripts())
+                if (s->fullpath == entry->path) {
+                    script = s.get();
+                    break;
+                }
+            if (!script) {
+                *flag = false;
+                return;
+            }
+            // A thread of its own: a run waits on its workers, which the
+            // shared executor would have to run
+            CScripting::RunScriptAsync(script, [flag] { *flag = false; }, true);
+        });
+    }
+
+    void CScheduler::Run() {
+        std::unique_lock<std::mutex> lk(m);
+        std::vector<std::shared_ptr<Entry>> due;
+        while (!stop) {
+            const uint64_t now = (uint64_t)((std::chrono::steady_clock::now() - epoch) / kTick);
+            wheel.Advance(now, [&due](Timer &t, uint64_t) {
+                if (t.generation == t.entry->generation)
+                    due.push_back(std::move(t.entry));
+            });
+            for (auto &entry : due) {
+                Fire(entry);
+                Arm(entry, false);
+            }
+            due.clear();
+
+            // Sleeps until the next occupied slot; with nothing scheduled the
+            // thread only wakes for Set or shutdown
+            if (std::optional<uint64_t> next = wheel.NextTick())
+                cv.wait_until(lk, epoch + kTick * (int64_t)*next);
+            else
+                cv.wait(lk);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include "UTILS/TimerWheel.h"
+#include <atomic>
+#include <bitset>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+
+namespace SCR {
+
+    // When a scheduled script runs: every `interval`, or whenever the local
+    // time matches a five field cron expression (minute hour day month
+    // weekday; `*`, lists, ranges and `/step`, plus @hourly, @daily,
+    // @weekly, @monthly).
+    struct ScheduleSpec {
+        std::chrono::milliseconds interval{0}; // zero for cron
+        std::bitset<60> minutes;
+        std::bitset<24> hours;
+        std::bitset<32> days;   // 1-31
+        std::bitset<13> months; // 1-12
+        std::bitset<7> weekdays; // 0 = Sunday
+        bool anyDay = true, anyWeekday = true;
+
+        // "5s", "every 2m", "1h30m", "250ms" or a cron expression
+        static std::optional<ScheduleSpec> Parse(const std::string &text, std::string &error);
+
+        // First matching minute strictly after `after`
+        std::optional<std::chrono::system_clock::time_point> NextCron(std::chrono::system_clock::time_point after) const;
+    };
+
+    struct ScheduleStatus {
+        std::string spec;
+        std::chrono::steady_clock::time_point next;
+        uint64_t runs = 0;      // handed to the executor
+        uint64_t coalesced = 0; // fired while the previous run was still going
+    };
+
+    // Runs scripts on their schedules. One thread sleeps on a timer wheel
+    // until the next due schedule and hands it to CScripting through the GUI
+    // task queue. A schedule that fires while its previous run is still
+    // queued or running is coalesced into that run instead of stacking up,
+    // and every fire is delayed by a small random amount so schedules
+    // created together do not all start on the same tick.
+    class CScheduler {
+        public:
+            static CScheduler &Get();
+
+            // Replaces the schedule of the script at `path`
+            bool Set(const std::string &path, const std::string &spec, std::string &error);
+            void Remove(const std::string &path);
+            void Clear();
+
+            std::optional<ScheduleStatus> Status(const std::string &path);
+
+            static constexpr std::chrono::milliseconds kTick{10};
+            static constexpr std::chrono::milliseconds kMinInterval{100};
+            static constexpr std::chrono::milliseconds kMaxJitter{2000};
+
+        private:
+            CScheduler();
+            ~CScheduler();
+            CScheduler(const CScheduler &) = delete;
+            CScheduler &operator=(const CScheduler &) = delete;
+
+            struct Entry {
+                std::string path;
+                std::string text;
+                ScheduleSpec spec;
+                uint64_t generation = 0;
+                std::chrono::steady_clock::time_point ideal; // before jitter
+                std::chrono::steady_clock::time_point next;
+                std::chrono::system_clock::time_point cronTarget; // last matched minute
+                std::shared_ptr<std::atomic<bool>> inFlight;
+                std::atomic<uint64_t> runs{0};
+                std::atomic<uint64_t> coalesced{0};
+            };
+            struct Timer {
+                std::shared_ptr<Entry> entry;
+                uint64_t generation;
+            };
+
+            void Run();
+            void Arm(const std::shared_ptr<Entry> &entry, bool first);
+            void Fire(const std::shared_ptr<Entry> &entry);
+            uint64_t TickOf(std::chrono::steady_clock::time_point t) const;
+
+            std::mutex m;
+            std::condition_variable cv;
+            std::map<std::string, std::shared_ptr<Entry>> entries;
+            // Per script rather than per entry, so a run started before the
+            // schedule was replaced or removed still counts as in flight
+            std::map<std::string, std::shared_ptr<std::atomic<bool>>> inFlight;
+            TimerWheel<Timer> wheel;
+            std::chrono::steady_clock::time_point epoch;
+            std::mt19937_64 rng;
+            uint64_t nextGeneration = 0;
+            bool stop = false;
+            std::thread worker;
+    };
+}
@@ -0,0 +1,327 @@
+#include "ScriptArena.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <iterator>
+
+namespace SCR {
+
+    namespace {
+        // 16 byte steps where most QuickJS objects, shapes and atoms land,
+        // then coarser classes up to kMaxSmall
+        constexpr uint32_t kClassSizes[] = {16,  32,  48,  64,  80,  96,   112,  128,  144,  160,  176,  192,
+                                            208, 224, 240, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+        constexpr int kClassCount = (int)(sizeof(kClassSizes) / sizeof(kClassSizes[0]));
+
+        // Sits right before every block so the usable size can be found from
+        // the pointer alone, which is all js_malloc_usable_size gets
+        struct alignas(16) BlockHeader {
+            std::size_t size;
+            uint32_t cls;
+        };
+
+        BlockHeader *HeaderOf(const void *ptr) {
+            return (BlockHeader *)((const char *)ptr - sizeof(BlockHeader));
+        }
+    }
+
+    struct alignas(16) CScriptArena::Chunk {
+        Chunk *next;
+    };
+
+    struct alignas(16) CScriptArena::LargeBlock {
+        LargeBlock *prev;
+        LargeBlock *next;
+        BlockHeader header;
+    };
+
+    struct alignas(16) CScriptArena::ExternalBlock {
+        ExternalRelease release;
+        void *context;
+        BlockHeader header;
+    };
+
+    CScriptArena::CScriptArena() : created(std::chrono::steady_clock::now()) {
+        static_assert(sizeof(freeLists) / sizeof(freeLists[0]) == kClassCount, "one free list per size class");
+        static_assert(kClassSizes[kClassCount - 1] == kMaxSmall, "largest class is kMaxSmall");
+        static_assert(sizeof(ExternalBlock) == kExternalPrefix, "external header fills the prefix");
+    }
+
+    CScriptArena::~CScriptArena() {
+        Release();
+    }
+
+    JSRuntime *CScriptArena::NewRuntime() {
+        static const JSMallocFunctions functions = {JsMalloc, JsFree, JsRealloc, JsUsableSize};
+        return JS_NewRuntime2(&functions, this);
+    }
+
+    ArenaStats CScriptArena::Stats() const {
+        ArenaStats s = stats;
+        s.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - created).count();
+        return s;
+    }
+
+    bool CScriptArena::CanTransfer(const void *data) {
+        if (!data)
+            return false;
+        const uint32_t cls = HeaderOf(data)->cls;
+        return cls == kLarge || cls == kOwned || cls == kExternal;
+    }
+
+    void CScriptArena::BeginTransfer(void *data) {
+        BlockHeader *header = HeaderOf(data);
+        header->cls = header->cls == kExternal ? kTransferringExternal : kTransferring;
+    }
+
+    void *CScriptArena::NewTransferBlock(std::size_t size) {
+        auto *block = (LargeBlock *)std::malloc(sizeof(LargeBlock) + std::max<std::size_t>(size, 1));
+        if (!block)
+            return nullptr;
+        block->prev = block->next = nullptr;
+        block->header.size = size;
+        block->header.cls = kOwned;
+        return block + 1;
+    }
+
+    void *CScriptArena::ResizeTransferBlock(void *ptr, std::size_t size) {
+        if (!ptr)
+            return NewTransferBlock(size);
+        auto *block = (LargeBlock *)std::realloc((LargeBlock *)ptr - 1, sizeof(LargeBlock) + std::max<std::size_t>(size, 1));
+        if (!block)
+            return nullptr;
+        block->header.size = size;
+        return block + 1;
+    }
+
+    void CScriptArena::FreeTransferred(JSRuntime *, void *, void *ptr) {
+        if (!ptr)
+            return;
+        BlockHeader *header = HeaderOf(ptr);
+        switch (header->cls) {
+            case kTransferring: // detached to move on to yet another runtime
+                header->cls = kOwned;
+                return;
+            case kTransferringExternal:
+                header->cls = kExternal;
+                return;
+            case kExternal: {
+                const auto *block = (ExternalBlock *)ptr - 1;
+                block->release(ptr, block->header.size, block->context);
+                return;
+            }
+            default:
+                std::free((LargeBlock *)ptr - 1);
+        }
+    }
+
+    void CScriptArena::InitExternalBlock(void *data, std::size_t size, ExternalRelease release, void *context) {
+        auto *block = (ExternalBlock *)data - 1;
+        block->release = release;
+        block->context = context;
+        block->header.size = size;
+        block->header.cls = kExternal;
+    }
+
+    // QuickJS keeps its own count and size in the JSMallocState to decide
+    // when to collect, so the hooks maintain those the way its default
+    // allocator does and leave the pooling to Allocate and Deallocate
+
+    void *CScriptArena::JsMalloc(JSMallocState *s, std::size_t size) {
+        if (s->malloc_size + size > s->malloc_limit)
+            return nullptr;
+        void *ptr = ((CScriptArena *)s->opaque)->Allocate(size);
+        if (!ptr)
+            return nullptr;
+        s->malloc_count++;
+        s->malloc_size += JsUsableSize(ptr) + sizeof(BlockHeader);
+        return ptr;
+    }
+
+    void CScriptArena::JsFree(JSMallocState *s, void *ptr) {
+        if (!ptr)
+            return;
+        s->malloc_count--;
+        s->malloc_size -= JsUsableSize(ptr) + sizeof(BlockHeader);
+        ((CScriptArena *)s->opaque)->Deallocate(ptr);
+    }
+
+    void *CScriptArena::JsRealloc(JSMallocState *s, void *ptr, std::size_t size) {
+        if (!ptr)
+            return size ? JsMalloc(s, size) : nullptr;
+        if (!size) {
+            JsFree(s, ptr);
+            return nullptr;
+        }
+
+        const std::size_t oldSize = JsUsableSize(ptr);
+        if (s->malloc_size + size - oldSize > s->malloc_limit)
+            return nullptr;
+        ptr = ((CScriptArena *)s->opaque)->Resize(ptr, size);
+        if (!ptr)
+            return nullptr;
+        s->malloc_size += JsUsableSize(ptr) - oldSize;
+        return ptr;
+    }
+
+    std::size_t CScriptArena::JsUsableSize(const void *ptr) {
+        return ptr ? HeaderOf(ptr)->size : 0;
+    }
+
+    int CScriptArena::SizeClass(std::size_t size) {
+        if (size <= 256)
+            return size ? (int)((size + 15) / 16) - 1 : 0;
+        if (size > kMaxSmall)
+            return -1;
+        return (int)(std::lower_bound(kClassSizes + 16, kClassSizes + kClassCount, (uint32_t)size) - kClassSizes);
+    }
+
+    void *CScriptArena::Allocate(std::size_t size) {
+        void *ptr;
+        std::size_t usable;
+
+        const int cls = SizeClass(size);
+        if (cls < 0) {
+            auto *block = (LargeBlock *)std::malloc(sizeof(LargeBlock) + size);
+            if (!block)
+                return nullptr;
+            block->prev = nullptr;
+            block->next = large;
+            if (large)
+                large->prev = block;
+            large = block;
+            block->header.size = size;
+            block->header.cls = kLarge;
+            stats.reserved += sizeof(LargeBlock) + size;
+            ptr = block + 1;
+            usable = size;
+        } else {
+            ptr = freeLists[cls];
+            if (ptr)
+                freeLists[cls] = *(void **)ptr;
+            else if (!(ptr = Carve(cls)))
+                return nullptr;
+            usable = kClassSizes[cls];
+        }
+
+        stats.bytes += usable;
+        stats.peak = std::max(stats.peak, stats.bytes);
+        stats.allocations++;
+        return ptr;
+    }
+
+    void CScriptArena::Deallocate(void *ptr) {
+        BlockHeader *header = HeaderOf(ptr);
+        // A block handed over by a transfer was never counted here and has
+        // no free list; it goes back where it came from
+        if (header->cls == kOwned || header->cls == kExternal) {
+            FreeTransferred(nullptr, nullptr, ptr);
+            return;
+        }
+        assert(header->cls < (uint32_t)kClassCount || header->cls == kLarge || header->cls == kTransferring);
+        stats.bytes -= header->size;
+
+        if (header->cls == kLarge || header->cls == kTransferring) {
+            auto *block = (LargeBlock *)ptr - 1;
+            if (block->prev)
+                block->prev->next = block->next;
+            else
+                large = block->next;
+            if (block->next)
+                block->next->prev = block->prev;
+            stats.reserved -= sizeof(LargeBlock) + block->header.size;
+            if (header->cls == kTransferring) {
+                // Leaves the arena with the ArrayBuffer it backed
+                block->prev = block->next = nullptr;
+                header->cls = kOwned;
+                return;
+            }
+            std::free(block);
+            return;
+        }
+
+        *(void **)ptr = freeLists[header->cls];
+        freeLists[header->cls] = ptr;
+    }
+
+    void *CScriptArena::Resize(void *ptr, std::size_t size) {
+        BlockHeader *header = HeaderOf(ptr);
+        const int cls = SizeClass(size);
+
+        // Same class: the block already fits and is not oversized. A
+        // transferred block never matches and is copied in, then released
+        // by Deallocate.
+        if (cls >= 0 && (uint32_t)cls == header->cls)
+            return ptr;
+
+        // Large to large stays in the C heap, where realloc can grow in place
+        if (cls < 0 && header->cls == kLarge) {
+            auto *block = (LargeBlock *)ptr - 1;
+            const std::size_t oldSize = block->header.size;
+            const auto oldAddress = (uintptr_t)block;
+            auto *moved = (LargeBlock *)std::realloc(block, sizeof(LargeBlock) + size);
+            if (!moved)
+                return nullptr;
+            if (moved->prev)
+                moved->prev->next = moved;
+            else
+                large = moved;
+            if (moved->next)
+                moved->next->prev = moved;
+            moved->header.size = size;
+            stats.reserved += size - oldSize;
+            stats.bytes += size - oldSize;
+            stats.peak = std::max(stats.peak, stats.bytes);
+            if ((uintptr_t)moved != oldAddress)
+                stats.allocations++;
+            return moved + 1;
+        }
+
+        void *fresh = Allocate(size);
+        if (!fresh)
+            return nullptr;
+        std::memcpy(fresh, ptr, std::min<std::size_t>(header->size, size));
+        Deallocate(ptr);
+        return fresh;
+    }
+
+    void *CScriptArena::Carve(int cls) {
+        const std::size_t slot = sizeof(BlockHeader) + kClassSizes[cls];
+        if ((std::size_t)(bumpEnd - bump) < slot) {
+            // The tail of the previous chunk is too small for this class and
+            // is simply left unused
+            auto *chunk = (Chunk *)std::malloc(kChunkSize);
+            if (!chunk)
+                return nullptr;
+            chunk->next = chunks;
+            chunks = chunk;
+            bump = (char *)(chunk + 1);
+            bumpEnd = (char *)chunk + kChunkSize;
+            stats.reserved += kChunkSize;
+        }
+
+        auto *header = (BlockHeader *)bump;
+        header->size = kClassSizes[cls];
+        header->cls = (uint32_t)cls;
+        bump += slot;
+        return header + 1;
+    }
+
+    void CScriptArena::Release() {
+        while (chunks) {
+            Chunk *next = chunks->next;
+            std::free(chunks);
+            chunks = next;
+        }
+        while (large) {
+            LargeBlock *next = large->next;
+            std::free(large);
+            large = next;
+        }
+        bump = bumpEnd = nullptr;
+        std::fill(std::begin(freeLists), std::end(freeLists), nullptr);
+        stats.bytes = 0;
+        stats.reserved = 0;
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <quickjs.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace SCR {
+
+    struct ArenaStats {
+        std::size_t bytes = 0;       // handed out to QuickJS right now
+        std::size_t peak = 0;        // highest `bytes` seen
+        std::size_t reserved = 0;    // chunks plus large blocks taken from the heap
+        uint64_t allocations = 0;    // malloc calls, reallocs that moved included
+        double seconds = 0.0;        // lifetime of the arena
+        [[nodiscard]] double AllocationsPerSecond() const {
+            return seconds > 0.0 ? (double)allocations / seconds : 0.0;
+        }
+    };
+
+    // Allocator behind one QuickJS runtime. Small blocks come from per-size
+    // class free lists carved out of 64 KiB chunks, larger ones straight from
+    // malloc, and everything is returned to the heap in one go when the arena
+    // is destroyed. Not thread safe: a runtime only ever runs on one thread,
+    // so the arena never takes a lock and never touches the global heap for
+    // the small, short-lived allocations scripts make most of.
+    class CScriptArena {
+        public:
+            CScriptArena();
+            ~CScriptArena();
+
+            CScriptArena(const CScriptArena &) = delete;
+            CScriptArena &operator=(const CScriptArena &) = delete;
+
+            // The runtime must be freed before the arena is
+            JSRuntime *NewRuntime();
+
+            [[nodiscard]] ArenaStats Stats() const;
+
+            // Moving ArrayBuffer memory between runtimes. `data` must be the
+            // backing store of an ArrayBuffer in an arena runtime. Blocks
+            // that live in a chunk cannot leave it and have to be copied into
+            // a NewTransferBlock instead. BeginTransfer marks a block so that
+            // detaching the buffer right after hands the memory over instead
+            // of freeing it; it then belongs to whoever took it until it is
+            // wrapped with JS_NewArrayBuffer(..., FreeTransferred, ...) or
+            // given back with FreeTransferred. Native code can fill a
+            // NewTransferBlock and wrap it the same way, and the buffer it
+            // makes can then be transferred without a copy as well.
+            static bool CanTransfer(const void *data);
+            static void BeginTransfer(void *data);
+            static void *NewTransferBlock(std::size_t size);
+            // Like realloc; `ptr` may be null, and stays valid on failure
+            static void *ResizeTransferBlock(void *ptr, std::size_t size);
+            static void FreeTransferred(JSRuntime *rt, void *opaque, void *ptr);
+
+            // Memory the heap does not own, such as a file mapping, made into
+            // a transfer block. The kExternalPrefix bytes right before `data`
+            // must be writable and are used for the block's header; `release`
+            // runs once the last owner frees it.
+            using ExternalRelease = void (*)(void *data, std::size_t size, void *context);
+            static constexpr std::size_t kExternalPrefix = 32;
+            static void InitExternalBlock(void *data, std::size_t size, ExternalRelease release, void *context);
+
+        private:
+            static constexpr std::size_t kChunkSize = 64 * 1024;
+            static constexpr std::size_t kMaxSmall = 4096;
+            static constexpr uint32_t kLarge = UINT32_MAX;
+            static constexpr uint32_t kTransferring = UINT32_MAX - 1; // detach hands it over
+            static constexpr uint32_t kOwned = UINT32_MAX - 2;        // outside any arena
+            static constexpr uint32_t kExternal = UINT32_MAX - 3;
+            static constexpr uint32_t kTransferringExternal = UINT32_MAX - 4;
+
+            static void *JsMalloc(JSMallocState *s, std::size_t size);
+            static void JsFree(JSMallocState *s, void *ptr);
+            static void *JsRealloc(JSMallocState *s, void *ptr, std::size_t size);
+            static std::size_t JsUsableSize(const void *ptr);
+
+            static int SizeClass(std::size_t size);
+
+            void *Allocate(std::size_t size);
+            void Deallocate(void *ptr);
+            void *Resize(void *ptr, std::size_t size);
+            void *Carve(int cls);
+            void Release();
+
+            struct Chunk;
+            struct LargeBlock;
+            struct ExternalBlock;
+
+            Chunk *chunks = nullptr;
+            char *bump = nullptr, *bumpEnd = nullptr;
+            LargeBlock *large = nullptr;
+            void *freeLists[24] = {};
+
+            ArenaStats stats;
+            std::chrono::steady_clock::time_point created;
+    };
+}
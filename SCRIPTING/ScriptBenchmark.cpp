@@ -0,0 +1,238 @@
+#include "ScriptBenchmark.h"
+#include "../Dependencies/json/json.hpp"
+#include "../Dependencies/quickjs/quickjs.h"
+#include "../UTILS/BuildInfo.h"
+#include "../UTILS/Hash.h"
+#include "../UTILS/Logger.h"
+#include "../UTILS/ThreadPool.h"
+#include "FS/MainFileSystem.h"
+#include "FunctionBindings.h"
+#include "ModuleLoader.h"
+#include "Scripting.h"
+#include "SharedBuffers.h"
+#include "UI/GuiTaskQueue.h"
+#include "Workers.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+
+namespace SCR {
+
+    namespace {
+        // Older entries are dropped so the file stays readable
+        constexpr std::size_t kMaxHistory = 20;
+
+        JSValue bench_create_window(JSContext *, JSValueConst, int, JSValueConst *) {
+            return JS_UNDEFINED;
+        }
+
+        int bench_interrupt(JSRuntime *, void *opaque) {
+            const auto *deadline = static_cast<std::chrono::steady_clock::time_point *>(opaque);
+            return std::chrono::steady_clock::now() > *deadline;
+        }
+
+        std::string Timestamp() {
+            const std::time_t now = std::time(nullptr);
+            std::tm tm{};
+#if defined(_WIN32)
+            gmtime_s(&tm, &now);
+#else
+            gmtime_r(&now, &tm);
+#endif
+            char buf[32];
+            std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%SZ", &tm);
+            return buf;
+        }
+
+        void ComputeStats(std::vector<double> samples, BenchmarkResult &r) {
+            if (samples.empty())
+                return;
+            std::sort(samples.begin(), samples.end());
+            const std::size_t n = samples.size();
+
+            r.min_ms = samples.front();
+            r.median_ms = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) * 0.5;
+            r.p99_ms = samples[(std::size_t)std::ceil(0.99 * n) - 1];
+
+            double sum = 0.0;
+            for (double s : samples)
+                sum += s;
+            r.mean_ms = sum / n;
+
+            double sq = 0.0;
+            for (double s : samples)
+                sq += (s - r.mean_ms) * (s - r.mean_ms);
+            r.stddev_ms = n > 1 ? std::sqrt(sq / (n - 1)) : 0.0;
+        }
+    }
+
+    std::filesystem::path CScriptBenchmark::ResultPathFor(const std::string &scriptPath) {
+        std::filesystem::path p(scriptPath);
+        return p.parent_path() / (p.stem().string() + ".bench.json");
+    }
+
+    BenchmarkResult CScriptBenchmark::Run(const std::string &name, const std::string &path, int runs) {
+        BenchmarkResult r;
+        r.script = name;
+        r.runs = std::max(runs, 1);
+        r.warmup = kWarmupRuns;
+
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            r.error = "cannot open " + path;
+            return r;
+        }
+        const std::string src{std::istreambuf_iterator<char>(in), {}};
+
+        // Same allocator as a normal run, so the timings include it
+        CScriptArena arena;
+        JSRuntime *rt = arena.NewRuntime();
+        if (!rt) {
+            r.error = "cannot create runtime";
+            return r;
+        }
+        SCR::register_class(rt);
+        CModuleLoader::Install(rt);
+        CSharedBuffers::InstallAllocator(rt);
+        const bool isModule = JS_DetectModule(src.c_str(), src.size());
+
+        std::chrono::steady_clock::time_point deadline;
+        JS_SetInterruptHandler(rt, bench_interrupt, &deadline);
+
+        // console.log output of the runs collects here and is thrown away,
+        // without going to the log, so log writes are not timed
+        FS::ScriptJS sink(name, path);
+        sink.mirrorLog = false;
+
+        std::vector<double> samples;
+        samples.reserve(r.runs);
+        const int total = r.warmup + r.runs;
+        for (int i = 0; i < total; i++) {
+            JSContext *ctx = JS_NewContext(rt);
+            if (!ctx) {
+                r.error = "cannot create context";
+                break;
+            }
+            CScripting::InstallGlobals(ctx, &sink);
+
+            JSValue global = JS_GetGlobalObject(ctx);
+            JSValue ui = JS_GetPropertyStr(ctx, global, "ui");
+            JS_SetPropertyStr(ctx, ui, "create_window",
+                              JS_NewCFunction(ctx, bench_create_window, "create_window", 2));
+            JS_FreeValue(ctx, ui);
+            JS_FreeValue(ctx, global);
+
+            deadline = std::chrono::steady_clock::now() + kRunTimeout;
+            const auto t0 = std::chrono::steady_clock::now();
+            JSValue res = isModule ? CModuleLoader::EvalModule(ctx, path)
+                                   : JS_Eval(ctx, src.c_str(), src.size(), name.c_str(), JS_EVAL_TYPE_GLOBAL);
+            const auto t1 = std::chrono::steady_clock::now();
+
+            if (JS_IsException(res)) {
+                JSValue exc = JS_GetException(ctx);
+                const char *msg = JS_ToCString(ctx, exc);
+                r.error = msg ? msg : "(unable to stringify exception)";
+                JS_FreeCString(ctx, msg);
+                JS_FreeValue(ctx, exc);
+                JS_FreeContext(ctx);
+                break;
+            }
+            JS_FreeValue(ctx, res);
+
+            if (i >= r.warmup)
+                samples.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+
+            if (i == total - 1) {
+                JSMemoryUsage mu;
+                JS_ComputeMemoryUsage(rt, &mu);
+                r.malloc_count = mu.malloc_count;
+                r.malloc_size = mu.malloc_size;
+                r.memory_used = mu.memory_used_size;
+                r.obj_count = mu.obj_count;
+
+                // The top level function is gone once it has run, so size
+                // the bytecode from a compile-only pass
+                JSValue fn = isModule ? CModuleLoader::CompileModule(ctx, src, name)
+                                      : JS_Eval(ctx, src.c_str(), src.size(), name.c_str(),
+                                                JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+                if (!JS_IsException(fn)) {
+                    JS_ComputeMemoryUsage(rt, &mu);
+                    r.bytecode_size = mu.js_func_code_size;
+                }
+                JS_FreeValue(ctx, fn);
+            }
+
+            JS_FreeContext(ctx);
+            JS_RunGC(rt);
+
+            std::lock_guard<std::mutex> lk(sink.m);
+            sink.output.clear();
+        }
+        JS_FreeRuntime(rt);
+
+        ComputeStats(std::move(samples), r);
+        return r;
+    }
+
+    bool CScriptBenchmark::SaveResult(const std::string &scriptPath, const BenchmarkResult &r) {
+        const std::filesystem::path file = ResultPathFor(scriptPath);
+
+        nlohmann::json doc;
+        if (std::ifstream ifs(file); ifs)
+            doc = nlohmann::json::parse(ifs, nullptr, false);
+        if (!doc.is_object())
+            doc = nlohmann::json::object();
+        doc["script"] = r.script;
+        if (!doc["history"].is_array())
+            doc["history"] = nlohmann::json::array();
+
+        std::ifstream src(scriptPath, std::ios::binary);
+        const std::string source{std::istreambuf_iterator<char>(src), {}};
+
+        nlohmann::json entry;
+        entry["timestamp"] = Timestamp();
+        entry["build"] = UTILS::BuildDescription();
+        // Only compare entries whose source hash matches
+        char hex[17];
+        snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)UTILS::Fnv1a(source));
+        entry["source_hash"] = hex;
+        entry["runs"] = r.runs;
+        entry["warmup"] = r.warmup;
+        entry["wall_ms"] = {{"min", r.min_ms},
+                            {"median", r.median_ms},
+                            {"p99", r.p99_ms},
+                            {"mean", r.mean_ms},
+                            {"stddev", r.stddev_ms}};
+        entry["memory"] = {{"malloc_count", r.malloc_count},
+                           {"malloc_size", r.malloc_size},
+                           {"memory_used", r.memory_used},
+                           {"obj_count", r.obj_count},
+                           {"bytecode_size", r.bytecode_size}};
+
+        auto &history = doc["history"];
+        history.push_back(std::move(entry));
+        if (history.size() > kMaxHistory)
+            history.erase(history.begin(), history.begin() + (history.size() - kMaxHistory));
+
+        return FS::CFileSystem::WriteFileAtomic(file, doc.dump(4));
+    }
+
+    void CScriptBenchmark::RunAsync(const std::string &name, const std::string &path, int runs, Callback done) {
+        // On the worker pool, which is joined at exit, rather than a
+        // thread of its own
+        CWorkerHost::Executor().Add([name, path, runs, done = std::move(done)] {
+            BenchmarkResult r = Run(name, path, runs);
+            if (r.error.empty()) {
+                LOG_INFO(Script, "{}: {} runs, median {:.3f} ms, p99 {:.3f} ms", name, r.runs, r.median_ms, r.p99_ms);
+                if (!SaveResult(path, r))
+                    LOG_WARN(Script, "Could not write {}", ResultPathFor(path).string());
+            } else {
+                LOG_WARN(Script, "{}: benchmark failed: {}", name, r.error);
+            }
+            g_guiTasks.push([r = std::move(r), done] { done(r); });
+        });
+    }
+}
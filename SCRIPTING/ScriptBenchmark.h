@@ -0,0 +1,55 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+
+namespace SCR {
+
+    struct BenchmarkResult {
+        std::string script;
+        int runs = 0;
+        int warmup = 0;
+        std::string error; // empty when every run finished
+
+        // Wall time of one evaluation, in milliseconds
+        double min_ms = 0.0;
+        double median_ms = 0.0;
+        double p99_ms = 0.0;
+        double mean_ms = 0.0;
+        double stddev_ms = 0.0;
+
+        // JS_ComputeMemoryUsage at the end of the last run; bytecode_size
+        // is the compiled script's code
+        int64_t malloc_count = 0;
+        int64_t malloc_size = 0;
+        int64_t memory_used = 0;
+        int64_t obj_count = 0;
+        int64_t bytecode_size = 0;
+    };
+
+    // Times a script over repeated evaluations. One runtime stays warm for
+    // the whole benchmark and every run gets a fresh context with the same
+    // globals a normal run has, so runs do not see each other's state.
+    // ui.create_window is stubbed out so N runs do not open N windows.
+    class CScriptBenchmark {
+        public:
+            using Callback = std::function<void(BenchmarkResult)>;
+
+            static constexpr int kDefaultRuns = 30;
+            static constexpr int kWarmupRuns = 3;
+            // A single run taking longer than this is interrupted
+            static constexpr std::chrono::seconds kRunTimeout{10};
+
+            static BenchmarkResult Run(const std::string &name, const std::string &path, int runs);
+
+            // Runs on the worker pool, saves the result and hands it to
+            // `done` on the GUI thread
+            static void RunAsync(const std::string &name, const std::string &path, int runs, Callback done);
+
+            // Appends to the history in <script>.bench.json beside the script
+            static bool SaveResult(const std::string &scriptPath, const BenchmarkResult &result);
+            static std::filesystem::path ResultPathFor(const std::string &scriptPath);
+    };
+}
@@ -0,0 +1,159 @@
+#include "ScriptWindows.h"
+#include "ImGuiBindings.h"
+#include "UI/Renderer.h"
+#include <algorithm>
+#include <numeric>
+
+namespace SCR {
+
+    namespace {
+        bool Take(std::vector<std::shared_ptr<JSImGuiWindow>> &from, const std::shared_ptr<JSImGuiWindow> &window) {
+            auto it = std::find(from.begin(), from.end(), window);
+            if (it == from.end())
+                return false;
+            from.erase(it);
+            return true;
+        }
+    }
+
+    CScriptWindows &CScriptWindows::Get() {
+        static std::shared_ptr<CScriptWindows> windows = [] {
+            std::shared_ptr<CScriptWindows> w(new CScriptWindows());
+            GUI::Renderer::renderer->PushWindow(w);
+            return w;
+        }();
+        return *windows;
+    }
+
+    void CScriptWindows::Add(std::shared_ptr<JSImGuiWindow> window) {
+        open.push_back(std::move(window));
+    }
+
+    void CScriptWindows::Reopen(const std::shared_ptr<JSImGuiWindow> &window) {
+        if (Take(parked, window))
+            open.push_back(window);
+        window->Reopen();
+    }
+
+    std::shared_ptr<JSImGuiWindow> CScriptWindows::Reuse(const std::string &key) {
+        for (auto it = parked.rbegin(); it != parked.rend(); ++it) {
+            if ((*it)->ReuseKey() != key)
+                continue;
+            std::shared_ptr<JSImGuiWindow> window = *it;
+            Reopen(window);
+            return window;
+        }
+        return nullptr;
+    }
+
+    void CScriptWindows::Draw() {
+        const std::vector<bool> run = Schedule();
+        spentMs = 0;
+        // A window may open another from its draw callback; that one runs
+        for (std::size_t i = 0; i < open.size(); i++) {
+            std::shared_ptr<JSImGuiWindow> window = open[i];
+            window->Draw(i >= run.size() || run[i]);
+            spentMs += window->Stats().last_ms;
+        }
+        if (showProfiler)
+            DrawProfiler();
+        Sweep();
+    }
+
+    std::vector<bool> CScriptWindows::Schedule() const {
+        // The focused window first, then whichever waited longest
+        std::vector<std::size_t> order(open.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+            const JSImGuiWindow &x = *open[a], &y = *open[b];
+            if (x.Focused() != y.Focused())
+                return x.Focused();
+            return x.Stats().waited > y.Stats().waited;
+        });
+
+        std::vector<bool> run(open.size());
+        double planned = 0;
+        for (std::size_t i : order) {
+            const JSImGuiWindow &window = *open[i];
+            if (window.Deferred()) {
+                run[i] = true;
+                continue;
+            }
+            const double cost = window.Stats().cost_ms;
+            // Something always runs, even when it alone is over budget
+            run[i] = window.Focused() || !window.CanReuse() || planned == 0 ||
+                     planned + cost <= kFrameBudgetMs || window.Stats().waited >= kMaxWait;
+            if (run[i])
+                planned += cost;
+        }
+        return run;
+    }
+
+    void CScriptWindows::DrawProfiler() {
+        ImGui::SetNextWindowSize(ImVec2(480, 0), ImGuiCond_FirstUseEver);
+        if (ImGui::Begin("Script window profiler", &showProfiler)) {
+            ImGui::Text("Draw callbacks: %.2f ms of a %.1f ms budget", spentMs, kFrameBudgetMs);
+            if (ImGui::BeginTable("windows", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp)) {
+                ImGui::TableSetupColumn("Window");
+                ImGui::TableSetupColumn("Cost (ms)");
+                ImGui::TableSetupColumn("Updates/s");
+                ImGui::TableSetupColumn("Mode");
+                ImGui::TableHeadersRow();
+                for (const auto &window : open) {
+                    const JSImGuiWindow::DrawStats &stats = window->Stats();
+                    const bool throttled = stats.calls_per_sec < stats.frames_per_sec * 0.95f;
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(window->Title().c_str());
+                    ImGui::TableNextColumn();
+                    if (window->Deferred())
+                        ImGui::TextUnformatted("-");
+                    else
+                        ImGui::Text("%.2f", stats.cost_ms);
+                    ImGui::TableNextColumn();
+                    if (window->Deferred())
+                        ImGui::TextUnformatted("-");
+                    else
+                        ImGui::Text("%.0f of %.0f", stats.calls_per_sec, stats.frames_per_sec);
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(window->Deferred() ? "deferred"
+                                           : window->Focused() ? "focused"
+                                           : throttled ? "throttled"
+                                                       : "every frame");
+                }
+                ImGui::EndTable();
+            }
+        }
+        ImGui::End();
+    }
+
+    void CScriptWindows::Sweep() {
+        std::vector<std::shared_ptr<JSImGuiWindow>> closed;
+        open.erase(std::remove_if(open.begin(), open.end(),
+                                  [&closed](const auto &window) {
+                                      if (window->IsOpen())
+                                          return false;
+                                      closed.push_back(window);
+                                      return true;
+                                  }),
+                   open.end());
+        for (auto &window : closed)
+            parked.push_back(std::move(window));
+        while (parked.size() > kMaxParked) {
+            std::shared_ptr<JSImGuiWindow> oldest = std::move(parked.front());
+            parked.erase(parked.begin());
+            Retire(std::move(oldest));
+        }
+
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                     [](const auto &window) { return window->Drained(); }),
+                      retired.end());
+    }
+
+    void CScriptWindows::Retire(std::shared_ptr<JSImGuiWindow> window) {
+        LOG_DEBUG(Script, "{}: closed, freeing its context", window->Title());
+        window->Shutdown();
+        if (!window->Drained())
+            retired.push_back(std::move(window));
+    }
+}
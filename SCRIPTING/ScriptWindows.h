@@ -0,0 +1,73 @@
+#pragma once
+#include "UI/IWindow.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace SCR {
+
+    class JSImGuiWindow;
+
+    // Every script window, drawn as one entry in the renderer's window list.
+    // GUI thread only. A window the user or its script closed leaves the
+    // screen after the frame and is parked, context and state intact. Its
+    // context belongs to the GUI runtime, so the window outlives the script
+    // run that created it: handle.open() brings it back, and so does a
+    // later create_window with the same title and the same callback or
+    // module, from any script, merging the new state into the kept one
+    // without loading anything again. Only kMaxParked windows are kept;
+    // past that the longest parked is shut down, its context freed and the
+    // images it loaded released. A shut down window's object lingers only
+    // until work it was waiting for, such as an async read, has come back.
+    //
+    // Draw callbacks share a budget of kFrameBudgetMs per frame. The
+    // focused window's callback always runs, then the others in the order
+    // they have waited longest while their typical cost still fits; a
+    // window that is left out shows its last output, and none waits more
+    // than kMaxWait frames. A window left out still runs when it turns out
+    // to be hovered or taking input, so no click is lost, and one with
+    // child windows always runs, since its output cannot be reused. Deferred windows record off the GUI thread and
+    // take nothing from the budget. The profiler panel shows how often
+    // each window's callback gets to run.
+    class CScriptWindows : public GUI::IWindow {
+        public:
+            static CScriptWindows &Get();
+
+            void Add(std::shared_ptr<JSImGuiWindow> window);
+            void Reopen(const std::shared_ptr<JSImGuiWindow> &window);
+            // Reopens the parked window with this reuse key, if any
+            std::shared_ptr<JSImGuiWindow> Reuse(const std::string &key);
+            [[nodiscard]] std::size_t OpenCount() const { return open.size(); }
+
+            // Draws the open windows, then sweeps out the ones closed
+            void Draw() override;
+
+            static constexpr double kFrameBudgetMs = 4.0;
+            static constexpr int kMaxWait = 30;
+            static constexpr std::size_t kMaxParked = 8;
+
+            // Static, so toggling it does not create the window list in the
+            // middle of the renderer's frame
+            static inline bool showProfiler = false;
+
+            void ResizeWindowScaled(MATH::Vector2D<int> &) override {}
+            void SetWindowSize(const MATH::Vector2D<int> &) override {}
+            MATH::Vector2D<int> GetWindowSize() override { return {}; }
+            void SetWindowPos(const MATH::Vector2D<int> &) override {}
+            MATH::Vector2D<int> GetWindowPos() override { return {}; }
+
+        private:
+            CScriptWindows() = default;
+
+            // Which open windows call their draw callback this frame
+            std::vector<bool> Schedule() const;
+            void DrawProfiler();
+            void Sweep();
+            void Retire(std::shared_ptr<JSImGuiWindow> window);
+
+            std::vector<std::shared_ptr<JSImGuiWindow>> open;
+            std::vector<std::shared_ptr<JSImGuiWindow>> parked; // oldest first
+            std::vector<std::shared_ptr<JSImGuiWindow>> retired; // shut down, waiting for posts
+            double spentMs = 0; // in draw callbacks, last frame
+    };
+}
@@ -1,10 +1,16 @@
 #include "./Scripting.h"
-#include "../Dependencies/fmt/fmt/core.h"
 #include "../Dependencies/quickjs/quickjs.h"
 #include "../NETWORKING/CNetworking.h"
+#include "../UTILS/Logger.h"
 #include "FS/MainFileSystem.h"
+#include "EventBus.h"
+#include "FsModule.h"
 #include "FunctionBindings.h"
 #include "ImGuiBindings.h"
+#include "ModuleLoader.h"
+#include "SharedBuffers.h"
+#include "StorageModule.h"
+#include "Workers.h"
 #include <cstring>
 #include <fstream>
 #include <sstream>
@@ -13,55 +19,44 @@ namespace SCR {
 
     // Static storage
     std::vector<JSThreadInfo> CScripting::threads;
+    std::mutex CScripting::memoryMutex;
+    std::unordered_map<std::string, ArenaStats> CScripting::lastRunMemory;
 
     // Public API
-    void CScripting::RunScriptAsync(FS::ScriptJS *script) {
+    void CScripting::RunScriptAsync(FS::ScriptJS *script, std::function<void()> onDone, bool scheduled) {
         JSThreadInfo info;
         info.script_name = script->name;
         info.running = true;
 
         info.thread =
-                std::async(std::launch::async, [script] { RunScriptJob(script); });
+                std::async(std::launch::async, [script, onDone = std::move(onDone), scheduled] {
+                    RunScriptJob(script, scheduled);
+                    if (onDone)
+                        onDone();
+                });
 
         threads.emplace_back(std::move(info));
     }
 
     void CScripting::PollThreads() {
-        for (auto &t : threads) {
-            if (t.running && t.thread.wait_for(std::chrono::seconds(0)) ==
-                             std::future_status::ready) {
-                t.thread.get();
-                t.running = false;
+        for (auto it = threads.begin(); it != threads.end();) {
+            if (it->thread.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                it->thread.get();
+                it = threads.erase(it);
+            } else {
+                ++it;
             }
         }
     }
 
-    // Job executed in background
-    void CScripting::RunScriptJob(FS::ScriptJS *script) {
-        JSRuntime *rt = JS_NewRuntime();
-        if (!rt) {
-            fmt::print("QuickJS: cannot create runtime\n");
-            return;
-        }
-
-        SCR::register_class(rt);
-        JSContext *ctx = JS_NewContext(rt);
-        if (!ctx) {
-            fmt::print("QuickJS: cannot create context\n");
-            JS_FreeRuntime(rt);
-            return;
-        }
-
-        std::ifstream in(script->fullpath);
-        if (!in) {
-            fmt::print("Cannot open script {}\n", script->fullpath);
-            JS_FreeContext(ctx);
-            JS_FreeRuntime(rt);
-            return;
-        }
-
-        const std::string src{std::istreambuf_iterator<char>(in), {}};
+    std::size_t CScripting::RunningCount() {
+        std::size_t n = 0;
+        for (const auto &t : threads)
+            n += t.running ? 1 : 0;
+        return n;
+    }
 
+    void CScripting::InstallGlobals(JSContext *ctx, FS::ScriptJS *script) {
         // Wire console.log that carries the pointer in this
         JSValue global = JS_GetGlobalObject(ctx);
 
@@ -77,29 +72,99 @@ namespace SCR {
                         JS_NewCFunction(ctx, SCR::js_http_get, "http_get", 1));
 
         SCR::install_ui_object(ctx);
+        CFsModule::Install(ctx);
+        CStorageModule::Install(ctx, script->fullpath);
+        CEventBus::Install(ctx);
+        CSharedBuffers::Install(ctx);
 
         JS_FreeValue(ctx, global);
+    }
 
-        JSValue res = JS_Eval(ctx, src.c_str(), src.size(), script->name.c_str(),
-                            JS_EVAL_TYPE_GLOBAL);
-
-        if (JS_IsException(res)) {
-            JSValue exc = JS_GetException(ctx);
-            const char *msg = JS_ToCString(ctx, exc);
-        {
-            std::lock_guard<std::mutex> lg(script->m); // LOCK here too
-            script->output += "[JS exception] ";
-            script->output += (msg ? msg : "(unable to stringify exception)");
-            script->output += '\n';
-        }
+    JSValue CScripting::EvalSource(JSContext *ctx, const std::string &src, const std::string &path,
+                                   const std::string &name) {
+        return JS_DetectModule(src.c_str(), src.size())
+                       ? CModuleLoader::EvalModule(ctx, path)
+                       : JS_Eval(ctx, src.c_str(), src.size(), name.c_str(), JS_EVAL_TYPE_GLOBAL);
+    }
 
+    void CScripting::ReportException(JSContext *ctx, FS::ScriptJS *script) {
+        JSValue exc = JS_GetException(ctx);
+        const char *msg = JS_ToCString(ctx, exc);
+        ReportError(script, msg ? msg : "(unable to stringify exception)");
         JS_FreeCString(ctx, msg);
         JS_FreeValue(ctx, exc);
-        } else {
-            JS_FreeValue(ctx, res);
+    }
+
+    void CScripting::ReportError(FS::ScriptJS *script, const std::string &message) {
+        LOG_WARN(Script, "{}: [JS exception] {}", script->name, message);
+        std::lock_guard<std::mutex> lg(script->m);
+        script->output += "[JS exception] ";
+        script->output += message;
+        script->output += '\n';
+    }
+
+    bool CScripting::LastRunMemory(const std::string &path, ArenaStats &out) {
+        std::lock_guard<std::mutex> lk(memoryMutex);
+        auto it = lastRunMemory.find(path);
+        if (it == lastRunMemory.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+
+    // Job executed in background
+    void CScripting::RunScriptJob(FS::ScriptJS *script, bool scheduled) {
+        // Everything the runtime allocates comes from here and goes back to
+        // the heap in one piece when the job returns
+        CScriptArena arena;
+        JSRuntime *rt = arena.NewRuntime();
+        if (!rt) {
+            LOG_ERROR(Script, "QuickJS: cannot create runtime");
+            return;
+        }
+
+        SCR::register_class(rt);
+        CModuleLoader::Install(rt);
+        CSharedBuffers::InstallAllocator(rt);
+        JSContext *ctx = JS_NewContext(rt);
+        if (!ctx) {
+            LOG_ERROR(Script, "QuickJS: cannot create context");
+            JS_FreeRuntime(rt);
+            return;
         }
 
+        std::ifstream in(script->fullpath);
+        if (!in) {
+            LOG_ERROR(Script, "Cannot open script {}", script->fullpath);
+            JS_FreeContext(ctx);
+            JS_FreeRuntime(rt);
+            return;
+        }
+
+        const std::string src{std::istreambuf_iterator<char>(in), {}};
+
+        InstallGlobals(ctx, script);
+        CWorkerHost workers(script, scheduled);
+        workers.Install(ctx);
+
+        // Scripts that import or export run as modules, everything else
+        // keeps running as a classic script
+        JSValue res = EvalSource(ctx, src, script->fullpath, script->name);
+        if (JS_IsException(res))
+            ReportException(ctx, script);
+        else
+            JS_FreeValue(ctx, res);
+
+        // Stays alive while it has workers busy
+        workers.Run(ctx);
+
         JS_FreeContext(ctx);
         JS_FreeRuntime(rt);
+
+        const ArenaStats mem = arena.Stats();
+        LOG_DEBUG(Script, "{}: {} allocations ({:.0f}/s), peak {} KiB, {} KiB reserved", script->name,
+                 mem.allocations, mem.AllocationsPerSecond(), mem.peak / 1024, mem.reserved / 1024);
+        std::lock_guard<std::mutex> lk(memoryMutex);
+        lastRunMemory[script->fullpath] = mem;
     }
 }
@@ -1,7 +1,12 @@
 #pragma once
 #include "FS/MainFileSystem.h"
+#include "ScriptArena.h"
+#include <quickjs.h>
+#include <functional>
 #include <future>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 namespace SCR {
@@ -14,13 +19,43 @@ namespace SCR {
 
     class CScripting {
         public:
-            static void RunScriptAsync(FS::ScriptJS *script);
+            // `onDone` runs on the script's thread once the run has finished
+            // `scheduled` for runs the scheduler starts, which must not
+            // subscribe to the bus
+            static void RunScriptAsync(FS::ScriptJS *script, std::function<void()> onDone = {},
+                                       bool scheduled = false);
 
+            // Collects the runs started with RunScriptAsync that finished
             static void PollThreads();
 
+            // Scripts started with RunScriptAsync that have not been polled
+            // as finished yet
+            static std::size_t RunningCount();
+
+            // console and storage (bound to `script`), http_get, the ui object, fs,
+            // bus and shared
+            static void InstallGlobals(JSContext *ctx, FS::ScriptJS *script);
+
+            // Runs a script file's source as a module when it imports or
+            // exports, as a classic script otherwise
+            static JSValue EvalSource(JSContext *ctx, const std::string &src, const std::string &path,
+                                      const std::string &name);
+
+            // Takes the pending exception of `ctx` and reports it in the
+            // log and the script's output
+            static void ReportException(JSContext *ctx, FS::ScriptJS *script);
+            static void ReportError(FS::ScriptJS *script, const std::string &message);
+
+            // Allocator counters of the last finished run of the script at
+            // `path`; false if it has not finished a run yet
+            static bool LastRunMemory(const std::string &path, ArenaStats &out);
+
         private:
-            static void RunScriptJob(FS::ScriptJS *script);
+            static void RunScriptJob(FS::ScriptJS *script, bool scheduled);
 
             static std::vector<JSThreadInfo> threads;
+
+            static std::mutex memoryMutex;
+            static std::unordered_map<std::string, ArenaStats> lastRunMemory;
     };
 }
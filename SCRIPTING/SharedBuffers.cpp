@@ -0,0 +1,168 @@
+#include "SharedBuffers.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+namespace SCR {
+
+    std::mutex CSharedBuffers::m;
+    std::unordered_set<void *> CSharedBuffers::live;
+    std::unordered_map<std::string, CSharedBuffers::Published> CSharedBuffers::names;
+
+    namespace {
+        // In front of the data of every shared block; 16 bytes keeps the
+        // data aligned for any typed array
+        struct alignas(16) SharedBlock {
+            std::atomic<std::size_t> refs;
+        };
+
+        SharedBlock *BlockOf(void *data) { return static_cast<SharedBlock *>(data) - 1; }
+
+        bool ToName(JSContext *ctx, JSValueConst arg, std::string &out) {
+            if (!JS_IsString(arg)) {
+                JS_ThrowTypeError(ctx, "shared: name string expected");
+                return false;
+            }
+            std::size_t n;
+            const char *s = JS_ToCStringLen(ctx, &n, arg);
+            if (!s)
+                return false;
+            out.assign(s, n);
+            JS_FreeCString(ctx, s);
+            return true;
+        }
+    }
+
+    void CSharedBuffers::InstallAllocator(JSRuntime *rt) {
+        JSSharedArrayBufferFunctions funcs{};
+        funcs.sab_alloc = Alloc;
+        funcs.sab_free = Free;
+        funcs.sab_dup = Dup;
+        JS_SetSharedArrayBufferFunctions(rt, &funcs);
+    }
+
+    void CSharedBuffers::Install(JSContext *ctx) {
+        JSValue shared = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, shared, "publish", JS_NewCFunction(ctx, JsPublish, "publish", 2));
+        JS_SetPropertyStr(ctx, shared, "open", JS_NewCFunction(ctx, JsOpen, "open", 1));
+        JS_SetPropertyStr(ctx, shared, "unpublish", JS_NewCFunction(ctx, JsUnpublish, "unpublish", 1));
+        JS_SetPropertyStr(ctx, shared, "names", JS_NewCFunction(ctx, JsNames, "names", 0));
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "shared", shared);
+        JS_FreeValue(ctx, global);
+    }
+
+    void *CSharedBuffers::Alloc(void *, std::size_t size) {
+        void *mem = std::malloc(sizeof(SharedBlock) + size);
+        if (!mem)
+            return nullptr;
+        SharedBlock *block = new (mem) SharedBlock{{1}};
+        void *data = block + 1;
+        std::lock_guard<std::mutex> lk(m);
+        live.insert(data);
+        return data;
+    }
+
+    void CSharedBuffers::Free(void *, void *ptr) {
+        SharedBlock *block = BlockOf(ptr);
+        if (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+            return;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            live.erase(ptr);
+        }
+        block->~SharedBlock();
+        std::free(block);
+    }
+
+    void CSharedBuffers::Dup(void *, void *ptr) {
+        BlockOf(ptr)->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    JSValue CSharedBuffers::JsPublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        std::string name;
+        if (!ToName(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, name))
+            return JS_EXCEPTION;
+        std::size_t size = 0;
+        uint8_t *data = argc > 1 ? JS_GetArrayBuffer(ctx, &size, argv[1]) : nullptr;
+        if (!data)
+            return JS_ThrowTypeError(ctx, "shared: SharedArrayBuffer expected");
+
+        void *replaced = nullptr;
+        bool ours;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            // Plain ArrayBuffers, and anything dressed up as a shared one,
+            // were never handed out by Alloc
+            ours = live.count(data) != 0;
+            if (ours) {
+                Dup(nullptr, data);
+                auto [it, inserted] = names.try_emplace(name, Published{data, size});
+                if (!inserted) {
+                    replaced = it->second.data;
+                    it->second = Published{data, size};
+                }
+            }
+        }
+        if (!ours)
+            return JS_ThrowTypeError(ctx, "shared: SharedArrayBuffer expected");
+        if (replaced)
+            Free(nullptr, replaced);
+        return JS_UNDEFINED;
+    }
+
+    JSValue CSharedBuffers::JsOpen(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        std::string name;
+        if (!ToName(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, name))
+            return JS_EXCEPTION;
+        // Referenced under the lock so the block cannot be unpublished and
+        // freed before the new buffer takes its own reference. Nothing that
+        // can run the GC, and so a finalizer calling Free, happens under it.
+        Published published;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            auto it = names.find(name);
+            if (it == names.end())
+                return JS_NULL;
+            published = it->second;
+            Dup(nullptr, published.data);
+        }
+        JSValue buffer =
+                JS_NewArrayBuffer(ctx, static_cast<uint8_t *>(published.data), published.size, nullptr, nullptr, true);
+        Free(nullptr, published.data);
+        return buffer;
+    }
+
+    JSValue CSharedBuffers::JsUnpublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        std::string name;
+        if (!ToName(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, name))
+            return JS_EXCEPTION;
+        void *data;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            auto it = names.find(name);
+            if (it == names.end())
+                return JS_FALSE;
+            data = it->second.data;
+            names.erase(it);
+        }
+        Free(nullptr, data);
+        return JS_TRUE;
+    }
+
+    JSValue CSharedBuffers::JsNames(JSContext *ctx, JSValueConst, int, JSValueConst *) {
+        std::vector<std::string> list;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            for (const auto &[name, published] : names)
+                list.push_back(name);
+        }
+        JSValue array = JS_NewArray(ctx);
+        uint32_t i = 0;
+        for (const std::string &name : list)
+            JS_SetPropertyUint32(ctx, array, i++, JS_NewStringLen(ctx, name.data(), name.size()));
+        return array;
+    }
+}
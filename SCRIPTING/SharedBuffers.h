@@ -0,0 +1,52 @@
+#pragma once
+#include <quickjs.h>
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace SCR {
+
+    // SharedArrayBuffers that several runtimes can map at once. Their memory
+    // comes from the process heap instead of a script arena, counted by
+    // every runtime mapping it, so it outlives whichever runtime allocated
+    // it. Scripts get a `shared` global to pass them around by name:
+    //
+    //   shared.publish(name, sab)  makes `sab` available under `name`
+    //   shared.open(name)          the same memory in this runtime, or null
+    //   shared.unpublish(name)     true when the name existed
+    //   shared.names()
+    //
+    // A published buffer stays alive while it is published or mapped
+    // anywhere, and Atomics work on it across runtimes, so a worker can fill
+    // a ring that a window reads every frame without any copy. Atomics.wait
+    // stays unavailable: workers share the executor threads and windows run
+    // on the GUI thread, so none of them may block.
+    class CSharedBuffers {
+        public:
+            // Every script runtime, before it runs anything
+            static void InstallAllocator(JSRuntime *rt);
+            static void Install(JSContext *ctx);
+
+        private:
+            static void *Alloc(void *, std::size_t size);
+            static void Free(void *, void *ptr);
+            static void Dup(void *, void *ptr);
+
+            static JSValue JsPublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsOpen(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsUnpublish(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsNames(JSContext *ctx, JSValueConst, int, JSValueConst *);
+
+            struct Published {
+                void *data = nullptr;
+                std::size_t size = 0;
+            };
+
+            // Never held across anything that can run the GC
+            static std::mutex m;
+            static std::unordered_set<void *> live; // data of every block not yet freed
+            static std::unordered_map<std::string, Published> names;
+    };
+}
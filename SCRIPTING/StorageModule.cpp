@@ -0,0 +1,164 @@
+#include "StorageModule.h"
+#include "../UTILS/Logger.h"
+#include "FS/LogStore.h"
+#include "FS/MainFileSystem.h"
+#include "StructuredClone.h"
+#include <filesystem>
+#include <memory>
+#include <mutex>
+
+namespace SCR {
+
+    namespace {
+        // Keys are stored as "<script path>\0<key>", the path relative to
+        // the Scripts folder so moving the Buddy folder keeps them
+        bool StoreKey(JSContext *ctx, JSValueConst prefix, int argc, JSValueConst *argv, std::string &out) {
+            if (argc < 1 || !JS_IsString(argv[0])) {
+                JS_ThrowTypeError(ctx, "storage: key string expected");
+                return false;
+            }
+            std::size_t pn, kn;
+            const char *p = JS_ToCStringLen(ctx, &pn, prefix);
+            const char *k = p ? JS_ToCStringLen(ctx, &kn, argv[0]) : nullptr;
+            if (k) {
+                out.assign(p, pn);
+                out.append(k, kn);
+            }
+            JS_FreeCString(ctx, p);
+            JS_FreeCString(ctx, k);
+            return k != nullptr;
+        }
+
+        FS::CLogStore *StoreOrThrow(JSContext *ctx) {
+            FS::CLogStore *store = CStorageModule::Store();
+            if (!store)
+                JS_ThrowInternalError(ctx, "storage: the store could not be opened");
+            return store;
+        }
+
+        struct Function {
+            const char *name;
+            JSCFunctionData *func;
+            int length;
+        };
+    }
+
+    FS::CLogStore *CStorageModule::Store() {
+        static std::once_flag once;
+        static std::unique_ptr<FS::CLogStore> store;
+        std::call_once(once, [] {
+            auto s = std::make_unique<FS::CLogStore>(FS::CFileSystem::GetBaseFolderLocation() / "Storage" / "scripts.log");
+            std::string error;
+            if (s->Open(error))
+                store = std::move(s);
+            else
+                LOG_ERROR(Script, "Script storage unavailable: {}", error);
+        });
+        return store.get();
+    }
+
+    void CStorageModule::Install(JSContext *ctx, const std::string &scriptPath) {
+        static const Function functions[] = {
+                {"get", JsGet, 1},
+                {"set", JsSet, 2},
+                {"delete", JsDelete, 1},
+                {"has", JsHas, 1},
+                {"keys", JsKeys, 0},
+                {"flush", JsFlush, 0},
+        };
+        const std::filesystem::path relative =
+                std::filesystem::path(scriptPath).lexically_relative(FS::CFileSystem::GetScriptFolderLocation());
+        std::string prefix = relative.empty() || *relative.begin() == ".." ? scriptPath : relative.generic_string();
+        prefix.push_back('\0');
+        JSValue data = JS_NewStringLen(ctx, prefix.data(), prefix.size());
+
+        JSValue storage = JS_NewObject(ctx);
+        for (const Function &f : functions)
+            JS_SetPropertyStr(ctx, storage, f.name, JS_NewCFunctionData(ctx, f.func, f.length, 0, 1, &data));
+        JS_FreeValue(ctx, data);
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "storage", storage);
+        JS_FreeValue(ctx, global);
+    }
+
+    JSValue CStorageModule::JsGet(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data) {
+        std::string key;
+        if (!StoreKey(ctx, data[0], argc, argv, key))
+            return JS_EXCEPTION;
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+
+        ClonedValue value;
+        if (!store->Get(key, value.data))
+            return JS_UNDEFINED;
+        return CStructuredClone::Deserialize(ctx, value);
+    }
+
+    JSValue CStorageModule::JsSet(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data) {
+        std::string key;
+        if (!StoreKey(ctx, data[0], argc, argv, key))
+            return JS_EXCEPTION;
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+
+        ClonedValue value;
+        if (!CStructuredClone::Serialize(ctx, argc > 1 ? argv[1] : JS_UNDEFINED, JS_UNDEFINED, value))
+            return JS_EXCEPTION;
+        if (key.size() > FS::CLogStore::kMaxKeySize || value.data.size() > FS::CLogStore::kMaxValueSize)
+            return JS_ThrowRangeError(ctx, "storage: key or value too large");
+        if (!store->Put(key, value.data))
+            return JS_ThrowInternalError(ctx, "storage: write failed");
+        return JS_UNDEFINED;
+    }
+
+    JSValue CStorageModule::JsDelete(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data) {
+        std::string key;
+        if (!StoreKey(ctx, data[0], argc, argv, key))
+            return JS_EXCEPTION;
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+        return JS_NewBool(ctx, store->Remove(key));
+    }
+
+    JSValue CStorageModule::JsHas(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data) {
+        std::string key;
+        if (!StoreKey(ctx, data[0], argc, argv, key))
+            return JS_EXCEPTION;
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+        return JS_NewBool(ctx, store->Contains(key));
+    }
+
+    JSValue CStorageModule::JsKeys(JSContext *ctx, JSValueConst, int, JSValueConst *, int, JSValue *data) {
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+        std::size_t pn;
+        const char *p = JS_ToCStringLen(ctx, &pn, data[0]);
+        if (!p)
+            return JS_EXCEPTION;
+        const std::string prefix(p, pn);
+        JS_FreeCString(ctx, p);
+
+        JSValue keys = JS_NewArray(ctx);
+        uint32_t i = 0;
+        for (const std::string &key : store->Keys(prefix))
+            JS_SetPropertyUint32(ctx, keys, i++,
+                                 JS_NewStringLen(ctx, key.data() + prefix.size(), key.size() - prefix.size()));
+        return keys;
+    }
+
+    JSValue CStorageModule::JsFlush(JSContext *ctx, JSValueConst, int, JSValueConst *, int, JSValue *) {
+        FS::CLogStore *store = StoreOrThrow(ctx);
+        if (!store)
+            return JS_EXCEPTION;
+        if (!store->Sync())
+            return JS_ThrowInternalError(ctx, "storage: flush failed");
+        return JS_UNDEFINED;
+    }
+}
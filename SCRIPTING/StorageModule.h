@@ -0,0 +1,41 @@
+#pragma once
+#include <quickjs.h>
+#include <string>
+
+namespace FS {
+    class CLogStore;
+}
+
+namespace SCR {
+
+    // The `storage` global: values that outlive the script run, kept in one
+    // log store under the Buddy folder that every script shares.
+    //
+    //   get(key)         the stored value, or undefined
+    //   set(key, value)  stores anything postMessage could send
+    //   delete(key)      true when the key existed
+    //   has(key), keys()
+    //   flush()          waits until everything set so far is on disk
+    //
+    // Each script sees only its own keys, scoped by its path under the
+    // Scripts folder, so two scripts with the same file name in different
+    // folders stay apart; its workers share them. Values
+    // are kept in structured clone form, so objects, Maps, Dates and
+    // ArrayBuffers come back as they went in.
+    class CStorageModule {
+        public:
+            // `scriptPath` is the script's full path
+            static void Install(JSContext *ctx, const std::string &scriptPath);
+
+            // Opened on first use; null when the log cannot be opened
+            static FS::CLogStore *Store();
+
+        private:
+            static JSValue JsGet(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data);
+            static JSValue JsSet(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data);
+            static JSValue JsDelete(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data);
+            static JSValue JsHas(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv, int, JSValue *data);
+            static JSValue JsKeys(JSContext *ctx, JSValueConst, int, JSValueConst *, int, JSValue *data);
+            static JSValue JsFlush(JSContext *ctx, JSValueConst, int, JSValueConst *, int, JSValue *);
+    };
+}
@@ -0,0 +1,720 @@
+#include "StructuredClone.h"
+#include "ScriptArena.h"
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
+
+namespace SCR {
+
+    namespace {
+        enum class Tag : uint8_t {
+            Undefined,
+            Null,
+            False,
+            True,
+            Int32,
+            Float64,
+            String,
+            Ref, // an object already written, by index
+            Array,
+            Object,
+            Date,
+            Error,
+            Map,
+            Set,
+            ArrayBuffer,
+            Transferred, // index into ClonedValue::buffers
+            TypedArray,
+            DataView,
+        };
+
+        const char *const kTypedArrays[] = {"Int8Array",    "Uint8Array",   "Uint8ClampedArray", "Int16Array",
+                                            "Uint16Array",  "Int32Array",   "Uint32Array",       "Float32Array",
+                                            "Float64Array", "BigInt64Array", "BigUint64Array"};
+        constexpr int kTypedArrayCount = (int)std::size(kTypedArrays);
+
+        const char *const kErrors[] = {"Error",          "EvalError",   "RangeError", "ReferenceError",
+                                       "SyntaxError",    "TypeError",   "URIError",   "AggregateError"};
+
+        JSValue GetGlobal(JSContext *ctx, const char *name) {
+            JSValue global = JS_GetGlobalObject(ctx);
+            JSValue v = JS_GetPropertyStr(ctx, global, name);
+            JS_FreeValue(ctx, global);
+            return v;
+        }
+
+        bool ThrowUncloneable(JSContext *ctx, const char *what) {
+            JS_ThrowTypeError(ctx, "DataCloneError: %s could not be cloned", what);
+            return false;
+        }
+
+        class Writer {
+            public:
+                Writer(JSContext *ctx, std::string &out) : ctx(ctx), out(out) {
+                    JSValue object = GetGlobal(ctx, "Object");
+                    objectProto = JS_GetPropertyStr(ctx, object, "prototype");
+                    toString = JS_GetPropertyStr(ctx, objectProto, "toString");
+                    JS_FreeValue(ctx, object);
+                    JSValue array = GetGlobal(ctx, "Array");
+                    arrayFrom = JS_GetPropertyStr(ctx, array, "from");
+                    JS_FreeValue(ctx, array);
+                }
+
+                ~Writer() {
+                    JS_FreeValue(ctx, objectProto);
+                    JS_FreeValue(ctx, toString);
+                    JS_FreeValue(ctx, arrayFrom);
+                    for (auto &[key, entry] : seen)
+                        JS_FreeValue(ctx, entry.object);
+                }
+
+                Writer(const Writer &) = delete;
+                Writer &operator=(const Writer &) = delete;
+
+                // Object.prototype.toString's "[object X]" without the brackets
+                std::string ClassOf(JSValueConst v) {
+                    JSValue tag = JS_Call(ctx, toString, v, 0, nullptr);
+                    std::string cls;
+                    if (const char *s = JS_IsException(tag) ? nullptr : JS_ToCString(ctx, tag)) {
+                        cls = s;
+                        JS_FreeCString(ctx, s);
+                    }
+                    JS_FreeValue(ctx, tag);
+                    if (cls.size() > 9 && cls.compare(0, 8, "[object ") == 0)
+                        return cls.substr(8, cls.size() - 9);
+                    return cls;
+                }
+
+                bool Write(JSValueConst v, int depth) {
+                    switch (JS_VALUE_GET_TAG(v)) {
+                        case JS_TAG_UNDEFINED:
+                            PutTag(Tag::Undefined);
+                            return true;
+                        case JS_TAG_NULL:
+                            PutTag(Tag::Null);
+                            return true;
+                        case JS_TAG_BOOL:
+                            PutTag(JS_VALUE_GET_BOOL(v) ? Tag::True : Tag::False);
+                            return true;
+                        case JS_TAG_INT:
+                            PutTag(Tag::Int32);
+                            Put<int32_t>(JS_VALUE_GET_INT(v));
+                            return true;
+                        case JS_TAG_FLOAT64:
+                            PutTag(Tag::Float64);
+                            Put<double>(JS_VALUE_GET_FLOAT64(v));
+                            return true;
+                        case JS_TAG_STRING:
+                            PutTag(Tag::String);
+                            return PutString(v);
+                        case JS_TAG_OBJECT:
+                            return WriteObject(v, depth);
+                        case JS_TAG_BIG_INT:
+                            return ThrowUncloneable(ctx, "a BigInt");
+                        default:
+                            return ThrowUncloneable(ctx, "this value");
+                    }
+                }
+
+                // ArrayBuffer objects of the transfer list, by object
+                std::unordered_map<void *, uint32_t> transfers;
+
+            private:
+                void Put(const void *p, std::size_t n) { out.append((const char *)p, n); }
+                template <typename T> void Put(T v) { Put(&v, sizeof(v)); }
+                void PutTag(Tag tag) { Put<uint8_t>((uint8_t)tag); }
+
+                bool PutString(JSValueConst v) {
+                    std::size_t n;
+                    const char *s = JS_ToCStringLen(ctx, &n, v);
+                    if (!s)
+                        return false;
+                    Put<uint32_t>((uint32_t)n);
+                    Put(s, n);
+                    JS_FreeCString(ctx, s);
+                    return true;
+                }
+
+                bool PutProperty(JSValueConst obj, const char *name) {
+                    JSValue v = JS_GetPropertyStr(ctx, obj, name);
+                    bool ok = !JS_IsException(v);
+                    if (ok) {
+                        JSValue s = JS_IsUndefined(v) ? JS_NewString(ctx, "") : JS_ToString(ctx, v);
+                        ok = !JS_IsException(s) && PutString(s);
+                        JS_FreeValue(ctx, s);
+                    }
+                    JS_FreeValue(ctx, v);
+                    return ok;
+                }
+
+                bool WriteObject(JSValueConst v, int depth) {
+                    if (depth > CStructuredClone::kMaxDepth) {
+                        JS_ThrowRangeError(ctx, "DataCloneError: object nested too deeply");
+                        return false;
+                    }
+
+                    // Shared and cyclic references come out as shared again.
+                    // Getters and proxies can hand out objects nothing else
+                    // holds, so each one is kept alive until the walk ends,
+                    // or a later object could reuse its address.
+                    void *key = JS_VALUE_GET_PTR(v);
+                    auto [it, fresh] = seen.emplace(key, Seen{(uint32_t)seen.size(), JS_UNDEFINED});
+                    if (!fresh) {
+                        PutTag(Tag::Ref);
+                        Put<uint32_t>(it->second.index);
+                        return true;
+                    }
+                    it->second.object = JS_DupValue(ctx, v);
+
+                    if (JS_IsFunction(ctx, v))
+                        return ThrowUncloneable(ctx, "a function");
+
+                    const int isArray = JS_IsArray(ctx, v);
+                    if (isArray < 0)
+                        return false;
+                    if (isArray)
+                        return WriteArray(v, depth);
+
+                    // Plain objects are by far the most common, and need no
+                    // toString call to tell apart
+                    JSValue proto = JS_GetPrototype(ctx, v);
+                    if (JS_IsException(proto))
+                        return false;
+                    const bool plain = JS_VALUE_GET_PTR(proto) == JS_VALUE_GET_PTR(objectProto);
+                    JS_FreeValue(ctx, proto);
+                    if (plain)
+                        return WriteProperties(v, depth);
+
+                    const std::string cls = ClassOf(v);
+                    if (cls == "ArrayBuffer")
+                        return WriteArrayBuffer(v, key);
+                    if (cls == "Date") {
+                        double t;
+                        // The internal time value; JS_ToFloat64 would call
+                        // a valueOf the script may have replaced
+                        if (JS_GetTimeValue(ctx, v, &t) < 0)
+                            return false;
+                        PutTag(Tag::Date);
+                        Put<double>(t);
+                        return true;
+                    }
+                    if (cls == "Error") {
+                        PutTag(Tag::Error);
+                        return PutProperty(v, "name") && PutProperty(v, "message");
+                    }
+                    if (cls == "Map" || cls == "Set")
+                        return WriteCollection(v, cls == "Map", depth);
+                    if (cls == "DataView") {
+                        int64_t offset, length;
+                        JSValue off = JS_GetPropertyStr(ctx, v, "byteOffset");
+                        JSValue len = JS_GetPropertyStr(ctx, v, "byteLength");
+                        const bool ok = JS_ToInt64(ctx, &offset, off) == 0 && JS_ToInt64(ctx, &length, len) == 0;
+                        JS_FreeValue(ctx, off);
+                        JS_FreeValue(ctx, len);
+                        if (!ok)
+                            return false;
+                        PutTag(Tag::DataView);
+                        Put<uint64_t>((uint64_t)offset);
+                        Put<uint64_t>((uint64_t)length);
+                        JSValue buffer = JS_GetPropertyStr(ctx, v, "buffer");
+                        const bool written = !JS_IsException(buffer) && Write(buffer, depth + 1);
+                        JS_FreeValue(ctx, buffer);
+                        return written;
+                    }
+                    for (int kind = 0; kind < kTypedArrayCount; kind++) {
+                        if (cls != kTypedArrays[kind])
+                            continue;
+                        std::size_t offset, length, elementSize;
+                        JSValue buffer = JS_GetTypedArrayBuffer(ctx, v, &offset, &length, &elementSize);
+                        if (JS_IsException(buffer))
+                            return false;
+                        PutTag(Tag::TypedArray);
+                        Put<uint8_t>((uint8_t)kind);
+                        Put<uint64_t>(offset);
+                        Put<uint64_t>(length / elementSize);
+                        const bool written = Write(buffer, depth + 1);
+                        JS_FreeValue(ctx, buffer);
+                        return written;
+                    }
+                    // Class instances and objects without a prototype clone
+                    // as plain objects, as in a browser
+                    if (cls == "Object" || cls == "Arguments")
+                        return WriteProperties(v, depth);
+                    return ThrowUncloneable(ctx, cls.empty() ? "this object" : cls.c_str());
+                }
+
+                bool WriteArray(JSValueConst v, int depth) {
+                    JSValue lengthValue = JS_GetPropertyStr(ctx, v, "length");
+                    uint32_t length;
+                    const int r = JS_ToUint32(ctx, &length, lengthValue);
+                    JS_FreeValue(ctx, lengthValue);
+                    if (r < 0)
+                        return false;
+
+                    PutTag(Tag::Array);
+                    Put<uint32_t>(length);
+                    for (uint32_t i = 0; i < length; i++) {
+                        JSValue item = JS_GetPropertyUint32(ctx, v, i);
+                        const bool ok = !JS_IsException(item) && Write(item, depth + 1);
+                        JS_FreeValue(ctx, item);
+                        if (!ok)
+                            return false;
+                    }
+                    return true;
+                }
+
+                bool WriteProperties(JSValueConst v, int depth) {
+                    JSPropertyEnum *props;
+                    uint32_t count;
+                    if (JS_GetOwnPropertyNames(ctx, &props, &count, v, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0)
+                        return false;
+
+                    PutTag(Tag::Object);
+                    Put<uint32_t>(count);
+                    bool ok = true;
+                    for (uint32_t i = 0; i < count; i++) {
+                        if (ok) {
+                            JSValue name = JS_AtomToString(ctx, props[i].atom);
+                            ok = !JS_IsException(name) && PutString(name);
+                            JS_FreeValue(ctx, name);
+                        }
+                        if (ok) {
+                            JSValue item = JS_GetProperty(ctx, v, props[i].atom);
+                            ok = !JS_IsException(item) && Write(item, depth + 1);
+                            JS_FreeValue(ctx, item);
+                        }
+                        JS_FreeAtom(ctx, props[i].atom);
+                    }
+                    js_free(ctx, props);
+                    return ok;
+                }
+
+                bool WriteArrayBuffer(JSValueConst v, void *key) {
+                    auto t = transfers.find(key);
+                    if (t != transfers.end()) {
+                        PutTag(Tag::Transferred);
+                        Put<uint32_t>(t->second);
+                        return true;
+                    }
+                    std::size_t length;
+                    const uint8_t *data = JS_GetArrayBuffer(ctx, &length, v);
+                    if (!data)
+                        return false;
+                    PutTag(Tag::ArrayBuffer);
+                    Put<uint64_t>(length);
+                    Put(data, length);
+                    return true;
+                }
+
+                bool WriteCollection(JSValueConst v, bool map, int depth) {
+                    // Array.from gives the entries, or the values of a Set
+                    JSValue items = JS_Call(ctx, arrayFrom, JS_UNDEFINED, 1, &v);
+                    if (JS_IsException(items))
+                        return false;
+                    JSValue lengthValue = JS_GetPropertyStr(ctx, items, "length");
+                    uint32_t length = 0;
+                    bool ok = JS_ToUint32(ctx, &length, lengthValue) == 0;
+                    JS_FreeValue(ctx, lengthValue);
+
+                    if (ok) {
+                        PutTag(map ? Tag::Map : Tag::Set);
+                        Put<uint32_t>(length);
+                    }
+                    for (uint32_t i = 0; ok && i < length; i++) {
+                        JSValue item = JS_GetPropertyUint32(ctx, items, i);
+                        if (map) {
+                            JSValue k = JS_GetPropertyUint32(ctx, item, 0);
+                            JSValue val = JS_GetPropertyUint32(ctx, item, 1);
+                            ok = Write(k, depth + 1) && Write(val, depth + 1);
+                            JS_FreeValue(ctx, k);
+                            JS_FreeValue(ctx, val);
+                        } else {
+                            ok = Write(item, depth + 1);
+                        }
+                        JS_FreeValue(ctx, item);
+                    }
+                    JS_FreeValue(ctx, items);
+                    return ok;
+                }
+
+                JSContext *ctx;
+                std::string &out;
+                JSValue objectProto, toString, arrayFrom;
+                struct Seen {
+                    uint32_t index;
+                    JSValue object; // a reference, so the address stays taken
+                };
+                std::unordered_map<void *, Seen> seen;
+        };
+
+        class Reader {
+            public:
+                Reader(JSContext *ctx, std::string_view data, std::vector<std::pair<uint8_t *, std::size_t>> *buffers)
+                    : ctx(ctx), data(data), buffers(buffers) {}
+
+                ~Reader() {
+                    for (JSValue v : objects)
+                        JS_FreeValue(ctx, v);
+                    for (auto &[name, ctor] : constructors)
+                        JS_FreeValue(ctx, ctor);
+                }
+
+                Reader(const Reader &) = delete;
+                Reader &operator=(const Reader &) = delete;
+
+                JSValue Read(int depth) {
+                    uint8_t tag;
+                    if (depth > CStructuredClone::kMaxDepth || !Get(tag))
+                        return Corrupt();
+
+                    switch ((Tag)tag) {
+                        case Tag::Undefined:
+                            return JS_UNDEFINED;
+                        case Tag::Null:
+                            return JS_NULL;
+                        case Tag::False:
+                            return JS_FALSE;
+                        case Tag::True:
+                            return JS_TRUE;
+                        case Tag::Int32: {
+                            int32_t i;
+                            return Get(i) ? JS_NewInt32(ctx, i) : Corrupt();
+                        }
+                        case Tag::Float64: {
+                            double d;
+                            return Get(d) ? JS_NewFloat64(ctx, d) : Corrupt();
+                        }
+                        case Tag::String:
+                            return ReadString();
+                        case Tag::Ref: {
+                            uint32_t index;
+                            if (!Get(index) || index >= objects.size() || JS_IsUndefined(objects[index]))
+                                return Corrupt();
+                            return JS_DupValue(ctx, objects[index]);
+                        }
+                        case Tag::Array:
+                            return ReadArray(depth);
+                        case Tag::Object:
+                            return ReadObject(depth);
+                        case Tag::Date: {
+                            double t;
+                            if (!Get(t))
+                                return Corrupt();
+                            JSValue arg = JS_NewFloat64(ctx, t);
+                            return Register(Construct("Date", 1, &arg));
+                        }
+                        case Tag::Error:
+                            return ReadError();
+                        case Tag::Map:
+                        case Tag::Set:
+                            return ReadCollection((Tag)tag == Tag::Map, depth);
+                        case Tag::ArrayBuffer: {
+                            uint64_t length;
+                            if (!Get(length) || length > data.size() - pos)
+                                return Corrupt();
+                            JSValue buffer =
+                                    JS_NewArrayBufferCopy(ctx, (const uint8_t *)data.data() + pos, length);
+                            pos += length;
+                            return Register(buffer);
+                        }
+                        case Tag::Transferred: {
+                            uint32_t index;
+                            if (!Get(index) || !buffers || index >= buffers->size() || !(*buffers)[index].first)
+                                return Corrupt();
+                            auto &[block, length] = (*buffers)[index];
+                            JSValue buffer =
+                                    JS_NewArrayBuffer(ctx, block, length, CScriptArena::FreeTransferred, nullptr, false);
+                            // Still ours to free if the runtime could not take it
+                            if (!JS_IsException(buffer))
+                                block = nullptr;
+                            return Register(buffer);
+                        }
+                        case Tag::TypedArray:
+                        case Tag::DataView:
+                            return ReadView((Tag)tag, depth);
+                    }
+                    return Corrupt();
+                }
+
+            private:
+                template <typename T> bool Get(T &v) {
+                    if (data.size() - pos < sizeof(T))
+                        return false;
+                    std::memcpy(&v, data.data() + pos, sizeof(T));
+                    pos += sizeof(T);
+                    return true;
+                }
+
+                JSValue Corrupt() { return JS_ThrowInternalError(ctx, "corrupt structured clone data"); }
+
+                // Objects are numbered in the order the writer met them, so
+                // each one takes its slot before its children are read
+                JSValue Register(JSValue v) {
+                    if (!JS_IsException(v))
+                        objects.push_back(JS_DupValue(ctx, v));
+                    return v;
+                }
+
+                JSValue Construct(const char *name, int argc, JSValue *argv) {
+                    auto it = constructors.find(name);
+                    if (it == constructors.end())
+                        it = constructors.emplace(name, GetGlobal(ctx, name)).first;
+                    JSValue v = JS_CallConstructor(ctx, it->second, argc, argv);
+                    for (int i = 0; i < argc; i++)
+                        JS_FreeValue(ctx, argv[i]);
+                    return v;
+                }
+
+                JSValue ReadString() {
+                    uint32_t length;
+                    if (!Get(length) || length > data.size() - pos)
+                        return Corrupt();
+                    JSValue s = JS_NewStringLen(ctx, data.data() + pos, length);
+                    pos += length;
+                    return s;
+                }
+
+                JSValue ReadArray(int depth) {
+                    uint32_t length;
+                    if (!Get(length))
+                        return Corrupt();
+                    JSValue array = Register(JS_NewArray(ctx));
+                    for (uint32_t i = 0; i < length && !JS_IsException(array); i++) {
+                        JSValue item = Read(depth + 1);
+                        if (JS_IsException(item) ||
+                            JS_DefinePropertyValueUint32(ctx, array, i, item, JS_PROP_C_W_E) < 0) {
+                            JS_FreeValue(ctx, array);
+                            return JS_EXCEPTION;
+                        }
+                    }
+                    return array;
+                }
+
+                JSValue ReadObject(int depth) {
+                    uint32_t count;
+                    if (!Get(count))
+                        return Corrupt();
+                    JSValue obj = Register(JS_NewObject(ctx));
+                    for (uint32_t i = 0; i < count && !JS_IsException(obj); i++) {
+                        uint32_t length;
+                        if (!Get(length) || length > data.size() - pos) {
+                            JS_FreeValue(ctx, obj);
+                            return Corrupt();
+                        }
+                        JSAtom name = JS_NewAtomLen(ctx, data.data() + pos, length);
+                        pos += length;
+                        JSValue item = Read(depth + 1);
+                        const bool ok = name != JS_ATOM_NULL && !JS_IsException(item) &&
+                                        JS_DefinePropertyValue(ctx, obj, name, item, JS_PROP_C_W_E) >= 0;
+                        if (name == JS_ATOM_NULL || JS_IsException(item))
+                            JS_FreeValue(ctx, item);
+                        JS_FreeAtom(ctx, name);
+                        if (!ok) {
+                            JS_FreeValue(ctx, obj);
+                            return JS_EXCEPTION;
+                        }
+                    }
+                    return obj;
+                }
+
+                JSValue ReadError() {
+                    JSValue name = ReadString();
+                    if (JS_IsException(name))
+                        return name;
+                    JSValue message = ReadString();
+                    if (JS_IsException(message)) {
+                        JS_FreeValue(ctx, name);
+                        return message;
+                    }
+
+                    const char *n = JS_ToCString(ctx, name);
+                    const char *ctor = "Error";
+                    for (const char *known : kErrors)
+                        if (n && std::strcmp(n, known) == 0)
+                            ctor = known;
+                    const bool custom = !n || std::strcmp(n, ctor) != 0;
+                    JS_FreeCString(ctx, n);
+
+                    JSValue error = Register(Construct(ctor, 1, &message));
+                    if (custom && !JS_IsException(error))
+                        JS_DefinePropertyValueStr(ctx, error, "name", JS_DupValue(ctx, name),
+                                                  JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+                    JS_FreeValue(ctx, name);
+                    return error;
+                }
+
+                JSValue ReadCollection(bool map, int depth) {
+                    uint32_t length;
+                    if (!Get(length))
+                        return Corrupt();
+                    JSValue collection = Register(Construct(map ? "Map" : "Set", 0, nullptr));
+                    if (JS_IsException(collection))
+                        return collection;
+                    JSValue add = JS_GetPropertyStr(ctx, collection, map ? "set" : "add");
+                    for (uint32_t i = 0; i < length; i++) {
+                        JSValue args[2] = {Read(depth + 1), JS_UNDEFINED};
+                        if (map && !JS_IsException(args[0]))
+                            args[1] = Read(depth + 1);
+                        JSValue r = JS_IsException(args[0]) || JS_IsException(args[1])
+                                            ? JS_EXCEPTION
+                                            : JS_Call(ctx, add, collection, map ? 2 : 1, args);
+                        JS_FreeValue(ctx, args[0]);
+                        JS_FreeValue(ctx, args[1]);
+                        if (JS_IsException(r)) {
+                            JS_FreeValue(ctx, add);
+                            JS_FreeValue(ctx, collection);
+                            return JS_EXCEPTION;
+                        }
+                        JS_FreeValue(ctx, r);
+                    }
+                    JS_FreeValue(ctx, add);
+                    return collection;
+                }
+
+                JSValue ReadView(Tag tag, int depth) {
+                    uint8_t kind = 0;
+                    uint64_t offset, length;
+                    if ((tag == Tag::TypedArray && (!Get(kind) || kind >= kTypedArrayCount)) || !Get(offset) ||
+                        !Get(length))
+                        return Corrupt();
+
+                    // The view's slot comes before its buffer's
+                    const std::size_t slot = objects.size();
+                    objects.push_back(JS_UNDEFINED);
+                    JSValue buffer = Read(depth + 1);
+                    if (JS_IsException(buffer))
+                        return buffer;
+                    JSValue args[3] = {buffer, JS_NewInt64(ctx, (int64_t)offset), JS_NewInt64(ctx, (int64_t)length)};
+                    JSValue view = Construct(tag == Tag::DataView ? "DataView" : kTypedArrays[kind], 3, args);
+                    if (!JS_IsException(view))
+                        objects[slot] = JS_DupValue(ctx, view);
+                    return view;
+                }
+
+                JSContext *ctx;
+                std::string_view data;
+                std::vector<std::pair<uint8_t *, std::size_t>> *buffers; // null when nothing was transferred
+                std::size_t pos = 0;
+                std::vector<JSValue> objects;
+                std::unordered_map<std::string, JSValue> constructors;
+        };
+    }
+
+    ClonedValue::ClonedValue(ClonedValue &&other) noexcept
+        : data(std::move(other.data)), buffers(std::move(other.buffers)) {
+        other.buffers.clear();
+    }
+
+    ClonedValue &ClonedValue::operator=(ClonedValue &&other) noexcept {
+        if (this != &other) {
+            Reset();
+            data = std::move(other.data);
+            buffers = std::move(other.buffers);
+            other.buffers.clear();
+        }
+        return *this;
+    }
+
+    ClonedValue::~ClonedValue() {
+        Reset();
+    }
+
+    void ClonedValue::Reset() {
+        for (auto &[ptr, length] : buffers)
+            CScriptArena::FreeTransferred(nullptr, nullptr, ptr);
+        buffers.clear();
+        data.clear();
+    }
+
+    bool CStructuredClone::Serialize(JSContext *ctx, JSValueConst value, JSValueConst transfer, ClonedValue &out) {
+        out.Reset();
+        Writer writer(ctx, out.data);
+
+        std::vector<JSValue> transferred;
+        auto fail = [&] {
+            for (JSValue v : transferred)
+                JS_FreeValue(ctx, v);
+            out.Reset();
+            return false;
+        };
+
+        if (!JS_IsUndefined(transfer)) {
+            const int isArray = JS_IsArray(ctx, transfer);
+            if (isArray <= 0) {
+                if (isArray == 0)
+                    JS_ThrowTypeError(ctx, "transfer list must be an array");
+                return fail();
+            }
+            JSValue lengthValue = JS_GetPropertyStr(ctx, transfer, "length");
+            uint32_t length;
+            const int r = JS_ToUint32(ctx, &length, lengthValue);
+            JS_FreeValue(ctx, lengthValue);
+            if (r < 0)
+                return fail();
+
+            for (uint32_t i = 0; i < length; i++) {
+                JSValue item = JS_GetPropertyUint32(ctx, transfer, i);
+                transferred.push_back(item);
+                if (JS_IsException(item))
+                    return fail();
+                if (JS_VALUE_GET_TAG(item) != JS_TAG_OBJECT || writer.ClassOf(item) != "ArrayBuffer") {
+                    JS_ThrowTypeError(ctx, "DataCloneError: only ArrayBuffers can be transferred");
+                    return fail();
+                }
+                if (!writer.transfers.emplace(JS_VALUE_GET_PTR(item), i).second) {
+                    JS_ThrowTypeError(ctx, "DataCloneError: ArrayBuffer listed twice in the transfer list");
+                    return fail();
+                }
+            }
+        }
+
+        if (!writer.Write(value, 0))
+            return fail();
+
+        // Getters ran during the walk, so check again that every buffer is
+        // still attached before any of them is touched
+        std::vector<std::pair<uint8_t *, std::size_t>> sources;
+        for (JSValue v : transferred) {
+            std::size_t length;
+            uint8_t *data = JS_GetArrayBuffer(ctx, &length, v);
+            if (!data)
+                return fail();
+            sources.emplace_back(data, length);
+        }
+
+        // Small buffers live inside arena chunks and are copied; large ones
+        // change owner without their bytes being touched
+        for (auto &[data, length] : sources) {
+            if (CScriptArena::CanTransfer(data)) {
+                out.buffers.emplace_back(nullptr, length);
+                continue;
+            }
+            auto *copy = (uint8_t *)CScriptArena::NewTransferBlock(length);
+            if (!copy) {
+                JS_ThrowOutOfMemory(ctx);
+                return fail();
+            }
+            std::memcpy(copy, data, length);
+            out.buffers.emplace_back(copy, length);
+        }
+        for (std::size_t i = 0; i < transferred.size(); i++) {
+            if (!out.buffers[i].first) {
+                CScriptArena::BeginTransfer(sources[i].first);
+                out.buffers[i].first = sources[i].first;
+            }
+            JS_DetachArrayBuffer(ctx, transferred[i]);
+            JS_FreeValue(ctx, transferred[i]);
+        }
+        return true;
+    }
+
+    JSValue CStructuredClone::Deserialize(JSContext *ctx, ClonedValue &in) {
+        Reader reader(ctx, in.data, &in.buffers);
+        return reader.Read(0);
+    }
+
+    JSValue CStructuredClone::Deserialize(JSContext *ctx, std::string_view data) {
+        Reader reader(ctx, data, nullptr);
+        return reader.Read(0);
+    }
+}
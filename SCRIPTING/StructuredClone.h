@@ -0,0 +1,52 @@
+#pragma once
+#include <quickjs.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace SCR {
+
+    // A value taken out of one runtime so it can be recreated in another,
+    // possibly on a different thread. Holds the ArrayBuffer memory that was
+    // transferred with it until Deserialize hands it to the new runtime.
+    struct ClonedValue {
+        std::string data;
+        std::vector<std::pair<uint8_t *, std::size_t>> buffers;
+
+        ClonedValue() = default;
+        ClonedValue(ClonedValue &&other) noexcept;
+        ClonedValue &operator=(ClonedValue &&other) noexcept;
+        ClonedValue(const ClonedValue &) = delete;
+        ClonedValue &operator=(const ClonedValue &) = delete;
+        ~ClonedValue();
+
+        void Reset();
+    };
+
+    // Structured clone for postMessage: primitives, strings, arrays, plain
+    // objects, Date, Error, Map, Set, ArrayBuffer, typed arrays and DataView,
+    // with shared and cyclic references kept. Everything is written into
+    // one flat buffer in a single pass, so a message costs one allocation
+    // plus one per transferred buffer however large the object graph is.
+    //
+    // ArrayBuffers named in the transfer list are not copied: their memory
+    // moves into the ClonedValue and they are detached in the sender, the
+    // same as in a browser. Functions, symbols, SharedArrayBuffers and other
+    // host objects cannot be cloned.
+    class CStructuredClone {
+        public:
+            // `ctx` must belong to an arena runtime; throws and returns
+            // false when the value cannot be cloned, leaving it untouched
+            static bool Serialize(JSContext *ctx, JSValueConst value, JSValueConst transfer, ClonedValue &out);
+
+            // Consumes the transferred buffers of `in`
+            static JSValue Deserialize(JSContext *ctx, ClonedValue &in);
+            // A value cloned without a transfer list, which can be read any
+            // number of times
+            static JSValue Deserialize(JSContext *ctx, std::string_view data);
+
+            static constexpr int kMaxDepth = 512;
+    };
+}
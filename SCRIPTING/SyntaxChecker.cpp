@@ -0,0 +1,124 @@
+#include "SyntaxChecker.h"
+#include "../Dependencies/quickjs/quickjs.h"
+#include "../UTILS/Logger.h"
+#include "ModuleLoader.h"
+
+namespace SCR {
+
+    namespace {
+        SyntaxError ReadSyntaxError(JSContext *ctx) {
+            SyntaxError err;
+            JSValue exc = JS_GetException(ctx);
+
+            JSValue line = JS_GetPropertyStr(ctx, exc, "lineNumber");
+            int32_t n = 0;
+            if (!JS_IsUndefined(line) && JS_ToInt32(ctx, &n, line) == 0)
+                err.line = n;
+            JS_FreeValue(ctx, line);
+
+            JSValue msg = JS_GetPropertyStr(ctx, exc, "message");
+            const char *str = JS_ToCString(ctx, JS_IsUndefined(msg) ? exc : msg);
+            err.message = str ? str : "(unable to stringify exception)";
+            JS_FreeCString(ctx, str);
+            JS_FreeValue(ctx, msg);
+
+            JS_FreeValue(ctx, exc);
+            return err;
+        }
+    }
+
+    CSyntaxChecker &CSyntaxChecker::Get() {
+        static CSyntaxChecker checker;
+        return checker;
+    }
+
+    CSyntaxChecker::CSyntaxChecker() {
+        worker = std::thread([this] { Run(); });
+    }
+
+    CSyntaxChecker::~CSyntaxChecker() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    uint64_t CSyntaxChecker::Submit(std::string source, std::string filename) {
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lk(m);
+            generation = ++latest;
+            pending = Job{generation, std::move(source), std::move(filename)};
+        }
+        cv.notify_one();
+        return generation;
+    }
+
+    std::optional<SyntaxCheckResult> CSyntaxChecker::TakeResult(uint64_t generation) {
+        std::lock_guard<std::mutex> lk(m);
+        if (!result || result->generation != generation)
+            return std::nullopt;
+        std::optional<SyntaxCheckResult> out = std::move(result);
+        result.reset();
+        return out;
+    }
+
+    void CSyntaxChecker::Run() {
+        // Created on this thread so QuickJS measures the stack it runs on
+        JSRuntime *rt = JS_NewRuntime();
+        JSContext *ctx = rt ? JS_NewContext(rt) : nullptr;
+        if (!ctx) {
+            LOG_ERROR(Script, "QuickJS: cannot create the syntax check runtime");
+            if (rt)
+                JS_FreeRuntime(rt);
+            return;
+        }
+        CModuleLoader::Install(rt);
+
+        std::unique_lock<std::mutex> lk(m);
+        for (;;) {
+            cv.wait(lk, [this] { return stop || pending.has_value(); });
+            if (stop)
+                break;
+
+            Job job = std::move(*pending);
+            pending.reset();
+            lk.unlock();
+
+            SyntaxCheckResult res;
+            res.generation = job.generation;
+            if (JS_DetectModule(job.source.c_str(), job.source.size())) {
+                // A compiled module stays registered with its context, so
+                // every module check gets a throwaway one
+                JSContext *mctx = JS_NewContext(rt);
+                if (mctx) {
+                    JSValue mod = CModuleLoader::CompileModule(mctx, job.source, job.filename);
+                    if (JS_IsException(mod))
+                        res.errors.push_back(ReadSyntaxError(mctx));
+                    JS_FreeValue(mctx, mod);
+                    JS_FreeContext(mctx);
+                }
+            } else {
+                JSValue fn = JS_Eval(ctx, job.source.c_str(), job.source.size(), job.filename.c_str(),
+                                     JS_EVAL_TYPE_GLOBAL | JS_EVAL_FLAG_COMPILE_ONLY);
+                if (JS_IsException(fn))
+                    res.errors.push_back(ReadSyntaxError(ctx));
+                JS_FreeValue(ctx, fn);
+            }
+
+            lk.lock();
+            // Newer text arrived while compiling, nobody wants this answer
+            if (job.generation == latest)
+                result = std::move(res);
+            else
+                LOG_TRACE(Script, "Dropped stale syntax check {}", job.generation);
+        }
+        lk.unlock();
+
+        JS_FreeContext(ctx);
+        JS_FreeRuntime(rt);
+    }
+}
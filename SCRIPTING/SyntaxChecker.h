@@ -0,0 +1,63 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace SCR {
+
+    struct SyntaxError {
+        int line = 0;    // 1-based
+        int column = -1; // -1 when QuickJS does not know it
+        std::string message;
+    };
+
+    struct SyntaxCheckResult {
+        uint64_t generation = 0;
+        std::vector<SyntaxError> errors;
+    };
+
+    // Compiles sources with JS_EVAL_FLAG_COMPILE_ONLY on one worker thread
+    // that keeps its runtime and context warm between checks. Only the
+    // newest submission matters: a queued check is replaced by the next one
+    // and a result that went stale while compiling is dropped.
+    class CSyntaxChecker {
+        public:
+            static CSyntaxChecker &Get();
+
+            // Returns the generation the eventual result will carry
+            uint64_t Submit(std::string source, std::string filename);
+
+            // Hands out the newest result once, if it belongs to `generation`
+            std::optional<SyntaxCheckResult> TakeResult(uint64_t generation);
+
+            // How long the text has to sit still before it is worth checking
+            static constexpr std::chrono::milliseconds kDebounce{300};
+
+        private:
+            CSyntaxChecker();
+            ~CSyntaxChecker();
+            CSyntaxChecker(const CSyntaxChecker &) = delete;
+            CSyntaxChecker &operator=(const CSyntaxChecker &) = delete;
+
+            struct Job {
+                uint64_t generation;
+                std::string source;
+                std::string filename;
+            };
+
+            void Run();
+
+            std::mutex m;
+            std::condition_variable cv;
+            std::optional<Job> pending;
+            std::optional<SyntaxCheckResult> result;
+            uint64_t latest = 0;
+            bool stop = false;
+            std::thread worker;
+    };
+}
@@ -0,0 +1,449 @@
+#include "Workers.h"
+#include "../UTILS/Logger.h"
+#include "../UTILS/ThreadPool.h"
+#include "FS/MainFileSystem.h"
+#include "FunctionBindings.h"
+#include "JsHelpers.h"
+#include "ModuleLoader.h"
+#include "Scripting.h"
+#include "SharedBuffers.h"
+#include <algorithm>
+#include <cassert>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <thread>
+
+namespace SCR {
+
+    JSClassID CWorkerHost::classId = 0;
+
+    namespace {
+        // {data} for onmessage, as a MessageEvent would have it
+        JSValue NewMessageEvent(JSContext *ctx, ClonedValue &data) {
+            JSValue value = CStructuredClone::Deserialize(ctx, data);
+            if (JS_IsException(value))
+                return value;
+            JSValue event = JS_NewObject(ctx);
+            JS_SetPropertyStr(ctx, event, "data", value);
+            return event;
+        }
+    }
+
+    // CWorker, everything but the constructor runs on the executor
+
+    CWorker::CWorker(CWorkerHost &host, std::string path, std::string name)
+        : host(host), path(std::move(path)), name(std::move(name)) {}
+
+    CWorker::~CWorker() = default;
+
+    void CWorker::Hold() {
+        std::lock_guard<std::mutex> lk(host.m);
+        host.outstanding++;
+    }
+
+    bool CWorker::IsScheduledRun() const {
+        return host.IsScheduledRun();
+    }
+
+    void CWorker::Post(std::function<void(JSContext *)> task) {
+        std::lock_guard<std::mutex> lk(host.m);
+        if (closed) {
+            host.Finished(1);
+            return;
+        }
+        // Takes over the unit of its Hold
+        inbox.push_back(Inbound{{}, std::move(task)});
+        if (!scheduled)
+            Schedule();
+    }
+
+    void CWorker::Schedule() {
+        scheduled = true;
+        CWorkerHost::Executor().Add([self = shared_from_this()] { self->Drain(); });
+    }
+
+    void CWorker::Drain() {
+        bool boot, skip;
+        {
+            std::lock_guard<std::mutex> lk(host.m);
+            boot = !started;
+            skip = closed;
+        }
+        if (boot) {
+            const bool ok = !skip && Boot();
+            std::lock_guard<std::mutex> lk(host.m);
+            started = true;
+            if (!ok && !closed) {
+                closed = true;
+                host.Finished(inbox.size());
+                inbox.clear();
+            }
+            host.Finished(1);
+        } else if (rt) {
+            // Tasks land on whichever pool thread is free
+            JS_UpdateStackTop(rt);
+        }
+
+        for (int n = 0;; n++) {
+            Inbound item;
+            {
+                std::lock_guard<std::mutex> lk(host.m);
+                // Still marked scheduled, so nothing queues another Drain
+                // while this one tears the runtime down
+                if (closed)
+                    break;
+                if (inbox.empty()) {
+                    scheduled = false;
+                    return;
+                }
+                if (n == CWorkerHost::kBatch) {
+                    // Give other workers a turn on this thread
+                    Schedule();
+                    return;
+                }
+                item = std::move(inbox.front());
+                inbox.pop_front();
+            }
+            Deliver(item);
+            std::lock_guard<std::mutex> lk(host.m);
+            host.Finished(1);
+        }
+
+        Teardown();
+        std::lock_guard<std::mutex> lk(host.m);
+        host.live--;
+        host.cv.notify_all();
+    }
+
+    bool CWorker::Boot() {
+        std::ifstream in(path);
+        if (!in) {
+            host.PostFromWorker(*this, {}, "Worker " + name + ": cannot open " + path);
+            return false;
+        }
+        const std::string src{std::istreambuf_iterator<char>(in), {}};
+
+        arena = std::make_unique<CScriptArena>();
+        rt = arena->NewRuntime();
+        if (!rt) {
+            host.PostFromWorker(*this, {}, "Worker " + name + ": cannot create runtime");
+            return false;
+        }
+        register_class(rt);
+        CModuleLoader::Install(rt);
+        CSharedBuffers::InstallAllocator(rt);
+        JS_SetInterruptHandler(rt, Interrupt, this);
+        ctx = JS_NewContext(rt);
+        if (!ctx) {
+            host.PostFromWorker(*this, {}, "Worker " + name + ": cannot create context");
+            return false;
+        }
+        Attach(ctx);
+
+        CScripting::InstallGlobals(ctx, host.script);
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "self", JS_DupValue(ctx, global));
+        JS_SetPropertyStr(ctx, global, "postMessage", JS_NewCFunction(ctx, JsPostMessage, "postMessage", 2));
+        JS_SetPropertyStr(ctx, global, "close", JS_NewCFunction(ctx, JsClose, "close", 0));
+        JS_FreeValue(ctx, global);
+
+        // A script that throws at the top level still gets its messages, as
+        // in a browser
+        JSValue res = CScripting::EvalSource(ctx, src, path, name);
+        JSContext *failed = ctx;
+        if (JS_IsException(res) || !RunJobs(rt, failed))
+            host.PostFromWorker(*this, {}, "Worker " + name + ": " + TakeException(failed));
+        JS_FreeValue(ctx, res);
+        return true;
+    }
+
+    void CWorker::Deliver(Inbound &item) {
+        JSContext *failed = ctx;
+        if (item.task) {
+            item.task(ctx);
+            if (Threw(ctx) || !RunJobs(rt, failed))
+                host.PostFromWorker(*this, {}, "Worker " + name + ": " + TakeException(failed));
+            return;
+        }
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JSValue handler = JS_GetPropertyStr(ctx, global, "onmessage");
+        if (JS_IsFunction(ctx, handler)) {
+            JSValue event = NewMessageEvent(ctx, item.message);
+            JSValue r = JS_IsException(event) ? JS_EXCEPTION : JS_Call(ctx, handler, global, 1, &event);
+            if (JS_IsException(r) || !RunJobs(rt, failed))
+                host.PostFromWorker(*this, {}, "Worker " + name + ": " + TakeException(failed));
+            JS_FreeValue(ctx, r);
+            JS_FreeValue(ctx, event);
+        }
+        JS_FreeValue(ctx, handler);
+        JS_FreeValue(ctx, global);
+    }
+
+    void CWorker::Teardown() {
+        if (ctx) {
+            Close(ctx);
+            JS_FreeContext(ctx);
+        }
+        if (rt)
+            JS_FreeRuntime(rt);
+        ctx = nullptr;
+        rt = nullptr;
+        if (arena) {
+            const ArenaStats mem = arena->Stats();
+            LOG_DEBUG(Script, "Worker {}: {} allocations, peak {} KiB", name, mem.allocations, mem.peak / 1024);
+            arena.reset();
+        }
+    }
+
+    JSValue CWorker::JsPostMessage(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        auto *self = static_cast<CWorker *>(CRunLoop::Of(ctx));
+        ClonedValue data;
+        if (!CStructuredClone::Serialize(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, argc > 1 ? argv[1] : JS_UNDEFINED,
+                                         data))
+            return JS_EXCEPTION;
+        self->host.PostFromWorker(*self, std::move(data), {});
+        return JS_UNDEFINED;
+    }
+
+    JSValue CWorker::JsClose(JSContext *ctx, JSValueConst, int, JSValueConst *) {
+        auto *self = static_cast<CWorker *>(CRunLoop::Of(ctx));
+        std::lock_guard<std::mutex> lk(self->host.m);
+        // The handler that called close() finishes, nothing after it runs
+        if (!self->closed) {
+            self->closed = true;
+            self->host.Finished(self->inbox.size());
+            self->inbox.clear();
+        }
+        return JS_UNDEFINED;
+    }
+
+    int CWorker::Interrupt(JSRuntime *, void *opaque) {
+        return ((CWorker *)opaque)->terminated.load(std::memory_order_relaxed) ? 1 : 0;
+    }
+
+    // CWorkerHost, everything but Post and Finished runs on the parent's thread
+
+    CWorkerHost::CWorkerHost(FS::ScriptJS *script, bool scheduled) : script(script), scheduled(scheduled) {}
+
+    CWorkerHost::~CWorkerHost() {
+        std::unique_lock<std::mutex> lk(m);
+        for (auto &worker : workers)
+            Terminate(*worker);
+        cv.wait(lk, [this] { return live == 0; });
+    }
+
+    ThreadPool &CWorkerHost::Executor() {
+        static ThreadPool pool(std::max(2u, std::thread::hardware_concurrency()));
+        return pool;
+    }
+
+    void CWorkerHost::Install(JSContext *ctx) {
+        static std::once_flag once;
+        std::call_once(once, [] { JS_NewClassID(&classId); });
+
+        JSClassDef def{};
+        def.class_name = "Worker";
+        JS_NewClass(JS_GetRuntime(ctx), classId, &def);
+
+        JSValue proto = JS_NewObject(ctx);
+        JS_SetPropertyStr(ctx, proto, "postMessage", JS_NewCFunction(ctx, JsPostMessage, "postMessage", 2));
+        JS_SetPropertyStr(ctx, proto, "terminate", JS_NewCFunction(ctx, JsTerminate, "terminate", 0));
+        JS_SetClassProto(ctx, classId, JS_DupValue(ctx, proto));
+
+        JSValue ctor = JS_NewCFunction2(ctx, JsConstruct, "Worker", 1, JS_CFUNC_constructor, 0);
+        JS_SetConstructor(ctx, ctor, proto);
+        JS_FreeValue(ctx, proto);
+
+        JSValue global = JS_GetGlobalObject(ctx);
+        JS_SetPropertyStr(ctx, global, "Worker", ctor);
+        JS_FreeValue(ctx, global);
+
+        Attach(ctx);
+    }
+
+    void CWorkerHost::Run(JSContext *ctx) {
+        // Run waits for Drain tasks on the executor; called from one of its
+        // threads, it could take the last thread those tasks need
+        assert(!Executor().IsPoolThread());
+
+        JSContext *failed = ctx;
+        if (!RunJobs(JS_GetRuntime(ctx), failed))
+            CScripting::ReportException(failed, script);
+
+        for (;;) {
+            Event event;
+            {
+                std::unique_lock<std::mutex> lk(m);
+                // With no start, message or hold left to handle, nothing
+                // can post anything any more
+                cv.wait(lk, [this] { return !events.empty() || outstanding == 0; });
+                if (events.empty())
+                    break;
+                event = std::move(events.front());
+                events.pop_front();
+            }
+            Dispatch(ctx, event);
+        }
+        Shutdown(ctx);
+    }
+
+    void CWorkerHost::Hold() {
+        std::lock_guard<std::mutex> lk(m);
+        outstanding++;
+    }
+
+    void CWorkerHost::Post(std::function<void(JSContext *)> task) {
+        std::lock_guard<std::mutex> lk(m);
+        events.push_back(Event{nullptr, {}, {}, std::move(task)});
+        cv.notify_all();
+    }
+
+    void CWorkerHost::PostFromWorker(CWorker &worker, ClonedValue data, std::string error) {
+        std::lock_guard<std::mutex> lk(m);
+        if (worker.terminated)
+            return;
+        events.push_back(Event{worker.shared_from_this(), std::move(data), std::move(error), {}});
+        cv.notify_all();
+    }
+
+    void CWorkerHost::Finished(std::size_t units) {
+        outstanding -= units;
+        if (outstanding == 0)
+            cv.notify_all();
+    }
+
+    void CWorkerHost::Dispatch(JSContext *ctx, Event &event) {
+        if (event.task) {
+            event.task(ctx);
+            JSContext *failed = ctx;
+            if (Threw(ctx) || !RunJobs(JS_GetRuntime(ctx), failed))
+                CScripting::ReportException(failed, script);
+            std::lock_guard<std::mutex> lk(m);
+            Finished(1);
+            return;
+        }
+
+        CWorker &worker = *event.worker;
+        if (worker.terminated)
+            return;
+
+        const bool error = !event.error.empty();
+        JSValue handler = JS_GetPropertyStr(ctx, worker.object, error ? "onerror" : "onmessage");
+        if (JS_IsFunction(ctx, handler)) {
+            JSValue arg;
+            if (error) {
+                arg = JS_NewObject(ctx);
+                JS_SetPropertyStr(ctx, arg, "message", JS_NewStringLen(ctx, event.error.data(), event.error.size()));
+                JS_SetPropertyStr(ctx, arg, "filename", JS_NewString(ctx, worker.path.c_str()));
+            } else {
+                arg = NewMessageEvent(ctx, event.data);
+            }
+            JSValue r = JS_IsException(arg) ? JS_EXCEPTION : JS_Call(ctx, handler, worker.object, 1, &arg);
+            JSContext *failed = ctx;
+            if (JS_IsException(r) || !RunJobs(JS_GetRuntime(ctx), failed))
+                CScripting::ReportException(failed, script);
+            JS_FreeValue(ctx, r);
+            JS_FreeValue(ctx, arg);
+        } else if (error) {
+            CScripting::ReportError(script, event.error);
+        }
+        JS_FreeValue(ctx, handler);
+    }
+
+    void CWorkerHost::Terminate(CWorker &worker) {
+        if (worker.terminated.exchange(true))
+            return;
+        if (!worker.closed) {
+            worker.closed = true;
+            Finished(worker.inbox.size());
+            worker.inbox.clear();
+        }
+        // Wakes the worker up just to tear it down
+        if (!worker.scheduled)
+            worker.Schedule();
+    }
+
+    void CWorkerHost::Shutdown(JSContext *ctx) {
+        std::unique_lock<std::mutex> lk(m);
+        for (auto &worker : workers)
+            Terminate(*worker);
+        cv.wait(lk, [this] { return live == 0; });
+        events.clear();
+        lk.unlock();
+
+        for (auto &worker : workers) {
+            JS_FreeValue(ctx, worker->object);
+            worker->object = JS_UNDEFINED;
+        }
+        workers.clear();
+        Close(ctx);
+    }
+
+    JSValue CWorkerHost::JsConstruct(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv) {
+        auto *self = static_cast<CWorkerHost *>(CRunLoop::Of(ctx));
+        const char *spec = argc > 0 ? JS_ToCString(ctx, argv[0]) : nullptr;
+        if (!spec)
+            return JS_ThrowTypeError(ctx, "Worker: script path expected");
+        const std::string path = CModuleLoader::Resolve(ctx, self->script->fullpath, spec);
+        JS_FreeCString(ctx, spec);
+        if (path.empty())
+            return JS_EXCEPTION;
+        if (!std::filesystem::is_regular_file(path))
+            return JS_ThrowReferenceError(ctx, "Worker: no script at '%s'", path.c_str());
+
+        JSValue obj = JS_NewObjectClass(ctx, (int)classId);
+        if (JS_IsException(obj))
+            return obj;
+
+        auto worker = std::make_shared<CWorker>(*self, path, std::filesystem::path(path).filename().string());
+        JS_SetOpaque(obj, worker.get());
+        worker->object = JS_DupValue(ctx, obj);
+        self->workers.push_back(worker);
+
+        std::lock_guard<std::mutex> lk(self->m);
+        self->outstanding++;
+        self->live++;
+        worker->Schedule();
+        return obj;
+    }
+
+    JSValue CWorkerHost::JsPostMessage(JSContext *ctx, JSValueConst thisVal, int argc, JSValueConst *argv) {
+        auto *self = static_cast<CWorkerHost *>(CRunLoop::Of(ctx));
+        auto *worker = (CWorker *)JS_GetOpaque2(ctx, thisVal, classId);
+        if (!worker)
+            return JS_EXCEPTION;
+
+        ClonedValue data;
+        if (!CStructuredClone::Serialize(ctx, argc > 0 ? argv[0] : JS_UNDEFINED, argc > 1 ? argv[1] : JS_UNDEFINED,
+                                         data))
+            return JS_EXCEPTION;
+
+        std::lock_guard<std::mutex> lk(self->m);
+        // Posting to a closed worker is not an error, the message just goes nowhere
+        if (worker->closed)
+            return JS_UNDEFINED;
+        worker->inbox.push_back(CWorker::Inbound{std::move(data), {}});
+        self->outstanding++;
+        if (!worker->scheduled)
+            worker->Schedule();
+        return JS_UNDEFINED;
+    }
+
+    JSValue CWorkerHost::JsTerminate(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *) {
+        auto *self = static_cast<CWorkerHost *>(CRunLoop::Of(ctx));
+        auto *worker = (CWorker *)JS_GetOpaque2(ctx, thisVal, classId);
+        if (!worker)
+            return JS_EXCEPTION;
+        {
+            std::lock_guard<std::mutex> lk(self->m);
+            self->Terminate(*worker);
+        }
+        // Nothing is delivered to it any more, so the script's own
+        // references decide how long the object lives
+        JS_FreeValue(ctx, worker->object);
+        worker->object = JS_UNDEFINED;
+        return JS_UNDEFINED;
+    }
+}
@@ -0,0 +1,145 @@
+#pragma once
+#include "RunLoop.h"
+#include "ScriptArena.h"
+#include "StructuredClone.h"
+#include <quickjs.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class ThreadPool;
+
+namespace FS {
+    struct ScriptJS;
+}
+
+namespace SCR {
+
+    class CWorkerHost;
+
+    // One `new Worker(path)`: a script file running in a runtime of its own.
+    // A worker never holds a thread while it waits; whenever it has messages
+    // a task is queued on the shared executor that delivers them to its
+    // onmessage and returns.
+    class CWorker : public CRunLoop, public std::enable_shared_from_this<CWorker> {
+        public:
+            CWorker(CWorkerHost &host, std::string path, std::string name);
+            ~CWorker() override;
+
+            void Hold() override;
+            void Post(std::function<void(JSContext *)> task) override;
+            bool IsScheduledRun() const override;
+
+            CWorker(const CWorker &) = delete;
+            CWorker &operator=(const CWorker &) = delete;
+
+        private:
+            friend class CWorkerHost;
+
+            // A message from the parent, or a task posted to the loop
+            struct Inbound {
+                ClonedValue message;
+                std::function<void(JSContext *)> task;
+            };
+
+            void Schedule(); // host lock held
+            void Drain();
+            bool Boot();
+            void Deliver(Inbound &item);
+            void Teardown();
+
+            static JSValue JsPostMessage(JSContext *ctx, JSValueConst, int argc, JSValueConst *argv);
+            static JSValue JsClose(JSContext *ctx, JSValueConst, int, JSValueConst *);
+            static int Interrupt(JSRuntime *, void *opaque);
+
+            CWorkerHost &host;
+            const std::string path;
+            const std::string name;
+
+            // Guarded by the host's mutex
+            std::deque<Inbound> inbox;
+            bool started = false;   // the script has run, or never will
+            bool scheduled = false; // a Drain is queued or running
+            bool closed = false;
+
+            std::atomic<bool> terminated{false}; // by the parent; interrupts running code
+
+            // Only touched by Drain, which never runs twice at once
+            std::unique_ptr<CScriptArena> arena;
+            JSRuntime *rt = nullptr;
+            JSContext *ctx = nullptr;
+
+            // The parent's Worker object, parent thread only
+            JSValue object = JS_UNDEFINED;
+    };
+
+    // The Worker API of one script run. Install adds the `Worker`
+    // constructor; Run is the run's event loop, delivering what workers post
+    // back to the parent's onmessage and onerror until no worker has work
+    // left, at which point nothing can post anything any more and every
+    // worker is shut down. Workers get `postMessage`, `onmessage`, `close`
+    // and the usual globals, but cannot start workers of their own.
+    class CWorkerHost : public CRunLoop {
+        public:
+            explicit CWorkerHost(FS::ScriptJS *script, bool scheduled = false);
+            ~CWorkerHost() override;
+
+            void Hold() override;
+            void Post(std::function<void(JSContext *)> task) override;
+            bool IsScheduledRun() const override { return scheduled; }
+
+            CWorkerHost(const CWorkerHost &) = delete;
+            CWorkerHost &operator=(const CWorkerHost &) = delete;
+
+            // `ctx` must belong to an arena runtime
+            void Install(JSContext *ctx);
+            // Runs the loop until no worker, message or hold is left. Blocks
+            // on tasks queued to Executor(), so it must not be called from
+            // one of its threads: each run needs a thread of its own
+            void Run(JSContext *ctx);
+
+            // Where worker tasks run, one thread per core; only for tasks
+            // that never wait on the executor themselves
+            static ThreadPool &Executor();
+
+            static constexpr int kBatch = 64; // messages per task before yielding the thread
+
+        private:
+            friend class CWorker;
+
+            struct Event {
+                std::shared_ptr<CWorker> worker;
+                ClonedValue data;
+                std::string error; // an uncaught exception instead of a message
+                std::function<void(JSContext *)> task; // posted to the loop, no worker
+            };
+
+            void PostFromWorker(CWorker &worker, ClonedValue data, std::string error);
+            void Finished(std::size_t units); // lock held
+            void Dispatch(JSContext *ctx, Event &event);
+            void Terminate(CWorker &worker);  // lock held
+            void Shutdown(JSContext *ctx);
+
+            static JSValue JsConstruct(JSContext *ctx, JSValueConst newTarget, int argc, JSValueConst *argv);
+            static JSValue JsPostMessage(JSContext *ctx, JSValueConst thisVal, int argc, JSValueConst *argv);
+            static JSValue JsTerminate(JSContext *ctx, JSValueConst thisVal, int, JSValueConst *);
+
+            static JSClassID classId;
+
+            FS::ScriptJS *script;
+            const bool scheduled;
+
+            std::mutex m;
+            std::condition_variable cv;
+            std::deque<Event> events;
+            std::size_t outstanding = 0; // worker starts, messages and holds not yet handled
+            std::size_t live = 0;        // workers whose runtime is not torn down yet
+
+            std::vector<std::shared_ptr<CWorker>> workers; // parent thread only
+    };
+}
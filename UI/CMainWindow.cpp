@@ -10,17 +10,17 @@
 #include "CMainWindow.h"
 #include "Image/image.h"
 #include "MATH/Vector2D.h"
+#include "Renderer.h"
 #include "SettingsMenu.h"
 #include "UI/ScriptPlayground/ScriptPlayground.h"
 #include <GL/gl.h>
 #include <filesystem>
 
-// Add this include for exit functionality
-#include <cstdlib>
-
 namespace GUI {
 
     std::unique_ptr<CImage> CMainWindow::backgroundImage = nullptr;
+    std::unique_ptr<CImage> CMainWindow::previousBackground = nullptr;
+    float CMainWindow::backgroundFade = 1.0f;
     std::unique_ptr<CImage> CMainWindow::logo = nullptr;
 
     void CMainWindow::Draw() {
@@ -49,11 +49,22 @@ namespace GUI {
         {
             auto sm = SettingsMenu::GetInstance();
             if (sm->settings_state.selected_background == 1 && backgroundImage) {
+                ImDrawList *dl = ImGui::GetBackgroundDrawList(vp);
+                if (backgroundFade < 1.0f) {
+                    backgroundFade = ImMin(1.0f, backgroundFade + ImGui::GetIO().DeltaTime /
+                                                                  kBackgroundFadeSeconds);
+                    if (previousBackground && previousBackground->ImageLoaded)
+                        dl->AddImage(previousBackground->GetDataRaw(), vp->WorkPos,
+                                     vp->WorkPos + vp->WorkSize);
+                } else if (previousBackground) {
+                    previousBackground.reset();
+                }
+
                 if (backgroundImage->IsAnimated())
                     backgroundImage->UpdateAnimation(ImGui::GetIO().DeltaTime);
-                ImGui::GetBackgroundDrawList(vp)->AddImage(backgroundImage->GetDataRaw(),
-                                                           vp->WorkPos,
-                                                           vp->WorkPos + vp->WorkSize);
+                dl->AddImage(backgroundImage->GetDataRaw(), vp->WorkPos,
+                             vp->WorkPos + vp->WorkSize, ImVec2(0, 0), ImVec2(1, 1),
+                             IM_COL32(255, 255, 255, (int)(backgroundFade * 255.0f)));
             }
         }
 
@@ -103,7 +114,7 @@ namespace GUI {
             ImDrawList* drawList = ImGui::GetWindowDrawList();
 
             if (ImGui::InvisibleButton("##close", buttonSize)) {
-                std::exit(0);
+                Renderer::Get()->RequestClose();
             }
 
             // Draw the button background manually
@@ -273,7 +284,7 @@ namespace GUI {
                             cellPtr[idx] = *static_cast<FS::ScriptJS *const *>(ext->Data);
                             SettingsMenu::GetInstance()->settings_state.desktop_scripts[idx] =
                                     cellPtr[idx]->fullpath;
-                            SettingsMenu::GetInstance()->settings_state.SaveSettings();
+                            SettingsMenu::GetInstance()->settings_state.MarkDirty();
                         }
                         if (const ImGuiPayload *intp =
                                 ImGui::AcceptDragDropPayload("DESKTOP_CELL")) {
@@ -284,7 +295,7 @@ namespace GUI {
                                         SettingsMenu::GetInstance()->settings_state.desktop_scripts;
                                 st[src] = cellPtr[src] ? cellPtr[src]->fullpath : "";
                                 st[idx] = cellPtr[idx] ? cellPtr[idx]->fullpath : "";
-                                SettingsMenu::GetInstance()->settings_state.SaveSettings();
+                                SettingsMenu::GetInstance()->settings_state.MarkDirty();
                             }
                         }
                         ImGui::EndDragDropTarget();
@@ -296,7 +307,7 @@ namespace GUI {
                             SettingsMenu::GetInstance()
                                     ->settings_state.desktop_scripts[idx]
                                     .clear();
-                            SettingsMenu::GetInstance()->settings_state.SaveSettings();
+                            SettingsMenu::GetInstance()->settings_state.MarkDirty();
                         }
                         ImGui::EndPopup();
                     }
@@ -34,15 +34,19 @@ namespace GUI {
         MATH::Vector2D<int> windowSize = MATH::Vector2D<int>(0, 0);
         MATH::Vector2D<int> windowPos = MATH::Vector2D<int>(0, 0);
         static std::unique_ptr<CImage> backgroundImage;
+        static std::unique_ptr<CImage> previousBackground; // shown under a fade-in
+        static float backgroundFade;                       // 0..1 opacity of backgroundImage
 
     public:
         static void SetBackgroundImage(const std::string &path) {
             backgroundImage = std::make_unique<CImage>(path, false);
             backgroundImage.get()->LoadImage();
+            backgroundFade = 1.0f;
         }
 
         static void SetBackgroundImage(std::unique_ptr<CImage> image) {
             backgroundImage = std::move(image);
+            backgroundFade = 1.0f;
             if (backgroundImage) {
                 if (!backgroundImage->ImageLoaded) {
                     backgroundImage->LoadImage();
@@ -50,6 +54,16 @@ namespace GUI {
             }
         }
 
+        // Cross-fades from whatever is currently shown (image or fill) to an
+        // already uploaded image over kBackgroundFadeSeconds.
+        static void FadeInBackgroundImage(std::unique_ptr<CImage> image) {
+            previousBackground = std::move(backgroundImage);
+            backgroundImage = std::move(image);
+            backgroundFade = 0.0f;
+        }
+
+        static constexpr float kBackgroundFadeSeconds = 0.4f;
+
         static const CImage *GetBackgroundImage() { return backgroundImage.get(); }
         MATH::Vector2D<int> GetDesiredPos() { return MATH::Vector2D<int>{100, 100}; }
         MATH::Vector2D<int> GetDesiredSize() { return MATH::Vector2D<int>{0, 0}; }
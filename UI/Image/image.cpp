@@ -1,11 +1,152 @@
 #include "UTILS/ThreadPool.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "image.h"
+#include "FS/MainFileSystem.h"
+#include "UI/GuiTaskQueue.h"
+#include "UTILS/Hash.h"
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+namespace {
+  // Set up by CreateThreadPool. Joined at exit like the other pools, once
+  // whatever is still queued has run.
+  std::unique_ptr<ThreadPool> &LoaderPool() {
+    static std::unique_ptr<ThreadPool> pool;
+    return pool;
+  }
+
+  // Cached downloads are refetched once they get this old
+  constexpr auto kCacheMaxAge = std::chrono::hours(24 * 7);
+  // Past this, the least recently used entries are evicted
+  constexpr std::uintmax_t kCacheMaxBytes = 256ull << 20;
+
+  std::string ReadWholeFile(const std::string &path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+      return {};
+    return {std::istreambuf_iterator<char>(in), {}};
+  }
+
+  // An entry's write time is when it was last used, its header says when
+  // it was downloaded
+  void TouchCacheEntry(const std::string &file) {
+    std::error_code ec;
+    std::filesystem::last_write_time(
+        file, std::filesystem::file_time_type::clock::now(), ec);
+  }
+
+  void PruneCache() {
+    namespace fs = std::filesystem;
+    struct Entry {
+      fs::path path;
+      fs::file_time_type used;
+      std::uintmax_t size;
+    };
+    std::vector<Entry> entries;
+    std::uintmax_t total = 0;
+    std::error_code ec;
+    for (const auto &e :
+         fs::directory_iterator(FS::CFileSystem::GetCacheFolderLocation(), ec)) {
+      if (e.path().extension() != ".nxic")
+        continue;
+      std::error_code fec;
+      Entry entry{e.path(), e.last_write_time(fec), e.file_size(fec)};
+      if (fec)
+        continue;
+      total += entry.size;
+      entries.push_back(std::move(entry));
+    }
+    if (total <= kCacheMaxBytes)
+      return;
+
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &a, const Entry &b) { return a.used < b.used; });
+    for (const Entry &entry : entries) {
+      if (total <= kCacheMaxBytes)
+        break;
+      if (fs::remove(entry.path, ec))
+        total -= entry.size;
+    }
+  }
+
+  void RunOnLoader(std::function<void()> job) {
+    if (LoaderPool())
+      LoaderPool()->Add(std::move(job));
+    else
+      std::thread(std::move(job)).detach();
+  }
+} // namespace
 
 void CImageLoader::CreateThreadPool(const std::size_t &threadsnr) {
-  // CImageLoader::_threadPool = ThreadPool{threadsnr};
+  if (!LoaderPool())
+    LoaderPool() = std::make_unique<ThreadPool>(threadsnr);
 }
 
 void CImageLoader::AddImage(CImage *image) {
-  // CImageLoader::_threadPool.Add(&image->LoadImage);
+  RunOnLoader([image] {
+    const std::string bytes = ReadWholeFile(image->GetPath());
+    if (bytes.empty() ||
+        !image->DecodeFromMemory((const unsigned char *)bytes.data(),
+                                 bytes.size()))
+      return;
+    g_guiTasks.push([image] { image->UploadTexture(); });
+  });
+}
+
+std::string CImageLoader::CachePathFor(const std::string &source) {
+  char name[32];
+  snprintf(name, sizeof(name), "%016llx.nxic",
+           (unsigned long long)UTILS::Fnv1a(source));
+  return (FS::CFileSystem::GetCacheFolderLocation() / name).string();
+}
+
+void CImageLoader::LoadAsync(const std::string &source, bool is_url,
+                             Callback done) {
+  RunOnLoader([source, is_url, done = std::move(done)] {
+    auto image = std::make_shared<std::unique_ptr<CImage>>(
+        std::make_unique<CImage>(source, is_url));
+    CImage &img = **image;
+
+    bool ok = false;
+    if (is_url) {
+      const std::string cache = CachePathFor(source);
+      ok = img.LoadDecodedCache(cache, kCacheMaxAge);
+      if (ok) {
+        LOG_DEBUG(GUI, "{} restored from the decoded cache", source);
+        TouchCacheEntry(cache);
+      } else {
+        try {
+          const std::string bytes = Curl::Get(source);
+          ok = img.DecodeFromMemory((const unsigned char *)bytes.data(),
+                                    bytes.size());
+        } catch (const std::exception &e) {
+          LOG_ERROR(Net, "HTTP error for {}: {}", source, e.what());
+        }
+        if (ok && !img.SaveDecodedCache(cache))
+          LOG_WARN(GUI, "Could not write image cache {}", cache);
+        else if (ok)
+          PruneCache();
+      }
+    } else {
+      const std::string bytes = ReadWholeFile(source);
+      ok = !bytes.empty() &&
+           img.DecodeFromMemory((const unsigned char *)bytes.data(),
+                                bytes.size());
+    }
+
+    if (!ok)
+      image->reset();
+
+    // Textures can only be created on the GUI thread
+    g_guiTasks.push([image, done] {
+      if (*image)
+        (*image)->UploadTexture();
+      done(std::move(*image));
+    });
+  });
 }
@@ -3,10 +3,15 @@
 #include "../../Dependencies/ImGui/imgui.h"
 #include "../../Dependencies/stb/stb_image.h"
 #include "../../NETWORKING/CNetworking.h"
-#include "fmt/base.h"
+#include "../../UTILS/Logger.h"
 #include <GL/gl.h>
+#include <chrono>
 #include <condition_variable>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
 #include <mutex>
 #include <sstream>
 #include <string>
@@ -37,7 +42,7 @@ public:
     if (data)
       CreateTexture();
     else
-      fmt::print("embedded decode failed\n");
+      LOG_ERROR(GUI, "embedded decode failed");
   }
 
   ~CImage() {
@@ -73,14 +78,28 @@ public:
         keepBackup = true;
         CreateTexture();
       } else {
-        fmt::print("failed to load {}\n", path);
+        LOG_ERROR(GUI, "failed to load {}", path);
       }
     }
   }
 
   void Recolour(ImVec4 from, ImVec4 to, float tol = 0.05f) {
+    if (!RecolourPixels(from, to, tol))
+      return;
+
+    if (!s_gpuUploads)
+      return;
+
+    // Re-upload to the already created texture
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, data);
+  }
+
+  // CPU half of Recolour: rewrites `data` from the pristine backup
+  bool RecolourPixels(ImVec4 from, ImVec4 to, float tol = 0.05f) {
     if (!keepBackup)
-      return; // we only support static RGBA
+      return false; // we only support static RGBA
 
     const uint8_t fr = uint8_t(from.x * 255.f);
     const uint8_t fg = uint8_t(from.y * 255.f);
@@ -103,11 +122,7 @@ public:
         p[2] = tb;
       }
     }
-
-    // Re-upload to the already created texture
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA,
-                    GL_UNSIGNED_BYTE, data);
+    return true;
   }
 
   void LoadImageFromURL() {
@@ -127,12 +142,136 @@ public:
           keepBackup = true;
           CreateTexture();
         } else {
-          fmt::print("decode failed for {}\n", path);
+          LOG_ERROR(GUI, "decode failed for {}", path);
         }
       }
     } catch (const std::exception &e) {
-      fmt::print("HTTP error: {}\n", e.what());
+      LOG_ERROR(Net, "HTTP error for {}: {}", path, e.what());
+    }
+  }
+
+  // CPU-side decode only, safe on any thread. Call UploadTexture() on the
+  // GUI thread afterwards.
+  bool DecodeFromMemory(const unsigned char *buf, size_t len) {
+    if (len >= 6 &&
+        (!memcmp(buf, "GIF87a", 6) || !memcmp(buf, "GIF89a", 6))) {
+      DecodeGIFFromMemory(buf, len);
+    } else {
+      data = stbi_load_from_memory(buf, (int)len, &width, &height, &channel, 4);
+      if (data) {
+        channel = 4;
+        backup.assign(data, data + width * height * 4);
+        keepBackup = true;
+      }
     }
+    if (!data)
+      LOG_ERROR(GUI, "decode failed for {}", path);
+    return data != nullptr;
+  }
+
+  // Takes a copy of an already decoded w*h RGBA buffer, CPU side only
+  bool SetPixels(const unsigned char *rgba, int w, int h) {
+    const size_t bytes = (size_t)w * h * 4;
+    unsigned char *px = (unsigned char *)malloc(bytes); // stbi_image_free
+    if (!px)
+      return false;
+    memcpy(px, rgba, bytes);
+    if (data)
+      stbi_image_free(data);
+    data = px;
+    width = w;
+    height = h;
+    channel = 4;
+    isGif = false;
+    frameCount = 1;
+    backup.assign(data, data + bytes);
+    keepBackup = true;
+    return true;
+  }
+
+  void UploadTexture() {
+    if (!ImageLoaded)
+      CreateTexture();
+  }
+
+  bool HasPixels() const { return data != nullptr; }
+  const unsigned char *GetPixels() const { return data; }
+
+  // Decoded-pixel cache: "NXIC", version, w, h, frames, the time it was
+  // saved (seconds since the epoch), delays, RGBA frames. Restoring from it
+  // skips both the download and the decode; a copy saved more than
+  // `maxAge` ago is not restored.
+  bool LoadDecodedCache(const std::string &file, std::chrono::seconds maxAge) {
+    FILE *f = fopen(file.c_str(), "rb");
+    if (!f)
+      return false;
+
+    char magic[4];
+    int32_t hdr[4];
+    int64_t saved;
+    const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    bool ok = fread(magic, 1, 4, f) == 4 && !memcmp(magic, "NXIC", 4) &&
+              fread(hdr, sizeof(int32_t), 4, f) == 4 && hdr[0] == 2 &&
+              hdr[1] > 0 && hdr[2] > 0 && hdr[3] > 0 &&
+              fread(&saved, sizeof(saved), 1, f) == 1 &&
+              now - saved < maxAge.count();
+    if (ok) {
+      const int frames = hdr[3];
+      const size_t frameSize = (size_t)hdr[1] * hdr[2] * 4;
+      // malloc'd so the stbi_image_free calls in the destructor stay valid
+      int *d = frames > 1 ? (int *)malloc(sizeof(int) * frames) : nullptr;
+      unsigned char *px = (unsigned char *)malloc(frameSize * frames);
+      ok = px && (frames == 1 || (d && fread(d, sizeof(int), frames, f) ==
+                                              (size_t)frames)) &&
+           fread(px, 1, frameSize * frames, f) == frameSize * frames;
+      if (ok) {
+        width = hdr[1];
+        height = hdr[2];
+        channel = 4;
+        frameCount = frames;
+        data = px;
+        delays = d;
+        isGif = frames > 1;
+        if (!isGif) {
+          backup.assign(data, data + frameSize);
+          keepBackup = true;
+        }
+      } else {
+        free(px);
+        free(d);
+      }
+    }
+    fclose(f);
+    return ok;
+  }
+
+  bool SaveDecodedCache(const std::string &file) const {
+    if (!data)
+      return false;
+    const std::string tmp = file + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (!f)
+      return false;
+
+    const int frames = isGif ? frameCount : 1;
+    const int32_t hdr[4] = {2, width, height, frames};
+    const int64_t saved = std::chrono::duration_cast<std::chrono::seconds>(
+                              std::chrono::system_clock::now().time_since_epoch())
+                              .count();
+    const size_t frameSize = (size_t)width * height * 4;
+    bool ok = fwrite("NXIC", 1, 4, f) == 4 &&
+              fwrite(hdr, sizeof(int32_t), 4, f) == 4 &&
+              fwrite(&saved, sizeof(saved), 1, f) == 1 &&
+              (frames == 1 ||
+               fwrite(delays, sizeof(int), frames, f) == (size_t)frames) &&
+              fwrite(data, 1, frameSize * frames, f) == frameSize * frames;
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp.c_str(), file.c_str()) == 0;
+    if (!ok)
+      remove(tmp.c_str());
+    return ok;
   }
 
   void UpdateAnimation(float deltaTime) {
@@ -152,17 +291,22 @@ public:
     return ImageLoaded ? (void *)(intptr_t)texture : nullptr;
   }
 
+  const std::string &GetPath() const { return path; }
   float GetWidth() { return this->width; }
   float GetHeight() { return this->height; }
 
   bool IsAnimated() const { return isGif && frameCount > 1; }
   bool ImageLoaded = false;
 
+  // Headless runs have no GL context. With uploads off, images still
+  // decode and count as loaded but never touch GL, and draw with texture 0.
+  static void SetGpuUploads(bool enabled) { s_gpuUploads = enabled; }
+
 private:
   void LoadGIF() {
     FILE *file = fopen(path.c_str(), "rb");
     if (!file) {
-      fmt::print("failed to open {}\n", path);
+      LOG_ERROR(GUI, "failed to open {}", path);
       return;
     }
 
@@ -178,6 +322,11 @@ private:
   }
 
   void LoadGIFFromMemory(const unsigned char *buffer, size_t size) {
+    if (DecodeGIFFromMemory(buffer, size))
+      CreateTexture();
+  }
+
+  bool DecodeGIFFromMemory(const unsigned char *buffer, size_t size) {
     isGif = true;
 
     data = stbi_load_gif_from_memory(buffer, size, &delays, &width, &height,
@@ -187,17 +336,23 @@ private:
       channel = 4;
       currentFrame = 0;
       elapsedTime = 0.0f;
-      CreateTexture();
-    } else {
-      fmt::print("failed to load GIF {}\n", path);
-      isGif = false;
+      return true;
     }
+    LOG_ERROR(GUI, "failed to load GIF {}", path);
+    isGif = false;
+    return false;
   }
 
   void CreateTexture() {
     if (!data)
       return;
 
+    if (!s_gpuUploads) {
+      texture = 0;
+      ImageLoaded = true;
+      return;
+    }
+
     glGenTextures(1, &texture);
     glBindTexture(GL_TEXTURE_2D, texture);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
@@ -210,7 +365,7 @@ private:
   }
 
   void UpdateCurrentFrame() {
-    if (!ImageLoaded || !isGif)
+    if (!ImageLoaded || !isGif || !s_gpuUploads)
       return;
 
     glBindTexture(GL_TEXTURE_2D, texture);
@@ -249,14 +404,22 @@ private:
   // Recoloring members
   std::vector<uint8_t> backup;
   bool keepBackup = false;
+
+  static inline bool s_gpuUploads = true;
 };
 
 class CImageLoader {
 public:
+  using Callback = std::function<void(std::unique_ptr<CImage>)>;
+
   static void CreateThreadPool(const std::size_t &);
   static void AddImage(CImage *image);
 
-private:
-  // static ThreadPool _threadPool;
+  // Fetches (or reads from the decoded cache) and decodes on the loader
+  // pool, then uploads the texture and runs `done` on the GUI thread.
+  // `done` receives nullptr when loading failed.
+  static void LoadAsync(const std::string &source, bool is_url, Callback done);
+
+  static std::string CachePathFor(const std::string &source);
 };
 #endif
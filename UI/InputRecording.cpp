@@ -0,0 +1,312 @@
+#include "InputRecording.h"
+#include "../Dependencies/ImGui/imgui.h"
+#include "../Dependencies/glfw/include/GLFW/glfw3.h"
+#include "UTILS/Logger.h"
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <iterator>
+
+// Defined by imgui_impl_glfw.cpp, not declared in its header
+ImGuiKey ImGui_ImplGlfw_KeyToImGuiKey(int keycode, int scancode);
+
+namespace GUI {
+
+    CInputRecorder *CInputRecorder::s_active = nullptr;
+
+    CInputRecorder::~CInputRecorder() {
+        Close();
+    }
+
+    bool CInputRecorder::Open(const std::string &path) {
+        out.open(path, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            LOG_ERROR(GUI, "Cannot create input recording {}", path);
+            return false;
+        }
+        out.write(InputRecord::kMagic, sizeof(InputRecord::kMagic));
+        out.put((char)InputRecord::kVersion);
+        buffer.clear();
+        frames = 0;
+        lastWidth = lastHeight = 0;
+        s_active = this;
+        LOG_INFO(GUI, "Recording input to {}", path);
+        return true;
+    }
+
+    void CInputRecorder::Install(GLFWwindow *window) {
+        glfwSetCursorPosCallback(window, OnCursorPos);
+        glfwSetMouseButtonCallback(window, OnMouseButton);
+        glfwSetScrollCallback(window, OnScroll);
+        glfwSetKeyCallback(window, OnKey);
+        glfwSetCharCallback(window, OnChar);
+        glfwSetWindowFocusCallback(window, OnFocus);
+        glfwSetCursorEnterCallback(window, OnCursorEnter);
+    }
+
+    void CInputRecorder::EndFrame(const ImGuiIO &io) {
+        if (!out.is_open())
+            return;
+
+        const int w = (int)io.DisplaySize.x, h = (int)io.DisplaySize.y;
+        if (w != lastWidth || h != lastHeight) {
+            Byte(InputRecord::Resize);
+            Varint((uint64_t)std::max(w, 0));
+            Varint((uint64_t)std::max(h, 0));
+            lastWidth = w;
+            lastHeight = h;
+        }
+
+        Byte(InputRecord::Frame);
+        Varint((uint64_t)(io.DeltaTime * 1e6f + 0.5f));
+        // Whole frames only, flushed each frame, so a crash leaves a
+        // readable recording
+        out.write((const char *)buffer.data(), (std::streamsize)buffer.size());
+        out.flush();
+        buffer.clear();
+        frames++;
+    }
+
+    void CInputRecorder::Close() {
+        if (!out.is_open())
+            return;
+        out.close();
+        if (s_active == this)
+            s_active = nullptr;
+        LOG_INFO(GUI, "Recorded {} frames of input", frames);
+    }
+
+    void CInputRecorder::Varint(uint64_t v) {
+        do {
+            uint8_t b = v & 0x7f;
+            v >>= 7;
+            Byte(v ? (uint8_t)(b | 0x80) : b);
+        } while (v);
+    }
+
+    void CInputRecorder::Float(float v) {
+        uint32_t bits;
+        std::memcpy(&bits, &v, sizeof(bits));
+        for (int i = 0; i < 4; i++)
+            Byte((uint8_t)(bits >> (i * 8)));
+    }
+
+    void CInputRecorder::OnCursorPos(GLFWwindow *, double x, double y) {
+        if (!s_active)
+            return;
+        s_active->Byte(InputRecord::CursorPos);
+        s_active->Float((float)x);
+        s_active->Float((float)y);
+    }
+
+    void CInputRecorder::OnMouseButton(GLFWwindow *, int button, int action, int) {
+        if (!s_active || button < 0 || button >= ImGuiMouseButton_COUNT)
+            return;
+        s_active->Byte(InputRecord::MouseButton);
+        s_active->Byte((uint8_t)button);
+        s_active->Byte(action == GLFW_PRESS);
+    }
+
+    void CInputRecorder::OnScroll(GLFWwindow *, double dx, double dy) {
+        if (!s_active)
+            return;
+        s_active->Byte(InputRecord::Scroll);
+        s_active->Float((float)dx);
+        s_active->Float((float)dy);
+    }
+
+    // Stored as ImGuiKey so a replay needs no GLFW. The backend also undoes
+    // GLFW's layout untranslation for letter keys, which this skips, so
+    // non-QWERTY layouts may replay a different letter for shortcuts.
+    void CInputRecorder::OnKey(GLFWwindow *, int key, int scancode, int action, int) {
+        if (!s_active || (action != GLFW_PRESS && action != GLFW_RELEASE))
+            return;
+        const ImGuiKey k = ImGui_ImplGlfw_KeyToImGuiKey(key, scancode);
+        if (k == ImGuiKey_None)
+            return;
+        s_active->Byte(InputRecord::Key);
+        s_active->Varint((uint64_t)k);
+        s_active->Byte(action == GLFW_PRESS);
+    }
+
+    void CInputRecorder::OnChar(GLFWwindow *, unsigned int codepoint) {
+        if (!s_active)
+            return;
+        s_active->Byte(InputRecord::Char);
+        s_active->Varint(codepoint);
+    }
+
+    void CInputRecorder::OnFocus(GLFWwindow *, int focused) {
+        if (!s_active)
+            return;
+        s_active->Byte(InputRecord::Focus);
+        s_active->Byte(focused != 0);
+    }
+
+    void CInputRecorder::OnCursorEnter(GLFWwindow *, int entered) {
+        if (!s_active)
+            return;
+        s_active->Byte(InputRecord::CursorEnter);
+        s_active->Byte(entered != 0);
+    }
+
+    bool CInputReplayer::Load(const std::string &path) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            LOG_ERROR(GUI, "Cannot open input recording {}", path);
+            return false;
+        }
+        data.assign(std::istreambuf_iterator<char>(in), {});
+        if (data.size() < 5 || std::memcmp(data.data(), InputRecord::kMagic, 4) != 0 ||
+            data[4] != InputRecord::kVersion) {
+            LOG_ERROR(GUI, "{} is not a version {} input recording", path, InputRecord::kVersion);
+            data.clear();
+            return false;
+        }
+
+        // Count frames and drop anything after the last complete one
+        pos = 5;
+        frameCount = 0;
+        float dt;
+        while (Next(nullptr, dt))
+            frameCount++;
+        data.resize(pos);
+
+        pos = 5;
+        std::memset(ctrl, 0, sizeof(ctrl));
+        std::memset(shift, 0, sizeof(shift));
+        std::memset(alt, 0, sizeof(alt));
+        std::memset(super, 0, sizeof(super));
+        LOG_INFO(GUI, "Replaying {} frames of input from {}", frameCount, path);
+        return true;
+    }
+
+    float CInputReplayer::Apply(ImGuiIO &io) {
+        float dt = 0.0f;
+        return Next(&io, dt) ? dt : 0.0f;
+    }
+
+    bool CInputReplayer::Next(ImGuiIO *io, float &dt) {
+        const std::size_t start = pos;
+        uint8_t type;
+        while (ReadByte(type)) {
+            uint8_t a = 0, b = 0;
+            uint64_t u = 0, v = 0;
+            float x = 0.0f, y = 0.0f;
+            bool ok = true;
+
+            switch (type) {
+                case InputRecord::Frame:
+                    if (!ReadVarint(u)) {
+                        ok = false;
+                        break;
+                    }
+                    dt = (float)u / 1e6f;
+                    return true;
+                case InputRecord::CursorPos:
+                    ok = ReadFloat(x) && ReadFloat(y);
+                    if (ok && io)
+                        io->AddMousePosEvent(x, y);
+                    break;
+                case InputRecord::MouseButton:
+                    ok = ReadByte(a) && ReadByte(b) && a < ImGuiMouseButton_COUNT;
+                    if (ok && io)
+                        io->AddMouseButtonEvent(a, b != 0);
+                    break;
+                case InputRecord::Scroll:
+                    ok = ReadFloat(x) && ReadFloat(y);
+                    if (ok && io)
+                        io->AddMouseWheelEvent(x, y);
+                    break;
+                case InputRecord::Key:
+                    ok = ReadVarint(u) && ReadByte(b) && u >= ImGuiKey_NamedKey_BEGIN && u < ImGuiKey_NamedKey_END;
+                    if (ok && io) {
+                        const bool down = b != 0;
+                        switch ((ImGuiKey)u) {
+                            case ImGuiKey_LeftCtrl: ctrl[0] = down; break;
+                            case ImGuiKey_RightCtrl: ctrl[1] = down; break;
+                            case ImGuiKey_LeftShift: shift[0] = down; break;
+                            case ImGuiKey_RightShift: shift[1] = down; break;
+                            case ImGuiKey_LeftAlt: alt[0] = down; break;
+                            case ImGuiKey_RightAlt: alt[1] = down; break;
+                            case ImGuiKey_LeftSuper: super[0] = down; break;
+                            case ImGuiKey_RightSuper: super[1] = down; break;
+                            default: break;
+                        }
+                        // Modifiers first, like the backend does
+                        SyncModifiers(*io);
+                        io->AddKeyEvent((ImGuiKey)u, down);
+                    }
+                    break;
+                case InputRecord::Char:
+                    ok = ReadVarint(u);
+                    if (ok && io)
+                        io->AddInputCharacter((unsigned int)u);
+                    break;
+                case InputRecord::Focus:
+                    ok = ReadByte(a);
+                    if (ok && io)
+                        io->AddFocusEvent(a != 0);
+                    break;
+                case InputRecord::CursorEnter:
+                    ok = ReadByte(a);
+                    if (ok && io && !a)
+                        io->AddMousePosEvent(-FLT_MAX, -FLT_MAX);
+                    break;
+                case InputRecord::Resize:
+                    ok = ReadVarint(u) && ReadVarint(v);
+                    // With a window GLFW owns the display size
+                    if (ok && io && !io->BackendPlatformUserData)
+                        io->DisplaySize = ImVec2((float)u, (float)v);
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+            if (!ok)
+                break;
+        }
+
+        // Truncated or corrupt: treat as the end of the recording
+        pos = start;
+        return false;
+    }
+
+    bool CInputReplayer::ReadByte(uint8_t &v) {
+        if (pos >= data.size())
+            return false;
+        v = data[pos++];
+        return true;
+    }
+
+    bool CInputReplayer::ReadVarint(uint64_t &v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t b;
+            if (!ReadByte(b))
+                return false;
+            v |= (uint64_t)(b & 0x7f) << shift;
+            if (!(b & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    bool CInputReplayer::ReadFloat(float &v) {
+        if (data.size() - pos < 4)
+            return false;
+        uint32_t bits = 0;
+        for (int i = 0; i < 4; i++)
+            bits |= (uint32_t)data[pos++] << (i * 8);
+        std::memcpy(&v, &bits, sizeof(v));
+        return true;
+    }
+
+    void CInputReplayer::SyncModifiers(ImGuiIO &io) {
+        // ImGui drops events that do not change a key's state
+        io.AddKeyEvent(ImGuiMod_Ctrl, ctrl[0] || ctrl[1]);
+        io.AddKeyEvent(ImGuiMod_Shift, shift[0] || shift[1]);
+        io.AddKeyEvent(ImGuiMod_Alt, alt[0] || alt[1]);
+        io.AddKeyEvent(ImGuiMod_Super, super[0] || super[1]);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct GLFWwindow;
+struct ImGuiIO;
+
+namespace GUI {
+
+    // Recording format (.nxir): "NXIR", a version byte, then records of a
+    // type byte and its fields. Integers are LEB128 varints, positions and
+    // scroll deltas little-endian f32. Events belong to the frame whose
+    // Frame record follows them, so frame indices are implicit.
+    namespace InputRecord {
+        constexpr char kMagic[4] = {'N', 'X', 'I', 'R'};
+        constexpr uint8_t kVersion = 1;
+
+        enum Type : uint8_t {
+            Frame = 0,       // varint delta time in microseconds
+            CursorPos = 1,   // f32 x, f32 y
+            MouseButton = 2, // u8 button, u8 down
+            Scroll = 3,      // f32 dx, f32 dy
+            Key = 4,         // varint ImGuiKey, u8 down
+            Char = 5,        // varint codepoint
+            Focus = 6,       // u8 focused
+            CursorEnter = 7, // u8 entered
+            Resize = 8,      // varint width, varint height (display size)
+        };
+    }
+
+    // Captures the GLFW input callbacks of one window. Install() has to run
+    // before ImGui_ImplGlfw_InitForOpenGL so the backend chains to it and
+    // the app keeps receiving every event unchanged.
+    class CInputRecorder {
+        public:
+            ~CInputRecorder();
+
+            bool Open(const std::string &path);
+            void Install(GLFWwindow *window);
+            // Closes the current frame; call once per frame after NewFrame
+            void EndFrame(const ImGuiIO &io);
+            void Close();
+
+            [[nodiscard]] bool IsOpen() const { return out.is_open(); }
+
+        private:
+            static void OnCursorPos(GLFWwindow *, double x, double y);
+            static void OnMouseButton(GLFWwindow *, int button, int action, int mods);
+            static void OnScroll(GLFWwindow *, double dx, double dy);
+            static void OnKey(GLFWwindow *, int key, int scancode, int action, int mods);
+            static void OnChar(GLFWwindow *, unsigned int codepoint);
+            static void OnFocus(GLFWwindow *, int focused);
+            static void OnCursorEnter(GLFWwindow *, int entered);
+
+            void Byte(uint8_t v) { buffer.push_back(v); }
+            void Varint(uint64_t v);
+            void Float(float v);
+
+            static CInputRecorder *s_active;
+
+            std::ofstream out;
+            std::vector<uint8_t> buffer; // the frame being recorded
+            int lastWidth = 0, lastHeight = 0;
+            uint64_t frames = 0;
+    };
+
+    // Feeds a recording back through ImGui's IO event queue, one recorded
+    // frame per rendered frame, with the recorded delta times. Works with
+    // or without a window; with one, the Renderer keeps live input out of
+    // ImGui while a replay runs.
+    class CInputReplayer {
+        public:
+            bool Load(const std::string &path);
+
+            // Queues the next frame's events; returns its recorded delta time
+            // in seconds, or 0 once the recording is exhausted
+            float Apply(ImGuiIO &io);
+
+            [[nodiscard]] bool Finished() const { return pos >= data.size(); }
+            [[nodiscard]] uint64_t FrameCount() const { return frameCount; }
+
+        private:
+            // Consumes one frame, queueing its events on `io` unless it is
+            // null; false when no complete frame is left
+            bool Next(ImGuiIO *io, float &dt);
+            bool ReadByte(uint8_t &v);
+            bool ReadVarint(uint64_t &v);
+            bool ReadFloat(float &v);
+            void SyncModifiers(ImGuiIO &io);
+
+            std::vector<uint8_t> data;
+            std::size_t pos = 0;
+            uint64_t frameCount = 0;
+            bool ctrl[2] = {}, shift[2] = {}, alt[2] = {}, super[2] = {}; // left, right
+    };
+}
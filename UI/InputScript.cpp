@@ -0,0 +1,118 @@
+#include "InputScript.h"
+#include "../Dependencies/ImGui/imgui.h"
+#include "UTILS/Logger.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+namespace GUI {
+
+    namespace {
+        ImGuiKey KeyFromName(const std::string &name) {
+            if (name == "Ctrl")
+                return ImGuiMod_Ctrl;
+            if (name == "Shift")
+                return ImGuiMod_Shift;
+            if (name == "Alt")
+                return ImGuiMod_Alt;
+            if (name == "Super")
+                return ImGuiMod_Super;
+            for (int k = ImGuiKey_NamedKey_BEGIN; k < ImGuiKey_NamedKey_END; k++)
+                if (name == ImGui::GetKeyName((ImGuiKey)k))
+                    return (ImGuiKey)k;
+            return ImGuiKey_None;
+        }
+
+        bool ParseState(const std::string &word, bool &down) {
+            if (word != "down" && word != "up")
+                return false;
+            down = word == "down";
+            return true;
+        }
+    }
+
+    bool CInputScript::Load(const std::string &path) {
+        std::ifstream in(path);
+        if (!in) {
+            LOG_ERROR(GUI, "Cannot open input script {}", path);
+            return false;
+        }
+
+        events.clear();
+        next = 0;
+        std::string line;
+        for (int lineNo = 1; std::getline(in, line); lineNo++) {
+            std::istringstream ls(line);
+            Event e;
+            std::string type;
+            if (!(ls >> e.frame))
+                continue; // blank or comment
+            ls >> type;
+
+            bool ok = true;
+            if (type == "mouse_pos") {
+                e.type = Type::MousePos;
+                ok = (bool)(ls >> e.x >> e.y);
+            } else if (type == "mouse_button") {
+                std::string state;
+                e.type = Type::MouseButton;
+                ok = (ls >> e.code >> state) && ParseState(state, e.down) && e.code >= 0 &&
+                     e.code < ImGuiMouseButton_COUNT;
+            } else if (type == "mouse_wheel") {
+                e.type = Type::MouseWheel;
+                ok = (bool)(ls >> e.x >> e.y);
+            } else if (type == "key") {
+                std::string name, state;
+                e.type = Type::Key;
+                ok = (ls >> name >> state) && ParseState(state, e.down);
+                e.code = ok ? (int)KeyFromName(name) : 0;
+                ok = ok && e.code != ImGuiKey_None;
+            } else if (type == "text") {
+                e.type = Type::Text;
+                std::getline(ls >> std::ws, e.text);
+            } else if (type == "resize") {
+                e.type = Type::Resize;
+                ok = (bool)(ls >> e.x >> e.y);
+            } else {
+                ok = false;
+            }
+
+            if (!ok) {
+                LOG_ERROR(GUI, "{}:{}: cannot parse input event '{}'", path, lineNo, line);
+                return false;
+            }
+            events.push_back(std::move(e));
+        }
+
+        std::stable_sort(events.begin(), events.end(),
+                         [](const Event &a, const Event &b) { return a.frame < b.frame; });
+        LOG_INFO(GUI, "Loaded {} input events from {}", events.size(), path);
+        return true;
+    }
+
+    void CInputScript::Apply(int frame, ImGuiIO &io) {
+        for (; next < events.size() && events[next].frame <= frame; next++) {
+            const Event &e = events[next];
+            switch (e.type) {
+                case Type::MousePos:
+                    io.AddMousePosEvent(e.x, e.y);
+                    break;
+                case Type::MouseButton:
+                    io.AddMouseButtonEvent(e.code, e.down);
+                    break;
+                case Type::MouseWheel:
+                    io.AddMouseWheelEvent(e.x, e.y);
+                    break;
+                case Type::Key:
+                    io.AddKeyEvent((ImGuiKey)e.code, e.down);
+                    break;
+                case Type::Text:
+                    io.AddInputCharactersUTF8(e.text.c_str());
+                    break;
+                case Type::Resize:
+                    io.DisplaySize = ImVec2(e.x, e.y);
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <string>
+#include <vector>
+
+struct ImGuiIO;
+
+namespace GUI {
+
+    // Scripted input for headless runs, one event per line, applied through
+    // ImGui's IO event queue right before the NewFrame of its frame:
+    //
+    //   # frame event args...
+    //   0   resize 1280 720
+    //   10  mouse_pos 400 300
+    //   11  mouse_button 0 down
+    //   12  mouse_button 0 up
+    //   20  mouse_wheel 0 -1
+    //   30  key Ctrl down          (ImGui key names, plus Ctrl/Shift/Alt/Super)
+    //   31  key S down
+    //   40  text hello world       (the rest of the line)
+    //
+    // resize only matters headless; with a window GLFW owns the display size.
+    class CInputScript {
+        public:
+            // Needs a live ImGui context to resolve key names
+            bool Load(const std::string &path);
+
+            // Queues every event scheduled for `frame`; call once per frame, in order
+            void Apply(int frame, ImGuiIO &io);
+
+            [[nodiscard]] bool Empty() const { return events.empty(); }
+            // True once every event has been applied
+            [[nodiscard]] bool Finished() const { return next >= events.size(); }
+
+        private:
+            enum class Type { MousePos, MouseButton, MouseWheel, Key, Text, Resize };
+
+            struct Event {
+                int frame = 0;
+                Type type = Type::MousePos;
+                float x = 0.0f, y = 0.0f; // position, wheel delta or size
+                int code = 0;             // mouse button or ImGuiKey
+                bool down = false;
+                std::string text;
+            };
+
+            std::vector<Event> events; // sorted by frame
+            std::size_t next = 0;
+    };
+}
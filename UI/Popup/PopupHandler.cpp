@@ -1,6 +1,5 @@
 #include "PopupHandler.h"
-#include "../../Dependencies/fmt/fmt/color.h"
-#include "../../Dependencies/fmt/fmt/core.h"
+#include "../../UTILS/Logger.h"
 #include <memory>
 
 std::vector<std::shared_ptr<IPopup>> CPopupHandler::popup_array;
@@ -11,9 +10,8 @@ void CPopupHandler::AddPopup(std::shared_ptr<IPopup> popup) {
 
 void CPopupHandler::RemovePopup(const unsigned int index) {
   if (index >= popup_array.size()) {
-    fmt::print(fg(fmt::color::red),
-               "RemovePopup array, index {}, max_size {}!\nInvalid!", index,
-               popup_array.size());
+    LOG_ERROR(GUI, "RemovePopup array, index {}, max_size {}! Invalid!", index,
+              popup_array.size());
     return;
   }
   popup_array.erase(popup_array.begin() + index);
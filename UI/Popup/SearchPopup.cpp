@@ -1,7 +1,6 @@
 #include "SearchPopup.h"
-#include "../../Dependencies/fmt/fmt/color.h"
-#include "../../Dependencies/fmt/fmt/core.h"
 #include "../../MATH/Vector2D.h"
+#include "../../UTILS/Logger.h"
 #include "../Renderer.h"
 #include "imgui.h"
 
@@ -62,8 +61,7 @@ void CSearchPopup::Draw() {
 
 void CSearchPopup::SetVisible() {
   if (!this->was_instanciated) {
-    fmt::print(fg(fmt::color::red),
-               "CSearchPopup::Render was not called!\nReturning...\n");
+    LOG_ERROR(GUI, "CSearchPopup::Render was not called! Returning...");
     return;
   }
   ImGui::OpenPopup(
@@ -72,9 +70,7 @@ void CSearchPopup::SetVisible() {
 
 void CSearchPopup::Close() {
   if (!this->was_instanciated) {
-  fmt:
-    print(fg(fmt::color::red),
-          "CSearchPopup::Render was not called!\nReturning...\n");
+    LOG_ERROR(GUI, "CSearchPopup::Render was not called! Returning...");
     return;
   }
   ImGui::CloseCurrentPopup(); // This is a limitation of the current ImGui Popup
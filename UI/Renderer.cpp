@@ -1,7 +1,6 @@
 #include "./Renderer.h"
 #include "../Dependencies/ImGui/imgui_impl_glfw.h"
 #include "../Dependencies/ImGui/imgui_impl_opengl3.h"
-#include "../Dependencies/fmt/fmt/color.h"
 #include "../Dependencies/glfw/include/GLFW/glfw3.h"
 #include "./CMainWindow.h"
 #include "./ScriptPlayground/ScriptPlayground.h"
@@ -12,9 +11,36 @@
 #include "MATH/Vector2D.h"
 #include "SettingsMenu.h"
 #include "UI/IWindow.h"
+#include "UTILS/Logger.h"
+#include "../Dependencies/json/json.hpp"
+#include <algorithm>
+#include <fstream>
 #include <memory>
 
 GUI::Renderer *GUI::Renderer::renderer = nullptr;
+
+namespace {
+    // Per-frame CPU times plus their summary, for comparing two builds on
+    // the same replay
+    void WriteFrameTimings(const std::string &path, std::vector<float> frames) {
+        nlohmann::json doc;
+        doc["frame_ms"] = frames;
+        doc["frames"] = frames.size();
+        std::sort(frames.begin(), frames.end());
+        auto pct = [&frames](double p) {
+            return frames.empty() ? 0.0f : frames[std::min(frames.size() - 1, (std::size_t)(p * frames.size()))];
+        };
+        doc["p50_ms"] = pct(0.50);
+        doc["p95_ms"] = pct(0.95);
+        doc["p99_ms"] = pct(0.99);
+        doc["max_ms"] = frames.empty() ? 0.0f : frames.back();
+
+        std::ofstream out(path, std::ios::trunc);
+        out << doc.dump(1) << '\n';
+        if (!out)
+            LOG_ERROR(GUI, "Cannot write frame timings to {}", path);
+    }
+}
 GUI::FontPack GUI::Renderer::fonts;
 
 // Have the singleton declaration
@@ -25,39 +51,81 @@ GUI::Renderer *GUI::Renderer::Get() {
     return renderer;
 }
 
-void GUI::Renderer::Initialize() {
-    ::glfwSetErrorCallback([](int error, const char *description) -> void {
-        fmt::print(fg(fmt::color::red), "[ERROR] {}\n", description);
-    });
+void GUI::Renderer::Destroy() {
+    delete renderer;
+    renderer = nullptr;
+}
 
-    if (!glfwInit()) {
+void GUI::Renderer::Initialize(const RendererOptions &options) {
+    if (!Setup(options))
         return;
-    }
 
-    auto glsl_version = "#version 130";
-    ::glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    ::glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+    while (!ShouldClose())
+        RenderFrame();
+
+    Shutdown();
+}
+
+bool GUI::Renderer::Setup(const RendererOptions &options) {
+    this->options = options;
+    frameIndex = 0;
+    frameTimeTotalMs = 0.0;
+    closeRequested = false;
     CImageLoader::CreateThreadPool(4);
 
-    window = ::glfwCreateWindow(this->windowedWidth, this->windowedHeight,
-                                "Desktop", nullptr, nullptr);
-    if (window == nullptr)
-        return;
+    if (options.headless) {
+        if (!SetupHeadless())
+            return false;
+    } else {
+        ::glfwSetErrorCallback([](int error, const char *description) -> void {
+            LOG_ERROR(GUI, "GLFW error {}: {}", error, description);
+        });
 
-    ::glfwMakeContextCurrent(window);
-    ::glfwSwapInterval(1); // Enable vsync
+        if (!glfwInit()) {
+            LOG_ERROR(GUI, "glfwInit failed");
+            return false;
+        }
 
-    IMGUI_CHECKVERSION();
-    ImGui::CreateContext();
-    ImGuiIO &io = ImGui::GetIO();
-    (void)io;
-    fonts = GUI::LoadFonts();
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard; // Keyboard
-    io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;  // Controller
-    ImGui::StyleColorsDark();
-    SetupModernImGuiStyle();
-    ImGui_ImplGlfw_InitForOpenGL(window, true);
-    ImGui_ImplOpenGL3_Init(glsl_version);
+        auto glsl_version = "#version 130";
+        ::glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+        ::glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+        window = ::glfwCreateWindow(this->windowedWidth, this->windowedHeight,
+                                    "Desktop", nullptr, nullptr);
+        if (window == nullptr) {
+            LOG_ERROR(GUI, "Failed to create the main window");
+            ::glfwTerminate();
+            return false;
+        }
+
+        ::glfwMakeContextCurrent(window);
+        ::glfwSwapInterval(1); // Enable vsync
+
+        // Before the ImGui backend installs its callbacks, so it chains to ours
+        if (!options.recordFile.empty() && recorder.Open(options.recordFile))
+            recorder.Install(window);
+
+        IMGUI_CHECKVERSION();
+        ImGui::CreateContext();
+        ImGuiIO &io = ImGui::GetIO();
+        fonts = GUI::LoadFonts();
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard; // Keyboard
+        io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad;  // Controller
+        ImGui::StyleColorsDark();
+        SetupModernImGuiStyle();
+        // During a replay the recording is the only input, so the backend
+        // gets no callbacks to forward live events with
+        ImGui_ImplGlfw_InitForOpenGL(window, options.replayFile.empty());
+        ImGui_ImplOpenGL3_Init(glsl_version);
+    }
+
+    if (!options.inputFile.empty() && !input.Load(options.inputFile))
+        return false;
+    if (!options.replayFile.empty() && !replayer.Load(options.replayFile))
+        return false;
+    if (options.headless && !options.recordFile.empty())
+        LOG_WARN(GUI, "Nothing to record without a window, ignoring {}", options.recordFile);
+    frameTimesMs.clear();
 
     Windows.push_back(std::make_shared<CMainWindow>());
 
@@ -68,45 +136,122 @@ void GUI::Renderer::Initialize() {
     std::shared_ptr<IWindow> settingsWindow(settingsMenu);
     Windows.push_back(settingsWindow);
 
-    glfwSetFramebufferSizeCallback(window, WindowResizedCallback);
+    if (window)
+        glfwSetFramebufferSizeCallback(window, WindowResizedCallback);
 
     // Automatically load last saved settings
     SettingsMenu::GetInstance()->settings_state.LoadSettings();
+    lastFrame = std::chrono::steady_clock::now();
+    return true;
+}
+
+// ImGui without platform or renderer backend: the display size is fixed
+// (or set by the input script), the font atlas is built but never uploaded
+// and images skip their GL upload.
+bool GUI::Renderer::SetupHeadless() {
+    CImage::SetGpuUploads(false);
+
+    IMGUI_CHECKVERSION();
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    fonts = GUI::LoadFonts();
+    io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
+    io.BackendPlatformName = "headless";
+    io.BackendRendererName = "null";
+    io.BackendFlags |= ImGuiBackendFlags_RendererHasVtxOffset;
+    io.DisplaySize = ImVec2((float)windowedWidth, (float)windowedHeight);
+    io.IniFilename = nullptr;
+    ImGui::StyleColorsDark();
+    SetupModernImGuiStyle();
 
-    while (!::glfwWindowShouldClose(window)) {
+    unsigned char *pixels;
+    int w, h;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &w, &h);
+    LOG_INFO(GUI, "Running headless at {}x{}", windowedWidth, windowedHeight);
+    return true;
+}
+
+bool GUI::Renderer::ShouldClose() const {
+    if (closeRequested)
+        return true;
+    if (options.maxFrames > 0 && frameIndex >= options.maxFrames)
+        return true;
+    // Without a frame limit a replay ends with its recording
+    if (options.maxFrames <= 0 && !options.replayFile.empty() && replayer.Finished())
+        return true;
+    if (options.headless)
+        // ... and a scripted run with its script
+        return options.maxFrames <= 0 && !input.Empty() && input.Finished();
+    return ::glfwWindowShouldClose(window) != 0;
+}
+
+// Applies scripted or replayed input and, with a fixed timestep or a
+// replay, overrides the delta the backend measured so every run advances
+// time identically
+void GUI::Renderer::BeginFrameClock() {
+    ImGuiIO &io = ImGui::GetIO();
+    const auto now = std::chrono::steady_clock::now();
+    if (options.headless)
+        io.DeltaTime = std::max(1e-6f, std::chrono::duration<float>(now - lastFrame).count());
+    lastFrame = now;
+
+    if (!options.replayFile.empty()) {
+        // The backend still polls the cursor of a focused window and the
+        // gamepads on its own; those events are live input too
+        io.ClearEventsQueue();
+        const float recorded = replayer.Apply(io);
+        if (recorded > 0.0f)
+            io.DeltaTime = recorded;
+    }
+    if (options.fixedTimestep > 0.0f)
+        io.DeltaTime = options.fixedTimestep;
+
+    input.Apply(frameIndex, io);
+}
+
+void GUI::Renderer::RenderFrame() {
+    const auto frameStart = std::chrono::steady_clock::now();
+
+    if (window) {
         ::glfwPollEvents();
         if (::glfwGetWindowAttrib(window, GLFW_ICONIFIED) != 0) {
             ImGui_ImplGlfw_Sleep(10);
-            continue;
+            return;
         }
+    }
 
-        {
-            GuiTaskQueue::Task job;
-            while (g_guiTasks.pop(job)) // non-blocking drain
-                job();                    // executes on GUI thread
-        }
+    {
+        GuiTaskQueue::Task job;
+        while (g_guiTasks.pop(job)) // non-blocking drain
+            job();                    // executes on GUI thread
+    }
 
-        static bool f11KeyPressed = false;
-        if (glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS) {
-            if (!f11KeyPressed) { // Assuming f11KeyPressed is your class member
-                ToggleFullscreen();
-                f11KeyPressed = true;
-            }
-        } else {
-            f11KeyPressed = false;
+    static bool f11KeyPressed = false;
+    if (window && glfwGetKey(window, GLFW_KEY_F11) == GLFW_PRESS) {
+        if (!f11KeyPressed) {
+            ToggleFullscreen();
+            f11KeyPressed = true;
         }
+    } else {
+        f11KeyPressed = false;
+    }
 
-        SCR::CScripting::PollThreads();
+    SCR::CScripting::PollThreads();
+    if (window) {
         ImGui_ImplOpenGL3_NewFrame();
         ImGui_ImplGlfw_NewFrame();
-        ImGui::NewFrame();
+    }
+    BeginFrameClock();
+    ImGui::NewFrame();
+    recorder.EndFrame(ImGui::GetIO());
 
-        // Render all the windows added to the list
-        for (const auto &it : Windows) {
-            it->Draw();
-        }
+    // Render all the windows added to the list
+    for (const auto &it : Windows) {
+        it->Draw();
+    }
 
-        ImGui::Render();
+    ImGui::Render();
+    if (window) {
         int display_w, display_h;
         ::glfwGetFramebufferSize(window, &display_w, &display_h);
         ::glViewport(0, 0, display_w, display_h);
@@ -117,12 +262,37 @@ void GUI::Renderer::Initialize() {
         ::glfwSwapBuffers(window);
     }
 
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
+    frameIndex++;
+    const double frameMs =
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+    frameTimeTotalMs += frameMs;
+    if (!options.timingsFile.empty())
+        frameTimesMs.push_back((float)frameMs);
+}
+
+void GUI::Renderer::Shutdown() {
+    if (frameIndex > 0 && (options.headless || options.maxFrames > 0 || !options.replayFile.empty()))
+        LOG_INFO(GUI, "{} frames, {:.3f} ms per frame on average", frameIndex, frameTimeTotalMs / frameIndex);
+    if (!options.timingsFile.empty())
+        WriteFrameTimings(options.timingsFile, frameTimesMs);
+    recorder.Close();
+
+    if (window) {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+    }
     ImGui::DestroyContext();
 
-    ::glfwDestroyWindow(window);
-    ::glfwTerminate();
+    if (window) {
+        ::glfwDestroyWindow(window);
+        window = nullptr;
+        ::glfwTerminate();
+    }
+}
+
+void GUI::Renderer::SetSwapInterval(int interval) {
+    if (window)
+        ::glfwSwapInterval(interval);
 }
 
 void GUI::Renderer::SetupModernImGuiStyle() {
@@ -251,6 +421,9 @@ void GUI::Renderer::ToggleFullscreen() {
     static bool cached = false;
     static int wx, wy, ww, wh;
 
+    if (!window)
+        return;
+
     if (glfwGetWindowMonitor(window)) // currently fullscreen
     {
         glfwSetWindowMonitor(window, nullptr, wx, wy, ww, wh, 0);
@@ -275,6 +448,10 @@ void GUI::Renderer::PushWindow(std::shared_ptr<GUI::IWindow> window) {
 }
 
 MATH::Vector2D<int> GUI::Renderer::GetSystemWindowSize() const {
+    if (!window) {
+        const ImVec2 size = ImGui::GetIO().DisplaySize;
+        return MATH::Vector2D<int>{(int)size.x, (int)size.y};
+    }
     int w, h;
     glfwGetWindowSize(window, &w, &h);
     return MATH::Vector2D<int>{w, h};
@@ -1,19 +1,49 @@
 #pragma once
 #include "../MATH/Vector2D.h"
 #include "./IWindow.h"
+#include "./InputRecording.h"
+#include "./InputScript.h"
 #include "UI/Fonts.h"
+#include <chrono>
 #include <memory>
+#include <string>
 #include <vector>
 struct GLFWwindow;
 
 namespace GUI {
+    // How the main loop runs; the defaults are the interactive app
+    struct RendererOptions {
+        // No window and no GL: ImGui frames, window Draw calls and JS draw
+        // callbacks still run, nothing is submitted
+        bool headless = false;
+        int maxFrames = 0;          // stop after this many frames, 0 = no limit
+        float fixedTimestep = 0.0f; // seconds per frame, 0 = wall clock
+        std::string inputFile;      // CInputScript events, applied in any mode
+        std::string recordFile;     // capture GLFW input to a .nxir recording
+        std::string replayFile;     // feed a .nxir recording back, frame by frame
+        std::string timingsFile;    // per-frame CPU times as JSON at shutdown
+    };
+
     class Renderer {
         public:
             static Renderer *Get();
-            void Initialize();
+            static void Destroy(); // after Shutdown, frees the windows and the singleton
+            // Setup, the main loop until the window closes, then Shutdown
+            void Initialize(const RendererOptions &options = {});
+
+            // The pieces of Initialize, for tools that drive the loop
+            // themselves. Setup returns false when there is no window.
+            bool Setup(const RendererOptions &options = {});
+            void RenderFrame();
+            [[nodiscard]] bool ShouldClose() const;
+            void Shutdown();
+            void RequestClose() { closeRequested = true; } // ends the loop after this frame
+            void SetSwapInterval(int interval); // 0 disables vsync
+
             static Renderer *renderer;
             [[nodiscard]] MATH::Vector2D<int> GetSystemWindowSize() const;
             void PushWindow(std::shared_ptr<GUI::IWindow> window);
+            [[nodiscard]] std::size_t GetWindowCount() const { return Windows.size(); }
 
             IWindow *GetMainWindow() {
                 if (!Windows.empty()) {
@@ -26,12 +56,25 @@ namespace GUI {
             void SetupModernImGuiStyle();
             void ToggleFullscreen();
             bool isFullscreen = false;
+            [[nodiscard]] bool IsHeadless() const { return options.headless; }
 
     private:
         Renderer() = default;
         std::vector<std::shared_ptr<IWindow>> Windows; // This stores the windows
         GLFWwindow *window = nullptr;
         static void WindowResizedCallback(GLFWwindow *, int width, int height);
+        bool SetupHeadless();
+        void BeginFrameClock();
+
+        RendererOptions options;
+        CInputScript input;
+        CInputRecorder recorder;
+        CInputReplayer replayer;
+        std::vector<float> frameTimesMs; // only kept when timingsFile is set
+        int frameIndex = 0;
+        bool closeRequested = false;
+        double frameTimeTotalMs = 0.0;
+        std::chrono::steady_clock::time_point lastFrame;
         int windowedWidth = 1280;
         int windowedHeight = 720;
         int windowedPosX = 100;
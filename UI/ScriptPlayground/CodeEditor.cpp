@@ -0,0 +1,794 @@
+#include "CodeEditor.h"
+#include "./Dependencies/ImGui/imgui_internal.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstring>
+#include <unordered_set>
+
+namespace GUI {
+    namespace {
+        const std::unordered_set<std::string_view> kKeywords = {
+                "async", "await", "break", "case", "catch", "class", "const", "continue",
+                "debugger", "default", "delete", "do", "else", "export", "extends", "finally",
+                "for", "from", "function", "get", "if", "import", "in", "instanceof", "let",
+                "new", "of", "return", "set", "static", "super", "switch", "throw", "try",
+                "typeof", "var", "void", "while", "with", "yield"};
+
+        const std::unordered_set<std::string_view> kLiterals = {
+                "true", "false", "null", "undefined", "this", "NaN", "Infinity"};
+
+        const ImU32 kTokenColours[(int)JsToken::Count] = {
+                IM_COL32(220, 220, 220, 255), // Text
+                IM_COL32(86, 156, 214, 255),  // Keyword
+                IM_COL32(197, 134, 192, 255), // Literal
+                IM_COL32(181, 206, 168, 255), // Number
+                IM_COL32(206, 145, 120, 255), // String
+                IM_COL32(106, 153, 85, 255),  // Comment
+                IM_COL32(209, 105, 105, 255), // Regex
+                IM_COL32(180, 180, 180, 255), // Punct
+        };
+
+        bool IsIdentStart(unsigned char c) {
+            return std::isalpha(c) || c == '_' || c == '$' || c >= 0x80;
+        }
+
+        bool IsIdentChar(unsigned char c) {
+            return IsIdentStart(c) || std::isdigit(c);
+        }
+
+        // Returns the index just past the closing quote, or the line length
+        std::size_t ScanQuoted(std::string_view s, std::size_t i, char quote, bool &closed) {
+            while (i < s.size()) {
+                if (s[i] == '\\') {
+                    i += 2;
+                } else if (s[i] == quote) {
+                    closed = true;
+                    return i + 1;
+                } else {
+                    ++i;
+                }
+            }
+            closed = false;
+            return s.size();
+        }
+
+        // Index past the closing '/' of a regex body starting at `i`, npos if
+        // the line ends first (then it was a division after all)
+        std::size_t ScanRegex(std::string_view s, std::size_t i) {
+            bool inClass = false;
+            while (i < s.size()) {
+                const char c = s[i];
+                if (c == '\\') {
+                    i += 2;
+                    continue;
+                }
+                if (c == '[')
+                    inClass = true;
+                else if (c == ']')
+                    inClass = false;
+                else if (c == '/' && !inClass)
+                    return i + 1;
+                ++i;
+            }
+            return std::string_view::npos;
+        }
+
+        std::string NormalizeNewlines(std::string_view text) {
+            std::string out;
+            out.reserve(text.size());
+            for (std::size_t i = 0; i < text.size(); i++) {
+                if (text[i] == '\r') {
+                    if (i + 1 < text.size() && text[i + 1] == '\n')
+                        continue;
+                    out.push_back('\n');
+                } else {
+                    out.push_back(text[i]);
+                }
+            }
+            return out;
+        }
+    } // namespace
+
+    JsLexState TokenizeJsLine(std::string_view s, JsLexState state, std::vector<JsSpan> &out) {
+        out.clear();
+        const std::size_t n = s.size();
+        std::size_t i = 0;
+
+        auto emit = [&out](std::size_t b, std::size_t e, JsToken kind) {
+            if (e <= b)
+                return;
+            if (kind == JsToken::Punct && !out.empty() && out.back().kind == JsToken::Punct &&
+                out.back().start + out.back().length == b) {
+                out.back().length += (uint32_t)(e - b);
+                return;
+            }
+            out.push_back({(uint32_t)b, (uint32_t)(e - b), kind});
+        };
+
+        if (state == JsLexState::BlockComment) {
+            const std::size_t end = s.find("*/");
+            if (end == std::string_view::npos) {
+                emit(0, n, JsToken::Comment);
+                return JsLexState::BlockComment;
+            }
+            i = end + 2;
+            emit(0, i, JsToken::Comment);
+        } else if (state == JsLexState::Template) {
+            bool closed;
+            i = ScanQuoted(s, 0, '`', closed);
+            emit(0, i, JsToken::String);
+            if (!closed)
+                return JsLexState::Template;
+        }
+
+        // A '/' starts a regex unless it follows something that has a value
+        bool regexAllowed = true;
+        while (i < n) {
+            const unsigned char c = s[i];
+            if (c == ' ' || c == '\t' || c == '\r') {
+                ++i;
+                continue;
+            }
+
+            const std::size_t b = i;
+            const char next = i + 1 < n ? s[i + 1] : '\0';
+
+            if (c == '/' && next == '/') {
+                emit(b, n, JsToken::Comment);
+                break;
+            }
+            if (c == '/' && next == '*') {
+                const std::size_t end = s.find("*/", i + 2);
+                if (end == std::string_view::npos) {
+                    emit(b, n, JsToken::Comment);
+                    return JsLexState::BlockComment;
+                }
+                i = end + 2;
+                emit(b, i, JsToken::Comment);
+                continue;
+            }
+            if (c == '"' || c == '\'' || c == '`') {
+                bool closed;
+                i = ScanQuoted(s, i + 1, (char)c, closed);
+                emit(b, i, JsToken::String);
+                if (c == '`' && !closed)
+                    return JsLexState::Template;
+                regexAllowed = false;
+                continue;
+            }
+            if (std::isdigit(c) || (c == '.' && std::isdigit((unsigned char)next))) {
+                const bool hex = c == '0' && (next == 'x' || next == 'X');
+                ++i;
+                while (i < n) {
+                    const unsigned char d = s[i];
+                    const bool exponentSign = !hex && (d == '+' || d == '-') && (s[i - 1] == 'e' || s[i - 1] == 'E');
+                    if (!std::isalnum(d) && d != '_' && d != '.' && !exponentSign)
+                        break;
+                    ++i;
+                }
+                emit(b, i, JsToken::Number);
+                regexAllowed = false;
+                continue;
+            }
+            if (IsIdentStart(c)) {
+                while (i < n && IsIdentChar((unsigned char)s[i]))
+                    ++i;
+                const std::string_view word = s.substr(b, i - b);
+                JsToken kind = JsToken::Text;
+                if (kKeywords.count(word))
+                    kind = JsToken::Keyword;
+                else if (kLiterals.count(word))
+                    kind = JsToken::Literal;
+                emit(b, i, kind);
+                regexAllowed = kind == JsToken::Keyword;
+                continue;
+            }
+            if (c == '/' && regexAllowed) {
+                const std::size_t end = ScanRegex(s, i + 1);
+                if (end != std::string_view::npos) {
+                    i = end;
+                    while (i < n && std::isalpha((unsigned char)s[i]))
+                        ++i;
+                    emit(b, i, JsToken::Regex);
+                    regexAllowed = false;
+                    continue;
+                }
+            }
+
+            ++i;
+            emit(b, i, JsToken::Punct);
+            regexAllowed = c != ')' && c != ']';
+        }
+        return JsLexState::Normal;
+    }
+
+    void CCodeEditor::SetText(std::string_view text) {
+        buffer.SetText(NormalizeNewlines(text));
+        lines.assign(buffer.LineCount(), LineInfo{});
+        lexPending = true;
+        lexFrom = 0;
+        lexTo = lines.size() - 1;
+
+        cursor = anchor = 0;
+        preferredX = -1.0f;
+        undoStack.clear();
+        redoStack.clear();
+        markers.clear();
+        mergeUndo = false;
+        maxLineWidth = 0.0f;
+        scrollToCursor = true;
+        wantFocus = true;
+        ++revision;
+    }
+
+    const std::string &CCodeEditor::LineText(std::size_t line) {
+        lineBuf.clear();
+        buffer.CopyRange(buffer.LineStart(line), buffer.LineLength(line), lineBuf);
+        return lineBuf;
+    }
+
+    void CCodeEditor::ApplyInsert(std::size_t pos, std::string_view text) {
+        if (text.empty())
+            return;
+        const std::size_t line = buffer.LineOfOffset(pos);
+        const std::size_t added = (std::size_t)std::count(text.begin(), text.end(), '\n');
+        buffer.Insert(pos, text);
+
+        lines[line].dirty = true;
+        if (added)
+            lines.insert(lines.begin() + line + 1, added, LineInfo{});
+
+        if (lexPending) {
+            if (lexTo > line)
+                lexTo += added;
+            lexFrom = std::min(lexFrom, line);
+            lexTo = std::max(lexTo, line + added);
+        } else {
+            lexFrom = line;
+            lexTo = line + added;
+            lexPending = true;
+        }
+        ++revision;
+    }
+
+    void CCodeEditor::ApplyErase(std::size_t pos, std::size_t len) {
+        if (len == 0)
+            return;
+        const std::size_t line = buffer.LineOfOffset(pos);
+        const std::size_t removed = buffer.LineOfOffset(pos + len) - line;
+        buffer.Erase(pos, len);
+
+        if (removed)
+            lines.erase(lines.begin() + line + 1, lines.begin() + line + 1 + removed);
+        lines[line].dirty = true;
+
+        if (lexPending) {
+            if (lexTo > line)
+                lexTo = lexTo >= line + removed ? lexTo - removed : line;
+            lexFrom = std::min(lexFrom, line);
+            lexTo = std::max(lexTo, line);
+        } else {
+            lexFrom = lexTo = line;
+            lexPending = true;
+        }
+        ++revision;
+    }
+
+    void CCodeEditor::EnsureLexed(std::size_t upto) {
+        if (!lexPending)
+            return;
+
+        for (std::size_t i = lexFrom; i < lines.size(); ++i) {
+            const JsLexState in = i == 0 ? JsLexState::Normal : lines[i - 1].stateOut;
+            LineInfo &info = lines[i];
+            if (!info.dirty && info.stateIn == in) {
+                // Past the damage and the carried state has settled
+                if (i > lexTo) {
+                    lexPending = false;
+                    return;
+                }
+                continue;
+            }
+            // Off screen for now, picked up when it scrolls into view
+            if (i > upto) {
+                lexFrom = i;
+                return;
+            }
+            info.stateIn = in;
+            info.stateOut = TokenizeJsLine(LineText(i), in, info.spans);
+            info.dirty = false;
+        }
+        lexPending = false;
+    }
+
+    void CCodeEditor::PushUndo(EditOp op, bool mergeable) {
+        redoStack.clear();
+        if (mergeable && mergeUndo && !undoStack.empty()) {
+            EditOp &last = undoStack.back();
+            // Consecutive typing
+            if (op.removed.empty() && last.removed.empty() &&
+                last.pos + last.inserted.size() == op.pos) {
+                last.inserted += op.inserted;
+                last.cursorAfter = op.cursorAfter;
+                return;
+            }
+            // Consecutive backspaces
+            if (op.inserted.empty() && last.inserted.empty() &&
+                op.pos + op.removed.size() == last.pos) {
+                last.removed.insert(0, op.removed);
+                last.pos = op.pos;
+                last.cursorAfter = op.cursorAfter;
+                return;
+            }
+        }
+        undoStack.push_back(std::move(op));
+        if (undoStack.size() > kMaxUndo)
+            undoStack.pop_front();
+        mergeUndo = mergeable;
+    }
+
+    void CCodeEditor::ReplaceSelection(std::string_view text) {
+        const std::size_t s = SelStart();
+        const std::size_t e = SelEnd();
+        if (s == e && text.empty())
+            return;
+
+        EditOp op{s, {}, std::string(text), cursor, s + text.size()};
+        if (e > s) {
+            buffer.CopyRange(s, e - s, op.removed);
+            ApplyErase(s, e - s);
+        }
+        ApplyInsert(s, text);
+        cursor = anchor = op.cursorAfter;
+        preferredX = -1.0f;
+        scrollToCursor = true;
+
+        const bool typing = op.removed.empty() && text.size() == 1 && text[0] != '\n';
+        PushUndo(std::move(op), typing);
+    }
+
+    void CCodeEditor::DeleteRange(std::size_t from, std::size_t to) {
+        if (to <= from)
+            return;
+        EditOp op{from, {}, {}, cursor, from};
+        buffer.CopyRange(from, to - from, op.removed);
+        ApplyErase(from, to - from);
+        cursor = anchor = from;
+        preferredX = -1.0f;
+        scrollToCursor = true;
+
+        const bool single = op.removed.size() <= 4 && op.removed.find('\n') == std::string::npos;
+        PushUndo(std::move(op), single);
+    }
+
+    void CCodeEditor::Undo() {
+        if (undoStack.empty())
+            return;
+        EditOp op = std::move(undoStack.back());
+        undoStack.pop_back();
+        ApplyErase(op.pos, op.inserted.size());
+        ApplyInsert(op.pos, op.removed);
+        cursor = anchor = op.cursorBefore;
+        redoStack.push_back(std::move(op));
+        mergeUndo = false;
+        scrollToCursor = true;
+    }
+
+    void CCodeEditor::Redo() {
+        if (redoStack.empty())
+            return;
+        EditOp op = std::move(redoStack.back());
+        redoStack.pop_back();
+        ApplyErase(op.pos, op.removed.size());
+        ApplyInsert(op.pos, op.inserted);
+        cursor = anchor = op.cursorAfter;
+        undoStack.push_back(std::move(op));
+        mergeUndo = false;
+        scrollToCursor = true;
+    }
+
+    std::size_t CCodeEditor::PrevCharPos(std::size_t pos) const {
+        if (pos == 0)
+            return 0;
+        --pos;
+        while (pos > 0 && ((unsigned char)buffer.At(pos) & 0xC0) == 0x80)
+            --pos;
+        return pos;
+    }
+
+    std::size_t CCodeEditor::NextCharPos(std::size_t pos) const {
+        if (pos >= buffer.Size())
+            return buffer.Size();
+        ++pos;
+        while (pos < buffer.Size() && ((unsigned char)buffer.At(pos) & 0xC0) == 0x80)
+            ++pos;
+        return pos;
+    }
+
+    std::size_t CCodeEditor::WordBoundary(std::size_t pos, bool forward) const {
+        auto cls = [](char c) {
+            if (c == ' ' || c == '\t')
+                return 0;
+            if (c == '\n')
+                return 1;
+            return IsIdentChar((unsigned char)c) ? 2 : 3;
+        };
+
+        if (forward) {
+            const std::size_t n = buffer.Size();
+            if (pos >= n)
+                return n;
+            const int start = cls(buffer.At(pos));
+            while (pos < n && cls(buffer.At(pos)) == start && start != 1)
+                ++pos;
+            if (start == 1)
+                ++pos;
+            while (pos < n && cls(buffer.At(pos)) == 0)
+                ++pos;
+            return pos;
+        }
+
+        if (pos == 0)
+            return 0;
+        while (pos > 0 && cls(buffer.At(pos - 1)) == 0)
+            --pos;
+        if (pos == 0)
+            return 0;
+        const int start = cls(buffer.At(pos - 1));
+        if (start == 1)
+            return pos - 1;
+        while (pos > 0 && cls(buffer.At(pos - 1)) == start)
+            --pos;
+        return pos;
+    }
+
+    void CCodeEditor::MoveCursor(std::size_t pos, bool select) {
+        cursor = std::min(pos, buffer.Size());
+        if (!select)
+            anchor = cursor;
+        mergeUndo = false;
+        scrollToCursor = true;
+    }
+
+    void CCodeEditor::MoveVertical(std::ptrdiff_t delta, bool select) {
+        const std::size_t line = buffer.LineOfOffset(cursor);
+        const std::string &text = LineText(line);
+        if (preferredX < 0.0f)
+            preferredX = Run(nullptr, 0.0f, 0.0f, 0, text.data(), text.data() + (cursor - buffer.LineStart(line)));
+
+        const std::ptrdiff_t last = (std::ptrdiff_t)buffer.LineCount() - 1;
+        const std::size_t target = (std::size_t)std::clamp((std::ptrdiff_t)line + delta, (std::ptrdiff_t)0, last);
+        const float keepX = preferredX;
+        MoveCursor(buffer.LineStart(target) + ColumnAtX(LineText(target), keepX), select);
+        preferredX = keepX;
+    }
+
+    float CCodeEditor::Run(ImDrawList *draw, float x, float y, ImU32 col, const char *begin, const char *end) const {
+        ImFont *font = ImGui::GetFont();
+        const float fontSize = ImGui::GetFontSize();
+        const float tabStop = font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, " ").x * kTabWidth;
+
+        while (begin < end) {
+            const char *tab = (const char *)std::memchr(begin, '\t', end - begin);
+            const char *segEnd = tab ? tab : end;
+            if (segEnd > begin) {
+                if (draw)
+                    draw->AddText(font, fontSize, ImVec2(x, y), col, begin, segEnd);
+                x += font->CalcTextSizeA(fontSize, FLT_MAX, 0.0f, begin, segEnd).x;
+            }
+            if (!tab)
+                break;
+            x = (std::floor(x / tabStop + 0.001f) + 1.0f) * tabStop;
+            begin = tab + 1;
+        }
+        return x;
+    }
+
+    std::size_t CCodeEditor::ColumnAtX(const std::string &line, float x) const {
+        const char *begin = line.data();
+        const char *end = begin + line.size();
+        const char *p = begin;
+        float penX = 0.0f;
+        while (p < end) {
+            unsigned int c;
+            const int len = ImTextCharFromUtf8(&c, p, end);
+            const float nextX = Run(nullptr, penX, 0.0f, 0, p, p + len);
+            if (x < (penX + nextX) * 0.5f)
+                break;
+            penX = nextX;
+            p += len;
+        }
+        return (std::size_t)(p - begin);
+    }
+
+    void CCodeEditor::HandleKeyboard() {
+        ImGuiIO &io = ImGui::GetIO();
+        const bool ctrl = io.KeyCtrl;
+        const bool shift = io.KeyShift;
+        const bool hasSel = cursor != anchor;
+        const std::size_t line = buffer.LineOfOffset(cursor);
+
+        if (ImGui::IsKeyPressed(ImGuiKey_LeftArrow)) {
+            if (hasSel && !shift)
+                MoveCursor(SelStart(), false);
+            else
+                MoveCursor(ctrl ? WordBoundary(cursor, false) : PrevCharPos(cursor), shift);
+            preferredX = -1.0f;
+        } else if (ImGui::IsKeyPressed(ImGuiKey_RightArrow)) {
+            if (hasSel && !shift)
+                MoveCursor(SelEnd(), false);
+            else
+                MoveCursor(ctrl ? WordBoundary(cursor, true) : NextCharPos(cursor), shift);
+            preferredX = -1.0f;
+        } else if (ImGui::IsKeyPressed(ImGuiKey_UpArrow)) {
+            MoveVertical(-1, shift);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow)) {
+            MoveVertical(1, shift);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_PageUp)) {
+            MoveVertical(-(std::ptrdiff_t)visibleLines, shift);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_PageDown)) {
+            MoveVertical((std::ptrdiff_t)visibleLines, shift);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Home)) {
+            if (ctrl) {
+                MoveCursor(0, shift);
+            } else {
+                // First press goes to the indentation, the second to column 0
+                const std::size_t start = buffer.LineStart(line);
+                const std::string &text = LineText(line);
+                const std::size_t indent = std::min(text.find_first_not_of(" \t"), text.size());
+                MoveCursor(cursor == start + indent ? start : start + indent, shift);
+            }
+            preferredX = -1.0f;
+        } else if (ImGui::IsKeyPressed(ImGuiKey_End)) {
+            MoveCursor(ctrl ? buffer.Size() : buffer.LineStart(line) + buffer.LineLength(line), shift);
+            preferredX = -1.0f;
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Backspace)) {
+            if (hasSel)
+                DeleteRange(SelStart(), SelEnd());
+            else
+                DeleteRange(ctrl ? WordBoundary(cursor, false) : PrevCharPos(cursor), cursor);
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Delete)) {
+            if (hasSel)
+                DeleteRange(SelStart(), SelEnd());
+            else
+                DeleteRange(cursor, ctrl ? WordBoundary(cursor, true) : NextCharPos(cursor));
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Enter) || ImGui::IsKeyPressed(ImGuiKey_KeypadEnter)) {
+            // Keep the indentation of the line being split
+            const std::string &text = LineText(buffer.LineOfOffset(SelStart()));
+            const std::size_t indent = std::min(text.find_first_not_of(" \t"), text.size());
+            ReplaceSelection("\n" + text.substr(0, indent));
+        } else if (ImGui::IsKeyPressed(ImGuiKey_Tab)) {
+            ReplaceSelection("\t");
+        } else if (ctrl && ImGui::IsKeyPressed(ImGuiKey_A)) {
+            anchor = 0;
+            cursor = buffer.Size();
+        } else if (ctrl && (ImGui::IsKeyPressed(ImGuiKey_C) || ImGui::IsKeyPressed(ImGuiKey_X))) {
+            if (hasSel) {
+                std::string text;
+                buffer.CopyRange(SelStart(), SelEnd() - SelStart(), text);
+                ImGui::SetClipboardText(text.c_str());
+                if (ImGui::IsKeyPressed(ImGuiKey_X))
+                    DeleteRange(SelStart(), SelEnd());
+            }
+        } else if (ctrl && ImGui::IsKeyPressed(ImGuiKey_V)) {
+            if (const char *clip = ImGui::GetClipboardText()) {
+                ReplaceSelection(NormalizeNewlines(clip));
+                mergeUndo = false;
+            }
+        } else if (ctrl && ImGui::IsKeyPressed(ImGuiKey_Z)) {
+            if (shift)
+                Redo();
+            else
+                Undo();
+        } else if (ctrl && ImGui::IsKeyPressed(ImGuiKey_Y)) {
+            Redo();
+        }
+
+        // AltGr arrives as Ctrl+Alt on Windows and still produces text
+        if (!ctrl || io.KeyAlt) {
+            for (ImWchar ch : io.InputQueueCharacters) {
+                if (ch < 0x20 || ch == 0x7F)
+                    continue;
+                char utf8[5];
+                ReplaceSelection(ImTextCharToUtf8(utf8, ch));
+            }
+        }
+        io.InputQueueCharacters.resize(0);
+    }
+
+    void CCodeEditor::Render(const char *id, const ImVec2 &size) {
+        ImGuiIO &io = ImGui::GetIO();
+
+        if (wantFocus) {
+            ImGui::SetNextWindowFocus();
+            wantFocus = false;
+            focused = true;
+        }
+
+        ImGui::PushStyleColor(ImGuiCol_ChildBg, ImGui::GetStyleColorVec4(ImGuiCol_FrameBg));
+        ImGui::BeginChild(id, size, ImGuiChildFlags_Borders,
+                          ImGuiWindowFlags_HorizontalScrollbar | ImGuiWindowFlags_NoMove |
+                          ImGuiWindowFlags_NoNavInputs);
+        ImGui::PopStyleColor();
+
+        if (!ImGui::IsWindowFocused())
+            focused = false;
+
+        const ImGuiID textId = ImGui::GetID("##text");
+        if (focused) {
+            // Keep Tab, arrows and Enter away from ImGui's keyboard navigation
+            for (ImGuiKey key : {ImGuiKey_Tab, ImGuiKey_LeftArrow, ImGuiKey_RightArrow, ImGuiKey_UpArrow,
+                                 ImGuiKey_DownArrow, ImGuiKey_PageUp, ImGuiKey_PageDown, ImGuiKey_Home,
+                                 ImGuiKey_End, ImGuiKey_Enter, ImGuiKey_KeypadEnter, ImGuiKey_Space})
+                ImGui::SetKeyOwner(key, textId);
+            ImGui::SetNextFrameWantCaptureKeyboard(true);
+
+            const uint64_t before = revision;
+            const std::size_t cursorBefore = cursor;
+            HandleKeyboard();
+            if (revision != before || cursor != cursorBefore)
+                lastInputTime = ImGui::GetTime();
+        }
+
+        ImDrawList *draw = ImGui::GetWindowDrawList();
+        const float fontSize = ImGui::GetFontSize();
+        lineHeight = ImGui::GetTextLineHeightWithSpacing();
+        const std::size_t lineCount = buffer.LineCount();
+
+        char digits[24];
+        snprintf(digits, sizeof(digits), "%zu", lineCount);
+        const float gutterWidth = ImGui::CalcTextSize(digits).x + fontSize * 1.5f;
+
+        const ImVec2 origin = ImGui::GetCursorScreenPos();
+        const float scrollX = ImGui::GetScrollX();
+        const float scrollY = ImGui::GetScrollY();
+        const float textX = origin.x + gutterWidth;
+        const float viewHeight = ImGui::GetWindowHeight();
+        visibleLines = std::max<std::size_t>(1, (std::size_t)(viewHeight / lineHeight));
+
+        // One item covering the whole document: gives the child its scroll
+        // extent and handles clicks and drags
+        const ImVec2 extent(std::max(1.0f, gutterWidth + maxLineWidth + fontSize * 2.0f),
+                            std::max(1.0f, lineCount * lineHeight));
+        ImGui::InvisibleButton("##text", extent);
+
+        auto offsetAtMouse = [&]() {
+            const float relY = io.MousePos.y - origin.y;
+            const std::size_t line = relY <= 0.0f ? 0 : std::min(lineCount - 1, (std::size_t)(relY / lineHeight));
+            return buffer.LineStart(line) + ColumnAtX(LineText(line), io.MousePos.x - textX);
+        };
+
+        if (ImGui::IsItemActivated()) {
+            focused = true;
+            const std::size_t pos = offsetAtMouse();
+            if (io.MouseClickedCount[ImGuiMouseButton_Left] >= 2) {
+                // Double click selects the identifier under the mouse
+                MoveCursor(pos, false);
+                while (anchor > 0 && IsIdentChar((unsigned char)buffer.At(anchor - 1)))
+                    --anchor;
+                while (cursor < buffer.Size() && IsIdentChar((unsigned char)buffer.At(cursor)))
+                    ++cursor;
+            } else {
+                MoveCursor(pos, io.KeyShift);
+            }
+            preferredX = -1.0f;
+            lastInputTime = ImGui::GetTime();
+        } else if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left, 0.0f)) {
+            MoveCursor(offsetAtMouse(), true);
+            preferredX = -1.0f;
+            lastInputTime = ImGui::GetTime();
+        }
+
+        const std::size_t cursorLine = buffer.LineOfOffset(cursor);
+        if (scrollToCursor) {
+            const float cursorY = cursorLine * lineHeight;
+            if (cursorY < scrollY)
+                ImGui::SetScrollY(cursorY);
+            else if (cursorY + lineHeight > scrollY + viewHeight - ImGui::GetStyle().ScrollbarSize)
+                ImGui::SetScrollY(cursorY + lineHeight - viewHeight + ImGui::GetStyle().ScrollbarSize);
+
+            const std::string &text = LineText(cursorLine);
+            const float cursorX = Run(nullptr, 0.0f, 0.0f, 0, text.data(), text.data() + (cursor - buffer.LineStart(cursorLine)));
+            const float viewWidth = ImGui::GetWindowWidth() - gutterWidth - fontSize;
+            if (cursorX < scrollX)
+                ImGui::SetScrollX(std::max(0.0f, cursorX - fontSize * 4.0f));
+            else if (cursorX > scrollX + viewWidth)
+                ImGui::SetScrollX(cursorX - viewWidth + fontSize * 4.0f);
+            scrollToCursor = false;
+        }
+
+        const std::size_t first = std::min(lineCount - 1, (std::size_t)(std::max(0.0f, scrollY) / lineHeight));
+        const std::size_t last = std::min(lineCount, first + visibleLines + 2);
+        EnsureLexed(last);
+
+        const ImVec2 clipMin = ImGui::GetWindowPos();
+        const ImVec2 clipMax(clipMin.x + ImGui::GetWindowWidth(), clipMin.y + viewHeight);
+        const float gutterX = origin.x + scrollX;
+        const float textOffsetY = (lineHeight - fontSize) * 0.5f;
+        const std::size_t selStart = SelStart();
+        const std::size_t selEnd = SelEnd();
+        const ImU32 selColour = ImGui::GetColorU32(ImGuiCol_TextSelectedBg);
+        const float spaceWidth = ImGui::CalcTextSize(" ").x;
+
+        // Text is clipped so horizontal scrolling slides it under the gutter
+        draw->PushClipRect(ImVec2(gutterX + gutterWidth - fontSize * 0.25f, clipMin.y), clipMax, true);
+        for (std::size_t i = first; i < last; i++) {
+            const float y = origin.y + i * lineHeight;
+            const std::size_t start = buffer.LineStart(i);
+            const std::string &text = LineText(i);
+            const char *data = text.data();
+
+            if (selEnd > start && selStart <= start + text.size() && selStart != selEnd) {
+                const std::size_t a = std::max(selStart, start) - start;
+                const std::size_t b = std::min(selEnd, start + text.size()) - start;
+                const float x0 = Run(nullptr, textX, 0.0f, 0, data, data + a);
+                float x1 = Run(nullptr, x0, 0.0f, 0, data + a, data + b);
+                if (selEnd > start + text.size())
+                    x1 += spaceWidth;
+                draw->AddRectFilled(ImVec2(x0, y), ImVec2(x1, y + lineHeight), selColour);
+            }
+
+            float x = textX;
+            std::size_t pos = 0;
+            for (const JsSpan &span : lines[i].spans) {
+                x = Run(nullptr, x, 0.0f, 0, data + pos, data + span.start);
+                x = Run(draw, x, y + textOffsetY, kTokenColours[(int)span.kind], data + span.start,
+                        data + span.start + span.length);
+                pos = span.start + span.length;
+            }
+            x = Run(nullptr, x, 0.0f, 0, data + pos, data + text.size());
+            maxLineWidth = std::max(maxLineWidth, x - textX);
+
+            if (focused && i == cursorLine && std::fmod(ImGui::GetTime() - lastInputTime, 1.2) < 0.6) {
+                const float cx = Run(nullptr, textX, 0.0f, 0, data, data + (cursor - start));
+                draw->AddLine(ImVec2(cx, y), ImVec2(cx, y + lineHeight), kTokenColours[(int)JsToken::Text], 1.0f);
+            }
+        }
+
+        // Error underlines
+        const ImU32 errorColour = IM_COL32(240, 80, 80, 255);
+        for (const Marker &marker : markers) {
+            if (marker.line < first || marker.line >= last)
+                continue;
+            const std::string &text = LineText(marker.line);
+            const std::size_t from = marker.column >= 0
+                                             ? std::min<std::size_t>(marker.column, text.size())
+                                             : std::min(text.find_first_not_of(" \t"), text.size());
+            const float x0 = Run(nullptr, textX, 0.0f, 0, text.data(), text.data() + from);
+            const float x1 = std::max(x0 + spaceWidth, Run(nullptr, x0, 0.0f, 0, text.data() + from, text.data() + text.size()));
+            const float y = origin.y + (marker.line + 1) * lineHeight - 2.0f;
+            draw->AddLine(ImVec2(x0, y), ImVec2(x1, y), errorColour, 1.5f);
+        }
+        draw->PopClipRect();
+
+        // Line numbers stay put while the text scrolls sideways
+        for (std::size_t i = first; i < last; i++) {
+            char num[24];
+            const int len = snprintf(num, sizeof(num), "%zu", i + 1);
+            const float w = ImGui::CalcTextSize(num, num + len).x;
+            const ImU32 col = ImGui::GetColorU32(i == cursorLine ? ImGuiCol_Text : ImGuiCol_TextDisabled);
+            draw->AddText(ImVec2(gutterX + gutterWidth - fontSize - w, origin.y + i * lineHeight + textOffsetY), col,
+                          num, num + len);
+        }
+
+        const float markerRadius = fontSize * 0.2f;
+        for (const Marker &marker : markers) {
+            if (marker.line < first || marker.line >= last)
+                continue;
+            const float rowY = origin.y + marker.line * lineHeight;
+            const ImVec2 centre(gutterX + markerRadius * 2.0f, rowY + lineHeight * 0.5f);
+            draw->AddCircleFilled(centre, markerRadius, errorColour);
+
+            const bool overRow = io.MousePos.y >= rowY && io.MousePos.y < rowY + lineHeight;
+            if (overRow && ImGui::IsWindowHovered() && io.MousePos.x < gutterX + gutterWidth) {
+                if (marker.column >= 0)
+                    ImGui::SetTooltip("Line %zu, column %d: %s", marker.line + 1, marker.column + 1, marker.message.c_str());
+                else
+                    ImGui::SetTooltip("Line %zu: %s", marker.line + 1, marker.message.c_str());
+            }
+        }
+
+        ImGui::EndChild();
+    }
+}
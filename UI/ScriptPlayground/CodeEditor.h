@@ -0,0 +1,141 @@
+#pragma once
+#include "./Dependencies/ImGui/imgui.h"
+#include "PieceTable.h"
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace GUI {
+
+    // What a line leaves open for the next one
+    enum class JsLexState : uint8_t {
+        Normal,
+        BlockComment,
+        Template
+    };
+
+    enum class JsToken : uint8_t {
+        Text,
+        Keyword,
+        Literal,
+        Number,
+        String,
+        Comment,
+        Regex,
+        Punct,
+        Count
+    };
+
+    struct JsSpan {
+        uint32_t start;
+        uint32_t length;
+        JsToken kind;
+    };
+
+    // Lexes a single line (no '\n') that starts in `state` into `out` and
+    // returns the state the following line starts in
+    JsLexState TokenizeJsLine(std::string_view line, JsLexState state, std::vector<JsSpan> &out);
+
+    // Script editor widget. Text lives in a CPieceTable, highlighting is
+    // cached per line and only damaged lines are lexed again (continuing
+    // downwards only while the carried lexer state keeps changing), and only
+    // the rows inside the scroll view are measured and drawn.
+    class CCodeEditor {
+        public:
+            // Diagnostic shown in the gutter; `line` is 0-based, `column` -1
+            // underlines the whole line
+            struct Marker {
+                std::size_t line;
+                int column;
+                std::string message;
+            };
+
+            void SetText(std::string_view text);
+            std::string GetText() const { return buffer.GetText(); }
+
+            void Render(const char *id, const ImVec2 &size);
+
+            // Increases on every edit, lets callers notice changes cheaply
+            uint64_t GetRevision() const { return revision; }
+            bool IsFocused() const { return focused; }
+            std::size_t GetLineCount() const { return buffer.LineCount(); }
+
+            void SetMarkers(std::vector<Marker> newMarkers) { markers = std::move(newMarkers); }
+            const std::vector<Marker> &GetMarkers() const { return markers; }
+
+            static constexpr std::size_t kMaxUndo = 1000;
+            static constexpr int kTabWidth = 4;
+
+        private:
+            struct LineInfo {
+                JsLexState stateIn = JsLexState::Normal;
+                JsLexState stateOut = JsLexState::Normal;
+                bool dirty = true;
+                std::vector<JsSpan> spans;
+            };
+
+            struct EditOp {
+                std::size_t pos;
+                std::string removed;
+                std::string inserted;
+                std::size_t cursorBefore;
+                std::size_t cursorAfter;
+            };
+
+            // Buffer edits that keep the line cache in step
+            void ApplyInsert(std::size_t pos, std::string_view text);
+            void ApplyErase(std::size_t pos, std::size_t len);
+
+            // User edits, recorded for undo
+            void ReplaceSelection(std::string_view text);
+            void DeleteRange(std::size_t from, std::size_t to);
+            void PushUndo(EditOp op, bool mergeable);
+            void Undo();
+            void Redo();
+
+            void EnsureLexed(std::size_t upto);
+
+            void HandleKeyboard();
+            void MoveCursor(std::size_t pos, bool select);
+            void MoveVertical(std::ptrdiff_t lines, bool select);
+            std::size_t PrevCharPos(std::size_t pos) const;
+            std::size_t NextCharPos(std::size_t pos) const;
+            std::size_t WordBoundary(std::size_t pos, bool forward) const;
+            std::size_t SelStart() const { return cursor < anchor ? cursor : anchor; }
+            std::size_t SelEnd() const { return cursor < anchor ? anchor : cursor; }
+            const std::string &LineText(std::size_t line);
+
+            // Pen position after drawing (or, with no draw list, measuring)
+            // [begin, end) from `x`, expanding tabs to tab stops
+            float Run(ImDrawList *draw, float x, float y, ImU32 col, const char *begin, const char *end) const;
+            std::size_t ColumnAtX(const std::string &line, float x) const;
+
+            CPieceTable buffer;
+            std::vector<LineInfo> lines{1};
+            bool lexPending = true;
+            std::size_t lexFrom = 0;
+            std::size_t lexTo = 0;
+
+            std::size_t cursor = 0;
+            std::size_t anchor = 0;
+            float preferredX = -1.0f;
+            bool scrollToCursor = false;
+            bool focused = false;
+            bool wantFocus = false;
+            bool mergeUndo = false;
+            double lastInputTime = 0.0;
+
+            std::deque<EditOp> undoStack;
+            std::vector<EditOp> redoStack;
+            uint64_t revision = 0;
+            std::vector<Marker> markers;
+
+            float lineHeight = 16.0f;
+            float maxLineWidth = 0.0f;
+            std::size_t visibleLines = 20;
+            std::string lineBuf;
+    };
+}
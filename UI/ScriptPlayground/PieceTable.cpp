@@ -0,0 +1,216 @@
+#include "PieceTable.h"
+#include <algorithm>
+
+namespace GUI {
+
+    void CPieceTable::SetText(std::string_view text) {
+        original.assign(text.data(), text.size());
+        added.clear();
+        pieces.clear();
+        if (!original.empty())
+            pieces.push_back({false, 0, original.size()});
+        length = original.size();
+        hintIndex = 0;
+        hintStart = 0;
+
+        lineStarts.assign(1, 0);
+        for (std::size_t i = 0; i < original.size(); i++)
+            if (original[i] == '\n')
+                lineStarts.push_back(i + 1);
+        shiftLine = 0;
+        shiftDelta = 0;
+    }
+
+    std::string CPieceTable::GetText() const {
+        std::string out;
+        out.reserve(length);
+        for (const Piece &p : pieces)
+            out.append(PieceData(p), p.length);
+        return out;
+    }
+
+    std::size_t CPieceTable::FindPiece(std::size_t pos, std::size_t &pieceStart) const {
+        if (pos >= length) {
+            pieceStart = length;
+            return pieces.size();
+        }
+
+        std::size_t i = hintIndex;
+        std::size_t s = hintStart;
+        if (i >= pieces.size()) {
+            i = 0;
+            s = 0;
+        }
+        while (pos < s) {
+            --i;
+            s -= pieces[i].length;
+        }
+        while (pos >= s + pieces[i].length) {
+            s += pieces[i].length;
+            ++i;
+        }
+
+        hintIndex = i;
+        hintStart = s;
+        pieceStart = s;
+        return i;
+    }
+
+    char CPieceTable::At(std::size_t pos) const {
+        std::size_t ps;
+        const std::size_t i = FindPiece(pos, ps);
+        if (i >= pieces.size())
+            return '\0';
+        return PieceData(pieces[i])[pos - ps];
+    }
+
+    void CPieceTable::CopyRange(std::size_t pos, std::size_t len, std::string &out) const {
+        if (pos >= length || len == 0)
+            return;
+        len = std::min(len, length - pos);
+
+        std::size_t ps;
+        std::size_t i = FindPiece(pos, ps);
+        std::size_t off = pos - ps;
+        while (len > 0 && i < pieces.size()) {
+            const std::size_t take = std::min(len, pieces[i].length - off);
+            out.append(PieceData(pieces[i]) + off, take);
+            len -= take;
+            off = 0;
+            ++i;
+        }
+    }
+
+    void CPieceTable::Insert(std::size_t pos, std::string_view text) {
+        if (text.empty())
+            return;
+        pos = std::min(pos, length);
+        const std::size_t line = LineOfOffset(pos);
+
+        const std::size_t addStart = added.size();
+        added.append(text.data(), text.size());
+        const Piece piece{true, addStart, text.size()};
+
+        std::size_t ps;
+        const std::size_t i = FindPiece(pos, ps);
+        if (pos == ps) {
+            // Typing right after the previous insert just grows that piece
+            Piece *prev = i > 0 ? &pieces[i - 1] : nullptr;
+            if (prev && prev->fromAdded && prev->start + prev->length == addStart) {
+                prev->length += text.size();
+                hintIndex = i - 1;
+                hintStart = ps - (prev->length - text.size());
+            } else {
+                pieces.insert(pieces.begin() + i, piece);
+                hintIndex = i;
+                hintStart = ps;
+            }
+        } else {
+            Piece &p = pieces[i];
+            const std::size_t off = pos - ps;
+            const Piece right{p.fromAdded, p.start + off, p.length - off};
+            p.length = off;
+            pieces.insert(pieces.begin() + i + 1, {piece, right});
+            hintIndex = i + 1;
+            hintStart = pos;
+        }
+        length += text.size();
+
+        std::vector<std::size_t> newStarts;
+        for (std::size_t k = 0; k < text.size(); k++)
+            if (text[k] == '\n')
+                newStarts.push_back(pos + k + 1);
+
+        if (newStarts.empty()) {
+            ShiftLinesAfter(line, (std::ptrdiff_t)text.size());
+        } else {
+            FlushLineShift();
+            lineStarts.insert(lineStarts.begin() + line + 1, newStarts.begin(), newStarts.end());
+            shiftLine = line + newStarts.size();
+            shiftDelta = (std::ptrdiff_t)text.size();
+        }
+    }
+
+    void CPieceTable::Erase(std::size_t pos, std::size_t len) {
+        if (pos >= length || len == 0)
+            return;
+        len = std::min(len, length - pos);
+        const std::size_t end = pos + len;
+
+        // Lines starting inside (pos, end] lose their newline and merge up
+        const std::size_t line = LineOfOffset(pos);
+        const std::size_t endLine = LineOfOffset(end);
+        if (endLine == line) {
+            ShiftLinesAfter(line, -(std::ptrdiff_t)len);
+        } else {
+            FlushLineShift();
+            lineStarts.erase(lineStarts.begin() + line + 1, lineStarts.begin() + endLine + 1);
+            shiftLine = line;
+            shiftDelta = -(std::ptrdiff_t)len;
+        }
+
+        std::size_t ps;
+        std::size_t i = FindPiece(pos, ps);
+        if (pos > ps) {
+            Piece &p = pieces[i];
+            const std::size_t off = pos - ps;
+            const Piece right{p.fromAdded, p.start + off, p.length - off};
+            p.length = off;
+            pieces.insert(pieces.begin() + i + 1, right);
+            ++i;
+        }
+
+        const std::size_t first = i;
+        std::size_t remaining = len;
+        while (remaining > 0 && i < pieces.size() && pieces[i].length <= remaining) {
+            remaining -= pieces[i].length;
+            ++i;
+        }
+        if (remaining > 0) {
+            pieces[i].start += remaining;
+            pieces[i].length -= remaining;
+        }
+        pieces.erase(pieces.begin() + first, pieces.begin() + i);
+        length -= len;
+
+        hintIndex = first < pieces.size() ? first : 0;
+        hintStart = first < pieces.size() ? pos : 0;
+    }
+
+    std::size_t CPieceTable::LineStart(std::size_t line) const {
+        return lineStarts[line] + (line > shiftLine ? shiftDelta : 0);
+    }
+
+    std::size_t CPieceTable::LineLength(std::size_t line) const {
+        const std::size_t end = line + 1 < lineStarts.size() ? LineStart(line + 1) - 1 : length;
+        return end - LineStart(line);
+    }
+
+    std::size_t CPieceTable::LineOfOffset(std::size_t pos) const {
+        std::size_t lo = 0;
+        std::size_t hi = lineStarts.size();
+        while (hi - lo > 1) {
+            const std::size_t mid = lo + (hi - lo) / 2;
+            if (LineStart(mid) <= pos)
+                lo = mid;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    void CPieceTable::FlushLineShift() const {
+        if (shiftDelta == 0)
+            return;
+        for (std::size_t j = shiftLine + 1; j < lineStarts.size(); j++)
+            lineStarts[j] += shiftDelta;
+        shiftDelta = 0;
+    }
+
+    void CPieceTable::ShiftLinesAfter(std::size_t line, std::ptrdiff_t delta) {
+        if (shiftDelta != 0 && shiftLine != line)
+            FlushLineShift();
+        shiftLine = line;
+        shiftDelta += delta;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace GUI {
+
+    // Text buffer for the script editor. The loaded file is never copied
+    // again: edits only append to `added` and split the piece list, so a
+    // keystroke costs the same in a 20 line script and a 20000 line one.
+    // Line starts are kept alongside so row <-> offset lookups stay cheap.
+    class CPieceTable {
+        public:
+            void SetText(std::string_view text);
+            std::string GetText() const;
+
+            void Insert(std::size_t pos, std::string_view text);
+            void Erase(std::size_t pos, std::size_t len);
+
+            std::size_t Size() const { return length; }
+            char At(std::size_t pos) const;
+
+            // Appends [pos, pos + len) to `out`
+            void CopyRange(std::size_t pos, std::size_t len, std::string &out) const;
+
+            std::size_t LineCount() const { return lineStarts.size(); }
+            std::size_t LineStart(std::size_t line) const;
+            // Length without the trailing '\n'
+            std::size_t LineLength(std::size_t line) const;
+            std::size_t LineOfOffset(std::size_t pos) const;
+
+            std::size_t PieceCount() const { return pieces.size(); }
+
+        private:
+            struct Piece {
+                bool fromAdded;
+                std::size_t start;
+                std::size_t length;
+            };
+
+            // Index of the piece holding `pos` and that piece's first offset.
+            // Walks from the last hit, so consecutive edits are O(1).
+            std::size_t FindPiece(std::size_t pos, std::size_t &pieceStart) const;
+            const char *PieceData(const Piece &p) const {
+                return (p.fromAdded ? added.data() : original.data()) + p.start;
+            }
+
+            void FlushLineShift() const;
+            void ShiftLinesAfter(std::size_t line, std::ptrdiff_t delta);
+
+            std::string original;
+            std::string added;
+            std::vector<Piece> pieces;
+            std::size_t length = 0;
+
+            mutable std::size_t hintIndex = 0;
+            mutable std::size_t hintStart = 0;
+
+            // Every start after `shiftLine` is off by `shiftDelta` until the
+            // next edit on another line folds it in; typing along one line
+            // never touches the rest of the index.
+            mutable std::vector<std::size_t> lineStarts{0};
+            mutable std::size_t shiftLine = 0;
+            mutable std::ptrdiff_t shiftDelta = 0;
+    };
+}
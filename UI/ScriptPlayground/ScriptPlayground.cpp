@@ -3,12 +3,18 @@
 #include "./Dependencies/ImGui/imgui_stdlib.h"
 #include "FS/MainFileSystem.h"
 #include "MATH/Vector2D.h"
+#include "Scripting/ScriptBenchmark.h"
+#include "Scripting/Scheduler.h"
 #include "Scripting/Scripting.h"
+#include "Scripting/SyntaxChecker.h"
 #include "UI/SettingsMenu.h"
+#include <algorithm>
 #include <cstdint>
 #include <filesystem>
 #include <fstream>
 #include <type_traits>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace GUI {
     std::array<FS::ScriptJS *, DESK_SLOTS> cellPtr{};
@@ -17,6 +23,16 @@ namespace GUI {
     static bool s_reload_pending = false;
     static std::string selected_path;
 
+    // Latest benchmark per script path, and the ones still running
+    static std::unordered_map<std::string, SCR::BenchmarkResult> s_bench_results;
+    static std::unordered_set<std::string> s_bench_running;
+    static int s_bench_runs = SCR::CScriptBenchmark::kDefaultRuns;
+
+    // Schedule being edited for the selected script
+    static std::string s_schedule_for;
+    static std::string s_schedule_text;
+    static std::string s_schedule_error;
+
     void CScriptPlayground::Draw() {
         static bool reload_pending = false;
 
@@ -54,7 +70,7 @@ namespace GUI {
                         isNewFile = true;
                         newFileName = "";
                         newFileName.clear();
-                        editorBuf.clear();
+                        editor.SetText("");
                     }
                     if (ImGui::MenuItem("Refresh Scripts")) {
                         FS::CFileSystem::LoadScripts();
@@ -123,12 +139,30 @@ namespace GUI {
                             filenamebackup = selected_script->name;
                             std::stringstream buf;
                             buf << scr.rdbuf();
-                            editorBuf = buf.str();
+                            editor.SetText(buf.str());
                             newFileName = selected_script->name;
                             showEditor = true;
                         }
                     }
 
+                    ImGui::SameLine();
+                    const bool benchRunning = s_bench_running.count(selected_script->fullpath) > 0;
+                    ImGui::BeginDisabled(benchRunning);
+                    if (ImGui::Button(benchRunning ? "Benchmarking..." : "Benchmark")) {
+                        const std::string path = selected_script->fullpath;
+                        s_bench_running.insert(path);
+                        SCR::CScriptBenchmark::RunAsync(selected_script->name, path, s_bench_runs,
+                                                        [path](SCR::BenchmarkResult r) {
+                                                            s_bench_running.erase(path);
+                                                            s_bench_results[path] = std::move(r);
+                                                        });
+                    }
+                    ImGui::EndDisabled();
+                    ImGui::SameLine();
+                    ImGui::SetNextItemWidth(ImGui::CalcTextSize("0000").x + ImGui::GetFrameHeight() * 2);
+                    if (ImGui::InputInt("Runs", &s_bench_runs))
+                        s_bench_runs = std::clamp(s_bench_runs, 1, 10000);
+
                     ImGui::SameLine();
                     if (ImGui::Button("Delete script"))
                         ImGui::OpenPopup("RemovePopup");
@@ -155,6 +189,9 @@ namespace GUI {
                         ImGui::SetCursorPosX((ImGui::GetWindowWidth() - bw) * 0.5f);
 
                         if (ImGui::Button("YES")) {
+                            SCR::CScheduler::Get().Remove(selected_script->fullpath);
+                            if (SettingsMenu::GetInstance()->settings_state.script_schedules.erase(selected_script->fullpath))
+                                SettingsMenu::GetInstance()->settings_state.MarkDirty();
                             std::filesystem::remove(selected_script->fullpath);
                             selected_path.clear();
                             FS::CFileSystem::LoadScripts();
@@ -169,6 +206,64 @@ namespace GUI {
                         ImGui::EndPopup();
                     }
 
+                    auto &schedules = SettingsMenu::GetInstance()->settings_state.script_schedules;
+                    if (s_schedule_for != selected_script->fullpath) {
+                        s_schedule_for = selected_script->fullpath;
+                        auto it = schedules.find(s_schedule_for);
+                        s_schedule_text = it != schedules.end() ? it->second : "";
+                        s_schedule_error.clear();
+                    }
+                    ImGui::SetNextItemWidth(ImGui::CalcTextSize("*/15 9-17 * * 1-5").x + ImGui::GetFrameHeight());
+                    ImGui::InputTextWithHint("##schedule", "30s or */5 * * * *", &s_schedule_text);
+                    ImGui::SameLine();
+                    if (ImGui::Button("Schedule")) {
+                        if (SCR::CScheduler::Get().Set(s_schedule_for, s_schedule_text, s_schedule_error)) {
+                            s_schedule_error.clear();
+                            schedules[s_schedule_for] = s_schedule_text;
+                            SettingsMenu::GetInstance()->settings_state.MarkDirty();
+                        }
+                    }
+                    ImGui::SameLine();
+                    ImGui::BeginDisabled(!schedules.count(s_schedule_for));
+                    if (ImGui::Button("Unschedule")) {
+                        SCR::CScheduler::Get().Remove(s_schedule_for);
+                        schedules.erase(s_schedule_for);
+                        s_schedule_error.clear();
+                        SettingsMenu::GetInstance()->settings_state.MarkDirty();
+                    }
+                    ImGui::EndDisabled();
+                    if (!s_schedule_error.empty()) {
+                        ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.35f, 1.0f), "Schedule: %s", s_schedule_error.c_str());
+                    } else if (auto st = SCR::CScheduler::Get().Status(s_schedule_for)) {
+                        const double in = std::chrono::duration<double>(st->next - std::chrono::steady_clock::now()).count();
+                        ImGui::TextDisabled("Runs on '%s', next in %.1f s, %llu runs, %llu coalesced", st->spec.c_str(),
+                                            std::max(in, 0.0), (unsigned long long)st->runs,
+                                            (unsigned long long)st->coalesced);
+                    }
+
+                    SCR::ArenaStats mem;
+                    if (SCR::CScripting::LastRunMemory(selected_script->fullpath, mem)) {
+                        ImGui::Text("Last run: peak %.1f KiB, %llu allocations (%.0f/s), %.1f KiB reserved",
+                                    mem.peak / 1024.0, (unsigned long long)mem.allocations,
+                                    mem.AllocationsPerSecond(), mem.reserved / 1024.0);
+                        ImGui::Separator();
+                    }
+
+                    auto bench = s_bench_results.find(selected_script->fullpath);
+                    if (bench != s_bench_results.end()) {
+                        const SCR::BenchmarkResult &r = bench->second;
+                        if (!r.error.empty()) {
+                            ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.35f, 1.0f), "Benchmark failed: %s", r.error.c_str());
+                        } else {
+                            ImGui::Text("Benchmark (%d runs): min %.3f ms  median %.3f ms  p99 %.3f ms  stddev %.3f ms",
+                                        r.runs, r.min_ms, r.median_ms, r.p99_ms, r.stddev_ms);
+                            ImGui::Text("Heap: %lld allocations (%lld bytes), %lld objects, %lld bytes of bytecode",
+                                        (long long)r.malloc_count, (long long)r.malloc_size,
+                                        (long long)r.obj_count, (long long)r.bytecode_size);
+                        }
+                        ImGui::Separator();
+                    }
+
                     std::string snapshot;
                     {
                         std::lock_guard<std::mutex> lk(selected_script->m);
@@ -194,7 +289,7 @@ namespace GUI {
             }
             std::ofstream ofs(path, std::ios::trunc);
             if (ofs)
-                ofs << editorBuf;
+                ofs << editor.GetText();
             FS::CFileSystem::LoadScripts();
             SettingsMenu::GetInstance()->LoadDesktopFromSettings();
             showEditor = false;
@@ -222,8 +317,13 @@ namespace GUI {
 
         // Text box
         const ImVec2 size = ImVec2(-FLT_MIN, -ImGui::GetFrameHeightWithSpacing() * 2);
-        ImGui::InputTextMultiline("##src", &editorBuf, size,
-                                  ImGuiInputTextFlags_AllowTabInput);
+        editor.Render("##src", size);
+        UpdateSyntaxCheck();
+
+        if (ImGui::IsWindowFocused(ImGuiFocusedFlags_RootAndChildWindows) &&
+            ImGui::GetIO().KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_S, false)) {
+            savefile();
+        }
 
         if (ImGui::Button("Save")) {
             savefile();
@@ -232,9 +332,45 @@ namespace GUI {
         if (ImGui::Button("Cancel"))
             showEditor = false;
 
+        ImGui::SameLine();
+        if (editor.GetMarkers().empty())
+            ImGui::TextDisabled("%s", syntaxStatus.c_str());
+        else
+            ImGui::TextColored(ImVec4(1.0f, 0.35f, 0.35f, 1.0f), "%s", syntaxStatus.c_str());
+
         ImGui::End();
     }
 
+    void CScriptPlayground::UpdateSyntaxCheck() {
+        SCR::CSyntaxChecker &checker = SCR::CSyntaxChecker::Get();
+        const double now = ImGui::GetTime();
+
+        const uint64_t revision = editor.GetRevision();
+        if (revision != seenRevision) {
+            seenRevision = revision;
+            lastEditTime = now;
+        }
+
+        // The text is only copied out once typing pauses
+        if (revision != checkedRevision &&
+            now - lastEditTime >= std::chrono::duration<double>(SCR::CSyntaxChecker::kDebounce).count()) {
+            checkedRevision = revision;
+            checkGeneration = checker.Submit(editor.GetText(), newFileName + ".js");
+        }
+
+        if (auto result = checker.TakeResult(checkGeneration)) {
+            std::vector<CCodeEditor::Marker> markers;
+            for (const SCR::SyntaxError &err : result->errors)
+                markers.push_back({(std::size_t)std::max(err.line - 1, 0), err.column, err.message});
+
+            if (markers.empty())
+                syntaxStatus = "No syntax errors";
+            else
+                syntaxStatus = "Line " + std::to_string(markers.front().line + 1) + ": " + markers.front().message;
+            editor.SetMarkers(std::move(markers));
+        }
+    }
+
     void CScriptPlayground::SetWindowSize(const MATH::Vector2D<int> &size) {
         windowSize = size;
     }
@@ -1,6 +1,8 @@
 #pragma once
 #include "./MATH/Vector2D.h"
 #include "UI/INormalWindow.h"
+#include "CodeEditor.h"
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -35,11 +37,19 @@ private:
 
   bool showEditor = false;
   std::string newFileName;
-  std::string editorBuf;
+  CCodeEditor editor;
   bool isNewFile;
   std::string filenamebackup;
   void DrawEditor();
 
+  // Background syntax check of the editor text
+  uint64_t seenRevision = 0;
+  uint64_t checkedRevision = 0;
+  uint64_t checkGeneration = 0;
+  double lastEditTime = 0.0;
+  std::string syntaxStatus;
+  void UpdateSyntaxCheck();
+
 public:
   MATH::Vector2D<int> GetDesiredPos() { return MATH::Vector2D<int>{150, 150}; }
   MATH::Vector2D<int> GetDesiredSize() { return MATH::Vector2D<int>{600, 400}; }
@@ -1,6 +1,9 @@
 #include "SettingsMenu.h"
 #include "../Dependencies/ImGui/imgui.h"
 #include "FS/MainFileSystem.h"
+#include "SCRIPTING/Scheduler.h"
+#include "SCRIPTING/ScriptWindows.h"
+#include "UTILS/Logger.h"
 #include <set>
 #if defined(_WIN32) || defined(WIN32)
 #include <windows.h>
@@ -9,8 +12,10 @@
 #include "../Dependencies/tfd/tinyfiledialogs.h"
 #include "CMainWindow.h"
 #include "Renderer.h"
+#include "SettingsWriter.h"
 #include <GL/gl.h>
 #include <fstream>
+#include <iterator>
 #include <memory>
 #include <string>
 
@@ -206,6 +211,7 @@ namespace GUI {
             if (ImGui::Checkbox("Fullscreen", &GUI::Renderer::Get()->isFullscreen)) {
                 GUI::Renderer::Get()->ToggleFullscreen();
             }
+            ImGui::Checkbox("Script window profiler", &SCR::CScriptWindows::showProfiler);
             ImGui::Separator();
 
             if (ImGui::Button("Save Config")) {
@@ -267,7 +273,7 @@ namespace GUI {
 
     void SettingsMenu::LoadImageFromURL() {
         if (strlen(urlInput) == 0) {
-            fmt::print("URL is empty!\n");
+            LOG_WARN(GUI, "URL is empty!");
             return;
         }
 
@@ -277,8 +283,8 @@ namespace GUI {
         loadedImage->LoadImageFromURL();
 
         if (!loadedImage->ImageLoaded) {
-            fmt::print("Failed to load image from URL: {}\n",
-                       settings_state.background_url);
+            LOG_ERROR(GUI, "Failed to load image from URL: {}",
+                      settings_state.background_url);
             loadedImage.reset();
         } else {
             // Clear the local file path since we're using URL
@@ -317,7 +323,7 @@ namespace GUI {
                        j[3].get<float>());
     }
 
-    void CSettings::SaveSettings() {
+    std::string CSettings::Serialize() const {
         nlohmann::json j;
         j["selected_background"] = selected_background;
         j["background_filepath"] = background_filepath;
@@ -336,27 +342,31 @@ namespace GUI {
         j["image_source_type"] = image_source_type;
         j["background_url"] = background_url;
         j["accent_color"] = ToJson(accent_color);
-        j["isFullscreen"] = GUI::Renderer::Get()->isFullscreen;
+        j["isFullscreen"] = isFullscreen;
         nlohmann::json slotArr = nlohmann::json::array();
         for (auto &p : desktop_scripts)
             slotArr.push_back(p);
         j["desktop_scripts"] = slotArr;
-        std::ofstream ofs(
-                FS::CFileSystem::GetScriptFolderLocation().filename().string() +
-                "settings.json");
-        if (ofs)
-            ofs << std::setw(4) << j;
+        j["script_schedules"] = script_schedules;
+        return j.dump(4);
     }
 
-    void CSettings::LoadSettings() {
-        std::ifstream ifs(
-                FS::CFileSystem::GetScriptFolderLocation().filename().string() +
-                "settings.json");
-        if (!ifs)
-            return;
+    // Serialization and the file write happen on the settings writer thread;
+    // the GUI thread only copies the state.
+    void CSettings::SaveSettings() {
+        isFullscreen = GUI::Renderer::Get()->isFullscreen;
+        CSettingsWriter::Get().Submit(*this, true);
+    }
 
-        nlohmann::json j;
-        ifs >> j;
+    void CSettings::MarkDirty() {
+        isFullscreen = GUI::Renderer::Get()->isFullscreen;
+        CSettingsWriter::Get().Submit(*this);
+    }
+
+    bool CSettings::Deserialize(const std::string &text) {
+        nlohmann::json j = nlohmann::json::parse(text, nullptr, false);
+        if (j.is_discarded())
+            return false;
 
         if (j.contains("selected_background"))
             j.at("selected_background").get_to(selected_background);
@@ -367,17 +377,8 @@ namespace GUI {
         if (j.contains("bg_mode"))
             bg_mode = static_cast<BgMode>(j["bg_mode"].get<int>());
 
-        if (j.contains("isFullscreen")) {
-            bool savedFullscreenState;
-            j.at("isFullscreen").get_to(savedFullscreenState);
-
-            // Only toggle if the saved state differs from current state
-            if (savedFullscreenState != GUI::Renderer::Get()->isFullscreen) {
-                GUI::Renderer::Get()->ToggleFullscreen();
-            }
-
-            isFullscreen = savedFullscreenState;
-        }
+        if (j.contains("isFullscreen"))
+            j.at("isFullscreen").get_to(isFullscreen);
 
         if (j.contains("solid"))
             FromJson(j["solid"], solid);
@@ -398,6 +399,13 @@ namespace GUI {
                 desktop_scripts[i] = a[i].get<std::string>();
         }
 
+        if (j.contains("script_schedules") && j["script_schedules"].is_object()) {
+            script_schedules.clear();
+            for (auto &[path, spec] : j["script_schedules"].items())
+                if (spec.is_string())
+                    script_schedules[path] = spec.get<std::string>();
+        }
+
         if (j.contains("window_background") && j["window_background"].is_array()) {
             auto a = j["window_background"];
             if (a.size() == 4)
@@ -411,24 +419,77 @@ namespace GUI {
         if (j.contains("background_url"))
             j.at("background_url").get_to(background_url);
 
-        /* If the user had an image background selected, restore it immediately */
+        return true;
+    }
+
+    void CSettings::LoadSettings() {
+        std::ifstream ifs(FS::CFileSystem::GetSettingsFileLocation());
+        const bool migrating = !ifs;
+        if (migrating) {
+            // Older builds wrote "Scriptssettings.json" into the working directory
+            ifs.open(FS::CFileSystem::GetScriptFolderLocation().filename().string() +
+                     "settings.json");
+            if (!ifs)
+                return;
+            LOG_INFO(GUI, "Migrating settings from the working directory");
+        }
+
+        const std::string text{std::istreambuf_iterator<char>(ifs), {}};
+        if (!Deserialize(text)) {
+            LOG_ERROR(GUI, "settings.json is malformed, keeping defaults");
+            return;
+        }
+
+        // Only toggle if the saved state differs from current state
+        if (isFullscreen != GUI::Renderer::Get()->isFullscreen)
+            GUI::Renderer::Get()->ToggleFullscreen();
+
+        /* If the user had an image background selected, restore it in the
+           background. The fill colours show until the texture is ready and
+           the image then fades in, so the first frame never waits on disk
+           or network. */
         if (selected_background == 1) {
-            if (image_source_type == 0 && !background_filepath.empty()) {
-                CMainWindow::SetBackgroundImage(background_filepath);
-            } else if (image_source_type == 1 && !background_url.empty()) {
-                auto img = std::make_unique<CImage>(background_url, true);
-                img->LoadImageFromURL();
-                if (img->ImageLoaded)
-                    CMainWindow::SetBackgroundImage(std::move(img));
+            const bool is_url = image_source_type == 1;
+            const std::string source = is_url ? background_url : background_filepath;
+            if (!source.empty()) {
+                CImageLoader::LoadAsync(source, is_url, [source, is_url](std::unique_ptr<CImage> img) {
+                    if (!img) {
+                        LOG_ERROR(GUI, "Could not restore background {}", source);
+                        return;
+                    }
+                    // Skip it if the user picked something else meanwhile
+                    const auto &st = SettingsMenu::GetInstance()->settings_state;
+                    const std::string &wanted = st.image_source_type == 1 ? st.background_url
+                                                                          : st.background_filepath;
+                    if (st.selected_background != 1 || (st.image_source_type == 1) != is_url ||
+                        wanted != source)
+                        return;
+                    CMainWindow::FadeInBackgroundImage(std::move(img));
+                });
             }
         }
 
+        // Migrated settings are written to their new place right away;
+        // otherwise there is nothing to write until something changes
+        if (migrating)
+            SaveSettings();
+        else
+            CSettingsWriter::Get().SetBaseline(Serialize());
+
         GUI::Renderer::Get()->SetupModernImGuiStyle();
         if (CMainWindow::logo.get() != nullptr) {
             CMainWindow::logo.get()->Recolour(ImVec4(0.302f, 0.427f, 0.953f, 1.0f),
                                               accent_color, 0.01f);
         }
         SettingsMenu::GetInstance()->LoadDesktopFromSettings();
+
+        SCR::CScheduler &scheduler = SCR::CScheduler::Get();
+        scheduler.Clear();
+        for (const auto &[path, spec] : script_schedules) {
+            std::string error;
+            if (!scheduler.Set(path, spec, error))
+                LOG_WARN(Script, "Ignoring schedule '{}' for {}: {}", spec, path, error);
+        }
     }
 
 }
@@ -4,6 +4,7 @@
 #include "BaseApp.h"
 #include "Image/image.h"
 #include <array>
+#include <map>
 #include <memory>
 #include <string>
 
@@ -34,9 +35,19 @@ namespace GUI {
         int image_source_type = 0;
         std::string background_url = "";
         std::array<std::string, DESK_SLOTS> desktop_scripts{};
-        bool isFullscreen;
+        // Script full path -> schedule spec ("30s", "*/5 * * * *")
+        std::map<std::string, std::string> script_schedules;
+        bool isFullscreen = false;
+
+        // Queues an immediate background save (Save Config button)
         void SaveSettings();
+        // Queues a debounced background save; cheap enough for every edit
+        void MarkDirty();
         void LoadSettings();
+
+        std::string Serialize() const;
+        // Fills the fields present in `text`; false when it is not valid JSON
+        bool Deserialize(const std::string &text);
     };
 
     class SettingsMenu : public BaseApp {
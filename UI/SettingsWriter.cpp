@@ -0,0 +1,88 @@
+#include "SettingsWriter.h"
+#include "FS/MainFileSystem.h"
+#include "UTILS/Logger.h"
+#include <functional>
+
+namespace GUI {
+
+    CSettingsWriter &CSettingsWriter::Get() {
+        static CSettingsWriter writer;
+        return writer;
+    }
+
+    CSettingsWriter::CSettingsWriter() {
+        worker = std::thread([this] { Run(); });
+    }
+
+    // Static teardown (std::exit from the top bar) still writes what is pending
+    CSettingsWriter::~CSettingsWriter() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            stop = true;
+        }
+        cv.notify_one();
+        if (worker.joinable())
+            worker.join();
+    }
+
+    void CSettingsWriter::Submit(const CSettings &snapshot, bool immediate) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            pending = snapshot;
+            deadline = std::chrono::steady_clock::now() + (immediate ? std::chrono::milliseconds(0) : kDebounce);
+        }
+        cv.notify_one();
+    }
+
+    void CSettingsWriter::SetBaseline(const std::string &serialized) {
+        std::lock_guard<std::mutex> lk(m);
+        last_hash = std::hash<std::string>{}(serialized);
+    }
+
+    void CSettingsWriter::Flush() {
+        std::unique_lock<std::mutex> lk(m);
+        if (pending)
+            deadline = std::chrono::steady_clock::now();
+        cv.notify_one();
+        idle_cv.wait(lk, [this] { return !pending && !writing; });
+    }
+
+    void CSettingsWriter::Run() {
+        std::unique_lock<std::mutex> lk(m);
+        for (;;) {
+            cv.wait(lk, [this] { return stop || pending.has_value(); });
+            if (!pending && stop)
+                break;
+
+            // Every new Submit pushes the deadline out again
+            while (!stop && pending && std::chrono::steady_clock::now() < deadline)
+                cv.wait_until(lk, deadline);
+
+            CSettings snapshot = std::move(*pending);
+            pending.reset();
+            writing = true;
+            lk.unlock();
+
+            const std::string text = snapshot.Serialize();
+            const std::size_t hash = std::hash<std::string>{}(text);
+
+            lk.lock();
+            const bool unchanged = hash == last_hash;
+            lk.unlock();
+
+            if (unchanged) {
+                LOG_TRACE(GUI, "Settings unchanged, skipping write");
+            } else if (FS::CFileSystem::WriteFileAtomic(FS::CFileSystem::GetSettingsFileLocation(), text)) {
+                LOG_DEBUG(GUI, "Settings saved ({} bytes)", text.size());
+                lk.lock();
+                last_hash = hash;
+                lk.unlock();
+            }
+
+            lk.lock();
+            writing = false;
+            idle_cv.notify_all();
+        }
+        idle_cv.notify_all();
+    }
+}
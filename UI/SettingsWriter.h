@@ -0,0 +1,49 @@
+#pragma once
+#include "SettingsMenu.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace GUI {
+
+    // Persists CSettings off the GUI thread. Submissions within the debounce
+    // window collapse into one write of the newest snapshot, identical
+    // content is skipped by hash, and the file is replaced atomically.
+    class CSettingsWriter {
+        public:
+            static CSettingsWriter &Get();
+
+            // `immediate` skips the debounce window (explicit Save clicks)
+            void Submit(const CSettings &snapshot, bool immediate = false);
+
+            // Remember what is already on disk so an unchanged save is a no-op
+            void SetBaseline(const std::string &serialized);
+
+            // Blocks until every submitted snapshot has been handled
+            void Flush();
+
+            static constexpr std::chrono::milliseconds kDebounce{500};
+
+        private:
+            CSettingsWriter();
+            ~CSettingsWriter();
+            CSettingsWriter(const CSettingsWriter &) = delete;
+            CSettingsWriter &operator=(const CSettingsWriter &) = delete;
+
+            void Run();
+
+            std::mutex m;
+            std::condition_variable cv;
+            std::condition_variable idle_cv;
+            std::optional<CSettings> pending;
+            std::chrono::steady_clock::time_point deadline;
+            std::size_t last_hash = 0;
+            bool writing = false;
+            bool stop = false;
+            std::thread worker;
+    };
+}
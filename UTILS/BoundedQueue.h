@@ -0,0 +1,94 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// Bounded lock-free queue (Vyukov's sequence-numbered ring). Any number of
+// threads may push and pop; nothing blocks and nothing allocates after the
+// constructor. Producers only contend on one CAS of the tail counter.
+template <typename T> class BoundedQueue {
+    public:
+        explicit BoundedQueue(size_t capacity) {
+            size_t cap = 2;
+            while (cap < capacity)
+                cap <<= 1;
+            mask_ = cap - 1;
+            cells_ = std::make_unique<Cell[]>(cap);
+            for (size_t i = 0; i < cap; ++i)
+                cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        BoundedQueue(const BoundedQueue &) = delete;
+        BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+        // Claims a slot and lets `fill` construct the element in place, so
+        // large records are written once instead of being copied in.
+        template <typename Fill> bool emplace(Fill &&fill) {
+            Cell *cell;
+            size_t pos = tail_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                if (dif == 0) {
+                    if (tail_.compare_exchange_weak(pos, pos + 1,
+                                                    std::memory_order_relaxed))
+                        break;
+                } else if (dif < 0) {
+                    return false; // full
+                } else {
+                    pos = tail_.load(std::memory_order_relaxed);
+                }
+            }
+            fill(cell->value);
+            cell->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool push(T v) {
+            return emplace([&](T &slot) { slot = std::move(v); });
+        }
+
+        bool pop(T &out) {
+            Cell *cell;
+            size_t pos = head_.load(std::memory_order_relaxed);
+            for (;;) {
+                cell = &cells_[pos & mask_];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+                if (dif == 0) {
+                    if (head_.compare_exchange_weak(pos, pos + 1,
+                                                    std::memory_order_relaxed))
+                        break;
+                } else if (dif < 0) {
+                    return false; // empty
+                } else {
+                    pos = head_.load(std::memory_order_relaxed);
+                }
+            }
+            out = std::move(cell->value);
+            cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+            return true;
+        }
+
+        size_t capacity() const { return mask_ + 1; }
+
+        // Approximate; only meaningful as a hint for the consumer.
+        size_t size_approx() const {
+            size_t t = tail_.load(std::memory_order_relaxed);
+            size_t h = head_.load(std::memory_order_relaxed);
+            return t >= h ? t - h : 0;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> seq{0};
+            T value{};
+        };
+
+        std::unique_ptr<Cell[]> cells_;
+        size_t mask_ = 0;
+        alignas(64) std::atomic<size_t> head_{0};
+        alignas(64) std::atomic<size_t> tail_{0};
+};
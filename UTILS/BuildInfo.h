@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+
+namespace UTILS {
+
+    // Compiler and build type, recorded with benchmark results so they are
+    // only compared against runs of a like build
+    inline std::string BuildDescription() {
+        std::string build;
+#if defined(__clang__)
+        build = "clang " __clang_version__;
+#elif defined(__GNUC__)
+        build = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        build = "msvc " + std::to_string(_MSC_VER);
+#else
+        build = "unknown compiler";
+#endif
+#ifdef NDEBUG
+        build += ", release";
+#else
+        build += ", debug";
+#endif
+        return build;
+    }
+}
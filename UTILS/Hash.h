@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+namespace UTILS {
+
+    // FNV-1a, for hashes that are written to disk: unlike std::hash the
+    // value is the same whichever compiler built us
+    inline uint64_t Fnv1a(std::string_view bytes) {
+        uint64_t h = 1469598103934665603ull;
+        for (unsigned char c : bytes) {
+            h ^= c;
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+}
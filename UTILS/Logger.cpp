@@ -0,0 +1,279 @@
+#include "Logger.h"
+#include "BoundedQueue.h"
+#include "fmt/chrono.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace UTILS {
+
+    namespace {
+        constexpr size_t kQueueCapacity = 4096;
+        constexpr size_t kBatchSize = 512;
+        constexpr uintmax_t kMaxFileSize = 4 * 1024 * 1024;
+        constexpr int kKeptFiles = 5;
+        constexpr auto kFlushInterval = std::chrono::milliseconds(100);
+
+        struct LoggerState {
+            BoundedQueue<LogRecord> queue{kQueueCapacity};
+            std::atomic<uint64_t> dropped{0};
+            std::atomic<uint32_t> next_thread{1};
+            std::atomic<LogLevel> console_level{LogLevel::Info};
+
+            std::mutex m; // guards the fields below and the wakeup
+            std::condition_variable cv;
+            std::thread writer;
+            bool running = false;
+            bool wake = false;
+
+            // Owned by the writer thread
+            fs::path folder;
+            std::FILE *file = nullptr;
+            uintmax_t file_size = 0;
+            uint64_t reported_drops = 0;
+
+            ~LoggerState();
+        };
+
+        void StopWriter(LoggerState &st) {
+            {
+                std::lock_guard<std::mutex> lk(st.m);
+                if (!st.running)
+                    return;
+                st.running = false;
+            }
+            st.cv.notify_one();
+            if (st.writer.joinable())
+                st.writer.join();
+            if (st.file) {
+                std::fclose(st.file);
+                st.file = nullptr;
+            }
+        }
+
+        // Static teardown (std::exit from the top bar) still flushes the ring
+        LoggerState::~LoggerState() { StopWriter(*this); }
+
+        LoggerState &State() {
+            static LoggerState state;
+            return state;
+        }
+
+        uint32_t ThreadTag() {
+            thread_local uint32_t tag =
+                    State().next_thread.fetch_add(1, std::memory_order_relaxed);
+            return tag;
+        }
+
+        fs::path LogFile(const fs::path &folder, int index) {
+            if (index == 0)
+                return folder / "nexus.log";
+            return folder / fmt::format("nexus.{}.log", index);
+        }
+
+        void OpenLogFile(LoggerState &st) {
+            std::error_code ec;
+            fs::create_directories(st.folder, ec);
+            const fs::path path = LogFile(st.folder, 0);
+            st.file = std::fopen(path.string().c_str(), "ab");
+            st.file_size = fs::exists(path, ec) ? fs::file_size(path, ec) : 0;
+            if (ec)
+                st.file_size = 0;
+        }
+
+        // nexus.log -> nexus.1.log -> ... ; the oldest file falls off the end
+        void Rotate(LoggerState &st) {
+            if (st.file) {
+                std::fclose(st.file);
+                st.file = nullptr;
+            }
+            std::error_code ec;
+            fs::remove(LogFile(st.folder, kKeptFiles - 1), ec);
+            for (int i = kKeptFiles - 2; i >= 0; --i) {
+                const fs::path from = LogFile(st.folder, i);
+                if (fs::exists(from, ec))
+                    fs::rename(from, LogFile(st.folder, i + 1), ec);
+            }
+            OpenLogFile(st);
+        }
+
+        void AppendRecord(std::string &out, const LogRecord &rec) {
+            using namespace std::chrono;
+            const auto tp = system_clock::time_point(microseconds(rec.timestamp_us));
+            const auto ms = (rec.timestamp_us / 1000) % 1000;
+            fmt::format_to(std::back_inserter(out), "{:%Y-%m-%d %H:%M:%S}.{:03} [{:<5}] [{}] #{} ",
+                           fmt::localtime(system_clock::to_time_t(tp)), ms,
+                           CLogger::LevelName(rec.level), CLogger::ChannelName(rec.channel),
+                           rec.thread);
+            out.append(rec.text, rec.length);
+            if (rec.length == 0 || rec.text[rec.length - 1] != '\n')
+                out.push_back('\n');
+        }
+
+        // Drains whatever is queued; returns false when the ring was empty.
+        bool WriteBatch(LoggerState &st, std::string &buf, std::string &console) {
+            buf.clear();
+            console.clear();
+            const LogLevel console_level = st.console_level.load(std::memory_order_relaxed);
+
+            LogRecord rec;
+            size_t n = 0;
+            while (n < kBatchSize && st.queue.pop(rec)) {
+                const size_t before = buf.size();
+                AppendRecord(buf, rec);
+                if (rec.level >= console_level)
+                    console.append(buf, before, std::string::npos);
+                ++n;
+            }
+
+            const uint64_t dropped = st.dropped.load(std::memory_order_relaxed);
+            if (dropped != st.reported_drops) {
+                fmt::format_to(std::back_inserter(buf), "[log] {} records dropped (queue full)\n",
+                               dropped - st.reported_drops);
+                st.reported_drops = dropped;
+            }
+
+            if (buf.empty())
+                return false;
+
+            if (!console.empty())
+                std::fwrite(console.data(), 1, console.size(), stdout);
+
+            if (st.file) {
+                std::fwrite(buf.data(), 1, buf.size(), st.file);
+                std::fflush(st.file);
+                st.file_size += buf.size();
+                if (st.file_size >= kMaxFileSize)
+                    Rotate(st);
+            }
+            return n == kBatchSize;
+        }
+
+        void WriterLoop(LoggerState &st) {
+            std::string buf, console;
+            buf.reserve(64 * 1024);
+            for (;;) {
+                bool stop;
+                {
+                    std::unique_lock<std::mutex> lk(st.m);
+                    st.cv.wait_for(lk, kFlushInterval, [&] { return st.wake || !st.running; });
+                    st.wake = false;
+                    stop = !st.running;
+                }
+                while (WriteBatch(st, buf, console)) {
+                }
+                if (stop)
+                    break;
+            }
+            // Final drain so nothing queued before Shutdown() is lost
+            while (WriteBatch(st, buf, console)) {
+            }
+            std::fflush(stdout);
+        }
+    }
+
+    std::atomic<LogLevel> CLogger::levels[(size_t)LogChannel::Count] = {
+            LogLevel::Debug, LogLevel::Debug, LogLevel::Debug,
+            LogLevel::Debug, LogLevel::Debug, LogLevel::Debug};
+
+    void CLogger::Init(const fs::path &folder) {
+        LoggerState &st = State();
+        std::lock_guard<std::mutex> lk(st.m);
+        if (st.running)
+            return;
+        st.folder = folder;
+        OpenLogFile(st);
+        st.running = true;
+        st.writer = std::thread([&st] { WriterLoop(st); });
+    }
+
+    void CLogger::Shutdown() { StopWriter(State()); }
+
+    void CLogger::SetLevel(LogChannel channel, LogLevel level) {
+        levels[(size_t)channel].store(level, std::memory_order_relaxed);
+    }
+
+    void CLogger::SetLevel(LogLevel level) {
+        for (auto &l : levels)
+            l.store(level, std::memory_order_relaxed);
+    }
+
+    void CLogger::SetConsoleLevel(LogLevel level) {
+        State().console_level.store(level, std::memory_order_relaxed);
+    }
+
+    void CLogger::Write(LogLevel level, LogChannel channel, std::string_view text) {
+        if (!ShouldLog(level, channel))
+            return;
+        Enqueue(level, channel, [&](char *out, size_t cap) {
+            const size_t n = text.size() < cap ? text.size() : cap;
+            std::memcpy(out, text.data(), n);
+            return text.size();
+        });
+    }
+
+    void CLogger::EnqueueRaw(LogLevel level, LogChannel channel,
+                             size_t (*format)(void *, char *, size_t), void *fn) {
+        LoggerState &st = State();
+        const int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+                std::chrono::system_clock::now().time_since_epoch()).count();
+        const uint32_t thread = ThreadTag();
+
+        const bool queued = st.queue.emplace([&](LogRecord &rec) {
+            rec.timestamp_us = now;
+            rec.thread = thread;
+            rec.level = level;
+            rec.channel = channel;
+            const size_t n = format(fn, rec.text, LogRecord::kMaxText);
+            rec.length = (uint16_t)(n < LogRecord::kMaxText ? n : LogRecord::kMaxText);
+        });
+
+        if (!queued) {
+            st.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // Errors are worth a wakeup so they reach disk before a crash can eat them
+        if (level >= LogLevel::Error) {
+            {
+                std::lock_guard<std::mutex> lk(st.m);
+                st.wake = true;
+            }
+            st.cv.notify_one();
+        }
+    }
+
+    uint64_t CLogger::GetDroppedCount() {
+        return State().dropped.load(std::memory_order_relaxed);
+    }
+
+    const char *CLogger::LevelName(LogLevel level) {
+        switch (level) {
+            case LogLevel::Trace: return "TRACE";
+            case LogLevel::Debug: return "DEBUG";
+            case LogLevel::Info: return "INFO";
+            case LogLevel::Warn: return "WARN";
+            case LogLevel::Error: return "ERROR";
+            default: return "?";
+        }
+    }
+
+    const char *CLogger::ChannelName(LogChannel channel) {
+        switch (channel) {
+            case LogChannel::Core: return "Core";
+            case LogChannel::FS: return "FS";
+            case LogChannel::Script: return "Script";
+            case LogChannel::GUI: return "GUI";
+            case LogChannel::Audio: return "Audio";
+            case LogChannel::Net: return "Net";
+            default: return "?";
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include "fmt/format.h"
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace UTILS {
+
+    enum class LogLevel : uint8_t { Trace = 0, Debug, Info, Warn, Error, Off };
+
+    enum class LogChannel : uint8_t { Core = 0, FS, Script, GUI, Audio, Net, Count };
+
+    // One queued log line. Fixed size so the hot path never allocates;
+    // longer messages are truncated.
+    struct LogRecord {
+        static constexpr size_t kMaxText = 256;
+
+        int64_t timestamp_us = 0;
+        uint32_t thread = 0;
+        LogLevel level = LogLevel::Info;
+        LogChannel channel = LogChannel::Core;
+        uint16_t length = 0;
+        char text[kMaxText];
+    };
+
+    // Asynchronous logger. Callers format into a slot of a lock-free ring and
+    // return; a background thread drains the ring in batches into
+    // <Logs>/nexus.log, rotating it once it grows past the size cap.
+    class CLogger {
+        public:
+            CLogger() = delete;
+
+            static void Init(const std::filesystem::path &folder);
+            static void Shutdown();
+
+            static void SetLevel(LogChannel channel, LogLevel level);
+            static void SetLevel(LogLevel level); // every channel
+            static void SetConsoleLevel(LogLevel level);
+
+            static bool ShouldLog(LogLevel level, LogChannel channel) {
+                return level >= levels[(size_t)channel].load(std::memory_order_relaxed);
+            }
+
+            template <typename... Args>
+            static void Log(LogLevel level, LogChannel channel,
+                            fmt::format_string<Args...> format, Args &&...args) {
+                if (!ShouldLog(level, channel))
+                    return;
+                Enqueue(level, channel, [&](char *out, size_t cap) {
+                    return fmt::format_to_n(out, cap, format, std::forward<Args>(args)...).size;
+                });
+            }
+
+            // For messages that are already formatted (script output etc.)
+            static void Write(LogLevel level, LogChannel channel, std::string_view text);
+
+            // Records lost because the ring was full.
+            static uint64_t GetDroppedCount();
+
+            static const char *LevelName(LogLevel level);
+            static const char *ChannelName(LogChannel channel);
+
+        private:
+            template <typename Format>
+            static void Enqueue(LogLevel level, LogChannel channel, Format &&format) {
+                EnqueueRaw(level, channel, [](void *fn, char *out, size_t cap) {
+                    return (*static_cast<Format *>(fn))(out, cap);
+                }, &format);
+            }
+
+            static void EnqueueRaw(LogLevel level, LogChannel channel,
+                                   size_t (*format)(void *, char *, size_t), void *fn);
+
+            static std::atomic<LogLevel> levels[(size_t)LogChannel::Count];
+    };
+}
+
+#define LOG_TRACE(channel, ...)                                                \
+    UTILS::CLogger::Log(UTILS::LogLevel::Trace, UTILS::LogChannel::channel, __VA_ARGS__)
+#define LOG_DEBUG(channel, ...)                                                \
+    UTILS::CLogger::Log(UTILS::LogLevel::Debug, UTILS::LogChannel::channel, __VA_ARGS__)
+#define LOG_INFO(channel, ...)                                                 \
+    UTILS::CLogger::Log(UTILS::LogLevel::Info, UTILS::LogChannel::channel, __VA_ARGS__)
+#define LOG_WARN(channel, ...)                                                 \
+    UTILS::CLogger::Log(UTILS::LogLevel::Warn, UTILS::LogChannel::channel, __VA_ARGS__)
+#define LOG_ERROR(channel, ...)                                                \
+    UTILS::CLogger::Log(UTILS::LogLevel::Error, UTILS::LogChannel::channel, __VA_ARGS__)
@@ -1,29 +1,18 @@
 #ifndef _THREADPOOL
 #define _THREADPOOL
-#include "fmt/base.h"
-#include <climits>
+#include "Logger.h"
+#include <condition_variable>
+#include <deque>
 #include <functional>
-#include <limits>
-#include <queue>
+#include <mutex>
 #include <thread>
 #include <vector>
 
-struct _ThreadInfo {
-    std::thread thread;
-    std::queue<std::function<void()>> queue;
-    bool shouldStop;
-    unsigned id;
-
-    // std::thread is not copy-able :)
-    _ThreadInfo(std::thread t, unsigned i)
-            : thread(std::move(t)), id(i), shouldStop(false) {}
-};
-
 class ThreadPool {
 public:
     ThreadPool(const size_t &thread_number) {
         if (thread_number <= 0) {
-            fmt::print("Trebuie cel putin 1 thread");
+            LOG_WARN(Core, "ThreadPool needs at least 1 thread");
             nrThreads = 1;
         } else {
             nrThreads = thread_number;
@@ -35,50 +24,71 @@ public:
         PoolCleanup();
     }
 
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
     void Add(std::function<void()> &func) {
-        int best_thread = -1;
-        int count = std::numeric_limits<int>().max();
+        Add(std::move(func));
+    }
 
-        for (auto &thread : threads) {
-            if (thread.queue.empty()) {
-                best_thread = thread.id;
-                break;
-            }
-            if (thread.queue.size() < count) {
-                best_thread = thread.id;
-                count = thread.queue.size();
-            }
+    void Add(std::function<void()> &&func) {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            queue.emplace_back(std::move(func));
         }
+        cv.notify_one();
+    }
 
-        if (best_thread < threads.size()) {
-            threads[best_thread].queue.emplace(std::move(func));
-        } else {
-            fmt::print("Failed to get best thread, adding to the first one :(");
-            threads[0].queue.emplace(std::move(func));
-        }
+    size_t GetThreadCount() const { return nrThreads; }
+
+    // Whether the calling thread is one of this pool's workers
+    bool IsPoolThread() const {
+        const std::thread::id self = std::this_thread::get_id();
+        for (const auto &t : threads)
+            if (t.get_id() == self)
+                return true;
+        return false;
     }
 
 private:
+    // Runs whatever is still queued, then joins the workers
     void PoolCleanup() {
+        {
+            std::lock_guard<std::mutex> lk(m);
+            shouldStop = true;
+        }
+        cv.notify_all();
+        for (auto &t : threads)
+            if (t.joinable())
+                t.join();
+        threads.clear();
     }
 
     void GenerateThreads() {
         threads.reserve(nrThreads);
         for (size_t i = 0; i < nrThreads; i++) {
-            std::thread t([this, i]() {
-                while (!threads[i].shouldStop) {
-                    if (!threads[i].queue.empty()) {
-                        auto func = threads[i].queue.front();
-                        func();
-                        threads[i].queue.pop();
+            threads.emplace_back([this]() {
+                for (;;) {
+                    std::function<void()> func;
+                    {
+                        std::unique_lock<std::mutex> lk(m);
+                        cv.wait(lk, [this] { return shouldStop || !queue.empty(); });
+                        if (queue.empty())
+                            return;
+                        func = std::move(queue.front());
+                        queue.pop_front();
                     }
+                    func();
                 }
             });
-            threads.emplace_back(_ThreadInfo(std::move(t), i));
         }
     }
 
-    std::vector<_ThreadInfo> threads;
+    std::vector<std::thread> threads;
+    std::deque<std::function<void()>> queue;
+    std::mutex m;
+    std::condition_variable cv;
+    bool shouldStop = false;
     size_t nrThreads;
 };
 
@@ -0,0 +1,116 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+// Hierarchical timer wheel (Varghese & Lauck). Five levels of 64 slots:
+// level 0 holds timers due within 64 ticks, each further level covers 64
+// times the span of the one below and is cascaded down as time reaches it.
+// Scheduling is O(1), and a caller that sleeps until NextTick() wakes at
+// most once per occupied slot, so idle timers cost nothing. Not thread safe.
+template <typename T> class TimerWheel {
+    public:
+        static constexpr int kLevels = 5;
+        static constexpr int kBits = 6;
+        static constexpr uint64_t kSlots = 1u << kBits;
+        static constexpr uint64_t kMask = kSlots - 1;
+
+        explicit TimerWheel(uint64_t startTick = 0) : now_(startTick) {}
+
+        [[nodiscard]] uint64_t Now() const { return now_; }
+        [[nodiscard]] std::size_t Size() const { return size_; }
+
+        // A tick that is already due fires on the next Advance
+        void Schedule(uint64_t tick, T value) {
+            Place(Item{tick > now_ ? tick : now_ + 1, std::move(value)});
+            ++size_;
+        }
+
+        // Moves time forward to `tick`, calling fire(value, dueTick) for
+        // every timer that came due, in tick order
+        template <typename Fire> void Advance(uint64_t tick, Fire &&fire) {
+            while (now_ < tick) {
+                if (size_ == 0) {
+                    now_ = tick;
+                    break;
+                }
+                ++now_;
+                for (int level = 1; level < kLevels; level++) {
+                    if (now_ & ((uint64_t(1) << (level * kBits)) - 1))
+                        break;
+                    Cascade(level);
+                }
+
+                std::vector<Item> &slot = levels_[0][now_ & kMask];
+                if (slot.empty())
+                    continue;
+                std::vector<Item> due;
+                due.swap(slot);
+                size_ -= due.size();
+                for (Item &item : due)
+                    fire(item.value, item.tick);
+            }
+        }
+
+        // The earliest tick at which Advance has work to do, either firing
+        // or cascading; nothing when the wheel is empty
+        [[nodiscard]] std::optional<uint64_t> NextTick() const {
+            if (size_ == 0)
+                return std::nullopt;
+
+            std::optional<uint64_t> best;
+            for (uint64_t d = 1; d <= kSlots; d++)
+                if (!levels_[0][(now_ + d) & kMask].empty()) {
+                    best = now_ + d;
+                    break;
+                }
+            for (int level = 1; level < kLevels; level++) {
+                const int shift = level * kBits;
+                for (uint64_t k = 1; k <= kSlots; k++) {
+                    const uint64_t boundary = ((now_ >> shift) + k) << shift;
+                    if (best && boundary >= *best)
+                        break;
+                    if (!levels_[level][((now_ >> shift) + k) & kMask].empty()) {
+                        best = boundary;
+                        break;
+                    }
+                }
+            }
+            return best;
+        }
+
+    private:
+        struct Item {
+            uint64_t tick;
+            T value;
+        };
+
+        void Place(Item item) {
+            const uint64_t delta = item.tick - now_;
+            int level = 0;
+            while (level < kLevels - 1 && delta >= (uint64_t(1) << ((level + 1) * kBits)))
+                level++;
+            // Beyond the top level's span: park it as far out as the wheel
+            // reaches, it is placed again when that slot cascades
+            const uint64_t limit = uint64_t(1) << (kLevels * kBits);
+            const uint64_t slotTick = delta < limit ? item.tick : now_ + limit - 1;
+            levels_[level][(slotTick >> (level * kBits)) & kMask].push_back(std::move(item));
+        }
+
+        void Cascade(int level) {
+            std::vector<Item> &slot = levels_[level][(now_ >> (level * kBits)) & kMask];
+            if (slot.empty())
+                return;
+            std::vector<Item> items;
+            items.swap(slot);
+            for (Item &item : items)
+                Place(std::move(item));
+        }
+
+        std::array<std::array<std::vector<Item>, kSlots>, kLevels> levels_;
+        uint64_t now_;
+        std::size_t size_ = 0;
+};
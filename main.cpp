@@ -2,10 +2,54 @@
 #include "./FS/MainFileSystem.h"
 #include "Dependencies/fmt/fmt/core.h"
 #include "UI/Renderer.h"
-int main() {
+#include "UI/SettingsWriter.h"
+#include "UTILS/Logger.h"
+#include <cstdlib>
+#include <cstring>
+
+// Desktop [--headless] [--frames <n>] [--fixed-timestep <seconds>] [--input <events.txt>]
+//         [--record <input.nxir>] [--replay <input.nxir>] [--timings <frames.json>]
+static bool ParseOptions(int argc, char **argv, GUI::RendererOptions &options) {
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--headless"))
+            options.headless = true;
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc)
+            options.maxFrames = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--fixed-timestep") && i + 1 < argc)
+            options.fixedTimestep = (float)std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--input") && i + 1 < argc)
+            options.inputFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--record") && i + 1 < argc)
+            options.recordFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--replay") && i + 1 < argc)
+            options.replayFile = argv[++i];
+        else if (!std::strcmp(argv[i], "--timings") && i + 1 < argc)
+            options.timingsFile = argv[++i];
+        else
+            return false;
+    }
+    // A headless run has no window to close
+    return !options.headless || options.maxFrames > 0 || !options.inputFile.empty() || !options.replayFile.empty();
+}
+
+int main(int argc, char **argv) {
+    GUI::RendererOptions options;
+    if (!ParseOptions(argc, argv, options)) {
+        fmt::print(stderr,
+                   "usage: {} [--headless] [--frames <n>] [--fixed-timestep <seconds>] [--input <events.txt>]\n"
+                   "       [--record <input.nxir>] [--replay <input.nxir>] [--timings <frames.json>]\n"
+                   "--headless needs --frames, --input or --replay to know when to stop\n",
+                   argv[0]);
+        return 2;
+    }
+
     FS::CFileSystem::InitFileSystem();
+    UTILS::CLogger::Init(FS::CFileSystem::GetLogsFolderLocation());
     AUDIO::AudioPlayer::GetInstance()->Init();
-    GUI::Renderer::Get()->Initialize();
+    GUI::Renderer::Get()->Initialize(options);
+    GUI::Renderer::Destroy();
+    GUI::CSettingsWriter::Get().Flush();
     AUDIO::AudioPlayer::GetInstance()->Shutdown();
+    UTILS::CLogger::Shutdown();
     return 0;
 }